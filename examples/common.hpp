@@ -18,55 +18,89 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <camoto/gamegraphics.hpp>
+#include <camoto/stream_string.hpp>
 #include <png++/png.hpp>
 
 namespace stream = camoto::stream;
 namespace gg = camoto::gamegraphics;
 
-/// Export an image to a .png file.
+/// An image's pixels and palette, read out ready for writing to a .png.
+struct DecodedImage
+{
+	unsigned int width;         ///< Width in pixels
+	unsigned int height;        ///< Height in pixels
+	gg::StdImageDataPtr data;   ///< Pixels in standard 8bpp format
+	gg::StdImageDataPtr mask;   ///< Standard mask
+	gg::PaletteTablePtr palette; ///< Image palette, or the default for its depth
+};
+
+/// Read everything needed to write an image out as a .png.
 /**
- * Convert the given image into a PNG file on disk.
+ * This is the part of imageToPng() that touches the image, so it must be
+ * called on the thread that owns the underlying stream.
  *
  * @param img
- *   Image file to export
+ *   Image to read.
  *
- * @param destFile
- *   Filename of destination (including ".png")
+ * @param out
+ *   On return, the image's pixels and palette.
  */
-void imageToPng(gg::ImagePtr img, const std::string& destFile)
+void decodeImage(gg::ImagePtr img, DecodedImage *out)
 {
-	unsigned int width, height;
-	img->getDimensions(&width, &height);
-
-	gg::StdImageDataPtr data = img->toStandard();
-	gg::StdImageDataPtr mask = img->toStandardMask();
-
-	png::image<png::index_pixel> png(width, height);
-
-	bool useMask;
+	img->getDimensions(&out->width, &out->height);
 
-	gg::PaletteTablePtr srcPal;
+	out->data = img->toStandard();
+	out->mask = img->toStandardMask();
 
 	if (img->getCaps() & gg::Image::HasPalette) {
-		srcPal = img->getPalette();
+		out->palette = img->getPalette();
 	} else {
 		// Need to use the default palette
 		switch (img->getCaps() & gg::Image::ColourDepthMask) {
 			case gg::Image::ColourDepthVGA:
-				srcPal = gg::createPalette_DefaultVGA();
+				out->palette = gg::createPalette_DefaultVGA();
 				break;
 			case gg::Image::ColourDepthEGA:
-				srcPal = gg::createPalette_DefaultEGA();
+				out->palette = gg::createPalette_DefaultEGA();
 				break;
 			case gg::Image::ColourDepthCGA:
-				srcPal = gg::createPalette_CGA(gg::CGAPal_CyanMagenta);
+				out->palette = gg::createPalette_CGA(gg::CGAPal_CyanMagenta);
 				break;
 			case gg::Image::ColourDepthMono:
-				srcPal = gg::createPalette_DefaultMono();
+				out->palette = gg::createPalette_DefaultMono();
 				break;
 		}
 	}
+	return;
+}
+
+/// Write an image read by decodeImage() to a .png file.
+/**
+ * This only uses the data in img, so it is safe to call from any thread.
+ *
+ * @param img
+ *   Decoded image to write.
+ *
+ * @param destFile
+ *   Filename of destination (including ".png")
+ */
+void decodedImageToPng(const DecodedImage& img, const std::string& destFile)
+{
+	unsigned int width = img.width, height = img.height;
+	const gg::StdImageDataPtr& data = img.data;
+	const gg::StdImageDataPtr& mask = img.mask;
+	const gg::PaletteTablePtr& srcPal = img.palette;
+
+	png::image<png::index_pixel> png(width, height);
+
+	bool useMask;
 
 	unsigned int palSize = srcPal->size();
 	int j = 0;
@@ -118,34 +152,138 @@ void imageToPng(gg::ImagePtr img, const std::string& destFile)
 	return;
 }
 
-/// Replace an image with the contents of a .png file
+/// Export an image to a .png file.
 /**
- * Load the given PNG file and use it to replace the given image.
+ * Convert the given image into a PNG file on disk.
  *
- * @param  img  Image file to overwrite
+ * @param img
+ *   Image file to export
+ *
+ * @param destFile
+ *   Filename of destination (including ".png")
+ */
+void imageToPng(gg::ImagePtr img, const std::string& destFile)
+{
+	DecodedImage decoded;
+	decodeImage(img, &decoded);
+	decodedImageToPng(decoded, destFile);
+	return;
+}
+
+/// Check whether a .png file uses a palette.
+/**
+ * @param  srcFile  Filename of the .png
  *
+ * @return true for indexed images, false for greyscale or truecolour ones.
+ */
+bool pngIsIndexed(const std::string& srcFile)
+{
+	std::ifstream file(srcFile.c_str(), std::ios::in | std::ios::binary);
+	png::reader<std::istream> reader(file);
+	reader.read_info();
+	return reader.get_color_type() == png::color_type_palette;
+}
+
+/// Load a truecolour .png and match each pixel to the nearest palette entry.
+/**
  * @param  srcFile  Filename of source (including ".png")
+ *
+ * @param  pal  Palette to match the pixels against.
+ *
+ * @param  width  On return, the width of the image.
+ *
+ * @param  height  On return, the height of the image.
+ *
+ * @param  data  On return, the image in standard 8bpp format.
+ *
+ * @param  mask  On return, the image mask.  Pixels that are less than half
+ *   opaque are transparent.
  */
-void pngToImage(gg::ImagePtr img, const std::string& srcFile)
+void pngToStandard(const std::string& srcFile, gg::PaletteTablePtr pal,
+	unsigned int *width, unsigned int *height, gg::StdImageDataPtr *data,
+	gg::StdImageDataPtr *mask)
+{
+	png::image<png::rgba_pixel> png(srcFile);
+	*width = png.get_width();
+	*height = png.get_height();
+
+	std::vector<uint8_t> rgba(*width * *height * 4);
+	uint8_t *p = rgba.size() ? &rgba[0] : NULL;
+	for (unsigned int y = 0; y < *height; y++) {
+		for (unsigned int x = 0; x < *width; x++) {
+			const png::rgba_pixel& px = png[y][x];
+			*p++ = px.red;
+			*p++ = px.green;
+			*p++ = px.blue;
+			*p++ = px.alpha;
+		}
+	}
+
+	data->reset(new uint8_t[*width * *height]);
+	mask->reset(new uint8_t[*width * *height]);
+	if (rgba.empty()) return;
+	gg::PaletteMatcher matcher(*pal);
+	matcher.fromRGBA(&rgba[0], *width, *height, *width * 4, data->get(),
+		mask->get(), 0);
+	return;
+}
+
+/// Make sure an image is the same size as a .png being imported into it.
+/**
+ * @param  img  Image to check, resized if needed and possible.
+ *
+ * @param  pngWidth  Width of the .png image.
+ *
+ * @param  pngHeight  Height of the .png image.
+ *
+ * @throw stream::error if the sizes differ and the image can't be resized.
+ */
+void fitImageToPng(gg::ImagePtr img, unsigned int pngWidth,
+	unsigned int pngHeight)
 {
 	unsigned int width, height;
 	img->getDimensions(&width, &height);
 
-	png::image<png::index_pixel> png(srcFile);
-
-	unsigned int pngWidth = png.get_width();
-	unsigned int pngHeight = png.get_height();
 	if ((pngWidth != width) || (pngHeight != height)) {
 		if (img->getCaps() & gg::Image::CanSetDimensions) {
 			img->setDimensions(pngWidth, pngHeight);
-			width = pngWidth;
-			height = pngHeight;
 		} else {
 			throw stream::error(createString("png image is " << pngWidth << "x"
 				<< pngHeight << " but target image is fixed as " << width << "x"
 				<< height));
 		}
 	}
+	return;
+}
+
+/// Replace an image with the contents of a .png file
+/**
+ * Load the given PNG file and use it to replace the given image.
+ *
+ * Indexed images are imported as-is.  Truecolour images have each pixel
+ * mapped to the closest colour in the image's palette.
+ *
+ * @param  img  Image file to overwrite
+ *
+ * @param  srcFile  Filename of source (including ".png")
+ */
+void pngToImage(gg::ImagePtr img, const std::string& srcFile)
+{
+	if (!pngIsIndexed(srcFile)) {
+		unsigned int pngWidth, pngHeight;
+		gg::StdImageDataPtr stdimg, stdmask;
+		pngToStandard(srcFile, gg::getDisplayPalette(img), &pngWidth, &pngHeight,
+			&stdimg, &stdmask);
+		fitImageToPng(img, pngWidth, pngHeight);
+		img->fromStandard(stdimg, stdmask);
+		return;
+	}
+
+	png::image<png::index_pixel> png(srcFile);
+
+	unsigned int width = png.get_width();
+	unsigned int height = png.get_height();
+	fitImageToPng(img, width, height);
 
 	bool hasTransparency = false;
 	int pixelOffset = 0;
@@ -252,3 +390,185 @@ void imageToANSI(gg::ImagePtr img)
 	std::cout << "\x1B[0m" << std::endl;
 	return;
 }
+
+/// Current time in seconds, for timing --benchmark operations.
+double benchNow()
+{
+	static const boost::posix_time::ptime epoch =
+		boost::posix_time::microsec_clock::universal_time();
+	return (boost::posix_time::microsec_clock::universal_time() - epoch)
+		.total_microseconds() / 1000000.0;
+}
+
+/// Copy a stream into memory, so benchmarking can never alter the original.
+stream::string_sptr benchCopy(stream::input_sptr src)
+{
+	stream::string_sptr dst(new stream::string());
+	src->seekg(0, stream::start);
+	stream::copy(dst, src);
+	dst->seekg(0, stream::start);
+	dst->seekp(0, stream::start);
+	return dst;
+}
+
+/// Copy every supplementary stream into memory.
+camoto::SuppData benchCopy(const camoto::SuppData& suppData)
+{
+	camoto::SuppData copy;
+	for (camoto::SuppData::const_iterator
+		i = suppData.begin(); i != suppData.end(); i++
+	) {
+		copy[i->first] = benchCopy(i->second);
+	}
+	return copy;
+}
+
+/// Timings collected by --benchmark, grouped by operation.
+class BenchReport
+{
+	public:
+		/// Record one run of an operation.
+		/**
+		 * @param op
+		 *   Name of the operation, e.g. "decode".  Operations are reported in
+		 *   the order they are first added.
+		 *
+		 * @param seconds
+		 *   Time taken by this run.
+		 *
+		 * @param bytes
+		 *   Amount of file data handled by this run, or 0 if not known.
+		 *
+		 * @param pixels
+		 *   Number of pixels handled by this run, or 0 if not applicable.
+		 */
+		void add(const std::string& op, double seconds, unsigned long bytes,
+			unsigned long pixels)
+		{
+			Samples& s = this->ops[op];
+			if (s.seconds.empty()) this->order.push_back(op);
+			s.seconds.push_back(seconds);
+			s.bytes += bytes;
+			s.pixels += pixels;
+			return;
+		}
+
+		/// Record an item that could not be benchmarked.
+		/**
+		 * @param item
+		 *   What failed, e.g. a tileset or image ID.  Only the first failure
+		 *   of each item is kept, so repeated runs don't report it again.
+		 *
+		 * @param error
+		 *   Reason for the failure.
+		 */
+		void fail(const std::string& item, const std::string& error)
+		{
+			this->failures.insert(std::make_pair(item, error));
+			return;
+		}
+
+		/// Number of items that could not be benchmarked.
+		unsigned long failed() const
+		{
+			return this->failures.size();
+		}
+
+		/// Have any timings or failures been recorded?
+		bool empty() const
+		{
+			return this->order.empty() && this->failures.empty();
+		}
+
+		/// Print the latency and throughput of each operation.
+		/**
+		 * @param id
+		 *   What was benchmarked, e.g. a filename or tileset ID.
+		 *
+		 * @param bScript
+		 *   true to print one parseable line per operation.
+		 */
+		void print(const std::string& id, bool bScript) const
+		{
+			if (!bScript) std::cout << "Benchmark: " << id << "\n";
+			std::streamsize oldPrecision = std::cout.precision();
+			for (std::vector<std::string>::const_iterator
+				i = this->order.begin(); i != this->order.end(); i++
+			) {
+				const Samples& s = this->ops.find(*i)->second;
+				std::vector<double> sorted(s.seconds);
+				std::sort(sorted.begin(), sorted.end());
+				double total = 0;
+				for (std::vector<double>::const_iterator
+					t = sorted.begin(); t != sorted.end(); t++
+				) {
+					total += *t;
+				}
+				if (total <= 0) total = 1e-9;
+
+				unsigned long n = sorted.size();
+				double min = sorted[0];
+				double median = sorted[n / 2];
+				// Smallest sample at least 99% of the runs were no slower than
+				double p99 = sorted[(n * 99 + 99) / 100 - 1];
+				double mbPerSec = s.bytes / total / 1048576.0;
+				double mpxPerSec = s.pixels / total / 1000000.0;
+
+				if (bScript) {
+					std::cout << "benchmark=" << id
+						<< ";op=" << *i
+						<< ";runs=" << n
+						<< ";min_ms=" << min * 1000
+						<< ";median_ms=" << median * 1000
+						<< ";p99_ms=" << p99 * 1000;
+					if (s.bytes) std::cout << ";mb_per_sec=" << mbPerSec;
+					if (s.pixels) std::cout << ";mpx_per_sec=" << mpxPerSec;
+					std::cout << "\n";
+				} else {
+					std::cout << "  " << std::left << std::setw(8) << *i << std::right
+						<< std::fixed << std::setprecision(3)
+						<< std::setw(7) << n << " runs"
+						<< "  min " << std::setw(9) << min * 1000 << " ms"
+						<< "  median " << std::setw(9) << median * 1000 << " ms"
+						<< "  p99 " << std::setw(9) << p99 * 1000 << " ms";
+					if (s.bytes) std::cout << "  " << mbPerSec << " MB/s";
+					if (s.pixels) std::cout << "  " << mpxPerSec << " Mpx/s";
+					std::cout << "\n";
+					std::cout.unsetf(std::ios::floatfield);
+					std::cout.precision(oldPrecision);
+				}
+			}
+			for (std::map<std::string, std::string>::const_iterator
+				i = this->failures.begin(); i != this->failures.end(); i++
+			) {
+				if (bScript) {
+					std::cout << "benchmark=" << id
+						<< ";failed=" << i->first
+						<< ";error=" << i->second << "\n";
+				} else {
+					std::cout << "  failed  " << i->first << ": " << i->second << "\n";
+				}
+			}
+			std::cout << std::flush;
+			return;
+		}
+
+	protected:
+		/// All the runs of one operation.
+		struct Samples
+		{
+			std::vector<double> seconds; ///< Time taken by each run
+			unsigned long bytes;         ///< Total file data handled
+			unsigned long pixels;        ///< Total pixels handled
+
+			Samples()
+				:	bytes(0),
+					pixels(0)
+			{
+			}
+		};
+
+		std::vector<std::string> order;       ///< Operation names, first run first
+		std::map<std::string, Samples> ops;   ///< Runs of each operation
+		std::map<std::string, std::string> failures; ///< Error for each failed item
+};
@@ -47,6 +47,60 @@ namespace gg = camoto::gamegraphics;
 // Some files failed, but not in a common way (cut off write, disk full, etc.)
 #define RET_UNCOMMON_FAILURE   5
 
+/// Time opening, decoding and encoding an image.
+/**
+ * Each repetition works on a fresh in-memory copy of the file and its
+ * supplementary data, so the originals are never written to.
+ *
+ * @param type
+ *   Format to open the image as.
+ *
+ * @param file
+ *   Image file.
+ *
+ * @param suppData
+ *   Supplementary files needed by the format.
+ *
+ * @param repeat
+ *   Number of times to repeat each operation.
+ *
+ * @param id
+ *   Name to report the results under.
+ *
+ * @param bScript
+ *   true if -s option given (produces easily parseable output)
+ */
+void benchmarkImage(gg::ImageTypePtr type, stream::input_sptr file,
+	const camoto::SuppData& suppData, int repeat, const std::string& id,
+	bool bScript)
+{
+	BenchReport report;
+	for (int r = 0; r < repeat; r++) {
+		stream::string_sptr data = benchCopy(file);
+		camoto::SuppData supp = benchCopy(suppData);
+		unsigned long bytes = data->size();
+
+		double start = benchNow();
+		gg::ImagePtr img = type->open(data, supp);
+		report.add("open", benchNow() - start, bytes, 0);
+
+		unsigned int width, height;
+		img->getDimensions(&width, &height);
+		unsigned long pixels = width * height;
+
+		start = benchNow();
+		gg::StdImageDataPtr pixelData = img->toStandard();
+		gg::StdImageDataPtr maskData = img->toStandardMask();
+		report.add("decode", benchNow() - start, bytes, pixels);
+
+		start = benchNow();
+		img->fromStandard(pixelData, maskData);
+		report.add("encode", benchNow() - start, data->size(), pixels);
+	}
+	report.print(id, bScript);
+	return;
+}
+
 int main(int iArgC, char *cArgV[])
 {
 #ifdef __GLIBCXX__
@@ -70,6 +124,9 @@ int main(int iArgC, char *cArgV[])
 		("overwrite,o", po::value<std::string>(),
 			"replace the image with the given .png")
 
+		("benchmark,b",
+			"time opening, decoding and encoding the image, without changing it")
+
 //		("set-size,z", po::value<std::string>(),
 //			"set the tileset to the given image size in pixels (e.g. 16x16)")
 
@@ -83,6 +140,8 @@ int main(int iArgC, char *cArgV[])
 			"format output suitable for script parsing")
 		("force,f",
 			"force open even if the file is not in the given format")
+		("repeat,r", po::value<int>(),
+			"number of times to repeat each operation with --benchmark")
 		("list-types",
 			"list available types that can be passed to --type")
 	;
@@ -106,6 +165,8 @@ int main(int iArgC, char *cArgV[])
 	boost::shared_ptr<gg::Manager> pManager(gg::getManager());
 
 	bool bForceOpen = false; // open anyway even if image not in given format?
+	bool bScript = false; // show output suitable for script parsing?
+	int iRepeat = 10; // Number of times to repeat each --benchmark operation
 	try {
 		po::parsed_options pa = po::parse_command_line(iArgC, cArgV, poComplete);
 
@@ -163,6 +224,26 @@ int main(int iArgC, char *cArgV[])
 				(i->string_key.compare("force") == 0)
 			) {
 				bForceOpen = true;
+			} else if (
+				(i->string_key.compare("s") == 0) ||
+				(i->string_key.compare("script") == 0)
+			) {
+				bScript = true;
+			} else if (
+				(i->string_key.compare("r") == 0) ||
+				(i->string_key.compare("repeat") == 0)
+			) {
+				if (i->value.size() == 0) {
+					std::cerr << PROGNAME ": --repeat (-r) requires a parameter."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+				iRepeat = strtol(i->value[0].c_str(), NULL, 10);
+				if (iRepeat < 1) {
+					std::cerr << PROGNAME ": --repeat (-r) must be greater than zero."
+						<< std::endl;
+					return RET_BADARGS;
+				}
 			}
 		}
 
@@ -185,6 +266,7 @@ int main(int iArgC, char *cArgV[])
 		gg::ImageTypePtr pGfxType;
 		if (strType.empty()) {
 			// Need to autodetect the file format.
+			gg::TraceSpan span("autodetect");
 			gg::ImageTypePtr pTestType;
 			int i = 0;
 			while ((pTestType = pManager->getImageType(i++))) {
@@ -283,6 +365,10 @@ finishTesting:
 			} else if (i->string_key.compare("overwrite") == 0) {
 				pngToImage(img, i->value[0]);
 
+			} else if (i->string_key.compare("benchmark") == 0) {
+				benchmarkImage(pGfxType, psImage, suppData, iRepeat, strFilename,
+					bScript);
+
 			// Ignore --type/-t
 			} else if (i->string_key.compare("type") == 0) {
 			} else if (i->string_key.compare("t") == 0) {
@@ -292,6 +378,9 @@ finishTesting:
 			// Ignore --force/-f
 			} else if (i->string_key.compare("force") == 0) {
 			} else if (i->string_key.compare("f") == 0) {
+			// Ignore --repeat/-r
+			} else if (i->string_key.compare("repeat") == 0) {
+			} else if (i->string_key.compare("r") == 0) {
 
 			} // else it's the image filename, but we already have that
 
@@ -22,11 +22,15 @@
 #include <boost/program_options.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 #include <camoto/gamegraphics.hpp>
 #include <camoto/util.hpp>
 #include <camoto/stream_file.hpp>
 #include <iostream>
 #include "common.hpp"
+#include "manifest.hpp"
 
 namespace po = boost::program_options;
 
@@ -198,6 +202,9 @@ bool explodeId(std::vector<unsigned int> *id, const std::string& name)
  * Convert the given tileset into a PNG file on disk, by arranging each image
  * in the tileset as a grid of the given width.
  *
+ * The .png is written one row of tiles at a time, so only that many
+ * scanlines are ever held in memory no matter how big the tileset is.
+ *
  * @param tileset
  *   The tileset to export.
  *
@@ -228,7 +235,12 @@ void tilesetToPng(gg::TilesetPtr tileset, unsigned int widthTiles,
 			"are the same size");
 	}
 
-	png::image<png::index_pixel> png(width * widthTiles, height * heightTiles);
+	unsigned int pngWidth = width * widthTiles;
+	png::image_info info;
+	info.set_width(pngWidth);
+	info.set_height(height * heightTiles);
+	info.set_color_type(png::color_type_palette);
+	info.set_bit_depth(8);
 
 	bool useMask;
 	gg::PaletteTablePtr srcPal;
@@ -281,48 +293,67 @@ void tilesetToPng(gg::TilesetPtr tileset, unsigned int widthTiles,
 		pal[j] = png::color(i->red, i->green, i->blue);
 		if (i->alpha == 0x00) transparency.push_back(j);
 	}
-	png.set_palette(pal);
-	if (transparency.size()) png.set_tRNS(transparency);
-
-	int t = 0;
-	for (gg::Tileset::VC_ENTRYPTR::const_iterator i = tiles.begin();
-		i != tiles.end();
-		i++, t++
-	) {
-		if ((*i)->getAttr() & gg::Tileset::SubTileset) continue; // aah! tileset! bad!
-
-		gg::ImagePtr img = tileset->openImage(*i);
-		gg::StdImageDataPtr data = img->toStandard();
-		gg::StdImageDataPtr mask = img->toStandardMask();
-
-		unsigned int offX = (t % widthTiles) * width;
-		unsigned int offY = (t / widthTiles) * height;
+	info.set_palette(pal);
+	if (transparency.size()) info.set_tRNS(transparency);
 
-		for (unsigned int y = 0; y < height; y++) {
-			for (unsigned int x = 0; x < width; x++) {
-				if (useMask) {
-					if (mask[y*width+x] & 0x01) {
-						png[offY+y][offX+x] = png::index_pixel(0);
-					} else {
-						png[offY+y][offX+x] =
+	std::ofstream file(destFile.c_str(),
+		std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw stream::error("unable to create " + destFile);
+	}
+	png::writer<std::ostream> writer(file);
+	writer.set_image_info(info);
+	writer.write_info();
+
+	// Scanlines for one row of tiles
+	std::vector<png::byte> band(pngWidth * height);
+
+	for (unsigned int ty = 0; ty < heightTiles; ty++) {
+		// Anything not covered by a tile is palette entry 0
+		std::fill(band.begin(), band.end(), 0);
+
+		for (unsigned int tx = 0; tx < widthTiles; tx++) {
+			unsigned int t = ty * widthTiles + tx;
+			if (t >= numTiles) break;
+			if (tiles[t]->getAttr() & gg::Tileset::SubTileset) continue; // aah! tileset! bad!
+
+			gg::ImagePtr img = tileset->openImage(tiles[t]);
+			gg::StdImageDataPtr data = img->toStandard();
+			gg::StdImageDataPtr mask = img->toStandardMask();
+
+			unsigned int offX = tx * width;
+
+			for (unsigned int y = 0; y < height; y++) {
+				png::byte *row = &band[y * pngWidth + offX];
+				for (unsigned int x = 0; x < width; x++) {
+					if (useMask) {
+						if (mask[y*width+x] & 0x01) {
+							row[x] = 0;
+						} else {
 							// +1 to the colour to skip over transparent (#0)
-							png::index_pixel(data[y*width+x] + 1);
+							row[x] = data[y*width+x] + 1;
+						}
+					} else {
+						row[x] = data[y*width+x];
 					}
-				} else {
-					png[offY+y][offX+x] = png::index_pixel(data[y*width+x]);
 				}
 			}
 		}
+
+		for (unsigned int y = 0; y < height; y++) {
+			writer.write_row(&band[y * pngWidth]);
+		}
 	}
 
-	png.write(destFile);
+	writer.write_end_info();
 	return;
 }
 
 /// Replace a tileset with the contents of a .png file
 /**
  * Load the given PNG file and use it to replace the given tileset.  The .png
- * image must be an even multiple of the tile width.
+ * image must be an even multiple of the tile width.  Truecolour images have
+ * each pixel mapped to the closest colour in the tileset's palette.
  *
  * @param  tileset  Tileset to overwrite
  *
@@ -330,8 +361,6 @@ void tilesetToPng(gg::TilesetPtr tileset, unsigned int widthTiles,
  */
 void pngToTileset(gg::TilesetPtr tileset, const std::string& srcFile)
 {
-	png::image<png::index_pixel> png(srcFile);
-
 	unsigned int width, height;
 	tileset->getTilesetDimensions(&width, &height);
 	if ((width == 0) || (height == 0)) {
@@ -339,13 +368,6 @@ void pngToTileset(gg::TilesetPtr tileset, const std::string& srcFile)
 			"are the same size");
 	}
 
-	if ((png.get_width() % width) != 0) {
-		throw stream::error("image width must be a multiple of the tile width");
-	}
-	if ((png.get_height() % height) != 0) {
-		throw stream::error("image height must be a multiple of the tile height");
-	}
-
 	gg::PaletteTablePtr tilesetPal;
 	if (tileset->getCaps() & gg::Tileset::HasPalette) {
 		tilesetPal = tileset->getPalette();
@@ -367,84 +389,296 @@ void pngToTileset(gg::TilesetPtr tileset, const std::string& srcFile)
 		}
 	}
 
-	signed int paletteMap[256]; ///< -1 means that colour is transparent, 0 == EGA/VGA black, etc.
-	// Create a palette map in case the .png colours aren't in the same
-	// order as the original palette.  This is needed because some image
-	// editors (e.g. GIMP) omit colours from the palette if they are
-	// unused, messing up the index values.
-	memset(paletteMap, 0, sizeof(paletteMap));
-	const png::palette& pngPal = png.get_palette();
-	int i_index = 0;
-	for (png::palette::const_iterator
-		i = pngPal.begin(); i != pngPal.end(); i++, i_index++
-	) {
-		int j_index = 0;
-		for (gg::PaletteTable::iterator
-			j = tilesetPal->begin(); j != tilesetPal->end(); j++, j_index++
+	// Convert the whole .png into standard image data first, then cut the
+	// tiles out of that.
+	unsigned int pngWidth, pngHeight;
+	gg::StdImageDataPtr sheetData, sheetMask;
+	if (pngIsIndexed(srcFile)) {
+		png::image<png::index_pixel> png(srcFile);
+		pngWidth = png.get_width();
+		pngHeight = png.get_height();
+
+		// Create a palette map in case the .png colours aren't in the same
+		// order as the original palette.  This is needed because some image
+		// editors (e.g. GIMP) omit colours from the palette if they are
+		// unused, messing up the index values.  Colours that aren't in the
+		// tileset palette are mapped to the closest one that is.
+		signed int paletteMap[256]; ///< -1 means that colour is transparent, 0 == EGA/VGA black, etc.
+		memset(paletteMap, 0, sizeof(paletteMap));
+		gg::PaletteMatcher matcher(*tilesetPal);
+		const png::palette& pngPal = png.get_palette();
+		int i_index = 0;
+		for (png::palette::const_iterator
+			i = pngPal.begin(); (i != pngPal.end()) && (i_index < 256); i++, i_index++
 		) {
-			if (
-				(i->red == j->red) &&
-				(i->green == j->green) &&
-				(i->blue == j->blue)
-			) {
-				paletteMap[i_index] = j_index;
+			paletteMap[i_index] = matcher.nearest(i->red, i->green, i->blue);
+		}
+		png::tRNS transparency = png.get_tRNS();
+		for (png::tRNS::const_iterator
+			tx = transparency.begin(); tx != transparency.end(); tx++
+		) {
+			// This colour index is transparent
+			paletteMap[*tx] = -1;
+		}
+
+		sheetData.reset(new uint8_t[pngWidth * pngHeight]);
+		sheetMask.reset(new uint8_t[pngWidth * pngHeight]);
+		for (unsigned int y = 0; y < pngHeight; y++) {
+			for (unsigned int x = 0; x < pngWidth; x++) {
+				signed int pixel = paletteMap[png[y][x]];
+				if (pixel == -1) { // Palette #0 must be transparent
+					sheetMask[y * pngWidth + x] = 0x01; // transparent
+					sheetData[y * pngWidth + x] = 0x00; // use black in case someone else ignores transparency
+				} else {
+					sheetMask[y * pngWidth + x] = 0x00; // opaque
+					sheetData[y * pngWidth + x] = pixel;
+				}
 			}
 		}
+	} else {
+		// Truecolour artwork, match each pixel to the tileset palette
+		pngToStandard(srcFile, tilesetPal, &pngWidth, &pngHeight, &sheetData,
+			&sheetMask);
 	}
-	png::tRNS transparency = png.get_tRNS();
-	for (png::tRNS::const_iterator
-		tx = transparency.begin(); tx != transparency.end(); tx++
-	) {
-		// This colour index is transparent
-		paletteMap[*tx] = -1;
+
+	if ((pngWidth % width) != 0) {
+		throw stream::error("image width must be a multiple of the tile width");
+	}
+	if ((pngHeight % height) != 0) {
+		throw stream::error("image height must be a multiple of the tile height");
 	}
 
-	unsigned int tilesX = png.get_width() / width;
-	unsigned int tilesY = png.get_height() / height;
+	unsigned int tilesX = pngWidth / width;
+	unsigned int tilesY = pngHeight / height;
 	const gg::Tileset::VC_ENTRYPTR& tiles = tileset->getItems();
 	unsigned int numTiles = tiles.size();
 	if (numTiles > tilesX * tilesY) numTiles = tilesX * tilesY;
 
-	int imgSizeBytes = width * height;
-	uint8_t *imgData = new uint8_t[imgSizeBytes];
-	uint8_t *maskData = new uint8_t[imgSizeBytes];
-	gg::StdImageDataPtr stdimg(imgData);
-	gg::StdImageDataPtr stdmask(maskData);
-
-	int t = 0;
-	for (gg::Tileset::VC_ENTRYPTR::const_iterator i = tiles.begin();
-		i != tiles.end();
-		i++, t++
-	) {
-		if ((*i)->getAttr() & gg::Tileset::SubTileset) continue; // aah! tileset! bad!
+	// Cut out every tile first, then replace them all at once so the tileset
+	// can encode them in parallel and rewrite the file in a single pass.
+	unsigned int imgSizeBytes = width * height;
+	std::vector<gg::StdImageDataPtr> newData(tiles.size()), newMask(tiles.size());
+	for (unsigned int t = 0; t < numTiles; t++) {
+		// aah! tileset! bad!
+		if (tiles[t]->getAttr() & (gg::Tileset::SubTileset | gg::Tileset::EmptySlot)) {
+			continue;
+		}
 
-		gg::ImagePtr img = tileset->openImage(*i);
+		uint8_t *imgData = new uint8_t[imgSizeBytes];
+		uint8_t *maskData = new uint8_t[imgSizeBytes];
+		newData[t].reset(imgData);
+		newMask[t].reset(maskData);
 
 		unsigned int offX = (t % tilesX) * width;
 		unsigned int offY = (t / tilesX) * height;
 
 		for (unsigned int y = 0; y < height; y++) {
-			for (unsigned int x = 0; x < width; x++) {
-				signed int pixel = paletteMap[png[offY + y][offX + x]];
-				if (pixel == -1) { // Palette #0 must be transparent
-					maskData[y * width + x] = 0x01; // transparent
-					imgData[y * width + x] = 0x00; // use black in case someone else ignores transparency
+			unsigned long src = (offY + y) * pngWidth + offX;
+			memcpy(&imgData[y * width], &sheetData[src], width);
+			memcpy(&maskData[y * width], &sheetMask[src], width);
+		}
+
+		// TODO: If the image format supports custom palettes (Image::HasPalette)
+		// update it from the PNG image.
+	}
+	tileset->replaceAll(newData, newMask);
+
+	return;
+}
+
+/// Does the given file exist?
+static bool fileExists(const std::string& filename)
+{
+	std::ifstream f(filename.c_str());
+	return f.good();
+}
+
+/// One image waiting to be written out by extractAllImages().
+struct ExtractJob
+{
+	ExtractJob()
+		:	hasFingerprint(false),
+			fingerprint(0),
+			unchanged(false)
+	{
+	}
+
+	std::string id;        ///< Image ID, e.g. "0.1"
+	std::string filename;  ///< Destination .png file
+	DecodedImage image;    ///< Image read out of the tileset
+	std::string error;     ///< Reason for failure, empty on success
+	bool hasFingerprint;   ///< true if fingerprint is valid
+	uint64_t fingerprint;  ///< Value to record in the manifest once written
+	bool unchanged;        ///< true if the existing file is already up to date
+};
+
+/// Write out extracted images in batches, on multiple threads if requested.
+/**
+ * Images are read on the calling thread, as the tileset streams are not
+ * thread safe, but the PNG encoding and compression (most of the work) is
+ * shared between the worker threads.  Results are always reported in the
+ * order the images were added.
+ */
+class ExtractQueue
+{
+	public:
+		/// Set up a queue.
+		/**
+		 * @param jobs
+		 *   Number of threads to encode images with.  1 encodes on the calling
+		 *   thread.
+		 *
+		 * @param bScript
+		 *   true if -s option given (produces easily parseable output)
+		 *
+		 * @param manifest
+		 *   Manifest to record successfully written images in, or NULL.
+		 */
+		ExtractQueue(unsigned int jobs, bool bScript, Manifest *manifest)
+			:	jobs(jobs),
+				bScript(bScript),
+				manifest(manifest),
+				failures(0),
+				next(0)
+		{
+			// Enough images to keep every thread busy between reports
+			this->batchSize = jobs * 16;
+		}
+
+		/// Queue up an image, writing out the batch if it is full.
+		void add(const ExtractJob& job)
+		{
+			this->pending.push_back(job);
+			if (this->pending.size() >= this->batchSize) this->flush();
+			return;
+		}
+
+		/// Write out and report on every queued image.
+		void flush()
+		{
+			if (this->pending.empty()) return;
+
+			this->next = 0;
+			if (this->jobs <= 1) {
+				this->worker();
+			} else {
+				boost::thread_group threads;
+				for (unsigned int i = 0; i < this->jobs; i++) {
+					threads.create_thread(boost::bind(&ExtractQueue::worker, this));
+				}
+				threads.join_all();
+			}
+
+			for (std::vector<ExtractJob>::const_iterator
+				i = this->pending.begin(); i != this->pending.end(); i++
+			) {
+				if (!i->error.empty()) {
+					this->failures++;
+				} else if (this->manifest && i->hasFingerprint) {
+					this->manifest->record(i->id, i->fingerprint, false);
+				}
+				if (this->bScript) {
+					std::cout << "id=" << i->id
+						<< ";filename=" << i->filename
+						<< ";status=" << (!i->error.empty() ? "fail"
+							: (i->unchanged ? "unchanged" : "ok")) << std::endl;
+				} else if (i->unchanged) {
+					std::cout << "  unchanged: " << i->filename << std::endl;
 				} else {
-					maskData[y * width + x] = 0x00; // opaque
-					imgData[y * width + x] = pixel;
+					std::cout << " extracting: " << i->filename << std::endl;
+					if (!i->error.empty()) {
+						std::cout << " [failed; " << i->error << "]" << std::endl;
+					}
 				}
 			}
+			this->pending.clear();
+			return;
 		}
 
-		if (img->getCaps() & gg::Image::HasPalette) {
-			// TODO: This format supports custom palettes, so update it from the
-			// PNG image.
-			//img->setPalette(...);
+		/// Number of images that have failed so far, once flushed.
+		unsigned long getFailures() const
+		{
+			return this->failures;
 		}
-		img->fromStandard(stdimg, stdmask);
+
+	protected:
+		unsigned int jobs;      ///< Number of encoding threads
+		bool bScript;           ///< Report in script-parseable form
+		Manifest *manifest;     ///< Where to record written images, or NULL
+		unsigned long failures; ///< Images that could not be written
+		unsigned int batchSize; ///< Images to queue before writing them out
+		std::vector<ExtractJob> pending; ///< Images to write, in report order
+		unsigned int next;      ///< Next entry in pending to be encoded
+		boost::mutex nextLock;  ///< Protects next
+
+		/// Encode queued images until there are none left.
+		void worker()
+		{
+			for (;;) {
+				unsigned int n;
+				{
+					boost::mutex::scoped_lock lock(this->nextLock);
+					n = this->next++;
+				}
+				if (n >= this->pending.size()) break;
+
+				ExtractJob& job = this->pending[n];
+				if (!job.error.empty()) continue; // couldn't be read
+				if (job.unchanged) continue;
+
+				try {
+					decodedImageToPng(job.image, job.filename);
+				} catch (std::exception& e) {
+					job.error = e.what();
+				}
+				// Free the pixels now rather than at the end of the batch
+				job.image = DecodedImage();
+			}
+			return;
+		}
+};
+
+/// Carry an unchanged sub-tileset over from the last run without opening it.
+/**
+ * @param id
+ *   ID of the sub-tileset.
+ *
+ * @param queue
+ *   Queue to report the sub-tileset's images through as unchanged.
+ *
+ * @param manifest
+ *   Manifest from the last run.
+ *
+ * @return true if everything in the sub-tileset was carried over, false if
+ *   one of its images is missing and the sub-tileset must be extracted again.
+ */
+bool reuseTileset(const std::string& id, ExtractQueue& queue,
+	Manifest *manifest)
+{
+	ManifestEntries children;
+	manifest->getChildren(id, &children);
+	for (ManifestEntries::const_iterator
+		i = children.begin(); i != children.end(); i++
+	) {
+		if (!i->second.isTileset && !fileExists(i->first + ".png")) return false;
 	}
 
-	return;
+	for (ManifestEntries::const_iterator
+		i = children.begin(); i != children.end(); i++
+	) {
+		if (i->second.isTileset) {
+			manifest->record(i->first, i->second.fingerprint, true);
+		} else {
+			ExtractJob job;
+			job.id = i->first;
+			job.filename = i->first + ".png";
+			job.hasFingerprint = true;
+			job.fingerprint = i->second.fingerprint;
+			job.unchanged = true;
+			queue.add(job);
+		}
+	}
+	return true;
 }
 
 /// Export all images in the graphics file as either individual images or
@@ -468,12 +702,31 @@ void pngToTileset(gg::TilesetPtr tileset, const std::string& srcFile)
  *
  * @param bScript
  *   true if -s option given (produces easily parseable output)
+ *
+ * @param queue
+ *   Queue the individual images are written out through.  The caller must
+ *   flush it once this function returns.
+ *
+ * @param manifest
+ *   Fingerprints from the last run, to skip images whose source data hasn't
+ *   changed.  NULL to write out everything.  Only used when
+ *   tilesetAsSingleImage is false.
+ *
+ * @param parentFingerprint
+ *   Manifest fingerprint of this tileset, mixed into those of its entries so
+ *   they are written out again if only the tileset's header changes.  0 on
+ *   first call.
  */
 void extractAllImages(std::string prefix, bool tilesetAsSingleImage,
-	int widthTiles, gg::TilesetPtr tileset, bool bScript
+	int widthTiles, gg::TilesetPtr tileset, bool bScript, ExtractQueue& queue,
+	Manifest *manifest, uint64_t parentFingerprint
 ) {
 	const gg::Tileset::VC_ENTRYPTR& tiles = tileset->getItems();
 
+	// Images are drawn in the tileset's palette, which may not be stored with
+	// the entries themselves, so it must be part of their fingerprints.
+	uint64_t palHash = manifest ? hashPalette(tileset) : 0;
+
 	int j = 0;
 	for (gg::Tileset::VC_ENTRYPTR::const_iterator i = tiles.begin();
 		i != tiles.end();
@@ -482,6 +735,9 @@ void extractAllImages(std::string prefix, bool tilesetAsSingleImage,
 		try {
 			if ((*i)->getAttr() & gg::Tileset::SubTileset) {
 				if (tilesetAsSingleImage) {
+					// Report any earlier images first so the output stays in order
+					queue.flush();
+
 					std::ostringstream ssFilename;
 					ssFilename << prefix << '.' << ".png";
 					if (bScript) {
@@ -507,29 +763,69 @@ void extractAllImages(std::string prefix, bool tilesetAsSingleImage,
 				} else {
 					std::ostringstream ss;
 					ss << prefix << '.' << j;
+
+					uint64_t fingerprint;
+					bool hasFingerprint = manifest
+						&& getManifestFingerprint(tileset, *i, palHash, parentFingerprint,
+							&fingerprint);
+					if (hasFingerprint) {
+						if (manifest->matches(ss.str(), fingerprint, true)
+							&& reuseTileset(ss.str(), queue, manifest)
+						) {
+							manifest->record(ss.str(), fingerprint, true);
+							continue;
+						}
+						// Only record the sub-tileset if all of it is written out
+						queue.flush();
+					}
+					unsigned long failuresBefore = queue.getFailures();
+
 					gg::TilesetPtr sub = tileset->openTileset(*i);
 					assert(sub); // must throw exception on failure
 					extractAllImages(ss.str(), tilesetAsSingleImage, widthTiles,
-						sub, bScript);
+						sub, bScript, queue, manifest,
+						hasFingerprint ? fingerprint : parentFingerprint);
+
+					if (hasFingerprint) {
+						queue.flush();
+						if (queue.getFailures() == failuresBefore) {
+							manifest->record(ss.str(), fingerprint, true);
+						}
+					}
 				}
 
 			} else { // single image
-				std::ostringstream ssFilename;
-				ssFilename << prefix << '.' << j << ".png";
-				if (bScript) {
-					std::cout << "id=" << prefix << '.' << j
-						<< ";filename=" << ssFilename.str()
-						<< ";status=";
-				} else {
-					std::cout << " extracting: " << ssFilename.str() << std::endl;
+				std::ostringstream ssID, ssFilename;
+				ssID << prefix << '.' << j;
+				ssFilename << ssID.str() << ".png";
+
+				ExtractJob job;
+				job.id = ssID.str();
+				job.filename = ssFilename.str();
+				if (manifest && getManifestFingerprint(tileset, *i, palHash,
+					parentFingerprint, &job.fingerprint)
+				) {
+					job.hasFingerprint = true;
+					if (manifest->matches(job.id, job.fingerprint, false)
+						&& fileExists(job.filename)
+					) {
+						// Already written out last time, no need to decode it
+						job.unchanged = true;
+						queue.add(job);
+						continue;
+					}
 				}
-				gg::ImagePtr img = tileset->openImage(*i);
-				imageToPng(img, ssFilename.str());
-				if (bScript) {
-					std::cout << "ok" << std::endl;
+				try {
+					gg::ImagePtr img = tileset->openImage(*i);
+					decodeImage(img, &job.image);
+				} catch (std::exception& e) {
+					job.error = e.what();
+					//iRet = RET_NONCRITICAL_FAILURE; // one or more files failed
 				}
+				queue.add(job);
 			}
 		} catch (std::exception& e) {
+			queue.flush();
 			if (bScript) {
 				std::cout << "fail" << std::endl;
 			} else {
@@ -542,6 +838,154 @@ void extractAllImages(std::string prefix, bool tilesetAsSingleImage,
 	return;
 }
 
+/// Timings for each tileset in the file, keyed by tileset ID.
+typedef std::map<std::string, BenchReport> BenchReports;
+
+/// Time decoding and encoding every image in a tileset and its children.
+/**
+ * The results are recorded against both the overall report and the
+ * tileset the image is in, using the same IDs as --list.  Opening a
+ * sub-tileset is timed as "open-sub", separately from opening the file.
+ * An image or sub-tileset that throws an exception is recorded as a failure
+ * and skipped, so the rest of the file is still benchmarked.
+ *
+ * @param prefix
+ *   ID of this tileset (use "0" on first call)
+ *
+ * @param tileset
+ *   Tileset to go through.
+ *
+ * @param total
+ *   Overall results for the whole file.
+ *
+ * @param byTileset
+ *   Results for each tileset.
+ *
+ * @param order
+ *   Tileset IDs in the order they were first visited.
+ */
+void benchmarkEntries(const std::string& prefix, gg::TilesetPtr tileset,
+	BenchReport *total, BenchReports *byTileset, std::vector<std::string> *order)
+{
+	if (byTileset->find(prefix) == byTileset->end()) order->push_back(prefix);
+	BenchReport& report = (*byTileset)[prefix];
+
+	const gg::Tileset::VC_ENTRYPTR& tiles = tileset->getItems();
+	int j = 0;
+	for (gg::Tileset::VC_ENTRYPTR::const_iterator i = tiles.begin();
+		i != tiles.end();
+		i++, j++
+	) {
+		if ((*i)->getAttr() & gg::Tileset::EmptySlot) continue;
+
+		std::ostringstream ss;
+		ss << prefix << '.' << j;
+
+		if ((*i)->getAttr() & gg::Tileset::SubTileset) {
+			gg::TilesetPtr sub;
+			double start = benchNow();
+			try {
+				sub = tileset->openTileset(*i);
+			} catch (const std::exception& e) {
+				total->fail(ss.str(), e.what());
+				report.fail(ss.str(), e.what());
+				continue;
+			}
+			double elapsed = benchNow() - start;
+			total->add("open-sub", elapsed, 0, 0);
+			report.add("open-sub", elapsed, 0, 0);
+
+			benchmarkEntries(ss.str(), sub, total, byTileset, order);
+			continue;
+		}
+
+		try {
+			double start = benchNow();
+			gg::ImagePtr img = tileset->openImage(*i);
+			gg::StdImageDataPtr data = img->toStandard();
+			gg::StdImageDataPtr mask = img->toStandardMask();
+			double elapsed = benchNow() - start;
+
+			unsigned int width, height;
+			img->getDimensions(&width, &height);
+			unsigned long pixels = width * height;
+			total->add("decode", elapsed, 0, pixels);
+			report.add("decode", elapsed, 0, pixels);
+
+			start = benchNow();
+			img->fromStandard(data, mask);
+			elapsed = benchNow() - start;
+			total->add("encode", elapsed, 0, pixels);
+			report.add("encode", elapsed, 0, pixels);
+		} catch (const std::exception& e) {
+			total->fail(ss.str(), e.what());
+			report.fail(ss.str(), e.what());
+		}
+	}
+	return;
+}
+
+/// Time opening, decoding, encoding and flushing a whole tileset.
+/**
+ * Each repetition works on a fresh in-memory copy of the file and its
+ * supplementary data, so the originals are never written to.  The overall
+ * results are followed by a breakdown for each sub-tileset.
+ *
+ * @param type
+ *   Format to open the tileset as.
+ *
+ * @param file
+ *   Tileset file.
+ *
+ * @param suppData
+ *   Supplementary files needed by the format.
+ *
+ * @param repeat
+ *   Number of times to go through the whole tileset.
+ *
+ * @param id
+ *   Name to report the overall results under.
+ *
+ * @param bScript
+ *   true if -s option given (produces easily parseable output)
+ *
+ * @return true if every image and sub-tileset could be benchmarked.
+ */
+bool benchmarkTileset(gg::TilesetTypePtr type, stream::input_sptr file,
+	const camoto::SuppData& suppData, int repeat, const std::string& id,
+	bool bScript)
+{
+	BenchReport total;
+	BenchReports byTileset;
+	std::vector<std::string> order;
+
+	for (int r = 0; r < repeat; r++) {
+		stream::string_sptr data = benchCopy(file);
+		camoto::SuppData supp = benchCopy(suppData);
+
+		double start = benchNow();
+		gg::TilesetPtr tileset = type->open(data, supp);
+		total.add("open", benchNow() - start, data->size(), 0);
+
+		benchmarkEntries("0", tileset, &total, &byTileset, &order);
+
+		start = benchNow();
+		tileset->flush();
+		total.add("flush", benchNow() - start, data->size(), 0);
+	}
+
+	total.print(id, bScript);
+	if (order.size() > 1) {
+		for (std::vector<std::string>::const_iterator
+			i = order.begin(); i != order.end(); i++
+		) {
+			const BenchReport& report = byTileset[*i];
+			if (!report.empty()) report.print(*i, bScript);
+		}
+	}
+	return total.failed() == 0;
+}
+
 /// Find the EntryPtr for the given (user-supplied) ID.
 /**
  * Take the given ID and try to open it.
@@ -640,6 +1084,10 @@ int main(int iArgC, char *cArgV[])
 		("set-size,z", po::value<std::string>(),
 			"set the tileset to the given image size in pixels (e.g. 16x16)")
 
+		("benchmark,b",
+			"time opening, decoding, encoding and flushing every image, without "
+			"changing the file")
+
 	;
 
 	po::options_description poOptions("Options");
@@ -652,6 +1100,13 @@ int main(int iArgC, char *cArgV[])
 			"force open even if the file is not in the given format")
 		("width,w", po::value<int>(),
 			"width (in tiles) when exporting whole tileset")
+		("jobs,j", po::value<int>(),
+			"number of threads to write images with when extracting all")
+		("repeat,r", po::value<int>(),
+			"number of times to repeat each operation with --benchmark")
+		("manifest,m", po::value<std::string>(),
+			"with --extract-all-images, only write images changed since the "
+			"given manifest file was last updated, then update it")
 		("list-types",
 			"list available types that can be passed to --type")
 	;
@@ -678,6 +1133,9 @@ int main(int iArgC, char *cArgV[])
 	bool bScript = false; // show output suitable for script parsing?
 	bool bForceOpen = false; // open anyway even if tileset not in given format?
 	int iTilesetExportWidth = 0;  // Width when exporting whole tileset as single file (0 == entire tileset on one line)
+	int iJobs = 1; // Number of threads to encode extracted images with
+	int iRepeat = 10; // Number of times to repeat each --benchmark operation
+	std::string strManifest; // Fingerprints of previously extracted images
 	try {
 		po::parsed_options pa = po::parse_command_line(iArgC, cArgV, poComplete);
 
@@ -754,6 +1212,46 @@ int main(int iArgC, char *cArgV[])
 						<< std::endl;
 					return RET_BADARGS;
 				}
+			} else if (
+				(i->string_key.compare("j") == 0) ||
+				(i->string_key.compare("jobs") == 0)
+			) {
+				if (i->value.size() == 0) {
+					std::cerr << PROGNAME ": --jobs (-j) requires a parameter."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+				iJobs = strtol(i->value[0].c_str(), NULL, 10);
+				if (iJobs < 1) {
+					std::cerr << PROGNAME ": --jobs (-j) must be greater than zero."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+			} else if (
+				(i->string_key.compare("r") == 0) ||
+				(i->string_key.compare("repeat") == 0)
+			) {
+				if (i->value.size() == 0) {
+					std::cerr << PROGNAME ": --repeat (-r) requires a parameter."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+				iRepeat = strtol(i->value[0].c_str(), NULL, 10);
+				if (iRepeat < 1) {
+					std::cerr << PROGNAME ": --repeat (-r) must be greater than zero."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+			} else if (
+				(i->string_key.compare("m") == 0) ||
+				(i->string_key.compare("manifest") == 0)
+			) {
+				if (i->value.size() == 0) {
+					std::cerr << PROGNAME ": --manifest (-m) requires a parameter."
+						<< std::endl;
+					return RET_BADARGS;
+				}
+				strManifest = i->value[0];
 			}
 		}
 
@@ -776,6 +1274,7 @@ int main(int iArgC, char *cArgV[])
 		gg::TilesetTypePtr pGfxType;
 		if (strType.empty()) {
 			// Need to autodetect the file format.
+			gg::TraceSpan span("autodetect");
 			gg::TilesetTypePtr pTestType;
 			int i = 0;
 			while ((pTestType = pManager->getTilesetType(i++))) {
@@ -869,11 +1368,27 @@ finishTesting:
 			if (i->string_key.compare("list") == 0) {
 				printTilesetList("0", pTileset, bScript);
 
+			} else if (i->string_key.compare("benchmark") == 0) {
+				if (!benchmarkTileset(pGfxType, psTileset, suppData, iRepeat,
+					strFilename, bScript)
+				) {
+					iRet = RET_NONCRITICAL_FAILURE; // one or more items failed
+				}
+
 			} else if (i->string_key.compare("extract-all-images") == 0) {
-				extractAllImages("0", false, iTilesetExportWidth, pTileset, bScript);
+				boost::scoped_ptr<Manifest> manifest;
+				if (!strManifest.empty()) manifest.reset(new Manifest(strManifest));
+				ExtractQueue queue(iJobs, bScript, manifest.get());
+				extractAllImages("0", false, iTilesetExportWidth, pTileset, bScript,
+					queue, manifest.get(), 0);
+				queue.flush();
+				if (manifest) manifest->save();
 
 			} else if (i->string_key.compare("extract-all-tilesets") == 0) {
-				extractAllImages("0", true, iTilesetExportWidth, pTileset, bScript);
+				ExtractQueue queue(iJobs, bScript, NULL);
+				extractAllImages("0", true, iTilesetExportWidth, pTileset, bScript,
+					queue, NULL, 0);
+				queue.flush();
 
 			} else if (i->string_key.compare("extract") == 0) {
 				std::string id, strLocalFile;
@@ -0,0 +1,185 @@
+/**
+ * @file  manifest.hpp
+ * @brief Fingerprints of images written out by gametls --manifest.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMETLS_MANIFEST_HPP_
+#define _CAMOTO_GAMETLS_MANIFEST_HPP_
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <camoto/gamegraphics.hpp>
+
+namespace stream = camoto::stream;
+namespace gg = camoto::gamegraphics;
+
+/// Fingerprint of one entry as recorded in a Manifest.
+struct ManifestEntry
+{
+	uint64_t fingerprint;  ///< Source data fingerprint, mixed with the palette
+	bool isTileset;        ///< true for a sub-tileset, false for an image
+};
+
+/// Manifest entries keyed by ID, e.g. "0.1".
+typedef std::map<std::string, ManifestEntry> ManifestEntries;
+
+/// Fingerprints of everything written out by the last --extract-all-images.
+/**
+ * The manifest is a text file with one "<id> <fingerprint> <i|t>" line per
+ * image or sub-tileset.  Entries are only recorded once they have been
+ * written out successfully, so anything that failed is tried again next time.
+ */
+class Manifest
+{
+	public:
+		/// Load the manifest, if it exists.
+		Manifest(const std::string& filename)
+			:	filename(filename)
+		{
+			std::ifstream in(filename.c_str());
+			std::string id, kind;
+			ManifestEntry e;
+			while (in >> id >> std::hex >> e.fingerprint >> kind) {
+				e.isTileset = (kind.compare("t") == 0);
+				this->previous[id] = e;
+			}
+		}
+
+		/// Does the entry have the same fingerprint as last time?
+		bool matches(const std::string& id, uint64_t fingerprint,
+			bool isTileset) const
+		{
+			ManifestEntries::const_iterator i = this->previous.find(id);
+			return (i != this->previous.end())
+				&& (i->second.fingerprint == fingerprint)
+				&& (i->second.isTileset == isTileset);
+		}
+
+		/// Get everything recorded inside a sub-tileset last time.
+		void getChildren(const std::string& id, ManifestEntries *children) const
+		{
+			std::string prefix = id + '.';
+			for (ManifestEntries::const_iterator
+				i = this->previous.lower_bound(prefix);
+				(i != this->previous.end())
+					&& (i->first.compare(0, prefix.length(), prefix) == 0);
+				i++
+			) {
+				children->insert(*i);
+			}
+			return;
+		}
+
+		/// Record an entry as up to date for next time.
+		void record(const std::string& id, uint64_t fingerprint, bool isTileset)
+		{
+			ManifestEntry& e = this->current[id];
+			e.fingerprint = fingerprint;
+			e.isTileset = isTileset;
+			return;
+		}
+
+		/// Write out everything recorded, replacing the previous manifest.
+		void save() const
+		{
+			std::ofstream out(this->filename.c_str());
+			if (!out) throw stream::error("unable to create " + this->filename);
+			out << std::hex << std::setfill('0');
+			for (ManifestEntries::const_iterator
+				i = this->current.begin(); i != this->current.end(); i++
+			) {
+				out << i->first << ' ' << std::setw(16) << i->second.fingerprint
+					<< ' ' << (i->second.isTileset ? 't' : 'i') << '\n';
+			}
+			if (!out.flush()) throw stream::error("unable to write " + this->filename);
+			return;
+		}
+
+	protected:
+		std::string filename;     ///< Where the manifest is stored
+		ManifestEntries previous; ///< Entries loaded from the file
+		ManifestEntries current;  ///< Entries written out this time
+};
+
+/// Hash the palette a tileset draws its images in.
+/**
+ * @param tileset
+ *   Tileset to hash.
+ *
+ * @return Hash of the tileset's palette, or 0 if it doesn't have one.
+ */
+uint64_t hashPalette(gg::TilesetPtr tileset)
+{
+	if (!(tileset->getCaps() & gg::Tileset::HasPalette)) return 0;
+	gg::PaletteTablePtr pal = tileset->getPalette();
+	if (!pal) return 0;
+
+	uint64_t h = 14695981039346656037ULL; // FNV-1a
+	for (gg::PaletteTable::const_iterator i = pal->begin(); i != pal->end(); i++) {
+		uint8_t c[4] = {i->red, i->green, i->blue, i->alpha};
+		for (unsigned int n = 0; n < 4; n++) {
+			h ^= c[n];
+			h *= 1099511628211ULL;
+		}
+	}
+	return h;
+}
+
+/// Combine a fingerprint with another value it depends on.
+uint64_t mixFingerprint(uint64_t fingerprint, uint64_t other)
+{
+	return fingerprint ^ (other + 0x9e3779b97f4a7c15ULL
+		+ (fingerprint << 6) + (fingerprint >> 2));
+}
+
+/// Get the fingerprint to record in a Manifest for one entry.
+/**
+ * An entry's own fingerprint only covers its own data, but how it looks also
+ * depends on the palette of the tileset it is in, and on the header of the
+ * sub-tileset containing it (e.g. a colour map), so both are mixed in.
+ *
+ * @param tileset
+ *   Tileset containing the entry.
+ *
+ * @param id
+ *   Entry to fingerprint.
+ *
+ * @param palHash
+ *   Value returned by hashPalette() for the tileset.
+ *
+ * @param parentFingerprint
+ *   Manifest fingerprint of the sub-tileset, or 0 at the top level.
+ *
+ * @param fingerprint
+ *   On return, the fingerprint to record.
+ *
+ * @return true if fingerprint was set, false if the tileset can't
+ *   fingerprint this entry.
+ */
+bool getManifestFingerprint(gg::TilesetPtr tileset,
+	const gg::Tileset::EntryPtr& id, uint64_t palHash, uint64_t parentFingerprint,
+	uint64_t *fingerprint)
+{
+	if (!tileset->getFingerprint(id, fingerprint)) return false;
+	*fingerprint = mixFingerprint(mixFingerprint(*fingerprint, palHash),
+		parentFingerprint);
+	return true;
+}
+
+#endif // _CAMOTO_GAMETLS_MANIFEST_HPP_
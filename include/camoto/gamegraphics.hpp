@@ -89,10 +89,17 @@ Additional information is available from the Camoto homepage
 
 // These are all in the camoto::gamegraphics namespace
 #include <camoto/gamegraphics/palettetable.hpp>
+#include <camoto/gamegraphics/palettematch.hpp>
 #include <camoto/gamegraphics/image.hpp>
 #include <camoto/gamegraphics/imagetype.hpp>
 #include <camoto/gamegraphics/tileset.hpp>
 #include <camoto/gamegraphics/tilesettype.hpp>
 #include <camoto/gamegraphics/manager.hpp>
+#include <camoto/gamegraphics/rgba.hpp>
+#include <camoto/gamegraphics/animation.hpp>
+#include <camoto/gamegraphics/tileindex.hpp>
+#include <camoto/gamegraphics/tilemaprenderer.hpp>
+#include <camoto/gamegraphics/tilesetcache.hpp>
+#include <camoto/gamegraphics/trace.hpp>
 
 #endif // _CAMOTO_GAMEGRAPHICS_HPP_
@@ -0,0 +1,172 @@
+/**
+ * @file  camoto/gamegraphics/animation.hpp
+ * @brief Play back a tileset of animation frames.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_ANIMATION_HPP_
+#define _CAMOTO_GAMEGRAPHICS_ANIMATION_HPP_
+
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <camoto/gamegraphics/tileset.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// One frame of an animation.
+struct AnimationFrame {
+	unsigned int index;     ///< Frame number, from 0
+	unsigned long start;    ///< When the frame is first shown, in milliseconds
+	unsigned int duration;  ///< How long the frame is shown, in milliseconds
+	unsigned int width;     ///< Width in pixels
+	unsigned int height;    ///< Height in pixels
+	bool hasHotspot;        ///< Are hotspotX and hotspotY valid?
+	signed int hotspotX;    ///< See Image::getHotspot()
+	signed int hotspotY;    ///< See Image::getHotspot()
+	bool hasHitRect;        ///< Are hitRectX and hitRectY valid?
+	signed int hitRectX;    ///< See Image::getHitRect()
+	signed int hitRectY;    ///< See Image::getHitRect()
+	const uint8_t *pixels;  ///< Standard 8bpp pixels, NULL if not decoded
+	const uint8_t *mask;    ///< Standard mask, NULL if not decoded
+};
+
+struct AnimationPrefetch;
+
+/// Play the images in a tileset as a looping animation.
+/**
+ * The frames are decoded on a background thread, a few frames ahead of the
+ * playhead, into a small ring of buffers allocated up front.  As long as the
+ * decoding keeps up, getFrame() returns immediately and nothing is allocated
+ * during playback.
+ *
+ * None of the formats here store frame timing, so every frame is shown for
+ * the same length of time, given when the player is created.
+ *
+ * @note The background thread reads from the tileset for as long as the
+ *   player exists, so nothing else may use the tileset, or the tileset it was
+ *   opened from, until the player has been destroyed.
+ */
+class DLL_EXPORT AnimationPlayer
+{
+	public:
+		/// Start playing an animation.
+		/**
+		 * Each image in the tileset is one frame, in order.  Empty slots and
+		 * sub-tilesets are skipped.  The dimensions, hotspot and hit rectangle
+		 * of every frame are read now, so they can be looked up at any time with
+		 * getFrameInfo().
+		 *
+		 * @param frames
+		 *   Tileset holding the frames, usually a sub-tileset opened with
+		 *   Tileset::openTileset().
+		 *
+		 * @param frameDuration
+		 *   How long to show each frame, in milliseconds.
+		 *
+		 * @param ringSize
+		 *   Number of frames to keep decoded, including the current one.  At
+		 *   least two are always used so there is room to decode ahead.
+		 *
+		 * @throw stream::error if the frame information could not be read.
+		 */
+		AnimationPlayer(TilesetPtr frames, unsigned int frameDuration,
+			unsigned int ringSize);
+
+		/// Stop the background thread.
+		~AnimationPlayer();
+
+		/// Get the number of frames in the animation.
+		unsigned int getFrameCount() const;
+
+		/// Get the length of one loop of the animation, in milliseconds.
+		unsigned long getDuration() const;
+
+		/// Get the palette to draw the frames with.
+		/**
+		 * @return The palette from getDisplayPalette() for the first frame, or a
+		 *   null pointer if there are no frames.
+		 */
+		PaletteTablePtr getPalette() const;
+
+		/// Get the timing, size, hotspot and hit rectangle of a frame.
+		/**
+		 * This doesn't wait for the frame to be decoded, so the pixels and mask
+		 * in the returned frame are always NULL.
+		 *
+		 * @param index
+		 *   Frame number, from 0 to getFrameCount() - 1.
+		 */
+		const AnimationFrame& getFrameInfo(unsigned int index) const;
+
+		/// Get the frame at the playhead.
+		/**
+		 * If the frame hasn't been decoded yet this waits until it has.
+		 *
+		 * @return The frame.  The pixel and mask buffers stay valid until the
+		 *   playhead is next moved.
+		 *
+		 * @throw stream::error if the frame could not be decoded, or there are no
+		 *   frames.
+		 */
+		const AnimationFrame& getFrame();
+
+		/// Get the frame number at the playhead.
+		unsigned int getFrameIndex() const;
+
+		/// Move the playhead to the next frame, going back to the first at the end.
+		void nextFrame();
+
+		/// Move the playhead to a given frame.
+		/**
+		 * Frames already decoded ahead of the playhead are kept if the new frame
+		 * is among them.
+		 *
+		 * @param index
+		 *   Frame number, from 0 to getFrameCount() - 1.
+		 */
+		void seekFrame(unsigned int index);
+
+		/// Move the playhead to the frame shown at a given time.
+		/**
+		 * @param time
+		 *   Time since the animation started, in milliseconds.  Times past the
+		 *   end loop back around to the start.
+		 */
+		void seekTime(unsigned long time);
+
+	protected:
+		std::vector<AnimationFrame> frames;  ///< Frame information
+		PaletteTablePtr palette;             ///< Palette for every frame
+		boost::shared_ptr<AnimationPrefetch> prefetch; ///< Decoding thread state
+
+	private:
+		// The decoding thread points back at this->frames, so a copy would share
+		// it with the original.  Not implemented.
+		AnimationPlayer(const AnimationPlayer&);
+		AnimationPlayer& operator=(const AnimationPlayer&);
+};
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_ANIMATION_HPP_
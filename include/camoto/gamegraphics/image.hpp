@@ -254,6 +254,29 @@ class Image
 		virtual void fromStandard(StdImageDataPtr newContent,
 			StdImageDataPtr newMask) = 0;
 
+		/// Work out the size of the file fromStandard() would produce.
+		/**
+		 * Nothing is written, so this can be used to resize a file to the right
+		 * length before encoding into it, or to lay out a whole tileset before
+		 * writing any of it.
+		 *
+		 * @param newContent
+		 *   Image data, as would be passed to fromStandard().
+		 *
+		 * @param newMask
+		 *   Mask data, as would be passed to fromStandard().
+		 *
+		 * @param size
+		 *   On return, the length of the underlying stream after calling
+		 *   fromStandard() with the same data and the current dimensions and
+		 *   palette.  Left unchanged if false is returned.
+		 *
+		 * @return true if the size was calculated, false if this format can't
+		 *   tell without encoding the image.
+		 */
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size) = 0;
+
 		/// Get the indexed colour map from the file.
 		/**
 		 * @pre getCaps() return value includes HasPalette.
@@ -21,6 +21,8 @@
 #ifndef _CAMOTO_GAMEGRAPHICS_MANAGER_HPP_
 #define _CAMOTO_GAMEGRAPHICS_MANAGER_HPP_
 
+#include <string>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 #include <camoto/gamegraphics/tilesettype.hpp>
 #include <camoto/gamegraphics/imagetype.hpp>
@@ -32,6 +34,30 @@
 namespace camoto {
 namespace gamegraphics {
 
+/// Counters collected for one file format while instrumentation is enabled.
+/**
+ * The stream counters include any supplementary files, and every image and
+ * sub-tileset opened from a tileset is counted against the tileset's format.
+ */
+struct FormatStats {
+	std::string code;               ///< Format code, e.g. "img-pcx-1b4p"
+	unsigned long long bytesRead;   ///< Bytes read from the underlying streams
+	unsigned long long bytesWritten;///< Bytes written to the underlying streams
+	unsigned long readCalls;        ///< Number of read calls, however small
+	unsigned long writeCalls;       ///< Number of write calls, however small
+	unsigned long seekCalls;        ///< Number of seekg() and seekp() calls
+	unsigned long filterPasses;     ///< Number of filtered streams set up
+	unsigned long imageBuffers;     ///< Images returned by toStandard[Mask]()
+	unsigned long long imageBufferBytes; ///< Total width x height of those
+	unsigned long toStandardCalls;  ///< Calls to toStandard() and toStandardMask()
+	double toStandardSeconds;       ///< Wall time spent in those calls
+	unsigned long fromStandardCalls;///< Calls to fromStandard()
+	double fromStandardSeconds;     ///< Wall time spent in those calls
+};
+
+/// List of per-format counters.
+typedef std::vector<FormatStats> FormatStatsVector;
+
 /// Top-level class to manage graphics types.
 /**
  * This class provides access to the different graphics file formats supported
@@ -95,6 +121,53 @@ class Manager
 		 */
 		virtual const ImageTypePtr getImageTypeByCode(const std::string& strCode)
 			const = 0;
+
+		/// Turn the collection of per-format counters on or off.
+		/**
+		 * Instrumentation is off by default, and costs nothing while it is off.
+		 * When it is on, types returned by the functions above count the work
+		 * done by every image and tileset they open or create.  Images and
+		 * tilesets opened before instrumentation was enabled are not counted.
+		 *
+		 * The setting and the counters are shared by all Manager instances.
+		 *
+		 * @param enable
+		 *   true to start collecting counters, false to stop.
+		 */
+		virtual void setInstrumentation(bool enable) = 0;
+
+		/// Get the counters collected so far.
+		/**
+		 * @return One entry for each format that has been used since the last
+		 *   call to resetStats(), sorted by format code.
+		 */
+		virtual FormatStatsVector getStats() const = 0;
+
+		/// Discard all the counters collected so far.
+		virtual void resetStats() = 0;
+
+		/// Set the memory budget for caching decoded images.
+		/**
+		 * The cache is off by default.  When it is on, types returned by the
+		 * functions above keep the output of Image::toStandard() and
+		 * Image::toStandardMask() in memory, so decoding the same image again
+		 * (even from a different Image instance opened from the same tileset)
+		 * costs only a copy.  Once the budget is used up the least recently used
+		 * images are dropped.
+		 *
+		 * Cached data is discarded when the image is changed through the cache,
+		 * by Image::fromStandard(), Image::setDimensions(), Image::setPalette(),
+		 * Tileset::resize(), Tileset::remove(), Tileset::setPalette() or
+		 * Tileset::setTilesetDimensions().
+		 *
+		 * The budget and the cached data are shared by all Manager instances.
+		 * Images and tilesets opened while the cache was off are not cached.
+		 *
+		 * @param bytes
+		 *   Maximum number of bytes of decoded images to hold, or 0 to stop
+		 *   caching images opened from now on.
+		 */
+		virtual void setImageCacheSize(unsigned long bytes) = 0;
 };
 
 /// Shared pointer to a Manager.
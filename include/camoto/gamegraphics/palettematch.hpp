@@ -0,0 +1,141 @@
+/**
+ * @file  camoto/gamegraphics/palettematch.hpp
+ * @brief Mapping of truecolour pixels to the nearest palette entries.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_PALETTEMATCH_HPP_
+#define _CAMOTO_GAMEGRAPHICS_PALETTEMATCH_HPP_
+
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <camoto/gamegraphics/palettetable.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Find the closest palette entry for truecolour pixels.
+/**
+ * This is used when importing RGB artwork into an indexed format.  A k-d tree
+ * is built over the palette once, so looking up a colour only has to examine
+ * a few palette entries rather than all of them.
+ *
+ * Palette entries with an alpha of zero are never chosen for opaque pixels,
+ * as those entries are used by some formats to mark transparent pixels.
+ *
+ * @note Multithreading: Once constructed, all functions in this class may be
+ *       called from multiple threads at the same time.
+ */
+class DLL_EXPORT PaletteMatcher
+{
+	public:
+		/// Prepare to match colours against the given palette.
+		/**
+		 * @param pal
+		 *   Palette to match against.  Only the first 256 entries are used.
+		 *   The palette is copied, so later changes to it have no effect.
+		 */
+		PaletteMatcher(const PaletteTable& pal);
+
+		~PaletteMatcher();
+
+		/// Find the palette entry closest to the given colour.
+		/**
+		 * Distance is measured in RGB space.  If two entries are equally close
+		 * the one with the lower index is returned.
+		 *
+		 * @return Palette index.  If the palette is empty, 0 is returned.
+		 */
+		unsigned int nearest(uint8_t red, uint8_t green, uint8_t blue) const;
+
+		/// Convert 32-bit RGBA pixels into standard image data and mask.
+		/**
+		 * Pixels with an alpha below 128 are marked as Mask_Vis_Transparent in
+		 * the mask.  They are given the index of a fully transparent palette
+		 * entry if there is one, otherwise index 0.  All other pixels are
+		 * opaque and mapped to their nearest palette entry.
+		 *
+		 * @param rgba
+		 *   Source pixels, four bytes each in the order red, green, blue, alpha.
+		 *
+		 * @param width
+		 *   Image width in pixels.
+		 *
+		 * @param height
+		 *   Image height in pixels.
+		 *
+		 * @param stride
+		 *   Distance in bytes between the start of each row in rgba.
+		 *
+		 * @param data
+		 *   Output image data, width * height bytes.
+		 *
+		 * @param mask
+		 *   Output mask data, width * height bytes.  May be NULL if the mask is
+		 *   not needed.
+		 *
+		 * @param numThreads
+		 *   Number of threads to split the rows across.  0 uses one thread per
+		 *   CPU core.  Small images are always done on the calling thread.
+		 */
+		void fromRGBA(const uint8_t *rgba, unsigned int width,
+			unsigned int height, unsigned long stride, uint8_t *data, uint8_t *mask,
+			unsigned int numThreads) const;
+
+	protected:
+		/// One palette entry in the k-d tree.
+		struct Node {
+			uint8_t rgb[3];  ///< Colour of this entry
+			uint8_t axis;    ///< Which of rgb[] the tree splits on at this node
+			uint8_t index;   ///< Palette index
+		};
+
+		/// k-d tree, stored as a sorted array.
+		/**
+		 * The node for the range [begin, end) is at (begin + end) / 2, with the
+		 * lower half of the range to its left and the upper half to its right.
+		 */
+		std::vector<Node> tree;
+
+		/// Index written for transparent pixels.
+		uint8_t transparentIndex;
+
+		/// Arrange tree[begin, end) into a k-d tree.
+		void build(unsigned int begin, unsigned int end);
+
+		/// Search tree[begin, end) for a closer entry than best.
+		void search(unsigned int begin, unsigned int end, const int *rgb,
+			unsigned int *bestDist, unsigned int *bestIndex) const;
+
+		/// Convert rows [rowBegin, rowEnd) for fromRGBA().
+		void fromRGBARows(const uint8_t *rgba, unsigned int width,
+			unsigned long stride, uint8_t *data, uint8_t *mask,
+			unsigned int rowBegin, unsigned int rowEnd) const;
+};
+
+/// Shared pointer to a PaletteMatcher.
+typedef boost::shared_ptr<PaletteMatcher> PaletteMatcherPtr;
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_PALETTEMATCH_HPP_
@@ -0,0 +1,116 @@
+/**
+ * @file  camoto/gamegraphics/rgba.hpp
+ * @brief Conversion of indexed images to 32-bit RGBA pixels.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_RGBA_HPP_
+#define _CAMOTO_GAMEGRAPHICS_RGBA_HPP_
+
+#include <stdint.h>
+#include <camoto/gamegraphics/image.hpp>
+#include <camoto/gamegraphics/palettetable.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// How the image mask is applied when converting to RGBA.
+enum MaskPolicy {
+	/// Ignore the mask, alpha comes from the palette only.
+	MaskIgnore,
+
+	/// Pixels with Mask_Vis_Transparent set in the mask get an alpha of 0.
+	MaskTransparent
+};
+
+/// Get the palette to use when displaying an image.
+/**
+ * @param img
+ *   Image to examine.
+ *
+ * @return The image's own palette if it has one, otherwise the default
+ *   palette for its colour depth.
+ */
+PaletteTablePtr DLL_EXPORT getDisplayPalette(ImagePtr img);
+
+/// Convert 8bpp indexed pixels into 32-bit RGBA.
+/**
+ * Each output pixel is four bytes, in the order red, green, blue, alpha.
+ * Palette entries past the end of the palette are drawn as opaque black.
+ *
+ * @param data
+ *   Standard 8bpp image data, width * height bytes.
+ *
+ * @param mask
+ *   Standard mask data, the same size as data.  May be NULL if maskPolicy
+ *   is MaskIgnore.
+ *
+ * @param width
+ *   Image width in pixels.
+ *
+ * @param height
+ *   Image height in pixels.
+ *
+ * @param pal
+ *   Palette used to look up each pixel.
+ *
+ * @param maskPolicy
+ *   How the mask affects the alpha channel.
+ *
+ * @param out
+ *   Output buffer.  It must hold at least stride * (height - 1) + width * 4
+ *   bytes.
+ *
+ * @param stride
+ *   Distance in bytes between the start of each row in out.  Must be at
+ *   least width * 4.
+ */
+void DLL_EXPORT toRGBA(const uint8_t *data, const uint8_t *mask,
+	unsigned int width, unsigned int height, const PaletteTable& pal,
+	MaskPolicy maskPolicy, uint8_t *out, unsigned long stride);
+
+/// Convert an image into 32-bit RGBA.
+/**
+ * @param img
+ *   Image to convert.
+ *
+ * @param pal
+ *   Palette to use, or a null pointer to use getDisplayPalette().
+ *
+ * @param maskPolicy
+ *   How the image mask affects the alpha channel.  The mask is not read
+ *   from the image if this is MaskIgnore.
+ *
+ * @param out
+ *   Output buffer, see the other toRGBA() for details.
+ *
+ * @param stride
+ *   Distance in bytes between the start of each row in out.
+ *
+ * @throw stream::error on I/O error.
+ */
+void DLL_EXPORT toRGBA(ImagePtr img, PaletteTablePtr pal,
+	MaskPolicy maskPolicy, uint8_t *out, unsigned long stride);
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_RGBA_HPP_
@@ -0,0 +1,148 @@
+/**
+ * @file  camoto/gamegraphics/tileindex.hpp
+ * @brief Find identical tiles within and across tilesets.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_TILEINDEX_HPP_
+#define _CAMOTO_GAMEGRAPHICS_TILEINDEX_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <camoto/gamegraphics/image.hpp>
+#include <camoto/gamegraphics/tileset.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Hash an image's content.
+/**
+ * This is a fast non-cryptographic 64-bit hash over the dimensions, pixels
+ * and mask, so two tiles with the same hash are almost certainly identical.
+ *
+ * @param width
+ *   Image width in pixels.
+ *
+ * @param height
+ *   Image height in pixels.
+ *
+ * @param pixels
+ *   Image data in standard 8bpp format, width * height bytes.
+ *
+ * @param mask
+ *   Standard mask, width * height bytes.
+ *
+ * @return The hash.
+ */
+uint64_t DLL_EXPORT hashImage(unsigned int width, unsigned int height,
+	const uint8_t *pixels, const uint8_t *mask);
+
+/// One image seen by a TileIndex.
+struct TileIndexEntry {
+	unsigned int tileset;    ///< Which TileIndex::add() call found it, from 0
+	std::string id;          ///< Position, e.g. "0.2.5" (as listed by gametls)
+	TilesetPtr parent;       ///< Tileset (or sub-tileset) holding the tile
+	Tileset::EntryPtr entry; ///< The tile's entry within parent
+	unsigned int width;      ///< Width in pixels
+	unsigned int height;     ///< Height in pixels
+	uint64_t hash;           ///< Result of hashImage()
+	unsigned long original;  ///< Index of the first identical tile (or itself)
+	StdImageDataPtr pixels;  ///< Decoded pixels if sharing buffers, else empty
+	StdImageDataPtr mask;    ///< Decoded mask if sharing buffers, else empty
+};
+
+/// List of all the tiles in a TileIndex.
+typedef std::vector<TileIndexEntry> TileIndexEntries;
+
+/// Indices into TileIndex::getTiles() of tiles that are all identical.
+typedef std::vector<unsigned long> TileGroup;
+
+/// List of groups of identical tiles.
+typedef std::vector<TileGroup> TileGroups;
+
+/// Find identical tiles within and across tilesets.
+/**
+ * Each image is decoded once as it is added and its content hashed.  Tiles
+ * with the same hash and dimensions are treated as identical.
+ *
+ * With buffer sharing turned on the decoded images are kept, and identical
+ * tiles are also compared byte for byte and then share a single pair of
+ * buffers, so a pipeline can reuse the decoded data without decoding or
+ * storing any duplicate again.
+ */
+class DLL_EXPORT TileIndex
+{
+	public:
+		/// Create an empty index.
+		/**
+		 * @param shareBuffers
+		 *   true to keep each decoded image in TileIndexEntry::pixels and
+		 *   TileIndexEntry::mask, with identical tiles sharing the same buffers.
+		 *   false to keep only the hashes.
+		 */
+		TileIndex(bool shareBuffers);
+
+		/// Add every image in a tileset, including those in sub-tilesets.
+		/**
+		 * Empty slots are skipped.
+		 *
+		 * @param tileset
+		 *   Tileset to add.
+		 *
+		 * @return The number recorded in TileIndexEntry::tileset for these tiles.
+		 */
+		unsigned int add(TilesetPtr tileset);
+
+		/// Get every tile added so far, in the order they were found.
+		const TileIndexEntries& getTiles() const;
+
+		/// Get the groups of two or more identical tiles.
+		/**
+		 * @return One group per distinct image that appears more than once.  The
+		 *   first tile in each group is the one that was added first.  Groups
+		 *   are in the order their first tile was added.
+		 */
+		TileGroups getDuplicates() const;
+
+	protected:
+		/// Add the images in a tileset and recurse into sub-tilesets.
+		void addTiles(unsigned int tileset, const std::string& prefix,
+			TilesetPtr parent);
+
+		/// Index of the first tile seen with the given content.
+		unsigned long findOriginal(const TileIndexEntry& tile,
+			const StdImageDataPtr& pixels, const StdImageDataPtr& mask) const;
+
+		bool shareBuffers;         ///< Keep and share decoded images?
+		unsigned int numTilesets;  ///< Number of add() calls so far
+		TileIndexEntries tiles;    ///< Every tile seen
+
+		/// Distinct tiles by hash, pointing into tiles.
+		typedef std::multimap<uint64_t, unsigned long> HashIndex;
+		HashIndex byHash;
+};
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_TILEINDEX_HPP_
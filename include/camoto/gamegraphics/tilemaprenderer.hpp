@@ -0,0 +1,221 @@
+/**
+ * @file  camoto/gamegraphics/tilemaprenderer.hpp
+ * @brief Draw a grid of tiles from a tileset into a framebuffer.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_TILEMAPRENDERER_HPP_
+#define _CAMOTO_GAMEGRAPHICS_TILEMAPRENDERER_HPP_
+
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <camoto/gamegraphics/tileset.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Pixel format of a RenderTarget.
+enum RenderFormat {
+	/// One byte per pixel, a palette index.
+	RenderIndexed8,
+
+	/// Four bytes per pixel, in the order red, green, blue, alpha.
+	RenderRGBA
+};
+
+/// Framebuffer a TileMapRenderer draws into.
+struct RenderTarget {
+	uint8_t *pixels;      ///< Top-left pixel, owned by the caller
+	unsigned int width;   ///< Width in pixels
+	unsigned int height;  ///< Height in pixels
+	unsigned long stride; ///< Distance in bytes between the start of each row
+};
+
+/// Draw a map made of tiles from a tileset.
+/**
+ * Every tile the map refers to is decoded once, up front, into the output
+ * format along with a byte mask (0xFF for visible bytes, 0x00 for
+ * transparent ones), so drawing a frame is only a series of masked row
+ * copies.  Tiles with no transparent pixels are copied outright and fully
+ * transparent ones are skipped.
+ *
+ * Cell (x, y) is drawn with its top-left corner at (x * cellWidth,
+ * y * cellHeight) in map pixels.  Tiles larger than a cell overlap the cells
+ * to the right and below, and are drawn in row order, so later cells cover
+ * earlier ones.  Areas of the viewport with no tile, or under the
+ * transparent pixels of a tile, are filled with zero bytes.
+ */
+class DLL_EXPORT TileMapRenderer
+{
+	public:
+		/// Value of a map cell with no tile in it.
+		const static unsigned int EmptyCell = (unsigned int)-1;
+
+		/// Prepare to draw a map.
+		/**
+		 * @param tileset
+		 *   Tileset holding the tiles.  Only images directly in this tileset can
+		 *   be used; cells referring to sub-tilesets or empty slots are drawn as
+		 *   empty.
+		 *
+		 * @param cells
+		 *   Map content, mapWidth * mapHeight indices into tileset->getItems(),
+		 *   in rows from the top-left.  EmptyCell or an out of range index
+		 *   leaves the cell empty.
+		 *
+		 * @param mapWidth
+		 *   Width of the map, as a number of cells.
+		 *
+		 * @param mapHeight
+		 *   Height of the map, as a number of cells.
+		 *
+		 * @param cellWidth
+		 *   Horizontal distance between cells, in pixels.
+		 *
+		 * @param cellHeight
+		 *   Vertical distance between cells, in pixels.
+		 *
+		 * @param format
+		 *   Pixel format of the RenderTarget that will be drawn into.  For
+		 *   RenderRGBA each tile is converted with getDisplayPalette() and
+		 *   the palette's alpha is kept, but the mask alone decides which
+		 *   pixels are drawn.
+		 *
+		 * @throw stream::error if a tile could not be decoded.
+		 */
+		TileMapRenderer(TilesetPtr tileset, const std::vector<unsigned int>& cells,
+			unsigned int mapWidth, unsigned int mapHeight, unsigned int cellWidth,
+			unsigned int cellHeight, RenderFormat format);
+
+		/// Get the tile in a map cell.
+		unsigned int getCell(unsigned int x, unsigned int y) const;
+
+		/// Change the tile in a map cell.
+		/**
+		 * The tile is decoded now if it hasn't been used before.  The cell is
+		 * redrawn by the next call to update().
+		 *
+		 * @param x
+		 *   Column, from 0 to mapWidth - 1.
+		 *
+		 * @param y
+		 *   Row, from 0 to mapHeight - 1.
+		 *
+		 * @param index
+		 *   New tile, as for the cells passed to the constructor.
+		 *
+		 * @throw stream::error if the tile could not be decoded.
+		 */
+		void setCell(unsigned int x, unsigned int y, unsigned int index);
+
+		/// Draw the whole viewport.
+		/**
+		 * @param target
+		 *   Framebuffer to draw into, in the format passed to the constructor.
+		 *
+		 * @param viewX
+		 *   Map pixel drawn at the left edge of target.  May be negative or past
+		 *   the edge of the map.
+		 *
+		 * @param viewY
+		 *   Map pixel drawn at the top edge of target.
+		 */
+		void render(const RenderTarget& target, int viewX, int viewY);
+
+		/// Redraw only what has changed since the last render() or update().
+		/**
+		 * The target must still hold the frame drawn last time.  Its content is
+		 * shifted to follow the new viewport position, then only the strips
+		 * scrolled into view and the cells changed by setCell() are redrawn.
+		 * If nothing has been drawn yet, the target size has changed or the
+		 * viewport has moved too far for any of the old frame to be reused, the
+		 * whole viewport is drawn instead.
+		 *
+		 * @param target
+		 *   Framebuffer holding the previous frame.
+		 *
+		 * @param viewX
+		 *   New map pixel for the left edge of target.
+		 *
+		 * @param viewY
+		 *   New map pixel for the top edge of target.
+		 */
+		void update(const RenderTarget& target, int viewX, int viewY);
+
+	protected:
+		/// One decoded tile, ready to draw.
+		struct Tile {
+			unsigned int width;   ///< Width in pixels
+			unsigned int height;  ///< Height in pixels
+			bool visible;         ///< Does the tile have any visible pixels?
+			bool opaque;          ///< Are all of the tile's pixels visible?
+			std::vector<uint8_t> pixels; ///< Pixels in the output format
+			std::vector<uint8_t> mask;   ///< 0xFF per visible byte, 0x00 otherwise
+		};
+
+		/// Shared pointer to a Tile.
+		typedef boost::shared_ptr<Tile> TilePtr;
+
+		/// Get a tile, decoding it first if needed.
+		/**
+		 * @return The tile, or a null pointer if index doesn't refer to an image.
+		 */
+		const Tile *getTile(unsigned int index);
+
+		/// Draw the part of the map under a rectangle of the target.
+		/**
+		 * The rectangle is given in target pixels and must lie entirely within
+		 * the target.
+		 */
+		void drawRect(const RenderTarget& target, int viewX, int viewY,
+			unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+		/// Clip a rectangle in map pixels to the target and redraw it.
+		void redrawMapRect(const RenderTarget& target, int viewX, int viewY,
+			long mapX, long mapY, unsigned long width, unsigned long height);
+
+		TilesetPtr tileset;               ///< Source of the tiles
+		std::vector<unsigned int> cells;  ///< Map content
+		unsigned int mapWidth;            ///< Map width in cells
+		unsigned int mapHeight;           ///< Map height in cells
+		unsigned int cellWidth;           ///< Cell width in pixels
+		unsigned int cellHeight;          ///< Cell height in pixels
+		unsigned int bpp;                 ///< Bytes per output pixel
+		std::vector<TilePtr> tiles;       ///< Decoded tiles by index
+		std::vector<bool> decoded;        ///< Has tiles[n] been decoded yet?
+		unsigned int maxTileWidth;        ///< Widest tile decoded so far
+		unsigned int maxTileHeight;       ///< Tallest tile decoded so far
+
+		/// Cells changed by setCell() since the last frame.
+		std::vector<unsigned long> dirty;
+
+		bool drawn;                       ///< Has anything been drawn yet?
+		int lastViewX;                    ///< viewX of the last frame
+		int lastViewY;                    ///< viewY of the last frame
+		unsigned int lastWidth;           ///< Target width of the last frame
+		unsigned int lastHeight;          ///< Target height of the last frame
+};
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_TILEMAPRENDERER_HPP_
@@ -320,6 +320,53 @@ class Tileset: virtual public Metadata
 		 */
 		virtual void setPalette(PaletteTablePtr newPalette) = 0;
 
+		/// Get a fingerprint of an entry's stored data, without decoding it.
+		/**
+		 * The fingerprint is a hash of the raw bytes the entry occupies in the
+		 * underlying file, so it is the same every time the unchanged file is
+		 * opened and different once the entry is modified.  This lets callers
+		 * such as incremental exporters skip entries that have not changed
+		 * since last time without decoding them.
+		 *
+		 * @param id
+		 *   Entry to fingerprint.  Sub-tilesets are fingerprinted as a whole.
+		 *
+		 * @param fingerprint
+		 *   On return, set to the fingerprint if true is returned.
+		 *
+		 * @return true if fingerprint was set, false if this format can't tell
+		 *   where an entry's data is stored (the caller should then treat the
+		 *   entry as changed.)
+		 */
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint) = 0;
+
+		/// Replace the content of many images at once.
+		/**
+		 * This has the same effect as calling Image::fromStandard() on each
+		 * image in turn, but formats that store their images one after the
+		 * other encode them all first and then write the new file out in a
+		 * single pass, instead of moving the rest of the file every time an
+		 * image changes size.  This makes replacing every tile in a tileset take
+		 * time in proportion to the file size, rather than its square.
+		 *
+		 * Each image keeps its current dimensions, as with fromStandard().
+		 *
+		 * @param pixels
+		 *   New image data, one element per entry in getItems().  An empty
+		 *   pointer leaves that entry unchanged, and must be used for empty
+		 *   slots and sub-tilesets.
+		 *
+		 * @param masks
+		 *   New mask data, one element per entry in getItems().  Ignored for
+		 *   entries whose element in pixels is empty.
+		 *
+		 * @throw stream::error if the vectors are the wrong size or an image
+		 *   could not be encoded or written.  Some images may already have been
+		 *   replaced if this happens.
+		 */
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks) = 0;
+
 };
 
 /// Information about the location of a tile within an image.
@@ -373,6 +420,52 @@ TilesetPtr DLL_EXPORT createTilesetFromImages(TilesetFromImages_List& content,
 	unsigned int layoutWidth);
 // Defined in tilesetFromImages.cpp
 
+
+/// Location of one tileset entry within an Atlas.
+struct AtlasTile {
+	bool isImage;         ///< false for empty slots and sub-tilesets (not drawn)
+	unsigned int x;       ///< Left edge of the tile in the atlas, in pixels
+	unsigned int y;       ///< Top edge of the tile in the atlas, in pixels
+	unsigned int width;   ///< Tile width in pixels, 0 if !isImage
+	unsigned int height;  ///< Tile height in pixels, 0 if !isImage
+};
+
+/// Every image in a tileset drawn into a single picture.
+struct Atlas {
+	unsigned int width;      ///< Width of the whole atlas in pixels
+	unsigned int height;     ///< Height of the whole atlas in pixels
+	StdImageDataPtr pixels;  ///< width * height 8bpp pixels, 0 between tiles
+	StdImageDataPtr mask;    ///< Standard mask, transparent between tiles
+	PaletteTablePtr palette; ///< Tileset palette, or the default for its depth
+	std::vector<AtlasTile> tiles; ///< One per getItems() entry, in order
+};
+
+/// Shared pointer to an Atlas.
+typedef boost::shared_ptr<Atlas> AtlasPtr;
+
+/// Draw every image in a tileset into one picture.
+/**
+ * If all the images are the same size they are laid out as a grid in the
+ * same order as getItems(), with empty slots and sub-tilesets leaving a gap.
+ * Otherwise they are packed into rows, tallest first, in an area roughly
+ * square in shape.
+ *
+ * Each tile is decoded once and copied straight into its place in a buffer
+ * allocated up front for the whole atlas.
+ *
+ * @param tileset
+ *   Tileset to draw.  Sub-tilesets are not included.
+ *
+ * @param layoutWidth
+ *   Number of tiles across when all the tiles are the same size.  0 uses
+ *   tileset->getLayoutWidth(), or 16 if the tileset has no preference.
+ *
+ * @return The atlas.  Each entry in getItems() has a matching entry in
+ *   Atlas::tiles saying where it was drawn.
+ */
+AtlasPtr DLL_EXPORT createAtlas(TilesetPtr tileset, unsigned int layoutWidth);
+// Defined in atlas.cpp
+
 } // namespace gamegraphics
 } // namespace camoto
 
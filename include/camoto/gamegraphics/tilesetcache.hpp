@@ -0,0 +1,102 @@
+/**
+ * @file  camoto/gamegraphics/tilesetcache.hpp
+ * @brief Store decoded tilesets on disk so they can be reopened instantly.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_TILESETCACHE_HPP_
+#define _CAMOTO_GAMEGRAPHICS_TILESETCACHE_HPP_
+
+#include <string>
+#include <stdint.h>
+#include <camoto/stream.hpp>
+#include <camoto/gamegraphics/tileset.hpp>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Fingerprint the whole of a source file.
+/**
+ * This is a fast non-cryptographic hash of every byte in the stream, for use
+ * as the sourceFingerprint passed to writeTilesetCache() and
+ * openTilesetCache().  If a tileset uses supplementary files (such as a
+ * separate palette) their fingerprints should be combined with this one so
+ * the cache is also invalidated when they change.
+ *
+ * @param source
+ *   Stream to hash, from the start to the end.
+ *
+ * @return The fingerprint.
+ */
+uint64_t DLL_EXPORT fingerprintStream(stream::input_sptr source);
+
+/// Decode a whole tileset and save it to a cache file.
+/**
+ * Every image in the tileset and its sub-tilesets is decoded once and
+ * written out along with the entry names, attributes, dimensions, palettes,
+ * hotspots and hit rectangles, so that openTilesetCache() can present the
+ * same tree without decoding anything.
+ *
+ * The file is written under a temporary name and then renamed over the old
+ * cache, so a reader never sees a half-written cache.
+ *
+ * @param tileset
+ *   Tileset to save.
+ *
+ * @param sourceFingerprint
+ *   Fingerprint of the tileset's source data, e.g. from fingerprintStream().
+ *
+ * @param filename
+ *   Cache file to create or replace.
+ *
+ * @throw stream::error if the file could not be written or an image could
+ *   not be decoded.
+ */
+void DLL_EXPORT writeTilesetCache(TilesetPtr tileset,
+	uint64_t sourceFingerprint, const std::string& filename);
+
+/// Open a cache file written by writeTilesetCache() as a read-only tileset.
+/**
+ * The file is memory-mapped, so opening it is nearly instant no matter how
+ * large the tileset is.  Image::toStandard() and Image::toStandardMask()
+ * copy the pixels straight out of the mapping without decoding anything.
+ *
+ * Nothing in the returned tileset can be changed.  Functions that would
+ * modify it throw stream::error.
+ *
+ * @param filename
+ *   Cache file to open.
+ *
+ * @param sourceFingerprint
+ *   Fingerprint of the current source data.  If it doesn't match the one the
+ *   cache was written with, the cache is out of date and is not used.
+ *
+ * @return The cached tileset, or a null pointer if the file doesn't exist,
+ *   is out of date, or is not a valid cache (in which case the caller should
+ *   open the source file instead and probably rewrite the cache.)
+ */
+TilesetPtr DLL_EXPORT openTilesetCache(const std::string& filename,
+	uint64_t sourceFingerprint);
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_TILESETCACHE_HPP_
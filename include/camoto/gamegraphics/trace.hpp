@@ -0,0 +1,103 @@
+/**
+ * @file  camoto/gamegraphics/trace.hpp
+ * @brief Timeline output in Chrome trace-event format.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_TRACE_HPP_
+#define _CAMOTO_GAMEGRAPHICS_TRACE_HPP_
+
+#include <string>
+
+#ifndef DLL_EXPORT
+#define DLL_EXPORT
+#endif
+
+/// Environment variable naming a file to trace into from the first
+/// getManager() call onwards.
+#define CAMOTO_GAMEGRAPHICS_TRACE_ENV "CAMOTO_GAMEGRAPHICS_TRACE"
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Start writing trace events to a file.
+/**
+ * The file can be loaded into chrome://tracing or any other viewer that
+ * understands the Chrome trace-event JSON format.  Events are written as
+ * each span finishes.  Any trace already running is stopped first.
+ *
+ * Tracing can also be started by setting the environment variable
+ * CAMOTO_GAMEGRAPHICS_TRACE to a filename before calling getManager().  If
+ * that file can't be created, a warning is printed and tracing stays off.
+ *
+ * @param filename
+ *   File to write.  It is overwritten if it exists.
+ *
+ * @throw stream::open_error
+ *   The file could not be created.
+ */
+void DLL_EXPORT startTrace(const std::string& filename);
+
+/// Finish the trace file and stop collecting events.
+/**
+ * This is called automatically when the program exits.
+ */
+void DLL_EXPORT stopTrace();
+
+/// Is a trace currently being written?
+bool DLL_EXPORT isTracing();
+
+/// Record the time between construction and destruction as one trace event.
+/**
+ * This costs a single flag check when tracing is off, so spans can be left
+ * in place around any operation worth seeing on the timeline.
+ *
+ * @code
+ * {
+ *   TraceSpan span("Tileset::flush", "tls-ddave-ega");
+ *   ...
+ * } // event is written here
+ * @endcode
+ */
+class DLL_EXPORT TraceSpan
+{
+	public:
+		/// Start a span.
+		/**
+		 * @param name
+		 *   Event name.  The pointer must remain valid until the span ends, so
+		 *   this is normally a string literal.
+		 *
+		 * @param detail
+		 *   Optional extra text, such as a format code, shown with the event.
+		 *   Same lifetime requirement as name.
+		 */
+		TraceSpan(const char *name, const char *detail = NULL);
+
+		/// End the span and write out the event.
+		~TraceSpan();
+
+	private:
+		const char *name;   ///< Event name, or NULL if tracing was off
+		const char *detail; ///< Extra text, may be NULL
+		double start;       ///< Start time in microseconds since the trace began
+};
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_TRACE_HPP_
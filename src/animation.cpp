@@ -0,0 +1,269 @@
+/**
+ * @file  animation.cpp
+ * @brief Play back a tileset of animation frames.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <camoto/gamegraphics/animation.hpp>
+#include <camoto/gamegraphics/rgba.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Buffers holding one decoded frame.
+struct AnimationSlot {
+	/// Position in the playback sequence this slot holds (or is being
+	/// decoded for.)  The frame number is seq % number of frames.
+	unsigned long seq;
+
+	bool ready;                  ///< Has seq finished decoding?
+	bool failed;                 ///< Did decoding throw an exception?
+	std::string error;           ///< Exception message if failed
+	std::vector<uint8_t> pixels; ///< Big enough for the largest frame
+	std::vector<uint8_t> mask;   ///< Big enough for the largest frame
+	AnimationFrame frame;        ///< Frame info pointing into pixels and mask
+};
+
+/// State shared between an AnimationPlayer and its decoding thread.
+/**
+ * The playhead is a sequence number that only ever increases, so the frames
+ * decoded ahead of it stay valid as it loops around the animation.  Slot n
+ * holds sequence numbers equal to n modulo the ring size.
+ */
+struct AnimationPrefetch {
+	boost::mutex lock;                  ///< Protects everything below
+	boost::condition_variable changed;  ///< Signalled on any change
+	std::vector<ImagePtr> images;       ///< One per frame
+	std::vector<AnimationSlot> slots;   ///< Ring of decoded frames
+	unsigned long playPos;              ///< Sequence number of the playhead
+	bool stop;                          ///< Should the thread finish?
+	boost::shared_ptr<boost::thread> worker; ///< Decoding thread
+};
+
+/// Decode frames ahead of the playhead until told to stop.
+static void prefetchFrames(AnimationPrefetch *p,
+	const std::vector<AnimationFrame> *frames)
+{
+	unsigned long numFrames = frames->size();
+	unsigned long ringSize = p->slots.size();
+	boost::mutex::scoped_lock lock(p->lock);
+	for (;;) {
+		if (p->stop) break;
+
+		// Find the first frame in the window that isn't in its slot yet
+		unsigned long seq = p->playPos;
+		unsigned long end = p->playPos + ringSize;
+		while ((seq < end) && (p->slots[seq % ringSize].seq == seq)) seq++;
+		if (seq == end) {
+			p->changed.wait(lock);
+			continue;
+		}
+
+		// Claim the slot.  The player only reads a slot once it is ready, so it
+		// can be filled without holding the lock.
+		AnimationSlot& slot = p->slots[seq % ringSize];
+		slot.seq = seq;
+		slot.ready = false;
+		const AnimationFrame& info = (*frames)[seq % numFrames];
+		ImagePtr img = p->images[info.index];
+		lock.unlock();
+
+		bool failed = false;
+		std::string error;
+		try {
+			TraceSpan span("AnimationPlayer::decode");
+			unsigned long len = info.width * info.height;
+			StdImageDataPtr pixels = img->toStandard();
+			StdImageDataPtr mask = img->toStandardMask();
+			if (len) {
+				memcpy(&slot.pixels[0], pixels.get(), len);
+				memcpy(&slot.mask[0], mask.get(), len);
+			}
+		} catch (const std::exception& e) {
+			failed = true;
+			error = e.what();
+		}
+
+		lock.lock();
+		// If the playhead jumped while decoding, the slot may already have been
+		// claimed again for a later frame, which is decoded on the next pass.
+		if (slot.seq == seq) {
+			slot.frame = info;
+			slot.frame.pixels = slot.pixels.empty() ? NULL : &slot.pixels[0];
+			slot.frame.mask = slot.mask.empty() ? NULL : &slot.mask[0];
+			slot.failed = failed;
+			slot.error = error;
+			slot.ready = true;
+			p->changed.notify_all();
+		}
+	}
+	return;
+}
+
+AnimationPlayer::AnimationPlayer(TilesetPtr frames, unsigned int frameDuration,
+	unsigned int ringSize)
+	:	prefetch(new AnimationPrefetch)
+{
+	AnimationPrefetch *p = this->prefetch.get();
+	p->playPos = 0;
+	p->stop = false;
+
+	// Read everything except the pixels now, so it never has to be waited for
+	unsigned long maxLen = 0;
+	const Tileset::VC_ENTRYPTR& items = frames->getItems();
+	for (Tileset::VC_ENTRYPTR::const_iterator
+		i = items.begin(); i != items.end(); i++
+	) {
+		if ((*i)->getAttr() & (Tileset::EmptySlot | Tileset::SubTileset)) continue;
+
+		ImagePtr img = frames->openImage(*i);
+		AnimationFrame f;
+		f.index = this->frames.size();
+		f.start = (unsigned long)f.index * frameDuration;
+		f.duration = frameDuration;
+		img->getDimensions(&f.width, &f.height);
+		int caps = img->getCaps();
+		f.hasHotspot = (caps & Image::HasHotspot) != 0;
+		f.hotspotX = f.hotspotY = 0;
+		if (f.hasHotspot) img->getHotspot(&f.hotspotX, &f.hotspotY);
+		f.hasHitRect = (caps & Image::HasHitRect) != 0;
+		f.hitRectX = f.hitRectY = 0;
+		if (f.hasHitRect) img->getHitRect(&f.hitRectX, &f.hitRectY);
+		f.pixels = NULL;
+		f.mask = NULL;
+		this->frames.push_back(f);
+		p->images.push_back(img);
+
+		if (!this->palette) this->palette = getDisplayPalette(img);
+		unsigned long len = f.width * f.height;
+		if (len > maxLen) maxLen = len;
+	}
+	if (this->frames.empty()) return;
+
+	if (ringSize < 2) ringSize = 2;
+	p->slots.resize(ringSize);
+	for (std::vector<AnimationSlot>::iterator
+		i = p->slots.begin(); i != p->slots.end(); i++
+	) {
+		// Never a real sequence number, so every slot starts empty
+		i->seq = (unsigned long)-1;
+		i->ready = false;
+		i->failed = false;
+		i->pixels.resize(maxLen);
+		i->mask.resize(maxLen);
+	}
+
+	p->worker.reset(new boost::thread(boost::bind(prefetchFrames, p,
+		&this->frames)));
+}
+
+AnimationPlayer::~AnimationPlayer()
+{
+	AnimationPrefetch *p = this->prefetch.get();
+	if (!p->worker) return;
+	{
+		boost::mutex::scoped_lock lock(p->lock);
+		p->stop = true;
+		p->changed.notify_all();
+	}
+	p->worker->join();
+}
+
+unsigned int AnimationPlayer::getFrameCount() const
+{
+	return this->frames.size();
+}
+
+unsigned long AnimationPlayer::getDuration() const
+{
+	if (this->frames.empty()) return 0;
+	const AnimationFrame& last = this->frames.back();
+	return last.start + last.duration;
+}
+
+PaletteTablePtr AnimationPlayer::getPalette() const
+{
+	return this->palette;
+}
+
+const AnimationFrame& AnimationPlayer::getFrameInfo(unsigned int index) const
+{
+	return this->frames[index];
+}
+
+const AnimationFrame& AnimationPlayer::getFrame()
+{
+	if (this->frames.empty()) throw stream::error("animation has no frames");
+
+	AnimationPrefetch *p = this->prefetch.get();
+	boost::mutex::scoped_lock lock(p->lock);
+	AnimationSlot& slot = p->slots[p->playPos % p->slots.size()];
+	while ((slot.seq != p->playPos) || !slot.ready) p->changed.wait(lock);
+	if (slot.failed) throw stream::error(slot.error);
+	return slot.frame;
+}
+
+unsigned int AnimationPlayer::getFrameIndex() const
+{
+	if (this->frames.empty()) return 0;
+	AnimationPrefetch *p = this->prefetch.get();
+	boost::mutex::scoped_lock lock(p->lock);
+	return p->playPos % this->frames.size();
+}
+
+void AnimationPlayer::nextFrame()
+{
+	if (this->frames.empty()) return;
+	AnimationPrefetch *p = this->prefetch.get();
+	boost::mutex::scoped_lock lock(p->lock);
+	p->playPos++;
+	p->changed.notify_all();
+	return;
+}
+
+void AnimationPlayer::seekFrame(unsigned int index)
+{
+	unsigned long numFrames = this->frames.size();
+	if (numFrames == 0) return;
+	AnimationPrefetch *p = this->prefetch.get();
+	boost::mutex::scoped_lock lock(p->lock);
+	// Always move forwards, so frames decoded ahead can be reused
+	p->playPos += (index % numFrames + numFrames - p->playPos % numFrames)
+		% numFrames;
+	p->changed.notify_all();
+	return;
+}
+
+void AnimationPlayer::seekTime(unsigned long time)
+{
+	unsigned long duration = this->getDuration();
+	if (duration == 0) {
+		this->seekFrame(0);
+		return;
+	}
+	this->seekFrame((time % duration) / this->frames[0].duration);
+	return;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
@@ -0,0 +1,186 @@
+/**
+ * @file  atlas.cpp
+ * @brief Draw every image in a tileset into a single picture.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+#include <camoto/gamegraphics/tileset.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Sort entries tallest first, keeping the tileset order for equal heights.
+struct TallerTile {
+	const std::vector<AtlasTile>& tiles;
+
+	TallerTile(const std::vector<AtlasTile>& tiles)
+		:	tiles(tiles)
+	{
+	}
+
+	bool operator() (unsigned int a, unsigned int b) const
+	{
+		return this->tiles[a].height > this->tiles[b].height;
+	}
+};
+
+/// Pick a palette for the atlas when the tileset doesn't supply one.
+static PaletteTablePtr defaultPalette(int caps)
+{
+	switch (caps & Tileset::ColourDepthMask) {
+		case Tileset::ColourDepthEGA: return createPalette_DefaultEGA();
+		case Tileset::ColourDepthCGA: return createPalette_CGA(CGAPal_CyanMagenta);
+		case Tileset::ColourDepthMono: return createPalette_DefaultMono();
+		default: return createPalette_DefaultVGA();
+	}
+}
+
+// Exported in tileset.hpp
+AtlasPtr createAtlas(TilesetPtr tileset, unsigned int layoutWidth)
+{
+	TraceSpan span("createAtlas");
+
+	const Tileset::VC_ENTRYPTR& items = tileset->getItems();
+	unsigned int numItems = items.size();
+
+	AtlasPtr atlas(new Atlas);
+	atlas->width = 0;
+	atlas->height = 0;
+	atlas->tiles.resize(numItems);
+
+	// Open every image and find out how big it is, so the whole atlas can be
+	// laid out before anything is decoded.
+	std::vector<ImagePtr> images(numItems);
+	std::vector<unsigned int> present;
+	bool sameSize = true;
+	unsigned long area = 0;
+	unsigned int maxWidth = 0;
+	for (unsigned int i = 0; i < numItems; i++) {
+		AtlasTile& t = atlas->tiles[i];
+		t.isImage = false;
+		t.x = t.y = t.width = t.height = 0;
+
+		int attr = items[i]->getAttr();
+		if (attr & (Tileset::EmptySlot | Tileset::SubTileset)) continue;
+
+		images[i] = tileset->openImage(items[i]);
+		images[i]->getDimensions(&t.width, &t.height);
+		t.isImage = true;
+
+		if (!present.empty()) {
+			const AtlasTile& first = atlas->tiles[present[0]];
+			if ((t.width != first.width) || (t.height != first.height)) {
+				sameSize = false;
+			}
+		}
+		present.push_back(i);
+		area += t.width * t.height;
+		if (t.width > maxWidth) maxWidth = t.width;
+	}
+
+	if (present.empty()) {
+		// Nothing to draw
+	} else if (sameSize) {
+		// Grid in tileset order, so entry n is always in the same cell
+		unsigned int tileWidth = atlas->tiles[present[0]].width;
+		unsigned int tileHeight = atlas->tiles[present[0]].height;
+		if (layoutWidth == 0) layoutWidth = tileset->getLayoutWidth();
+		if (layoutWidth == 0) layoutWidth = 16;
+		if (layoutWidth > numItems) layoutWidth = numItems;
+		unsigned int layoutHeight = (numItems + layoutWidth - 1) / layoutWidth;
+
+		atlas->width = layoutWidth * tileWidth;
+		atlas->height = layoutHeight * tileHeight;
+		for (std::vector<unsigned int>::const_iterator
+			i = present.begin(); i != present.end(); i++
+		) {
+			AtlasTile& t = atlas->tiles[*i];
+			t.x = (*i % layoutWidth) * tileWidth;
+			t.y = (*i / layoutWidth) * tileHeight;
+		}
+	} else {
+		// Differing sizes, so pack them onto shelves, tallest first, aiming for
+		// a square atlas.
+		std::vector<unsigned int> order(present);
+		std::stable_sort(order.begin(), order.end(), TallerTile(atlas->tiles));
+
+		unsigned int targetWidth = (unsigned int)ceil(sqrt((double)area));
+		if (targetWidth < maxWidth) targetWidth = maxWidth;
+
+		unsigned int x = 0, y = 0, shelfHeight = 0;
+		for (std::vector<unsigned int>::const_iterator
+			i = order.begin(); i != order.end(); i++
+		) {
+			AtlasTile& t = atlas->tiles[*i];
+			if (x + t.width > targetWidth) {
+				y += shelfHeight;
+				x = 0;
+				shelfHeight = 0;
+			}
+			t.x = x;
+			t.y = y;
+			x += t.width;
+			if (t.height > shelfHeight) shelfHeight = t.height;
+			if (x > atlas->width) atlas->width = x;
+		}
+		atlas->height = y + shelfHeight;
+	}
+
+	// One buffer for the whole atlas, with gaps left transparent
+	unsigned long len = atlas->width * atlas->height;
+	atlas->pixels.reset(new uint8_t[len]);
+	atlas->mask.reset(new uint8_t[len]);
+	memset(atlas->pixels.get(), 0, len);
+	memset(atlas->mask.get(), Image::Mask_Vis_Transparent, len);
+
+	for (std::vector<unsigned int>::const_iterator
+		i = present.begin(); i != present.end(); i++
+	) {
+		const AtlasTile& t = atlas->tiles[*i];
+		if ((t.width == 0) || (t.height == 0)) continue;
+		StdImageDataPtr data = images[*i]->toStandard();
+		StdImageDataPtr mask = images[*i]->toStandardMask();
+
+		uint8_t *dstData = atlas->pixels.get() + t.y * atlas->width + t.x;
+		uint8_t *dstMask = atlas->mask.get() + t.y * atlas->width + t.x;
+		for (unsigned int y = 0; y < t.height; y++) {
+			memcpy(dstData, data.get() + y * t.width, t.width);
+			memcpy(dstMask, mask.get() + y * t.width, t.width);
+			dstData += atlas->width;
+			dstMask += atlas->width;
+		}
+
+		// Drop the image as soon as it has been drawn
+		images[*i].reset();
+	}
+
+	int caps = tileset->getCaps();
+	if (caps & Tileset::HasPalette) {
+		atlas->palette = tileset->getPalette();
+	} else {
+		atlas->palette = defaultPalette(caps);
+	}
+
+	return atlas;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
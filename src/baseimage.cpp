@@ -85,5 +85,11 @@ void Image_Base::setPalette(PaletteTablePtr newPalette)
 		" (this is a bug - the caller should have used getCaps() to detect this)");
 }
 
+bool Image_Base::getEncodedSize(StdImageDataPtr newContent,
+	StdImageDataPtr newMask, stream::len *size)
+{
+	return false;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
@@ -96,6 +96,13 @@ class Image_Base: virtual public Image
 		 * @throw stream::error on every call.
 		 */
 		virtual void setPalette(PaletteTablePtr newPalette);
+
+		/// Default function for formats that can't predict their size.
+		/**
+		 * @return false.
+		 */
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size);
 };
 
 } // namespace gamegraphics
@@ -101,5 +101,34 @@ void Tileset_Base::setPalette(PaletteTablePtr newPalette)
 	return;
 }
 
+bool Tileset_Base::getFingerprint(const EntryPtr& id, uint64_t *fingerprint)
+{
+	return false;
+}
+
+void Tileset_Base::replaceAll(const std::vector<StdImageDataPtr>& pixels,
+	const std::vector<StdImageDataPtr>& masks)
+{
+	replaceEachImage(this, pixels, masks);
+	return;
+}
+
+void replaceEachImage(Tileset *tileset,
+	const std::vector<StdImageDataPtr>& pixels,
+	const std::vector<StdImageDataPtr>& masks)
+{
+	const Tileset::VC_ENTRYPTR& items = tileset->getItems();
+	if ((pixels.size() != items.size()) || (masks.size() != items.size())) {
+		throw stream::error("replaceAll() needs one image for every entry in the"
+			" tileset");
+	}
+	for (unsigned long i = 0; i < items.size(); i++) {
+		if (!pixels[i]) continue;
+		ImagePtr img = tileset->openImage(items[i]);
+		img->fromStandard(pixels[i], masks[i]);
+	}
+	return;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
@@ -86,8 +86,36 @@ class Tileset_Base: virtual public Tileset
 		 * @throw stream::error on every call.
 		 */
 		virtual void setPalette(PaletteTablePtr newPalette);
+
+		/// Default function returning false (no fingerprint available).
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint);
+
+		/// Default function calling Image::fromStandard() on each image in turn.
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks);
 };
 
+/// Replace every image in a tileset by calling Image::fromStandard() on each.
+/**
+ * This is Tileset_Base::replaceAll(), shared with tilesets that don't derive
+ * from Tileset_Base.
+ *
+ * @param tileset
+ *   Tileset to change.
+ *
+ * @param pixels
+ *   New image data, as for Tileset::replaceAll().
+ *
+ * @param masks
+ *   New image masks, as for Tileset::replaceAll().
+ *
+ * @throw stream::error if pixels or masks don't have one entry for every
+ *   item in the tileset, or an image could not be written.
+ */
+void replaceEachImage(Tileset *tileset,
+	const std::vector<StdImageDataPtr>& pixels,
+	const std::vector<StdImageDataPtr>& masks);
+
 } // namespace gamegraphics
 } // namespace camoto
 
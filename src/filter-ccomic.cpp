@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <camoto/gamegraphics/trace.hpp>
 #include "filter-ccomic.hpp"
 
 namespace camoto {
@@ -43,6 +44,7 @@ void filter_ccomic_unrle::reset(stream::len lenInput)
 void filter_ccomic_unrle::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_ccomic_unrle::transform");
 	stream::len r = 0, w = 0;
 
 	if ((lenBlock == 0) && (*lenIn != 0)) {
@@ -147,6 +149,7 @@ void filter_ccomic_rle::reset(stream::len lenInput)
 void filter_ccomic_rle::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_ccomic_rle::transform");
 	stream::len r = 0, w = 0;
 	if (!this->writtenSize) {
 		// Write 8000 as a UINT16LE at the start of the file
@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <camoto/gamegraphics/trace.hpp>
 #include "filter-ccomic2.hpp"
 
 namespace camoto {
@@ -50,6 +51,7 @@ void filter_ccomic2_unrle::reset(stream::len lenInput)
 void filter_ccomic2_unrle::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_ccomic2_unrle::transform");
 	stream::len r = 0, w = 0;
 
 	// While there's more space to write, and either more data to read or
@@ -150,6 +152,7 @@ void filter_ccomic2_rle::reset(stream::len lenInput)
 void filter_ccomic2_rle::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_ccomic2_rle::transform");
 	stream::len r = 0, w = 0;
 	while (
 		(this->totalWritten < this->lenHeader)
@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <camoto/gamegraphics/trace.hpp>
 #include "filter-pad.hpp"
 
 namespace camoto {
@@ -38,6 +39,7 @@ void filter_pad::reset(stream::len lenInput)
 void filter_pad::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_pad::transform");
 	stream::len r = 0, w = 0;
 
 	if (this->lenProcessed >= this->lenPadPos) {
@@ -86,6 +88,7 @@ void filter_unpad::reset(stream::len lenInput)
 void filter_unpad::transform(uint8_t *out, stream::len *lenOut,
 	const uint8_t *in, stream::len *lenIn)
 {
+	TraceSpan span("filter_unpad::transform");
 	stream::len r = 0, w = 0;
 
 	if (this->lenProcessed >= this->lenPadPos) {
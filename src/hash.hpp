@@ -0,0 +1,82 @@
+/**
+ * @file  hash.hpp
+ * @brief Fast non-cryptographic 64-bit hashing of content.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_HASH_HPP_
+#define _CAMOTO_GAMEGRAPHICS_HASH_HPP_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Multiplier from MurmurHash64A.
+#define HASH_M 0xc6a4a7935bd1e995ULL
+
+/// Mix one 64-bit block into a running hash, as MurmurHash64A does.
+inline uint64_t hashBlock(uint64_t h, uint64_t k)
+{
+	k *= HASH_M;
+	k ^= k >> 47;
+	k *= HASH_M;
+	h ^= k;
+	h *= HASH_M;
+	return h;
+}
+
+/// Hash a buffer eight bytes at a time.
+/**
+ * A buffer can be hashed in pieces by passing the result of one call in as
+ * h for the next, as long as every piece but the last is a multiple of eight
+ * bytes long.  The length itself is not hashed, so callers should mix it in
+ * first if buffers of different lengths must hash differently.
+ */
+inline uint64_t hashBytes(uint64_t h, const uint8_t *data, unsigned long len)
+{
+	const uint8_t *end = data + (len & ~7UL);
+	for (; data < end; data += 8) {
+		uint64_t k;
+		memcpy(&k, data, 8); // may be unaligned
+		h = hashBlock(h, k);
+	}
+	// Leftover bytes
+	if (len & 7) {
+		uint64_t k = 0;
+		for (unsigned int i = 0; i < (len & 7); i++) {
+			k |= (uint64_t)data[i] << (i * 8);
+		}
+		h = hashBlock(h, k);
+	}
+	return h;
+}
+
+/// Final avalanche, so every input bit affects every output bit.
+inline uint64_t hashFinish(uint64_t h)
+{
+	h ^= h >> 47;
+	h *= HASH_M;
+	h ^= h >> 47;
+	return h;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_HASH_HPP_
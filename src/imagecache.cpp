@@ -0,0 +1,541 @@
+/**
+ * @file  imagecache.cpp
+ * @brief Process-wide cache of decoded images.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <string.h>
+#include <boost/thread/mutex.hpp>
+#include "imagecache.hpp"
+#include "lru-cache.hpp"
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Identifies one decoded buffer in the cache.
+struct ImageCacheKey {
+	unsigned long scope;      ///< CacheScope::id of the tileset or lone image
+	const void *entry;        ///< Tileset entry, or NULL for a lone image
+	unsigned long generation; ///< Number of times the entry has been changed
+	bool mask;                ///< true for toStandardMask(), false for toStandard()
+
+	bool operator< (const ImageCacheKey& b) const
+	{
+		if (this->scope != b.scope) return this->scope < b.scope;
+		if (this->entry != b.entry) return this->entry < b.entry;
+		if (this->generation != b.generation) return this->generation < b.generation;
+		return this->mask < b.mask;
+	}
+};
+
+/// Decoded buffers, costed by their size in bytes.
+typedef LRUCache<ImageCacheKey, StdImageDataPtr> ImageCache;
+
+/// Protects imageCache, cacheBudget and nextScope.
+static boost::mutex cacheMutex;
+
+/// Every cached buffer from every tileset and image.
+static ImageCache imageCache(0);
+
+/// Current capacity of imageCache, 0 if the cache is off.
+static unsigned long cacheBudget = 0;
+
+/// Next value for CacheScope::id.
+static unsigned long nextScope = 1;
+
+void setImageCacheSize(unsigned long bytes)
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	cacheBudget = bytes;
+	imageCache.setCapacity(bytes);
+	return;
+}
+
+unsigned long getImageCacheSize()
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	return cacheBudget;
+}
+
+unsigned long getImageCacheUsage()
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	return imageCache.size();
+}
+
+/// Get a number no other scope has used.
+static unsigned long newScopeId()
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	return nextScope++;
+}
+
+struct CacheScope;
+
+/// Shared pointer to a CacheScope.
+typedef boost::shared_ptr<CacheScope> CacheScopePtr;
+
+/// Generation counters for a tileset, shared with the images opened from it.
+struct CacheScope {
+	CacheScope()
+		:	id(newScopeId())
+	{
+	}
+
+	/// Unique number, replaced when every image in the tileset changes.
+	unsigned long id;
+
+	/// Number of times each entry has been changed, if it has.
+	std::map<const void *, unsigned long> generations;
+
+	/// Scopes of sub-tilesets, so reopening one still finds its images.
+	std::map<const void *, CacheScopePtr> children;
+};
+
+/// Current generation of an entry.
+static unsigned long getGeneration(const CacheScope *scope, const void *entry)
+{
+	std::map<const void *, unsigned long>::const_iterator i =
+		scope->generations.find(entry);
+	return (i == scope->generations.end()) ? 0 : i->second;
+}
+
+/// Forget everything cached in a tileset and its sub-tilesets.
+/**
+ * The old buffers can't be found without the keys, so they are left to be
+ * evicted as they become the least recently used.
+ */
+static void renewScope(CacheScope *scope)
+{
+	scope->id = newScopeId();
+	scope->generations.clear();
+	for (std::map<const void *, CacheScopePtr>::iterator
+		i = scope->children.begin(); i != scope->children.end(); i++
+	) {
+		renewScope(i->second.get());
+	}
+	return;
+}
+
+/// Forget everything cached for one entry, including a whole sub-tileset.
+static void invalidateEntry(CacheScope *scope, const void *entry)
+{
+	unsigned long& generation = scope->generations[entry];
+	ImageCacheKey key;
+	key.scope = scope->id;
+	key.entry = entry;
+	key.generation = generation;
+	{
+		boost::mutex::scoped_lock lock(cacheMutex);
+		key.mask = false;
+		imageCache.erase(key);
+		key.mask = true;
+		imageCache.erase(key);
+	}
+	generation++;
+
+	std::map<const void *, CacheScopePtr>::iterator child =
+		scope->children.find(entry);
+	if (child != scope->children.end()) renewScope(child->second.get());
+	return;
+}
+
+/// Image answering toStandard() and toStandardMask() from the cache.
+class CachedImage: virtual public Image
+{
+	public:
+		CachedImage(ImagePtr real, CacheScopePtr scope, const void *entry)
+			:	real(real),
+				scope(scope),
+				entry(entry)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->real->getCaps();
+		}
+
+		virtual void getDimensions(unsigned int *width, unsigned int *height)
+		{
+			this->real->getDimensions(width, height);
+			return;
+		}
+
+		virtual void setDimensions(unsigned int width, unsigned int height)
+		{
+			invalidateEntry(this->scope.get(), this->entry);
+			this->real->setDimensions(width, height);
+			return;
+		}
+
+		virtual void getHotspot(signed int *x, signed int *y)
+		{
+			this->real->getHotspot(x, y);
+			return;
+		}
+
+		virtual void setHotspot(signed int x, signed int y)
+		{
+			this->real->setHotspot(x, y);
+			return;
+		}
+
+		virtual void getHitRect(signed int *x, signed int *y)
+		{
+			this->real->getHitRect(x, y);
+			return;
+		}
+
+		virtual void setHitRect(signed int x, signed int y)
+		{
+			this->real->setHitRect(x, y);
+			return;
+		}
+
+		virtual StdImageDataPtr toStandard()
+		{
+			return this->decode(false);
+		}
+
+		virtual StdImageDataPtr toStandardMask()
+		{
+			return this->decode(true);
+		}
+
+		virtual void fromStandard(StdImageDataPtr newContent,
+			StdImageDataPtr newMask)
+		{
+			invalidateEntry(this->scope.get(), this->entry);
+			this->real->fromStandard(newContent, newMask);
+			return;
+		}
+
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size)
+		{
+			return this->real->getEncodedSize(newContent, newMask, size);
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			return this->real->getPalette();
+		}
+
+		virtual void setPalette(PaletteTablePtr newPalette)
+		{
+			invalidateEntry(this->scope.get(), this->entry);
+			this->real->setPalette(newPalette);
+			return;
+		}
+
+	protected:
+		ImagePtr real;          ///< Image doing the actual work
+		CacheScopePtr scope;    ///< Generations of the tileset holding the image
+		const void *entry;      ///< Tileset entry, or NULL for a lone image
+
+		/// Get the pixels or mask from the cache, decoding them if needed.
+		/**
+		 * Callers are allowed to modify the buffers they get back, so each call
+		 * returns its own copy rather than the cached one.
+		 */
+		StdImageDataPtr decode(bool mask)
+		{
+			unsigned int width, height;
+			this->real->getDimensions(&width, &height);
+			unsigned long len = width * height;
+
+			ImageCacheKey key;
+			key.scope = this->scope->id;
+			key.entry = this->entry;
+			key.generation = getGeneration(this->scope.get(), this->entry);
+			key.mask = mask;
+
+			StdImageDataPtr data;
+			bool found;
+			{
+				boost::mutex::scoped_lock lock(cacheMutex);
+				found = imageCache.get(key, &data);
+			}
+			if (!found) {
+				data = mask ? this->real->toStandardMask() : this->real->toStandard();
+				if (!data) return data;
+				boost::mutex::scoped_lock lock(cacheMutex);
+				imageCache.put(key, data, len);
+			}
+
+			StdImageDataPtr copy(new uint8_t[len]);
+			memcpy(copy.get(), data.get(), len);
+			return copy;
+		}
+};
+
+/// Tileset wrapping every image opened from it in a CachedImage.
+class CachedTileset: virtual public Tileset
+{
+	public:
+		CachedTileset(TilesetPtr real, CacheScopePtr scope)
+			:	real(real),
+				scope(scope)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->real->getCaps();
+		}
+
+		virtual const VC_ENTRYPTR& getItems() const
+		{
+			return this->real->getItems();
+		}
+
+		virtual TilesetPtr openTileset(const EntryPtr& id)
+		{
+			TilesetPtr sub = this->real->openTileset(id);
+			if (!sub) return sub;
+			CacheScopePtr& child = this->scope->children[id.get()];
+			if (!child) child.reset(new CacheScope());
+			return TilesetPtr(new CachedTileset(sub, child));
+		}
+
+		virtual ImagePtr openImage(const EntryPtr& id)
+		{
+			ImagePtr img = this->real->openImage(id);
+			if (!img) return img;
+			return ImagePtr(new CachedImage(img, this->scope, id.get()));
+		}
+
+		virtual EntryPtr insert(const EntryPtr& idBeforeThis, int attr)
+		{
+			return this->real->insert(idBeforeThis, attr);
+		}
+
+		virtual void remove(EntryPtr& id)
+		{
+			invalidateEntry(this->scope.get(), id.get());
+			this->scope->children.erase(id.get());
+			this->real->remove(id);
+			return;
+		}
+
+		virtual void resize(EntryPtr& id, stream::len newSize)
+		{
+			invalidateEntry(this->scope.get(), id.get());
+			this->real->resize(id, newSize);
+			return;
+		}
+
+		virtual void flush()
+		{
+			this->real->flush();
+			return;
+		}
+
+		virtual void getTilesetDimensions(unsigned int *width,
+			unsigned int *height)
+		{
+			this->real->getTilesetDimensions(width, height);
+			return;
+		}
+
+		virtual void setTilesetDimensions(unsigned int width, unsigned int height)
+		{
+			renewScope(this->scope.get());
+			this->real->setTilesetDimensions(width, height);
+			return;
+		}
+
+		virtual unsigned int getLayoutWidth()
+		{
+			return this->real->getLayoutWidth();
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			return this->real->getPalette();
+		}
+
+		virtual void setPalette(PaletteTablePtr newPalette)
+		{
+			renewScope(this->scope.get());
+			this->real->setPalette(newPalette);
+			return;
+		}
+
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint)
+		{
+			return this->real->getFingerprint(id, fingerprint);
+		}
+
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks)
+		{
+			const VC_ENTRYPTR& items = this->real->getItems();
+			for (unsigned long i = 0; (i < pixels.size()) && (i < items.size()); i++) {
+				if (pixels[i]) invalidateEntry(this->scope.get(), items[i].get());
+			}
+			this->real->replaceAll(pixels, masks);
+			return;
+		}
+
+	protected:
+		TilesetPtr real;        ///< Tileset doing the actual work
+		CacheScopePtr scope;    ///< Generations of this tileset's entries
+};
+
+/// Image type wrapping every image it returns in a CachedImage.
+class CachedImageType: virtual public ImageType
+{
+	public:
+		CachedImageType(ImageTypePtr real)
+			:	real(real)
+		{
+		}
+
+		virtual std::string getCode() const
+		{
+			return this->real->getCode();
+		}
+
+		virtual std::string getFriendlyName() const
+		{
+			return this->real->getFriendlyName();
+		}
+
+		virtual std::vector<std::string> getFileExtensions() const
+		{
+			return this->real->getFileExtensions();
+		}
+
+		virtual std::vector<std::string> getGameList() const
+		{
+			return this->real->getGameList();
+		}
+
+		virtual Certainty isInstance(stream::input_sptr psImage) const
+		{
+			return this->real->isInstance(psImage);
+		}
+
+		virtual ImagePtr create(stream::inout_sptr psImage,
+			SuppData& suppData) const
+		{
+			return cacheImage(this->real->create(psImage, suppData));
+		}
+
+		virtual ImagePtr open(stream::inout_sptr psImage,
+			SuppData& suppData) const
+		{
+			return cacheImage(this->real->open(psImage, suppData));
+		}
+
+		virtual SuppFilenames getRequiredSupps(const std::string& filenameImage)
+			const
+		{
+			return this->real->getRequiredSupps(filenameImage);
+		}
+
+	protected:
+		ImageTypePtr real;
+};
+
+/// Tileset type wrapping every tileset it returns in a CachedTileset.
+class CachedTilesetType: virtual public TilesetType
+{
+	public:
+		CachedTilesetType(TilesetTypePtr real)
+			:	real(real)
+		{
+		}
+
+		virtual std::string getCode() const
+		{
+			return this->real->getCode();
+		}
+
+		virtual std::string getFriendlyName() const
+		{
+			return this->real->getFriendlyName();
+		}
+
+		virtual std::vector<std::string> getFileExtensions() const
+		{
+			return this->real->getFileExtensions();
+		}
+
+		virtual std::vector<std::string> getGameList() const
+		{
+			return this->real->getGameList();
+		}
+
+		virtual Certainty isInstance(stream::input_sptr psTileset) const
+		{
+			return this->real->isInstance(psTileset);
+		}
+
+		virtual TilesetPtr create(stream::inout_sptr psTileset,
+			SuppData& suppData) const
+		{
+			return cacheTileset(this->real->create(psTileset, suppData));
+		}
+
+		virtual TilesetPtr open(stream::inout_sptr psTileset,
+			SuppData& suppData) const
+		{
+			return cacheTileset(this->real->open(psTileset, suppData));
+		}
+
+		virtual SuppFilenames getRequiredSupps(
+			const std::string& filenameTileset) const
+		{
+			return this->real->getRequiredSupps(filenameTileset);
+		}
+
+	protected:
+		TilesetTypePtr real;
+};
+
+ImageTypePtr cacheImageType(ImageTypePtr type)
+{
+	if (!type || !getImageCacheSize()) return type;
+	return ImageTypePtr(new CachedImageType(type));
+}
+
+TilesetTypePtr cacheTilesetType(TilesetTypePtr type)
+{
+	if (!type || !getImageCacheSize()) return type;
+	return TilesetTypePtr(new CachedTilesetType(type));
+}
+
+TilesetPtr cacheTileset(TilesetPtr tileset)
+{
+	if (!tileset) return tileset;
+	return TilesetPtr(new CachedTileset(tileset,
+		CacheScopePtr(new CacheScope())));
+}
+
+ImagePtr cacheImage(ImagePtr image)
+{
+	if (!image) return image;
+	return ImagePtr(new CachedImage(image, CacheScopePtr(new CacheScope()),
+		NULL));
+}
+
+} // namespace gamegraphics
+} // namespace camoto
@@ -0,0 +1,97 @@
+/**
+ * @file  imagecache.hpp
+ * @brief Process-wide cache of decoded images.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_IMAGECACHE_HPP_
+#define _CAMOTO_GAMEGRAPHICS_IMAGECACHE_HPP_
+
+#include <camoto/gamegraphics/manager.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Set the memory budget shared by every cached image.
+/**
+ * Lowering the budget drops the least recently used images straight away.
+ *
+ * @param bytes
+ *   Maximum number of bytes of decoded pixels and masks to hold.  0 turns
+ *   the cache off for types handed out from now on.
+ */
+void setImageCacheSize(unsigned long bytes);
+
+/// Get the budget set by setImageCacheSize().
+unsigned long getImageCacheSize();
+
+/// Get the number of bytes of decoded images currently held.
+unsigned long getImageCacheUsage();
+
+/// Wrap an image type so everything it opens or creates is cached.
+/**
+ * @param type
+ *   Real image type.
+ *
+ * @return A type that forwards every call to the real one, wrapping the
+ *   images it returns with cacheImage().  If the cache is off, type itself is
+ *   returned.
+ */
+ImageTypePtr cacheImageType(ImageTypePtr type);
+
+/// Wrap a tileset type so everything it opens or creates is cached.
+/**
+ * @param type
+ *   Real tileset type.
+ *
+ * @return A type that forwards every call to the real one, wrapping the
+ *   tilesets it returns with cacheTileset().  If the cache is off, type
+ *   itself is returned.
+ */
+TilesetTypePtr cacheTilesetType(TilesetTypePtr type);
+
+/// Cache the decoded images in a tileset and its sub-tilesets.
+/**
+ * Repeated toStandard() and toStandardMask() calls for the same entry are
+ * answered from memory, even through different Image instances, until the
+ * entry is changed through this tileset (by fromStandard(), setDimensions()
+ * or setPalette() on the image, or resize(), remove(), setPalette() or
+ * setTilesetDimensions() on the tileset.)
+ *
+ * @param tileset
+ *   Real tileset.  Changes made to it directly, rather than through the
+ *   returned wrapper, are not seen by the cache.
+ *
+ * @return Tileset forwarding every call to the real one.
+ */
+TilesetPtr cacheTileset(TilesetPtr tileset);
+
+/// Cache the decoded data of a single image.
+/**
+ * As for cacheTileset(), but for an image that isn't in a tileset.
+ *
+ * @param image
+ *   Real image.
+ *
+ * @return Image forwarding every call to the real one.
+ */
+ImagePtr cacheImage(ImagePtr image);
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_IMAGECACHE_HPP_
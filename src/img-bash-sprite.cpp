@@ -21,10 +21,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <camoto/stream_memory.hpp>
+#include <algorithm>
 #include <camoto/iostream_helpers.hpp>
 #include "img-bash-sprite.hpp"
-#include "img-ega-planar.hpp"
 
 namespace camoto {
 namespace gamegraphics {
@@ -143,14 +142,24 @@ void Image_BashSprite::setHitRect(signed int x, signed int y)
 
 StdImageDataPtr Image_BashSprite::toStandard()
 {
-	ImagePtr ega = this->toEGA();
-	return ega->toStandard();
+	assert((this->width != 0) && (this->height != 0));
+
+	unsigned int lenOut = this->width * this->height;
+	uint8_t *imgData = new uint8_t[lenOut];
+	StdImageDataPtr ret(imgData);
+	this->decode(imgData, NULL);
+	return ret;
 }
 
 StdImageDataPtr Image_BashSprite::toStandardMask()
 {
-	ImagePtr ega = this->toEGA();
-	return ega->toStandardMask();
+	assert((this->width != 0) && (this->height != 0));
+
+	unsigned int lenOut = this->width * this->height;
+	uint8_t *imgData = new uint8_t[lenOut];
+	StdImageDataPtr ret(imgData);
+	this->decode(NULL, imgData);
+	return ret;
 }
 
 void Image_BashSprite::fromStandard(StdImageDataPtr newContent,
@@ -158,68 +167,56 @@ void Image_BashSprite::fromStandard(StdImageDataPtr newContent,
 {
 	assert((this->width != 0) && (this->height != 0));
 
-	stream::inout_sptr content(new stream::memory);
-	{
-		PLANE_LAYOUT planes;
-		planes[PLANE_BLUE] = 1;
-		planes[PLANE_GREEN] = 2;
-		planes[PLANE_RED] = 3;
-		planes[PLANE_INTENSITY] = 4;
-		planes[PLANE_HITMAP] = 0;
-		planes[PLANE_OPACITY] = 5;
-
-		Image_EGAPlanar *ega = new Image_EGAPlanar();
-		ImagePtr conv(ega);
-		ega->setParams(content, 0, this->width, this->height, planes);
-		ega->fromStandard(newContent, newMask);
-	}
-	content->seekg(0, stream::start);
-
 	unsigned int widthBytes = (this->width + 7) / 8;
 	unsigned int planeSize = widthBytes * this->height;
 	unsigned int dataSize = (planeSize + 1) * 5 + 1;
 	uint8_t *imgData = new uint8_t[dataSize];
 	StdImageDataPtr ptrData(imgData);
-	memset(imgData, 0, dataSize);
 
 	// The transparency plane mask isn't a plane mask, but rather the width
 	// of the image in bytes.
 	imgData[0] = widthBytes;
 
-	// Plane IDs
-	imgData[(planeSize + 1)] = 0x01;
-	imgData[(planeSize + 1) * 2] = 0x02;
-	imgData[(planeSize + 1) * 3] = 0x04;
-	imgData[(planeSize + 1) * 4] = 0x08;
-	imgData[(planeSize + 1) * 5] = 0x00;
-
-	uint8_t *plane1 = new uint8_t[planeSize];
-	StdImageDataPtr ptrPlane1(plane1);
-
-	// Read blue, green, red and intensity as-is
+	// Plane IDs, which are the same bits as the matching standard pixel value
+	uint8_t *planes[5];
+	planes[0] = imgData + 1;
 	for (unsigned int p = 1; p < 5; p++) {
-		content->read(imgData + (planeSize + 1) * p + 1, planeSize);
+		imgData[(planeSize + 1) * p] = 1 << (p - 1);
+		planes[p] = imgData + (planeSize + 1) * p + 1;
 	}
-
-	// Read transparency (last in source EGA) into the first target plane
-	content->read(imgData + 1, planeSize);
+	imgData[(planeSize + 1) * 5] = 0x00;
 
 	// If the image is not a multiple of eight pixels, the game still draws it
 	// as such.  This means the transparency bits after the right-edge of the
 	// image up until the next eight-pixel boundary must still be set to
 	// transparent, otherwise pixels will be drawn in the game that aren't part
-	// of the image.
+	// of the image.  The colour planes are left as zero there.
 	unsigned int unusedBits = this->width % 8;
-	if (unusedBits) {
-		unsigned int padBits = ((256 >> unusedBits) - 1);
-		for (unsigned int p = 1; p < 5; p++) {
-			for (unsigned int y = 0; y < this->height; y++) {
-				imgData[(planeSize + 1) * p + 1 + y * widthBytes + (widthBytes - 1)] &= ~padBits;
+	uint8_t padBits = unusedBits ? ((256 >> unusedBits) - 1) : 0;
+
+	const uint8_t *pixel = newContent.get();
+	const uint8_t *mask = newMask.get();
+	unsigned int offset = 0;
+	for (unsigned int y = 0; y < this->height; y++) {
+		for (unsigned int x = 0; x < this->width; x += 8) {
+			unsigned int count = std::min(8U, this->width - x);
+			uint8_t b = 0, g = 0, r = 0, i = 0, t = 0;
+			for (unsigned int n = 0; n < count; n++) {
+				uint8_t bit = 0x80 >> n;
+				uint8_t c = *pixel++;
+				if (c & 0x01) b |= bit;
+				if (c & 0x02) g |= bit;
+				if (c & 0x04) r |= bit;
+				if (c & 0x08) i |= bit;
+				if (*mask++ & Image::Mask_Vis_Transparent) t |= bit;
 			}
-		}
-		// And set these bits in the transparency layer to make them transparent
-		for (unsigned int y = 0; y < this->height; y++) {
-			imgData[1 + y * widthBytes + (widthBytes - 1)] |= padBits;
+			if (count < 8) t |= padBits;
+			planes[0][offset] = t;
+			planes[1][offset] = b;
+			planes[2][offset] = g;
+			planes[3][offset] = r;
+			planes[4][offset] = i;
+			offset++;
 		}
 	}
 
@@ -229,63 +226,56 @@ void Image_BashSprite::fromStandard(StdImageDataPtr newContent,
 	return;
 }
 
-ImagePtr Image_BashSprite::toEGA()
+void Image_BashSprite::decode(uint8_t *pixels, uint8_t *mask)
 {
-	assert((this->width != 0) && (this->height != 0));
-
 	unsigned int lenRow = (this->width + 7) / 8;
-
 	unsigned int lenPlane = lenRow * this->height;
-	unsigned int lenOut = lenPlane * 5;
-	uint8_t *imgData = new uint8_t[lenOut];
-	StdImageDataPtr ptrData(imgData);
-	memset(imgData, 0, lenOut);
-
-	uint8_t *inPlane = new uint8_t[lenPlane];
-	StdImageDataPtr ptrInPlane(inPlane);
-
-	stream::pos lenRemaining = this->data->size() - 12;
+	unsigned int lenOut = this->width * this->height;
+	if (pixels) memset(pixels, 0, lenOut);
+	if (mask) memset(mask, 0, lenOut);
+
+	stream::pos lenStream = this->data->size();
+	if (lenStream <= 12) return;
+	stream::pos lenIn = lenStream - 12;
+	uint8_t *inData = new uint8_t[lenIn];
+	StdImageDataPtr ptrIn(inData);
 	this->data->seekg(12, stream::start);
-	// Convert the data into EGA planar format
+	this->data->read(inData, lenIn);
+
+	// Each incoming plane is a one-byte ID followed by the plane data.  The
+	// first is always transparency; the rest are XORed into every colour bit
+	// set in their ID, which conveniently matches the standard pixel bits.
+	const uint8_t *in = inData;
+	const uint8_t *inEnd = inData + lenIn;
 	bool firstIncomingPlane = true;
-	while (lenRemaining >= lenRow + 1) {
-		uint8_t plane;
-		this->data >> u8(plane);
+	while (inEnd - in >= (signed long)lenPlane + 1) {
+		uint8_t plane = *in++;
 		if (plane == 0x00) break; // EOF
-		this->data->read(inPlane, lenPlane);
-		lenRemaining -= lenPlane + 1;
+		const uint8_t *planeData = in;
+		in += lenPlane;
+
+		uint8_t *out;
+		uint8_t value;
 		if (firstIncomingPlane) {
-			// First incoming plane is transparency (output plane 5)
-			memcpy(imgData + lenPlane * 4, inPlane, lenPlane);
 			firstIncomingPlane = false;
-			// Transparency plane does not affect any other planes
-			continue;
+			if (!mask) continue;
+			out = mask;
+			value = Image::Mask_Vis_Transparent;
+		} else {
+			if (!pixels) continue;
+			out = pixels;
+			value = plane & 0x0F;
+			if (!value) continue;
 		}
-		for (unsigned int p = 0; p < 4; p++) {
-			if ((plane >> p) & 1) {
-				// This image plane contains data for EGA plane p
-				uint8_t *targetPlane = imgData + lenPlane * p;
-				for (unsigned int i = 0; i < lenPlane; i++) {
-					targetPlane[i] ^= inPlane[i];
-				}
+		for (unsigned int y = 0; y < this->height; y++) {
+			for (unsigned int x = 0; x < this->width; x++) {
+				if ((planeData[x >> 3] << (x & 7)) & 0x80) out[x] ^= value;
 			}
+			planeData += lenRow;
+			out += this->width;
 		}
 	}
-	stream::inout_sptr content(new stream::memory);
-	content->write(imgData, lenOut);
-
-	PLANE_LAYOUT planes;
-	planes[PLANE_BLUE] = 1;
-	planes[PLANE_GREEN] = 2;
-	planes[PLANE_RED] = 3;
-	planes[PLANE_INTENSITY] = 4;
-	planes[PLANE_HITMAP] = 0;
-	planes[PLANE_OPACITY] = 5;
-
-	Image_EGAPlanar *ega = new Image_EGAPlanar();
-	ImagePtr conv(ega);
-	ega->setParams(content, 0, this->width, this->height, planes);
-	return conv;
+	return;
 }
 
 } // namespace gamegraphics
@@ -53,8 +53,17 @@ class Image_BashSprite: virtual public Image_Base
 		int16_t hotspotX, hotspotY;
 		uint16_t rectX, rectY;
 
-		/// Convert the image data to a more standard EGA format.
-		ImagePtr toEGA();
+		/// Decode the sprite planes straight into standard buffers.
+		/**
+		 * @param pixels
+		 *   Destination for the colour data, width * height bytes, or NULL to
+		 *   skip the colour planes.
+		 *
+		 * @param mask
+		 *   Destination for the transparency mask, width * height bytes, or
+		 *   NULL to skip the transparency plane.
+		 */
+		void decode(uint8_t *pixels, uint8_t *mask);
 };
 
 } // namespace gamegraphics
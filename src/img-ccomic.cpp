@@ -22,6 +22,7 @@
 #include <camoto/stream_filtered.hpp>
 #include "filter-ccomic.hpp"
 #include "img-ccomic.hpp"
+#include "instrument.hpp"
 
 /// Width of image, in pixels
 #define CCIMG_WIDTH 320
@@ -136,6 +137,7 @@ Image_CComic::Image_CComic(stream::inout_sptr data)
 	filter_sptr filtWrite(new filter_ccomic_rle());
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(data, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	PLANE_LAYOUT planes;
 	memset(planes, 0, sizeof(planes));
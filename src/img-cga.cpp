@@ -18,19 +18,91 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <vector>
 #include "img-cga.hpp"
 
 namespace camoto {
 namespace gamegraphics {
 
+/// Lookup table expanding one byte of 2bpp data into four 8bpp pixels.
+struct CGAExpandTable
+{
+	uint8_t pixels[256][4];
+
+	CGAExpandTable()
+	{
+		for (unsigned int i = 0; i < 256; i++) {
+			this->pixels[i][0] = (i >> 6) & 3;
+			this->pixels[i][1] = (i >> 4) & 3;
+			this->pixels[i][2] = (i >> 2) & 3;
+			this->pixels[i][3] = i & 3;
+		}
+	}
+};
+
+/// Filled in during static initialisation, so it is read-only afterwards.
+static const CGAExpandTable cgaExpand;
+
+/// Expand packed 2bpp data into one byte per pixel.
+/**
+ * @param packed
+ *   Source data, (numPixels + 3) / 4 bytes.  The leftmost pixel is in the
+ *   most significant bits.
+ *
+ * @param pixels
+ *   Destination buffer, numPixels bytes.
+ *
+ * @param numPixels
+ *   Number of pixels to expand.
+ */
+static void cgaUnpack(const uint8_t *packed, uint8_t *pixels,
+	unsigned long numPixels)
+{
+	unsigned long whole = numPixels / 4;
+	for (unsigned long i = 0; i < whole; i++) {
+		memcpy(pixels, cgaExpand.pixels[*packed++], 4);
+		pixels += 4;
+	}
+	unsigned int remainder = numPixels % 4;
+	if (remainder) memcpy(pixels, cgaExpand.pixels[*packed], remainder);
+	return;
+}
+
+/// Pack one byte per pixel into 2bpp data.
+/**
+ * This is the inverse of cgaUnpack().  Any unused bits in the final byte
+ * are set to zero.
+ */
+static void cgaPack(const uint8_t *pixels, uint8_t *packed,
+	unsigned long numPixels)
+{
+	unsigned long whole = numPixels / 4;
+	for (unsigned long i = 0; i < whole; i++) {
+		*packed++ = ((pixels[0] & 3) << 6) | ((pixels[1] & 3) << 4)
+			| ((pixels[2] & 3) << 2) | (pixels[3] & 3);
+		pixels += 4;
+	}
+	unsigned int remainder = numPixels % 4;
+	if (remainder) {
+		uint8_t last = 0;
+		for (unsigned int i = 0; i < remainder; i++) {
+			last |= (pixels[i] & 3) << (6 - i * 2);
+		}
+		*packed = last;
+	}
+	return;
+}
+
 Image_CGA::Image_CGA(stream::inout_sptr data, stream::pos off,
-	unsigned int width, unsigned int height, CGAPaletteType cgaPal)
-	:	parent(data),
-		data(new bitstream(data, bitstream::bigEndian)),
+	unsigned int width, unsigned int height, CGAPaletteType cgaPal,
+	CGALayout layout)
+	:	data(data),
 		off(off),
 		width(width),
 		height(height),
-		cgaPal(cgaPal)
+		cgaPal(cgaPal),
+		layout(layout)
 {
 }
 
@@ -63,17 +135,30 @@ StdImageDataPtr Image_CGA::toStandard()
 	unsigned int width, height;
 	this->getDimensions(&width, &height);
 	assert((width != 0) && (height != 0));
-	int dataSize = width * height;
+	unsigned long dataSize = width * height;
 
 	uint8_t *imgData = new uint8_t[dataSize];
 	StdImageDataPtr ret(imgData);
-	this->data->seek(this->off << 3, stream::start);
 
-	// Read the data as 2bpp and write it to the buffer as 8bpp
-	while (dataSize--) {
-		unsigned int val;
-		this->data->read(2, &val);
-		*imgData++ = (uint8_t)val;
+	if (this->layout == CGA_Interlaced) {
+		unsigned int lenRow = (width + 3) / 4;
+		std::vector<uint8_t> packed(lenRow * ((height + 1) / 2));
+		for (unsigned int bank = 0; bank < 2; bank++) {
+			unsigned int numRows = (height + 1 - bank) / 2;
+			if (numRows == 0) break;
+			this->data->seekg(this->off + bank * CGA_BANK_OFFSET, stream::start);
+			this->data->read(&packed[0], lenRow * numRows);
+			for (unsigned int r = 0; r < numRows; r++) {
+				cgaUnpack(&packed[r * lenRow], imgData + (r * 2 + bank) * width,
+					width);
+			}
+		}
+	} else {
+		// Rows are packed back to back, so the whole image is one run of pixels
+		std::vector<uint8_t> packed((dataSize + 3) / 4);
+		this->data->seekg(this->off, stream::start);
+		this->data->read(&packed[0], packed.size());
+		cgaUnpack(&packed[0], imgData, dataSize);
 	}
 
 	return ret;
@@ -101,19 +186,43 @@ void Image_CGA::fromStandard(StdImageDataPtr newContent,
 	unsigned int width, height;
 	this->getDimensions(&width, &height);
 	assert((width != 0) && (height != 0));
-	int dataSize = width * height;
-
-	// Cut off any leftover data or resize so there's enough space
-	this->parent->truncate((dataSize >> 2) + this->off);
-
-	// No conversion needed, write out as-is
-	uint8_t *imgData = (uint8_t *)newContent.get();
-	this->data->seek(this->off << 3, stream::start);
-
-	// Write the data as 2bpp
-	while (dataSize--) {
-		this->data->write(2, *imgData++);
+	unsigned long dataSize = width * height;
+
+	const uint8_t *imgData = newContent.get();
+
+	if (this->layout == CGA_Interlaced) {
+		unsigned int lenRow = (width + 3) / 4;
+		stream::len lenImage = (height > 1)
+			? CGA_BANK_OFFSET + lenRow * (height / 2)
+			: lenRow;
+
+		// Only ever grow the data, so any padding after each bank (as found in
+		// a B800 memory dump) is preserved.
+		if (this->data->size() < this->off + lenImage) {
+			this->data->truncate(this->off + lenImage);
+		}
+
+		std::vector<uint8_t> packed(lenRow * ((height + 1) / 2));
+		for (unsigned int bank = 0; bank < 2; bank++) {
+			unsigned int numRows = (height + 1 - bank) / 2;
+			if (numRows == 0) break;
+			for (unsigned int r = 0; r < numRows; r++) {
+				cgaPack(imgData + (r * 2 + bank) * width, &packed[r * lenRow], width);
+			}
+			this->data->seekp(this->off + bank * CGA_BANK_OFFSET, stream::start);
+			this->data->write(&packed[0], lenRow * numRows);
+		}
+	} else {
+		std::vector<uint8_t> packed((dataSize + 3) / 4);
+
+		// Cut off any leftover data or resize so there's enough space
+		this->data->truncate(packed.size() + this->off);
+
+		cgaPack(imgData, &packed[0], dataSize);
+		this->data->seekp(this->off, stream::start);
+		this->data->write(&packed[0], packed.size());
 	}
+	this->data->flush();
 
 	return;
 }
@@ -163,10 +272,10 @@ ImageType::Certainty ImageType_CGARawLinear::isInstance(stream::input_sptr psIma
 {
 	stream::pos len = psImage->size();
 
-	// TESTED BY: TODO
+	// TESTED BY: img_cga_linear_isinstance_c00
 	if (len == 16000) return PossiblyYes;
 
-	// TESTED BY: TODO
+	// TESTED BY: img_cga_linear_isinstance_c01
 	return DefinitelyNo;
 }
 
@@ -187,7 +296,7 @@ ImagePtr ImageType_CGARawLinear::open(stream::inout_sptr psImage,
 	SuppData& suppData) const
 {
 	Image_CGA *cga = new Image_CGA(psImage, 0, 320, 200,
-		CGAPal_CyanMagentaBright);
+		CGAPal_CyanMagentaBright, CGA_Linear);
 	ImagePtr img(cga);
 	return img;
 }
@@ -197,5 +306,81 @@ SuppFilenames ImageType_CGARawLinear::getRequiredSupps(const std::string& filena
 	return SuppFilenames();
 }
 
+
+//
+// ImageType_CGARawInterlaced
+//
+
+ImageType_CGARawInterlaced::ImageType_CGARawInterlaced()
+{
+}
+
+ImageType_CGARawInterlaced::~ImageType_CGARawInterlaced()
+{
+}
+
+std::string ImageType_CGARawInterlaced::getCode() const
+{
+	return "img-cga-raw-interlaced-fullscreen";
+}
+
+std::string ImageType_CGARawInterlaced::getFriendlyName() const
+{
+	return "Raw Interlaced CGA fullscreen image";
+}
+
+// Get a list of the known file extensions for this format.
+std::vector<std::string> ImageType_CGARawInterlaced::getFileExtensions() const
+{
+	std::vector<std::string> vcExtensions;
+	return vcExtensions;
+}
+
+std::vector<std::string> ImageType_CGARawInterlaced::getGameList() const
+{
+	std::vector<std::string> vcGames;
+	return vcGames;
+}
+
+ImageType::Certainty ImageType_CGARawInterlaced::isInstance(stream::input_sptr psImage) const
+{
+	stream::pos len = psImage->size();
+
+	// Full 16kB of video memory, or without the padding after the second bank
+	// TESTED BY: img_cga_interlaced_isinstance_c00
+	// TESTED BY: img_cga_interlaced_isinstance_c01
+	if ((len == 16384) || (len == CGA_BANK_OFFSET + 8000)) return PossiblyYes;
+
+	// TESTED BY: img_cga_interlaced_isinstance_c02
+	return DefinitelyNo;
+}
+
+ImagePtr ImageType_CGARawInterlaced::create(stream::inout_sptr psImage,
+	SuppData& suppData) const
+{
+	psImage->truncate(16384);
+	psImage->seekp(0, stream::start);
+	char buf[64];
+	memset(buf, 0, 64);
+	for (int i = 0; i < 256; i++) psImage->write(buf, 64);
+
+	SuppData dummy;
+	return this->open(psImage, dummy);
+}
+
+ImagePtr ImageType_CGARawInterlaced::open(stream::inout_sptr psImage,
+	SuppData& suppData) const
+{
+	Image_CGA *cga = new Image_CGA(psImage, 0, 320, 200,
+		CGAPal_CyanMagentaBright, CGA_Interlaced);
+	ImagePtr img(cga);
+	return img;
+}
+
+SuppFilenames ImageType_CGARawInterlaced::getRequiredSupps(const std::string& filenameImage) const
+{
+	return SuppFilenames();
+}
+
 } // namespace gamegraphics
 } // namespace camoto
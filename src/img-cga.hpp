@@ -22,20 +22,34 @@
 #define _CAMOTO_IMG_CGA_HPP_
 
 #include <boost/iostreams/stream.hpp>
-#include <camoto/bitstream.hpp>
 #include "baseimage.hpp"
 #include <camoto/gamegraphics/imagetype.hpp>
 
 namespace camoto {
 namespace gamegraphics {
 
+/// How rows of CGA pixels are arranged in the underlying data.
+enum CGALayout {
+	/// Rows follow one after the other with no padding.
+	CGA_Linear,
+
+	/// Even rows in the first bank, odd rows in a second bank starting at
+	/// CGA_BANK_OFFSET, as in a dump of CGA video memory at B800:0000.
+	/// Each row starts on a byte boundary.
+	CGA_Interlaced
+};
+
+/// Offset of the odd-row bank in interlaced CGA data.
+#define CGA_BANK_OFFSET 0x2000
+
 /// CGA Image implementation.
 /**
  * This class adds support for converting to and from CGA format.  It
  * does not handle image size (dimensions) so it should be inherited by more
  * specific format handlers.
  *
- * Currently it only supports one format - 2bpp packed (not planar)
+ * Currently it only supports one format - 2bpp packed (not planar), stored
+ * either linearly or interlaced across two banks.
  */
 class Image_CGA: virtual public Image_Base
 {
@@ -56,9 +70,12 @@ class Image_CGA: virtual public Image_Base
 		 *
 		 * @param cgaPal
 		 *   CGA palette to use.  See generatePalette() for details.
+		 *
+		 * @param layout
+		 *   Arrangement of the rows in the data.
 		 */
 		Image_CGA(stream::inout_sptr data, stream::pos off, unsigned int width,
-			unsigned int height, CGAPaletteType cgaPal);
+			unsigned int height, CGAPaletteType cgaPal, CGALayout layout);
 
 		/// Destructor.
 		virtual ~Image_CGA();
@@ -79,12 +96,12 @@ class Image_CGA: virtual public Image_Base
 		virtual PaletteTablePtr getPalette();
 
 	protected:
-		stream::inout_sptr parent; ///< Parent stream under the bitstream
-		bitstream_sptr data;       ///< CGA image data
+		stream::inout_sptr data;   ///< CGA image data
 		stream::pos off;           ///< Offset of image data
 		unsigned int width;        ///< Image width in pixels
 		unsigned int height;       ///< Image height in pixels
 		CGAPaletteType cgaPal;     ///< CGA palette to use
+		CGALayout layout;          ///< Row arrangement
 };
 
 /// Filetype handler for full screen raw CGA images.
@@ -115,6 +132,34 @@ class ImageType_CGARawLinear: virtual public ImageType
 
 };
 
+/// Filetype handler for full screen interlaced CGA images (B800 dumps).
+class ImageType_CGARawInterlaced: virtual public ImageType
+{
+	public:
+		ImageType_CGARawInterlaced();
+
+		virtual ~ImageType_CGARawInterlaced();
+
+		virtual std::string getCode() const;
+
+		virtual std::string getFriendlyName() const;
+
+		virtual std::vector<std::string> getFileExtensions() const;
+
+		virtual std::vector<std::string> getGameList() const;
+
+		virtual Certainty isInstance(stream::input_sptr fsImage) const;
+
+		virtual ImagePtr create(stream::inout_sptr psImage,
+			SuppData& suppData) const;
+
+		virtual ImagePtr open(stream::inout_sptr fsImage,
+			SuppData& suppData) const;
+
+		virtual SuppFilenames getRequiredSupps(const std::string& filenameImage) const;
+
+};
+
 } // namespace gamegraphics
 } // namespace camoto
 
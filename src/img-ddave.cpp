@@ -26,8 +26,8 @@ namespace gamegraphics {
 
 Image_DDaveCGA::Image_DDaveCGA(stream::inout_sptr data,
 	bool fixedSize)
-	:	Image_CGA(data, fixedSize ? 0 : 4, 16, 16, CGAPal_CyanMagentaBright),
-		stream_data(data),
+	:	Image_CGA(data, fixedSize ? 0 : 4, 16, 16, CGAPal_CyanMagentaBright,
+			CGA_Linear),
 		fixedSize(fixedSize)
 {
 	if (!fixedSize) {
@@ -53,8 +53,8 @@ void Image_DDaveCGA::fromStandard(StdImageDataPtr newContent,
 
 	if (!this->fixedSize) {
 		// Update offset
-		this->stream_data->seekp(0, stream::start);
-		this->stream_data << u16le(this->width) << u16le(this->height);
+		this->data->seekp(0, stream::start);
+		this->data << u16le(this->width) << u16le(this->height);
 	}
 	return;
 }
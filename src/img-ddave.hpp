@@ -54,7 +54,6 @@ class Image_DDaveCGA: virtual public Image_CGA {
 			StdImageDataPtr newMask);
 
 	protected:
-		stream::inout_sptr stream_data; // stream::inout_sptr copy, as inherited one is a bitstream
 		bool fixedSize;
 
 };
@@ -24,7 +24,9 @@
 #include <camoto/util.hpp>
 #include <camoto/stream_filtered.hpp>
 #include <camoto/stream_sub.hpp>
+#include <camoto/gamegraphics/trace.hpp>
 #include "img-pcx.hpp"
+#include "instrument.hpp"
 
 /// Pad out to a multiple of two bytes
 /// @todo Does this work for files where it was four?
@@ -33,15 +35,6 @@
 namespace camoto {
 namespace gamegraphics {
 
-/// Resize a stream when the end part of it has been turned into a substream
-void truncateParent(stream::output_sptr parent, stream::output_sub_sptr sub,
-	stream::pos off, stream::len len)
-{
-	parent->truncate(off + len);
-	sub->resize(len);
-	return;
-}
-
 class filter_pcx_unrle: virtual public filter
 {
 	protected:
@@ -58,6 +51,7 @@ class filter_pcx_unrle: virtual public filter
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn)
 		{
+			TraceSpan span("filter_pcx_unrle::transform");
 			stream::len r = 0, w = 0;
 			// While there's more space to write, and either more data to read or
 			// more data to write
@@ -134,6 +128,7 @@ class filter_pcx_rle: virtual public filter
 		virtual void transform(uint8_t *out, stream::len *lenOut,
 			const uint8_t *in, stream::len *lenIn)
 		{
+			TraceSpan span("filter_pcx_rle::transform");
 			stream::len r = 0, w = 0;
 			// +2 == make sure there's always enough room to write one RLE pair
 			bool eof = false;
@@ -173,10 +168,41 @@ class filter_pcx_rle: virtual public filter
 		}
 };
 
-stream::len putNextChar(stream::output_sptr src, uint8_t *lastChar, uint8_t out)
+stream::len putNextChar(std::vector<uint8_t> *dest, uint8_t *lastChar,
+	uint8_t out)
 {
 	*lastChar = out;
-	return src->try_write(&out, 1);
+	dest->push_back(out);
+	return 1;
+}
+
+/// Number of bytes filter_pcx_rle writes for one run.
+static stream::len rleRunLength(uint8_t val, unsigned int count)
+{
+	if ((count > 2) || ((count > 0) && (val >= 0xC0))) return 2;
+	return count;
+}
+
+/// Work out how long filter_pcx_rle's output will be, without encoding.
+/**
+ * This must split the data into runs in exactly the same way as
+ * filter_pcx_rle::transform().
+ */
+static stream::len rleLength(const std::vector<uint8_t>& in)
+{
+	stream::len len = 0;
+	uint8_t val = 0;
+	unsigned int count = 0;
+	for (std::vector<uint8_t>::const_iterator i = in.begin(); i != in.end(); i++) {
+		if ((count < 63) && (*i == val)) {
+			count++;
+		} else {
+			len += rleRunLength(val, count);
+			val = *i;
+			count = 1;
+		}
+	}
+	return len + rleRunLength(val, count);
 }
 
 
@@ -454,6 +480,7 @@ StdImageDataPtr Image_PCX::toStandard()
 		filter_sptr filt(new filter_pcx_unrle());
 		stream::input_filtered_sptr fs(new stream::input_filtered());
 		fs->open(sub, filt);
+		countFilterPass();
 		filtered = fs;
 	} else {
 		filtered = this->data;
@@ -522,15 +549,16 @@ void Image_PCX::fromStandard(StdImageDataPtr newContent,
 	this->getDimensions(&width, &height);
 	assert((width != 0) && (height != 0));
 
-	int16_t bytesPerPlaneScanline = width * this->bitsPerPlane / 8;
-	// Pad out to a multiple of PLANE_PAD bytes
-	bytesPerPlaneScanline += bytesPerPlaneScanline % PLANE_PAD;
-
-	// Assume worst case and enlarge file enough to fit complete data
-	stream::len maxSize = 128+bytesPerPlaneScanline*2 * this->numPlanes * height + 768+1;
-	this->data->truncate(maxSize);
+	// Pack the pixels first so the file can be set to its final size up front
+	std::vector<uint8_t> lines;
+	int16_t bytesPerPlaneScanline = this->packScanlines(newContent.get(), &lines);
+	stream::len lenImage = (this->encoding == 1) ? rleLength(lines) : lines.size();
+	int palSize = this->pal->size();
+	bool vgaPal = (this->ver >= 5) && (palSize > 16);
+	stream::len lenTotal = 128 + lenImage + (vgaPal ? 769 : 0);
+	this->data->truncate(lenTotal);
 
-	this->data->seekg(0, stream::start);
+	this->data->seekp(0, stream::start);
 	this->data
 		<< u8(0x0A)
 		<< u8(this->ver)
@@ -546,7 +574,6 @@ void Image_PCX::fromStandard(StdImageDataPtr newContent,
 
 	/// @todo Handle CGA graphics-mode palette
 
-	int palSize = this->pal->size();
 	for (int i = 0; i < std::min(palSize, 16); i++) {
 		this->data
 			<< u8(this->pal->at(i).red)
@@ -573,23 +600,70 @@ void Image_PCX::fromStandard(StdImageDataPtr newContent,
 	}
 
 	assert(this->data->tellp() == 128);
-	// Encode the RLE image data if necessary
-	stream::output_sptr filtered;
+	// Encode the RLE image data if necessary.  This is done in memory rather
+	// than through a filtered stream, as that would resize the file again.
 	if (this->encoding == 1) {
-		stream::output_sub_sptr sub(new stream::output_sub());
-		sub->open(this->data, 128, maxSize - 128, boost::bind(&truncateParent, this->data, sub, 128, _1));
-		filter_sptr filt(new filter_pcx_rle());
-		stream::output_filtered_sptr fs(new stream::output_filtered());
-		fs->open(sub, filt, NULL);
-		filtered = fs;
-	} else {
-		filtered = this->data;
+		// +3 == room for transform() to finish the last RLE pair in one call
+		std::vector<uint8_t> rle(lenImage + 3);
+		filter_pcx_rle filt;
+		filt.reset(lines.size());
+		stream::len lenIn = lines.size(), lenOut = rle.size();
+		countFilterPass();
+		filt.transform(&rle[0], &lenOut, lines.empty() ? NULL : &lines[0], &lenIn);
+		assert((lenIn == lines.size()) && (lenOut == lenImage));
+		this->data->write(&rle[0], lenImage);
+	} else if (!lines.empty()) {
+		this->data->write(&lines[0], lines.size());
+	}
+
+	// Write the VGA palette if ver 5 and 256 colour pal
+	if (vgaPal) {
+		this->data << u8(0x0C); // palette presence flag
+		for (int i = 0; i < std::min(palSize, 256); i++) {
+			this->data
+				<< u8(this->pal->at(i).red)
+				<< u8(this->pal->at(i).green)
+				<< u8(this->pal->at(i).blue)
+			;
+		}
+		// Pad out to 256 colours if needed
+		for (int i = palSize; i < 256; i++) {
+			this->data->write("\0\0\0", 3);
+		}
 	}
 
-	uint8_t *line = newContent.get();
+	assert(this->data->tellp() == lenTotal);
+	return;
+}
+
+bool Image_PCX::getEncodedSize(StdImageDataPtr newContent,
+	StdImageDataPtr newMask, stream::len *size)
+{
+	if (!this->pal) this->getPalette();
+
+	std::vector<uint8_t> lines;
+	this->packScanlines(newContent.get(), &lines);
+	stream::len lenImage = (this->encoding == 1) ? rleLength(lines) : lines.size();
+	bool vgaPal = (this->ver >= 5) && (this->pal->size() > 16);
+	*size = 128 + lenImage + (vgaPal ? 769 : 0);
+	return true;
+}
+
+int16_t Image_PCX::packScanlines(const uint8_t *content,
+	std::vector<uint8_t> *lines)
+{
+	unsigned int width, height;
+	this->getDimensions(&width, &height);
+
+	int16_t bytesPerPlaneScanline = width * this->bitsPerPlane / 8;
+	// Pad out to a multiple of PLANE_PAD bytes
+	bytesPerPlaneScanline += bytesPerPlaneScanline % PLANE_PAD;
+	lines->reserve(bytesPerPlaneScanline * this->numPlanes * height);
+
+	const uint8_t *line = content;
 	bitstream_sptr bits(new bitstream(bitstream::bigEndian));
-	uint8_t lastChar;
-	fn_putnextchar cbNext = boost::bind(putNextChar, filtered, &lastChar, _1);
+	uint8_t lastChar = 0;
+	fn_putnextchar cbNext = boost::bind(putNextChar, lines, &lastChar, _1);
 	int planeMask = (1 << this->bitsPerPlane) - 1;
 	int pad = bytesPerPlaneScanline - ((this->bitsPerPlane * width + 7) / 8);
 	int val;
@@ -621,27 +695,7 @@ void Image_PCX::fromStandard(StdImageDataPtr newContent,
 		}
 		line += width;
 	}
-	filtered->flush();
-	filtered.reset();
-
-	// Write the VGA palette if ver 5 and 256 colour pal
-	if ((this->ver >= 5) && (palSize > 16)) {
-		this->data << u8(0x0C); // palette presence flag
-		for (int i = 0; i < std::min(palSize, 256); i++) {
-			this->data
-				<< u8(this->pal->at(i).red)
-				<< u8(this->pal->at(i).green)
-				<< u8(this->pal->at(i).blue)
-			;
-		}
-		// Pad out to 256 colours if needed
-		for (int i = palSize; i < 256; i++) {
-			this->data->write("\0\0\0", 3);
-		}
-	}
-
-	this->data->truncate_here();
-	return;
+	return bytesPerPlaneScanline;
 }
 
 PaletteTablePtr Image_PCX::getPalette()
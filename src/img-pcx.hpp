@@ -21,6 +21,7 @@
 #ifndef _CAMOTO_IMG_PCX_HPP_
 #define _CAMOTO_IMG_PCX_HPP_
 
+#include <vector>
 #include <camoto/gamegraphics/imagetype.hpp>
 #include "baseimage.hpp"
 
@@ -116,6 +117,8 @@ class Image_PCX: virtual public Image_Base
 		virtual StdImageDataPtr toStandardMask();
 		virtual void fromStandard(StdImageDataPtr newContent,
 			StdImageDataPtr newMask);
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size);
 		virtual PaletteTablePtr getPalette();
 		virtual void setPalette(PaletteTablePtr newPalette);
 
@@ -128,6 +131,18 @@ class Image_PCX: virtual public Image_Base
 		uint8_t numPlanes;
 		unsigned int width;
 		unsigned int height;
+
+		/// Split pixels into planes and scanlines as stored in the file.
+		/**
+		 * @param content
+		 *   Image data in the standard format.
+		 *
+		 * @param lines
+		 *   Empty vector to receive the scanlines, before any RLE encoding.
+		 *
+		 * @return Number of bytes in each plane of a scanline, including padding.
+		 */
+		int16_t packScanlines(const uint8_t *content, std::vector<uint8_t> *lines);
 };
 
 } // namespace gamegraphics
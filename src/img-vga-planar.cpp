@@ -18,11 +18,122 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "img-vga-planar.hpp"
 
 namespace camoto {
 namespace gamegraphics {
 
+/// Interleave four planes into linear pixel data.
+/**
+ * @param planes
+ *   Source data, four consecutive planes of planeSize bytes each.
+ *
+ * @param linear
+ *   Destination buffer, 4 * planeSize bytes.  Pixel n is taken from plane
+ *   n % 4.
+ *
+ * @param planeSize
+ *   Number of bytes in each plane.
+ */
+static void vgaPlanarToLinear(const uint8_t *planes, uint8_t *linear,
+	unsigned long planeSize)
+{
+	const uint8_t *p0 = planes;
+	const uint8_t *p1 = p0 + planeSize;
+	const uint8_t *p2 = p1 + planeSize;
+	const uint8_t *p3 = p2 + planeSize;
+	unsigned long j = 0;
+#ifdef __SSE2__
+	// Each pass reads 16 bytes from every plane and writes 64 linear pixels.
+	// Streaming stores keep the output from evicting the planes still being
+	// read, but they need an aligned destination.
+	bool aligned = ((reinterpret_cast<size_t>(linear) & 15) == 0);
+	for (; j + 16 <= planeSize; j += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(p0 + j));
+		__m128i b = _mm_loadu_si128((const __m128i *)(p1 + j));
+		__m128i c = _mm_loadu_si128((const __m128i *)(p2 + j));
+		__m128i d = _mm_loadu_si128((const __m128i *)(p3 + j));
+		__m128i abLo = _mm_unpacklo_epi8(a, b);
+		__m128i abHi = _mm_unpackhi_epi8(a, b);
+		__m128i cdLo = _mm_unpacklo_epi8(c, d);
+		__m128i cdHi = _mm_unpackhi_epi8(c, d);
+		__m128i *out = (__m128i *)(linear + j * 4);
+		if (aligned) {
+			_mm_stream_si128(out + 0, _mm_unpacklo_epi16(abLo, cdLo));
+			_mm_stream_si128(out + 1, _mm_unpackhi_epi16(abLo, cdLo));
+			_mm_stream_si128(out + 2, _mm_unpacklo_epi16(abHi, cdHi));
+			_mm_stream_si128(out + 3, _mm_unpackhi_epi16(abHi, cdHi));
+		} else {
+			_mm_storeu_si128(out + 0, _mm_unpacklo_epi16(abLo, cdLo));
+			_mm_storeu_si128(out + 1, _mm_unpackhi_epi16(abLo, cdLo));
+			_mm_storeu_si128(out + 2, _mm_unpacklo_epi16(abHi, cdHi));
+			_mm_storeu_si128(out + 3, _mm_unpackhi_epi16(abHi, cdHi));
+		}
+	}
+	if (aligned) _mm_sfence();
+#endif
+	for (; j < planeSize; j++) {
+		linear[j * 4 + 0] = p0[j];
+		linear[j * 4 + 1] = p1[j];
+		linear[j * 4 + 2] = p2[j];
+		linear[j * 4 + 3] = p3[j];
+	}
+	return;
+}
+
+#ifdef __SSE2__
+/// Extract one plane (byte n of every 32-bit group) from 64 linear pixels.
+static inline __m128i vgaExtractPlane(__m128i v0, __m128i v1, __m128i v2,
+	__m128i v3, int shift)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i s0 = _mm_and_si128(_mm_srl_epi32(v0, _mm_cvtsi32_si128(shift)), mask);
+	__m128i s1 = _mm_and_si128(_mm_srl_epi32(v1, _mm_cvtsi32_si128(shift)), mask);
+	__m128i s2 = _mm_and_si128(_mm_srl_epi32(v2, _mm_cvtsi32_si128(shift)), mask);
+	__m128i s3 = _mm_and_si128(_mm_srl_epi32(v3, _mm_cvtsi32_si128(shift)), mask);
+	// Values are all < 256 so neither pack saturates
+	return _mm_packus_epi16(_mm_packs_epi32(s0, s1), _mm_packs_epi32(s2, s3));
+}
+#endif
+
+/// Split linear pixel data into four planes.
+/**
+ * This is the inverse of vgaPlanarToLinear().
+ */
+static void vgaLinearToPlanar(const uint8_t *linear, uint8_t *planes,
+	unsigned long planeSize)
+{
+	uint8_t *p0 = planes;
+	uint8_t *p1 = p0 + planeSize;
+	uint8_t *p2 = p1 + planeSize;
+	uint8_t *p3 = p2 + planeSize;
+	unsigned long j = 0;
+#ifdef __SSE2__
+	for (; j + 16 <= planeSize; j += 16) {
+		const __m128i *in = (const __m128i *)(linear + j * 4);
+		__m128i v0 = _mm_loadu_si128(in + 0);
+		__m128i v1 = _mm_loadu_si128(in + 1);
+		__m128i v2 = _mm_loadu_si128(in + 2);
+		__m128i v3 = _mm_loadu_si128(in + 3);
+		_mm_storeu_si128((__m128i *)(p0 + j), vgaExtractPlane(v0, v1, v2, v3, 0));
+		_mm_storeu_si128((__m128i *)(p1 + j), vgaExtractPlane(v0, v1, v2, v3, 8));
+		_mm_storeu_si128((__m128i *)(p2 + j), vgaExtractPlane(v0, v1, v2, v3, 16));
+		_mm_storeu_si128((__m128i *)(p3 + j), vgaExtractPlane(v0, v1, v2, v3, 24));
+	}
+#endif
+	for (; j < planeSize; j++) {
+		p0[j] = linear[j * 4 + 0];
+		p1[j] = linear[j * 4 + 1];
+		p2[j] = linear[j * 4 + 2];
+		p3[j] = linear[j * 4 + 3];
+	}
+	return;
+}
+
 Image_VGAPlanar::Image_VGAPlanar(stream::inout_sptr data,
 	stream::pos off)
 	:	data(data),
@@ -56,8 +167,14 @@ StdImageDataPtr Image_VGAPlanar::toStandard()
 	// Convert the planar data to linear
 	unsigned int planeWidth = width / 4;
 	unsigned int planeSize = planeWidth * height;
-	for (unsigned int i = 0; i < dataSize; i++) {
-		imgData[i % planeSize * 4 + i / planeSize] = rawData[i];
+	if (width % 4 == 0) {
+		vgaPlanarToLinear(rawData, imgData, planeSize);
+	} else {
+		// Odd widths don't split evenly into planes, so keep the original
+		// behaviour for them.
+		for (unsigned int i = 0; i < dataSize; i++) {
+			imgData[i % planeSize * 4 + i / planeSize] = rawData[i];
+		}
 	}
 
 	return ret;
@@ -100,8 +217,12 @@ void Image_VGAPlanar::fromStandard(StdImageDataPtr newContent,
 	// Convert the linear data to planar
 	unsigned int planeWidth = width / 4;
 	unsigned int planeSize = planeWidth * height;
-	for (unsigned int i = 0; i < dataSize; i++) {
-		rawData[i] = newContent[i % planeSize * 4 + i / planeSize];
+	if (width % 4 == 0) {
+		vgaLinearToPlanar(newContent.get(), rawData, planeSize);
+	} else {
+		for (unsigned int i = 0; i < dataSize; i++) {
+			rawData[i] = newContent[i % planeSize * 4 + i / planeSize];
+		}
 	}
 
 	this->data->seekp(this->off, stream::start);
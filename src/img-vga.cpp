@@ -93,5 +93,15 @@ void Image_VGA::fromStandard(StdImageDataPtr newContent,
 	return;
 }
 
+bool Image_VGA::getEncodedSize(StdImageDataPtr newContent,
+	StdImageDataPtr newMask, stream::len *size)
+{
+	// Anything before off is a fixed-size header written by the descendent class
+	unsigned int width, height;
+	this->getDimensions(&width, &height);
+	*size = this->off + width * height;
+	return true;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
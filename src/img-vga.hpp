@@ -54,6 +54,8 @@ class Image_VGA: virtual public Image_Base
 		virtual StdImageDataPtr toStandardMask();
 		virtual void fromStandard(StdImageDataPtr newContent,
 			StdImageDataPtr newMask);
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size);
 
 	protected:
 		stream::inout_sptr data; ///< Image content
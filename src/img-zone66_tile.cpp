@@ -34,6 +34,110 @@
 namespace camoto {
 namespace gamegraphics {
 
+/// Decode Zone 66 RLE data that has already been loaded into memory.
+/**
+ * This is shared by ImageType_Zone66Tile::isInstance() and
+ * Image_Zone66Tile::toStandard() so that a file is only reported as valid if
+ * it will actually decode.
+ *
+ * @param rle
+ *   RLE data, starting just after the width/height header.
+ *
+ * @param lenRLE
+ *   Number of bytes available at rle.
+ *
+ * @param width
+ *   Image width, in pixels.
+ *
+ * @param height
+ *   Image height, in pixels.
+ *
+ * @param imgData
+ *   Buffer of width * height bytes to receive the 8bpp pixels, or NULL to
+ *   only check the data is valid.  Pixels skipped by the RLE codes are set to
+ *   zero (black.)
+ *
+ * @param lenUsed
+ *   On return, the number of bytes of RLE data used, including any trailing
+ *   end-of-image code.
+ *
+ * @return NULL on success, or a description of the problem if the data is
+ *   corrupt.
+ */
+static const char *z66_decode(const uint8_t *rle, stream::len lenRLE,
+	unsigned int width, unsigned int height, uint8_t *imgData,
+	stream::len *lenUsed)
+{
+	const uint8_t *in = rle, *inEnd = rle + lenRLE;
+	unsigned int dataSize = width * height;
+
+	// Everything before this offset has been written to, everything after is
+	// still uninitialised and must be blanked if it gets skipped over.
+	unsigned int filled = 0;
+
+	unsigned int y = 0;
+	unsigned int i = 0;
+	while (i < dataSize) {
+		if (in >= inEnd) {
+			*lenUsed = in - rle;
+			return "data ended before the end of the image";
+		}
+		uint8_t code = *in++;
+		switch (code) {
+			case 0xFD: // Skip the given number of pixels
+				if (in >= inEnd) {
+					*lenUsed = in - rle;
+					return "data ended in the middle of a skip code";
+				}
+				i += *in++;
+				// Note: i may now be >= dataSize
+				break;
+
+			case 0xFE: // Go to the next line
+				i = ++y * width;
+				break;
+
+			case 0xFF: // End of image
+				i = dataSize;
+				in--; // let the code below pick up the end-of-image code
+				break;
+
+			case 0x00: // shouldn't happen
+				*lenUsed = in - rle;
+				return "corrupted data";
+
+			default:
+				if (i + code > dataSize) {
+					*lenUsed = in - rle;
+					return "bad data, tried to write past end of image";
+				}
+				if (in + code > inEnd) {
+					*lenUsed = in - rle;
+					return "data ended in the middle of a pixel run";
+				}
+				if (imgData) {
+					// Make any skipped pixels black
+					if (i > filled) memset(imgData + filled, 0, i - filled);
+					memcpy(imgData + i, in, code);
+				}
+				in += code;
+				i += code;
+				if (i > filled) filled = i;
+				break;
+		}
+	}
+	// Blank out whatever was skipped at the end of the image
+	if (imgData && (filled < dataSize)) {
+		memset(imgData + filled, 0, dataSize - filled);
+	}
+
+	// Include the optional end-of-image code
+	if ((in < inEnd) && (*in == 0xFF)) in++;
+
+	*lenUsed = in - rle;
+	return NULL;
+}
+
 ImageType_Zone66Tile::ImageType_Zone66Tile()
 {
 }
@@ -69,41 +173,40 @@ std::vector<std::string> ImageType_Zone66Tile::getGameList() const
 ImageType::Certainty ImageType_Zone66Tile::isInstance(stream::input_sptr psImage) const
 {
 	stream::pos len = psImage->size();
+	if (len < Z66_IMG_OFFSET + 1) return DefinitelyNo; // too short
 
 	psImage->seekg(0, stream::start);
 	uint16_t width, height;
 	psImage >> u16le(width) >> u16le(height);
-	int imgSize = width * height;
-	int pos = 0;
-	while (pos < imgSize) {
-		uint8_t code;
-		psImage >> u8(code);
-		len--;
-		switch (code) {
-			case 0x00: return DefinitelyNo; // doesn't make sense
-			case 0xFF: // end of image
-				if (len == 0) return DefinitelyYes; // EOF marker at EOF
-				return DefinitelyNo; // EOF marker with trailing data
-			case 0xFE: // skip to EOL
-				pos += width - (pos % width);
-				break;
-			case 0xFD:
-				psImage >> u8(code);
-				pos += code;
-				len -= code+1;
-				break;
-			default:
-				pos += code;
-				len -= code;
-				break;
-		}
+
+	// Every pixel takes at most two bytes (a one-pixel run), plus a code at
+	// the end of each line and the image.  Anything longer isn't a tile, and
+	// this avoids loading the whole of some large unrelated file.
+	// TESTED BY: img_zone66_tile_isinstance_c06
+	stream::len lenRLE = len - Z66_IMG_OFFSET;
+	stream::len maxRLE = 2 * (stream::len)width * height + height + 1;
+	if (lenRLE > maxRLE) return DefinitelyNo;
+
+	// Parse the RLE data in one go, the same way toStandard() would
+	uint8_t *rle = new uint8_t[lenRLE];
+	StdImageDataPtr ptrRLE(rle);
+	psImage->read(rle, lenRLE);
+
+	stream::len lenUsed;
+	if (z66_decode(rle, lenRLE, width, height, NULL, &lenUsed)) {
+		// TESTED BY: img_zone66_tile_isinstance_c03
+		// TESTED BY: img_zone66_tile_isinstance_c04
+		// TESTED BY: img_zone66_tile_isinstance_c05
+		return DefinitelyNo; // corrupted data
 	}
 
-	// Read all data but didn't have 0xFF at EOF
-	if ((len == 0) && (pos == imgSize)) return DefinitelyYes;
+	// All the data must be used, trailing data means it's not a tile
+	// TESTED BY: img_zone66_tile_isinstance_c02
+	if (lenUsed != lenRLE) return DefinitelyNo;
 
-	// TESTED BY: TODO //fmt_grp_duke3d_isinstance_c01
-	return DefinitelyNo;
+	// TESTED BY: img_zone66_tile_isinstance_c00
+	// TESTED BY: img_zone66_tile_isinstance_c01
+	return DefinitelyYes;
 }
 
 ImagePtr ImageType_Zone66Tile::create(stream::inout_sptr psImage,
@@ -216,42 +319,17 @@ StdImageDataPtr Image_Zone66Tile::toStandard()
 		return ret;
 	}
 
-	// Make any skipped pixels black
-	memset(imgData, 0, dataSize);
-
+	// Read the whole tile in one go and decode it from memory
 	this->data->seekg(Z66_IMG_OFFSET, stream::start);
-	unsigned int y = 0;
-	for (int i = 0; i < dataSize; ) {
-		uint8_t code;
-		this->data >> u8(code);
-		switch (code) {
-			case 0xFD: // Skip the given number of pixels
-				this->data >> u8(code);
-				i += code;
-				// Note: i may now be >= dataSize
-				break;
-
-			case 0xFE: // Go to the next line
-				i = ++y * this->width;
-				break;
-
-			case 0xFF: // End of image
-				i = dataSize;
-				break;
+	stream::len lenRLE = this->data->size() - Z66_IMG_OFFSET;
+	uint8_t *rle = new uint8_t[lenRLE];
+	StdImageDataPtr ptrRLE(rle);
+	this->data->read(rle, lenRLE);
 
-			case 0x00: // shouldn't happen
-				throw stream::error("corrupted data");
-
-			default:
-				if (i + code <= dataSize) {
-					this->data->read(&imgData[i], code);
-					i += code;
-				} else {
-					throw stream::error("bad data, tried to write past end of image");
-				}
-				break;
-		}
-	}
+	stream::len lenUsed;
+	const char *error = z66_decode(rle, lenRLE, this->width, this->height,
+		imgData, &lenUsed);
+	if (error) throw stream::error(error);
 
 	return ret;
 }
@@ -269,28 +347,15 @@ StdImageDataPtr Image_Zone66Tile::toStandardMask()
 	return ret;
 }
 
-void Image_Zone66Tile::fromStandard(StdImageDataPtr newContent,
-	StdImageDataPtr newMask)
+void Image_Zone66Tile::encode(const uint8_t *imgData,
+	std::vector<uint8_t> *rle) const
 {
-	assert((this->width != 0) && (this->height != 0));
-	this->data->seekp(0, stream::start);
-
-	if ((this->width == 320) && (this->height == 200)) {
-		// Special case for headerless fullscreen images
-		this->data->truncate(64000);
-		this->data->write(newContent.get(), 64000);
-		return;
-	}
-
-	// Start off with enough space for the worst-case size
-	this->data->truncate(4 + (this->width + 2) * this->height + 1);
-	int finalSize = 4; // for header
-
-	this->data->seekp(Z66_IMG_OFFSET, stream::start);
-	uint8_t *imgData = (uint8_t *)newContent.get();
+	// The initial reservation is enough for most tiles, but the buffer can grow
+	// up to the worst case of (width + 2) * height + 1 if needed.
+	rle->reserve(this->width * this->height / 2 + this->height + 1);
 
 	// Find the last non-black pixel in the image
-	uint8_t *imgEnd = imgData + this->width * this->height - 1;
+	const uint8_t *imgEnd = imgData + this->width * this->height - 1;
 	while ((*imgEnd == 0) && (imgEnd > imgData)) imgEnd--;
 	imgEnd++; // still want current (non-black) pixel
 
@@ -315,8 +380,8 @@ void Image_Zone66Tile::fromStandard(StdImageDataPtr newContent,
 					if (amt > 1) {
 						// More efficient to write as RLE
 						// TESTED BY: img_zone66_tile_from_standard_8x4
-						this->data << u8(0xFD) << u8(amt);
-						finalSize += 2;
+						rle->push_back(0xFD);
+						rle->push_back(amt);
 						// If there were enough blanks, keep looking for more.
 						// TESTED BY: TODO
 						if (amt == 255) continue;
@@ -357,11 +422,10 @@ void Image_Zone66Tile::fromStandard(StdImageDataPtr newContent,
 					}
 				}
 			}
-			this->data << u8(amt);
-			this->data->write(imgData, amt);
+			rle->push_back(amt);
+			rle->insert(rle->end(), imgData, imgData + amt);
 			imgData += amt;
 			dw -= amt;
-			finalSize += amt + 1;
 		}
 
 		// TESTED BY: img_zone66_tile_from_standard_8x5
@@ -369,20 +433,54 @@ void Image_Zone66Tile::fromStandard(StdImageDataPtr newContent,
 		if (imgData >= imgEnd) break; // just write EOF
 
 		assert(dw == 0); // make sure we read everything
-		this->data << u8(0xFE); // end of line
-		finalSize++;
+		rle->push_back(0xFE); // end of line
 	}
-	this->data << u8(0xFF); // end of file
-	finalSize++;
+	rle->push_back(0xFF); // end of file
+	return;
+}
 
-	this->data->flush();
+void Image_Zone66Tile::fromStandard(StdImageDataPtr newContent,
+	StdImageDataPtr newMask)
+{
+	assert((this->width != 0) && (this->height != 0));
+	this->data->seekp(0, stream::start);
 
-	// Then shrink back to actual size
-	this->data->truncate(finalSize);
+	if ((this->width == 320) && (this->height == 200)) {
+		// Special case for headerless fullscreen images
+		this->data->truncate(64000);
+		this->data->write(newContent.get(), 64000);
+		return;
+	}
+
+	// Encode into memory first, so the file only has to be resized once
+	std::vector<uint8_t> rle;
+	this->encode(newContent.get(), &rle);
+
+	// Resize to the exact final size and write everything out at once
+	this->data->truncate(Z66_IMG_OFFSET + rle.size());
+	this->data->seekp(Z66_IMG_OFFSET, stream::start);
+	this->data->write(&rle[0], rle.size());
+	this->data->flush();
 
 	return;
 }
 
+bool Image_Zone66Tile::getEncodedSize(StdImageDataPtr newContent,
+	StdImageDataPtr newMask, stream::len *size)
+{
+	if ((this->width == 320) && (this->height == 200)) {
+		*size = 64000;
+		return true;
+	}
+
+	// There's no quicker way than running the encoder, but at least this
+	// doesn't touch the file.
+	std::vector<uint8_t> rle;
+	this->encode(newContent.get(), &rle);
+	*size = Z66_IMG_OFFSET + rle.size();
+	return true;
+}
+
 PaletteTablePtr Image_Zone66Tile::getPalette()
 {
 	return this->pal;
@@ -21,6 +21,7 @@
 #ifndef _CAMOTO_IMG_ZONE66_TILE_HPP_
 #define _CAMOTO_IMG_ZONE66_TILE_HPP_
 
+#include <vector>
 #include <camoto/gamegraphics/imagetype.hpp>
 #include "baseimage.hpp"
 
@@ -82,10 +83,25 @@ class Image_Zone66Tile: virtual public Image_Base {
 		virtual void fromStandard(StdImageDataPtr newContent,
 			StdImageDataPtr newMask);
 
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size);
+
 		virtual PaletteTablePtr getPalette();
 
 		virtual void setPalette(PaletteTablePtr newPalette);
 
+	protected:
+		/// Encode standard pixels into RLE data.
+		/**
+		 * @param imgData
+		 *   Image data, width * height bytes.
+		 *
+		 * @param rle
+		 *   Empty vector to receive the RLE data that goes after the header,
+		 *   including the end-of-file code.
+		 */
+		void encode(const uint8_t *imgData, std::vector<uint8_t> *rle) const;
+
 };
 
 } // namespace gamegraphics
@@ -0,0 +1,685 @@
+/**
+ * @file  instrument.cpp
+ * @brief Optional per-format I/O, allocation and timing counters.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <map>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+#include "instrument.hpp"
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Is instrumentation turned on?  Checked without the lock by every call.
+static boost::atomic<bool> instrumenting(false);
+
+/// Protects statsMap and every FormatStats within it.
+static boost::mutex statsMutex;
+
+/// Counters for each format code.
+/**
+ * Entries are never removed, only zeroed, so the wrappers below can keep
+ * pointers to them.
+ */
+typedef std::map<std::string, FormatStats> StatsMap;
+static StatsMap statsMap;
+
+/// thread_specific_ptr cleanup function, as the counters aren't owned.
+static void noCleanup(FormatStats *)
+{
+}
+
+/// Counters for the instrumented format currently running in each thread.
+static boost::thread_specific_ptr<FormatStats> currentFormat(noCleanup);
+
+void setInstrumenting(bool enable)
+{
+	instrumenting = enable;
+	return;
+}
+
+bool isInstrumenting()
+{
+	return instrumenting;
+}
+
+/// Set every counter back to zero.
+static void zeroStats(FormatStats *s)
+{
+	s->bytesRead = 0;
+	s->bytesWritten = 0;
+	s->readCalls = 0;
+	s->writeCalls = 0;
+	s->seekCalls = 0;
+	s->filterPasses = 0;
+	s->imageBuffers = 0;
+	s->imageBufferBytes = 0;
+	s->toStandardCalls = 0;
+	s->toStandardSeconds = 0;
+	s->fromStandardCalls = 0;
+	s->fromStandardSeconds = 0;
+	return;
+}
+
+/// Has anything been counted since the last reset?
+static bool statsUsed(const FormatStats& s)
+{
+	return s.readCalls || s.writeCalls || s.seekCalls || s.filterPasses
+		|| s.imageBuffers || s.toStandardCalls || s.fromStandardCalls;
+}
+
+/// Get the counters for a format, creating them if needed.
+static FormatStats *getStats(const std::string& code)
+{
+	boost::mutex::scoped_lock lock(statsMutex);
+	StatsMap::iterator i = statsMap.find(code);
+	if (i == statsMap.end()) {
+		FormatStats s;
+		s.code = code;
+		zeroStats(&s);
+		i = statsMap.insert(std::make_pair(code, s)).first;
+	}
+	return &i->second;
+}
+
+void countFilterPass()
+{
+	if (!instrumenting) return;
+	FormatStats *s = currentFormat.get();
+	if (!s) return;
+	boost::mutex::scoped_lock lock(statsMutex);
+	s->filterPasses++;
+	return;
+}
+
+FormatStatsVector getFormatStats()
+{
+	boost::mutex::scoped_lock lock(statsMutex);
+	FormatStatsVector list;
+	for (StatsMap::const_iterator i = statsMap.begin(); i != statsMap.end(); i++) {
+		if (statsUsed(i->second)) list.push_back(i->second);
+	}
+	return list;
+}
+
+void resetFormatStats()
+{
+	boost::mutex::scoped_lock lock(statsMutex);
+	for (StatsMap::iterator i = statsMap.begin(); i != statsMap.end(); i++) {
+		zeroStats(&i->second);
+	}
+	return;
+}
+
+/// Mark a format as the one running in this thread until going out of scope.
+class ActiveFormat
+{
+	public:
+		ActiveFormat(FormatStats *stats)
+			:	prev(currentFormat.get())
+		{
+			currentFormat.reset(stats);
+		}
+
+		~ActiveFormat()
+		{
+			currentFormat.reset(this->prev);
+		}
+
+	protected:
+		FormatStats *prev;
+};
+
+/// Seconds elapsed since a given time.
+static double secondsSince(const boost::posix_time::ptime& start)
+{
+	return (boost::posix_time::microsec_clock::universal_time() - start)
+		.total_microseconds() / 1000000.0;
+}
+
+/// Read-only stream counting the calls made to another.
+class InstrumentedInput: virtual public stream::input
+{
+	public:
+		InstrumentedInput(stream::input_sptr parent, FormatStats *stats)
+			:	in(parent),
+				stats(stats)
+		{
+		}
+
+		virtual stream::len try_read(uint8_t *buffer, stream::len len)
+		{
+			stream::len r = this->in->try_read(buffer, len);
+			if (!instrumenting) return r;
+			boost::mutex::scoped_lock lock(statsMutex);
+			this->stats->readCalls++;
+			this->stats->bytesRead += r;
+			return r;
+		}
+
+		virtual void seekg(stream::delta off, stream::seek_from from)
+		{
+			if (instrumenting) {
+				boost::mutex::scoped_lock lock(statsMutex);
+				this->stats->seekCalls++;
+			}
+			this->in->seekg(off, from);
+			return;
+		}
+
+		virtual stream::pos tellg() const
+		{
+			return this->in->tellg();
+		}
+
+		virtual stream::len size() const
+		{
+			return this->in->size();
+		}
+
+	protected:
+		stream::input_sptr in;
+		FormatStats *stats;
+};
+
+/// Read/write stream counting the calls made to another.
+class InstrumentedStream: virtual public stream::inout,
+	virtual public InstrumentedInput
+{
+	public:
+		InstrumentedStream(stream::inout_sptr parent, FormatStats *stats)
+			:	InstrumentedInput(parent, stats),
+				out(parent)
+		{
+		}
+
+		virtual stream::len try_write(const uint8_t *buffer, stream::len len)
+		{
+			stream::len w = this->out->try_write(buffer, len);
+			if (!instrumenting) return w;
+			boost::mutex::scoped_lock lock(statsMutex);
+			this->stats->writeCalls++;
+			this->stats->bytesWritten += w;
+			return w;
+		}
+
+		virtual void seekp(stream::delta off, stream::seek_from from)
+		{
+			if (instrumenting) {
+				boost::mutex::scoped_lock lock(statsMutex);
+				this->stats->seekCalls++;
+			}
+			this->out->seekp(off, from);
+			return;
+		}
+
+		virtual stream::pos tellp() const
+		{
+			return this->out->tellp();
+		}
+
+		virtual void truncate(stream::len size)
+		{
+			this->out->truncate(size);
+			return;
+		}
+
+		virtual void flush()
+		{
+			this->out->flush();
+			return;
+		}
+
+	protected:
+		stream::inout_sptr out;
+};
+
+/// Wrap a stream so its use is counted.
+static stream::inout_sptr instrumentStream(stream::inout_sptr s,
+	FormatStats *stats)
+{
+	if (!s) return s;
+	return stream::inout_sptr(new InstrumentedStream(s, stats));
+}
+
+/// Wrap every supplementary stream so its use is counted.
+static SuppData instrumentSupps(const SuppData& suppData, FormatStats *stats)
+{
+	SuppData wrapped;
+	for (SuppData::const_iterator i = suppData.begin(); i != suppData.end(); i++) {
+		wrapped[i->first] = instrumentStream(i->second, stats);
+	}
+	return wrapped;
+}
+
+/// Image forwarding to another, timing the conversions.
+class InstrumentedImage: virtual public Image
+{
+	public:
+		InstrumentedImage(ImagePtr real, FormatStats *stats)
+			:	real(real),
+				stats(stats)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->real->getCaps();
+		}
+
+		virtual void getDimensions(unsigned int *width, unsigned int *height)
+		{
+			this->real->getDimensions(width, height);
+			return;
+		}
+
+		virtual void setDimensions(unsigned int width, unsigned int height)
+		{
+			ActiveFormat active(this->stats);
+			this->real->setDimensions(width, height);
+			return;
+		}
+
+		virtual void getHotspot(signed int *x, signed int *y)
+		{
+			this->real->getHotspot(x, y);
+			return;
+		}
+
+		virtual void setHotspot(signed int x, signed int y)
+		{
+			this->real->setHotspot(x, y);
+			return;
+		}
+
+		virtual void getHitRect(signed int *x, signed int *y)
+		{
+			this->real->getHitRect(x, y);
+			return;
+		}
+
+		virtual void setHitRect(signed int x, signed int y)
+		{
+			this->real->setHitRect(x, y);
+			return;
+		}
+
+		virtual StdImageDataPtr toStandard()
+		{
+			return this->convert(false);
+		}
+
+		virtual StdImageDataPtr toStandardMask()
+		{
+			return this->convert(true);
+		}
+
+		virtual void fromStandard(StdImageDataPtr newContent,
+			StdImageDataPtr newMask)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Image::fromStandard", this->stats->code.c_str());
+			boost::posix_time::ptime start =
+				boost::posix_time::microsec_clock::universal_time();
+			this->real->fromStandard(newContent, newMask);
+			if (!instrumenting) return;
+			double elapsed = secondsSince(start);
+
+			boost::mutex::scoped_lock lock(statsMutex);
+			this->stats->fromStandardCalls++;
+			this->stats->fromStandardSeconds += elapsed;
+			return;
+		}
+
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Image::getEncodedSize", this->stats->code.c_str());
+			return this->real->getEncodedSize(newContent, newMask, size);
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			ActiveFormat active(this->stats);
+			return this->real->getPalette();
+		}
+
+		virtual void setPalette(PaletteTablePtr newPalette)
+		{
+			ActiveFormat active(this->stats);
+			this->real->setPalette(newPalette);
+			return;
+		}
+
+	protected:
+		ImagePtr real;
+		FormatStats *stats;
+
+		/// Time a call to toStandard() or toStandardMask().
+		StdImageDataPtr convert(bool mask)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span(mask ? "Image::toStandardMask" : "Image::toStandard",
+				this->stats->code.c_str());
+			boost::posix_time::ptime start =
+				boost::posix_time::microsec_clock::universal_time();
+			StdImageDataPtr data = mask
+				? this->real->toStandardMask() : this->real->toStandard();
+			if (!instrumenting) return data;
+			double elapsed = secondsSince(start);
+
+			unsigned int width, height;
+			this->real->getDimensions(&width, &height);
+
+			boost::mutex::scoped_lock lock(statsMutex);
+			this->stats->toStandardCalls++;
+			this->stats->toStandardSeconds += elapsed;
+			this->stats->imageBuffers++;
+			this->stats->imageBufferBytes += width * height;
+			return data;
+		}
+};
+
+/// Wrap an image so its use is counted.
+static ImagePtr instrumentImage(ImagePtr img, FormatStats *stats)
+{
+	if (!img) return img;
+	return ImagePtr(new InstrumentedImage(img, stats));
+}
+
+/// Tileset forwarding to another, wrapping everything opened from it.
+class InstrumentedTileset: virtual public Tileset
+{
+	public:
+		InstrumentedTileset(TilesetPtr real, FormatStats *stats)
+			:	real(real),
+				stats(stats)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->real->getCaps();
+		}
+
+		virtual const VC_ENTRYPTR& getItems() const
+		{
+			return this->real->getItems();
+		}
+
+		virtual TilesetPtr openTileset(const EntryPtr& id)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Tileset::openTileset", this->stats->code.c_str());
+			TilesetPtr sub = this->real->openTileset(id);
+			if (!sub) return sub;
+			return TilesetPtr(new InstrumentedTileset(sub, this->stats));
+		}
+
+		virtual ImagePtr openImage(const EntryPtr& id)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Tileset::openImage", this->stats->code.c_str());
+			return instrumentImage(this->real->openImage(id), this->stats);
+		}
+
+		virtual EntryPtr insert(const EntryPtr& idBeforeThis, int attr)
+		{
+			ActiveFormat active(this->stats);
+			return this->real->insert(idBeforeThis, attr);
+		}
+
+		virtual void remove(EntryPtr& id)
+		{
+			ActiveFormat active(this->stats);
+			this->real->remove(id);
+			return;
+		}
+
+		virtual void resize(EntryPtr& id, stream::len newSize)
+		{
+			ActiveFormat active(this->stats);
+			this->real->resize(id, newSize);
+			return;
+		}
+
+		virtual void flush()
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Tileset::flush", this->stats->code.c_str());
+			this->real->flush();
+			return;
+		}
+
+		virtual void getTilesetDimensions(unsigned int *width,
+			unsigned int *height)
+		{
+			this->real->getTilesetDimensions(width, height);
+			return;
+		}
+
+		virtual void setTilesetDimensions(unsigned int width, unsigned int height)
+		{
+			ActiveFormat active(this->stats);
+			this->real->setTilesetDimensions(width, height);
+			return;
+		}
+
+		virtual unsigned int getLayoutWidth()
+		{
+			return this->real->getLayoutWidth();
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			ActiveFormat active(this->stats);
+			return this->real->getPalette();
+		}
+
+		virtual void setPalette(PaletteTablePtr newPalette)
+		{
+			ActiveFormat active(this->stats);
+			this->real->setPalette(newPalette);
+			return;
+		}
+
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint)
+		{
+			ActiveFormat active(this->stats);
+			return this->real->getFingerprint(id, fingerprint);
+		}
+
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks)
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("Tileset::replaceAll", this->stats->code.c_str());
+			this->real->replaceAll(pixels, masks);
+			return;
+		}
+
+	protected:
+		TilesetPtr real;
+		FormatStats *stats;
+};
+
+/// Image type wrapping the streams and images of another.
+class InstrumentedImageType: virtual public ImageType
+{
+	public:
+		InstrumentedImageType(ImageTypePtr real)
+			:	real(real),
+				stats(getStats(real->getCode()))
+		{
+		}
+
+		virtual std::string getCode() const
+		{
+			return this->real->getCode();
+		}
+
+		virtual std::string getFriendlyName() const
+		{
+			return this->real->getFriendlyName();
+		}
+
+		virtual std::vector<std::string> getFileExtensions() const
+		{
+			return this->real->getFileExtensions();
+		}
+
+		virtual std::vector<std::string> getGameList() const
+		{
+			return this->real->getGameList();
+		}
+
+		virtual Certainty isInstance(stream::input_sptr psImage) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("ImageType::isInstance", this->stats->code.c_str());
+			stream::input_sptr counted(new InstrumentedInput(psImage, this->stats));
+			return this->real->isInstance(counted);
+		}
+
+		virtual ImagePtr create(stream::inout_sptr psImage,
+			SuppData& suppData) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("ImageType::create", this->stats->code.c_str());
+			SuppData counted = instrumentSupps(suppData, this->stats);
+			return instrumentImage(
+				this->real->create(instrumentStream(psImage, this->stats), counted),
+				this->stats
+			);
+		}
+
+		virtual ImagePtr open(stream::inout_sptr psImage,
+			SuppData& suppData) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("ImageType::open", this->stats->code.c_str());
+			SuppData counted = instrumentSupps(suppData, this->stats);
+			return instrumentImage(
+				this->real->open(instrumentStream(psImage, this->stats), counted),
+				this->stats
+			);
+		}
+
+		virtual SuppFilenames getRequiredSupps(const std::string& filenameImage)
+			const
+		{
+			return this->real->getRequiredSupps(filenameImage);
+		}
+
+	protected:
+		ImageTypePtr real;
+		FormatStats *stats;
+};
+
+/// Tileset type wrapping the streams and tilesets of another.
+class InstrumentedTilesetType: virtual public TilesetType
+{
+	public:
+		InstrumentedTilesetType(TilesetTypePtr real)
+			:	real(real),
+				stats(getStats(real->getCode()))
+		{
+		}
+
+		virtual std::string getCode() const
+		{
+			return this->real->getCode();
+		}
+
+		virtual std::string getFriendlyName() const
+		{
+			return this->real->getFriendlyName();
+		}
+
+		virtual std::vector<std::string> getFileExtensions() const
+		{
+			return this->real->getFileExtensions();
+		}
+
+		virtual std::vector<std::string> getGameList() const
+		{
+			return this->real->getGameList();
+		}
+
+		virtual Certainty isInstance(stream::input_sptr psTileset) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("TilesetType::isInstance", this->stats->code.c_str());
+			stream::input_sptr counted(new InstrumentedInput(psTileset, this->stats));
+			return this->real->isInstance(counted);
+		}
+
+		virtual TilesetPtr create(stream::inout_sptr psTileset,
+			SuppData& suppData) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("TilesetType::create", this->stats->code.c_str());
+			SuppData counted = instrumentSupps(suppData, this->stats);
+			TilesetPtr tileset = this->real->create(
+				instrumentStream(psTileset, this->stats), counted);
+			if (!tileset) return tileset;
+			return TilesetPtr(new InstrumentedTileset(tileset, this->stats));
+		}
+
+		virtual TilesetPtr open(stream::inout_sptr psTileset,
+			SuppData& suppData) const
+		{
+			ActiveFormat active(this->stats);
+			TraceSpan span("TilesetType::open", this->stats->code.c_str());
+			SuppData counted = instrumentSupps(suppData, this->stats);
+			TilesetPtr tileset = this->real->open(
+				instrumentStream(psTileset, this->stats), counted);
+			if (!tileset) return tileset;
+			return TilesetPtr(new InstrumentedTileset(tileset, this->stats));
+		}
+
+		virtual SuppFilenames getRequiredSupps(
+			const std::string& filenameTileset) const
+		{
+			return this->real->getRequiredSupps(filenameTileset);
+		}
+
+	protected:
+		TilesetTypePtr real;
+		FormatStats *stats;
+};
+
+ImageTypePtr instrumentImageType(ImageTypePtr type)
+{
+	if (!type || !(instrumenting || isTracing())) return type;
+	return ImageTypePtr(new InstrumentedImageType(type));
+}
+
+TilesetTypePtr instrumentTilesetType(TilesetTypePtr type)
+{
+	if (!type || !(instrumenting || isTracing())) return type;
+	return TilesetTypePtr(new InstrumentedTilesetType(type));
+}
+
+} // namespace gamegraphics
+} // namespace camoto
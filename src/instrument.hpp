@@ -0,0 +1,79 @@
+/**
+ * @file  instrument.hpp
+ * @brief Optional per-format I/O, allocation and timing counters.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_INSTRUMENT_HPP_
+#define _CAMOTO_GAMEGRAPHICS_INSTRUMENT_HPP_
+
+#include <camoto/gamegraphics/manager.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Turn instrumentation on or off for types handed out from now on.
+void setInstrumenting(bool enable);
+
+/// Is instrumentation currently turned on?
+bool isInstrumenting();
+
+/// Wrap an image type so everything it opens or creates is counted.
+/**
+ * The wrapper also emits trace spans for detection, opening and conversion
+ * while a trace is being written.
+ *
+ * @param type
+ *   Real image type.
+ *
+ * @return A type that forwards every call to the real one, counting the work
+ *   against type->getCode().  If neither instrumentation nor tracing is on,
+ *   type itself is returned.
+ */
+ImageTypePtr instrumentImageType(ImageTypePtr type);
+
+/// Wrap a tileset type so everything it opens or creates is counted.
+/**
+ * As for instrumentImageType(), trace spans are also emitted while tracing.
+ *
+ * @param type
+ *   Real tileset type.
+ *
+ * @return A type that forwards every call to the real one, counting the work
+ *   against type->getCode().  If neither instrumentation nor tracing is on,
+ *   type itself is returned.
+ */
+TilesetTypePtr instrumentTilesetType(TilesetTypePtr type);
+
+/// Record that a filtered stream has been set up over a format's data.
+/**
+ * Called wherever a stream::filtered or similar is opened.  The pass is
+ * counted against whichever instrumented format is running in this thread,
+ * and is ignored if there isn't one.
+ */
+void countFilterPass();
+
+/// Get a copy of all the counters, sorted by format code.
+FormatStatsVector getFormatStats();
+
+/// Remove all the counters.
+void resetFormatStats();
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_INSTRUMENT_HPP_
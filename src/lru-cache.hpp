@@ -0,0 +1,171 @@
+/**
+ * @file  lru-cache.hpp
+ * @brief Size-bounded least-recently-used cache.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_LRU_CACHE_HPP_
+#define _CAMOTO_GAMEGRAPHICS_LRU_CACHE_HPP_
+
+#include <list>
+#include <map>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Cache that discards the least recently used items once it gets too big.
+/**
+ * Each item is given a cost when it is added (e.g. its size in bytes) and
+ * the oldest items are dropped whenever the total cost exceeds the capacity.
+ * An item that costs more than the whole capacity is never stored.
+ */
+template <typename Key, typename Value>
+class LRUCache
+{
+	public:
+		/// Create an empty cache.
+		/**
+		 * @param capacity
+		 *   Maximum total cost of all items held at once.
+		 */
+		LRUCache(unsigned long capacity)
+			:	capacity(capacity),
+				used(0)
+		{
+		}
+
+		/// Look up an item, marking it as the most recently used.
+		/**
+		 * @param key
+		 *   Item to find.
+		 *
+		 * @param value
+		 *   On return, set to the cached value if the item was found.
+		 *
+		 * @return true if the item was in the cache, false if not.
+		 */
+		bool get(const Key& key, Value *value)
+		{
+			typename ItemIndex::iterator i = this->index.find(key);
+			if (i == this->index.end()) return false;
+			// Move to the front without invalidating the iterator
+			this->items.splice(this->items.begin(), this->items, i->second);
+			*value = i->second->value;
+			return true;
+		}
+
+		/// Add or replace an item.
+		/**
+		 * @param key
+		 *   Item to store.
+		 *
+		 * @param value
+		 *   Value to store.
+		 *
+		 * @param cost
+		 *   Amount of the capacity this item uses up.
+		 */
+		void put(const Key& key, const Value& value, unsigned long cost)
+		{
+			this->erase(key);
+			if (cost > this->capacity) return;
+			this->shrink(this->capacity - cost);
+			Item item;
+			item.key = key;
+			item.value = value;
+			item.cost = cost;
+			this->items.push_front(item);
+			this->index[key] = this->items.begin();
+			this->used += cost;
+			return;
+		}
+
+		/// Remove an item, if it is present.
+		void erase(const Key& key)
+		{
+			typename ItemIndex::iterator i = this->index.find(key);
+			if (i == this->index.end()) return;
+			this->used -= i->second->cost;
+			this->items.erase(i->second);
+			this->index.erase(i);
+			return;
+		}
+
+		/// Remove all items.
+		void clear()
+		{
+			this->items.clear();
+			this->index.clear();
+			this->used = 0;
+			return;
+		}
+
+		/// Change the capacity, dropping the oldest items if they no longer fit.
+		/**
+		 * @param capacity
+		 *   New maximum total cost of all items held at once.
+		 */
+		void setCapacity(unsigned long capacity)
+		{
+			this->capacity = capacity;
+			this->shrink(capacity);
+			return;
+		}
+
+		/// Total cost of all items currently held.
+		unsigned long size() const
+		{
+			return this->used;
+		}
+
+		/// Number of items currently held.
+		unsigned long count() const
+		{
+			return this->index.size();
+		}
+
+	protected:
+		struct Item {
+			Key key;
+			Value value;
+			unsigned long cost;
+		};
+		typedef std::list<Item> ItemList;
+		typedef std::map<Key, typename ItemList::iterator> ItemIndex;
+
+		/// Drop the least recently used items until the total cost is at most limit.
+		void shrink(unsigned long limit)
+		{
+			while (this->used > limit) {
+				const Item& oldest = this->items.back();
+				this->used -= oldest.cost;
+				this->index.erase(oldest.key);
+				this->items.pop_back();
+			}
+			return;
+		}
+
+		unsigned long capacity; ///< Maximum value of used
+		unsigned long used;     ///< Sum of the cost of every item
+		ItemList items;         ///< Items, most recently used first
+		ItemIndex index;        ///< Key lookup into items
+};
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_LRU_CACHE_HPP_
@@ -18,7 +18,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
+#include <iostream>
+#include <boost/thread/once.hpp>
+#include <camoto/stream.hpp>
 #include <camoto/gamegraphics/manager.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+#include "imagecache.hpp"
+#include "instrument.hpp"
 
 // Include all the file formats for the Manager to load
 #include "tls-actrinfo.hpp"
@@ -79,10 +86,35 @@ class ActualManager: virtual public Manager
 		virtual const TilesetTypePtr getTilesetTypeByCode(const std::string& strCode) const;
 		virtual const ImageTypePtr getImageType(unsigned int iIndex) const;
 		virtual const ImageTypePtr getImageTypeByCode(const std::string& strCode) const;
+		virtual void setInstrumentation(bool enable);
+		virtual FormatStatsVector getStats() const;
+		virtual void resetStats();
+		virtual void setImageCacheSize(unsigned long bytes);
 };
 
+/// Start tracing if the environment variable asks for it.
+/**
+ * Run once, by the first getManager() call in any thread.  A trace file that
+ * can't be written only disables tracing, it doesn't stop the library being
+ * used.
+ */
+static void startTraceFromEnv()
+{
+	const char *traceFile = std::getenv(CAMOTO_GAMEGRAPHICS_TRACE_ENV);
+	if (!traceFile || !*traceFile) return;
+	try {
+		startTrace(traceFile);
+	} catch (const stream::open_error& e) {
+		std::cerr << "Warning: " CAMOTO_GAMEGRAPHICS_TRACE_ENV " is set but "
+			"tracing has been disabled: " << e.what() << std::endl;
+	}
+	return;
+}
+
 const ManagerPtr getManager()
 {
+	static boost::once_flag checkedEnv = BOOST_ONCE_INIT;
+	boost::call_once(startTraceFromEnv, checkedEnv);
 	return ManagerPtr(new ActualManager());
 }
 
@@ -124,6 +156,7 @@ ActualManager::ActualManager()
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_CComic()));
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_CosmoBackdrop()));
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_CGARawLinear()));
+	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_CGARawInterlaced()));
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_EGARawPlanarBGRI()));
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_Mono()));
 	this->vcImageTypes.push_back(ImageTypePtr(new ImageType_Nukem2Backdrop()));
@@ -151,7 +184,7 @@ ActualManager::~ActualManager()
 const TilesetTypePtr ActualManager::getTilesetType(unsigned int iIndex) const
 {
 	if (iIndex >= this->vcTilesetTypes.size()) return TilesetTypePtr();
-	return this->vcTilesetTypes[iIndex];
+	return cacheTilesetType(instrumentTilesetType(this->vcTilesetTypes[iIndex]));
 }
 
 const TilesetTypePtr ActualManager::getTilesetTypeByCode(
@@ -161,7 +194,9 @@ const TilesetTypePtr ActualManager::getTilesetTypeByCode(
 		i != this->vcTilesetTypes.end();
 		i++
 	) {
-		if ((*i)->getCode().compare(strCode) == 0) return *i;
+		if ((*i)->getCode().compare(strCode) == 0) {
+			return cacheTilesetType(instrumentTilesetType(*i));
+		}
 	}
 	return TilesetTypePtr();
 }
@@ -169,7 +204,7 @@ const TilesetTypePtr ActualManager::getTilesetTypeByCode(
 const ImageTypePtr ActualManager::getImageType(unsigned int iIndex) const
 {
 	if (iIndex >= this->vcImageTypes.size()) return ImageTypePtr();
-	return this->vcImageTypes[iIndex];
+	return cacheImageType(instrumentImageType(this->vcImageTypes[iIndex]));
 }
 
 const ImageTypePtr ActualManager::getImageTypeByCode(const std::string& strCode)
@@ -179,10 +214,35 @@ const ImageTypePtr ActualManager::getImageTypeByCode(const std::string& strCode)
 		i != this->vcImageTypes.end();
 		i++
 	) {
-		if ((*i)->getCode().compare(strCode) == 0) return *i;
+		if ((*i)->getCode().compare(strCode) == 0) {
+			return cacheImageType(instrumentImageType(*i));
+		}
 	}
 	return ImageTypePtr();
 }
 
+void ActualManager::setInstrumentation(bool enable)
+{
+	setInstrumenting(enable);
+	return;
+}
+
+FormatStatsVector ActualManager::getStats() const
+{
+	return getFormatStats();
+}
+
+void ActualManager::resetStats()
+{
+	resetFormatStats();
+	return;
+}
+
+void ActualManager::setImageCacheSize(unsigned long bytes)
+{
+	gamegraphics::setImageCacheSize(bytes);
+	return;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
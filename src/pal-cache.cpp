@@ -0,0 +1,150 @@
+/**
+ * @file  pal-cache.cpp
+ * @brief Shared cache of decoded palettes.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+#include "pal-cache.hpp"
+
+namespace camoto {
+namespace gamegraphics {
+
+/// One palette decoded from one stream.
+struct CachedPalette
+{
+	boost::weak_ptr<stream::inout> data; ///< Stream the palette came from
+	const stream::inout *id;             ///< Address of data, for quick compare
+	stream::len size;                    ///< Size of data when decoded
+	unsigned int depth;                  ///< Depth palette was decoded at
+	uint32_t hash;                       ///< Hash of the decoded palette
+	PaletteTablePtr pal;                 ///< Decoded palette
+};
+
+typedef std::vector<CachedPalette> CachedPaletteList;
+
+/// All cached palettes.  There are only ever a handful so a list is fine.
+static CachedPaletteList cachedPalettes;
+
+/// Lock held while cachedPalettes is read or changed.
+static boost::mutex cacheMutex;
+
+/// FNV-1a hash of the palette content.
+static uint32_t hashPalette(const PaletteTable& pal)
+{
+	uint32_t hash = 2166136261u;
+	for (PaletteTable::const_iterator i = pal.begin(); i != pal.end(); i++) {
+		hash = (hash ^ i->red) * 16777619u;
+		hash = (hash ^ i->green) * 16777619u;
+		hash = (hash ^ i->blue) * 16777619u;
+		hash = (hash ^ i->alpha) * 16777619u;
+	}
+	return hash;
+}
+
+/// Drop entries whose streams have been closed.
+/**
+ * cacheMutex must be held by the caller.
+ */
+static void pruneCachedPalettes()
+{
+	for (CachedPaletteList::iterator i = cachedPalettes.begin();
+		i != cachedPalettes.end();
+	) {
+		if (i->data.expired()) i = cachedPalettes.erase(i);
+		else i++;
+	}
+	return;
+}
+
+PaletteTablePtr findCachedPalette(const stream::inout_sptr& data,
+	unsigned int depth)
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	pruneCachedPalettes();
+	for (CachedPaletteList::const_iterator i = cachedPalettes.begin();
+		i != cachedPalettes.end(); i++
+	) {
+		if ((i->id == data.get()) && (i->depth == depth)) {
+			if (i->size != data->size()) break;
+			return i->pal;
+		}
+	}
+	return PaletteTablePtr();
+}
+
+/// Remove any cached palettes for the given stream.
+/**
+ * cacheMutex must be held by the caller.
+ */
+static void removeCachedPalette(const stream::inout_sptr& data)
+{
+	for (CachedPaletteList::iterator i = cachedPalettes.begin();
+		i != cachedPalettes.end();
+	) {
+		if ((i->id == data.get()) || i->data.expired()) {
+			i = cachedPalettes.erase(i);
+		} else i++;
+	}
+	return;
+}
+
+PaletteTablePtr cachePalette(const stream::inout_sptr& data,
+	unsigned int depth, PaletteTablePtr pal)
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	removeCachedPalette(data);
+
+	CachedPalette entry;
+	entry.data = data;
+	entry.id = data.get();
+	entry.size = data->size();
+	entry.depth = depth;
+	entry.hash = hashPalette(*pal);
+	entry.pal = pal;
+
+	// Share the table with any other stream holding the same palette
+	for (CachedPaletteList::const_iterator i = cachedPalettes.begin();
+		i != cachedPalettes.end(); i++
+	) {
+		if (
+			(i->hash == entry.hash)
+			&& (i->pal->size() == pal->size())
+			&& (pal->empty() || (memcmp(&(*i->pal)[0], &(*pal)[0],
+				pal->size() * sizeof(PaletteEntry)) == 0))
+		) {
+			entry.pal = i->pal;
+			break;
+		}
+	}
+
+	cachedPalettes.push_back(entry);
+	return entry.pal;
+}
+
+void invalidateCachedPalette(const stream::inout_sptr& data)
+{
+	boost::mutex::scoped_lock lock(cacheMutex);
+	removeCachedPalette(data);
+	return;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
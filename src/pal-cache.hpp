@@ -0,0 +1,89 @@
+/**
+ * @file  pal-cache.hpp
+ * @brief Shared cache of decoded palettes.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CAMOTO_GAMEGRAPHICS_PAL_CACHE_HPP_
+#define _CAMOTO_GAMEGRAPHICS_PAL_CACHE_HPP_
+
+#include <camoto/stream.hpp>
+#include <camoto/gamegraphics/palettetable.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Find a palette previously decoded from the given stream.
+/**
+ * Many tilesets and images in a game share the one palette file, and each
+ * time one of them is opened a new palette object is created for the same
+ * supplementary stream.  This cache lets those objects share a single
+ * decoded table instead of parsing the file again.
+ *
+ * Entries are keyed on the identity of the stream (held weakly, so a freed
+ * stream never matches a new one at the same address), its size and the
+ * palette depth.  Changes made through setPalette() must be followed by a
+ * call to invalidateCachedPalette().  The cache is protected by a lock so
+ * palettes can be opened from multiple threads.
+ *
+ * @param data
+ *   Stream the palette was read from.
+ *
+ * @param depth
+ *   Format-specific value that changes how the data is interpreted, such as
+ *   the number of bits per channel.
+ *
+ * @return The shared palette, or a null pointer if this stream has not been
+ *   cached or its size has changed.  The returned table is shared between
+ *   all users and must never be modified.  Palette_VGA hands out copies of
+ *   it, so the table can't be changed through the public API.
+ */
+PaletteTablePtr findCachedPalette(const stream::inout_sptr& data,
+	unsigned int depth);
+
+/// Add a newly decoded palette to the cache.
+/**
+ * If an identical palette is already in the cache (e.g. the same file has
+ * been opened through a different stream) that table is returned instead,
+ * so all users share the one copy.
+ *
+ * @param data
+ *   Stream the palette was read from.
+ *
+ * @param depth
+ *   Same value later passed to findCachedPalette().
+ *
+ * @param pal
+ *   Decoded palette.  This must not be modified after it has been passed in.
+ *
+ * @return The palette to use, which may be a different but identical table
+ *   to pal.
+ */
+PaletteTablePtr cachePalette(const stream::inout_sptr& data,
+	unsigned int depth, PaletteTablePtr pal);
+
+/// Remove any cached palettes for the given stream.
+/**
+ * @param data
+ *   Stream that has been modified.
+ */
+void invalidateCachedPalette(const stream::inout_sptr& data);
+
+} // namespace gamegraphics
+} // namespace camoto
+
+#endif // _CAMOTO_GAMEGRAPHICS_PAL_CACHE_HPP_
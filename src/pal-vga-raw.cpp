@@ -18,6 +18,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "pal-cache.hpp"
 #include "pal-vga-raw.hpp"
 
 namespace camoto {
@@ -177,6 +178,18 @@ Palette_VGA::~Palette_VGA()
 
 PaletteTablePtr Palette_VGA::getPalette()
 {
+	// Callers are free to modify the table they get back (e.g. to add
+	// transparency) so they always get their own copy of the shared one.
+	if (!this->pal) this->pal = this->loadPalette();
+	return PaletteTablePtr(new PaletteTable(*this->pal));
+}
+
+PaletteTablePtr Palette_VGA::loadPalette()
+{
+	// Reuse the table from another Palette_VGA opened on this stream
+	PaletteTablePtr cached = findCachedPalette(this->data, this->depth);
+	if (cached) return cached;
+
 	PaletteTablePtr pal(new PaletteTable());
 	pal->reserve(256);
 
@@ -216,7 +229,7 @@ PaletteTablePtr Palette_VGA::getPalette()
 			break;
 	}
 
-	return pal;
+	return cachePalette(this->data, this->depth, pal);
 }
 
 void Palette_VGA::setPalette(PaletteTablePtr newPalette)
@@ -238,6 +251,10 @@ void Palette_VGA::setPalette(PaletteTablePtr newPalette)
 	this->data->truncate(768);
 	this->data->seekp(0, stream::start);
 	this->data->write(buf, 768);
+
+	// Other palette objects sharing this stream must reread it
+	invalidateCachedPalette(this->data);
+	this->pal.reset();
 	return;
 }
 
@@ -66,6 +66,11 @@ class ImageType_VGA8Palette: virtual public ImageType_Palette_VGA
 };
 
 /// Palette interface to 768-byte raw 6/8-bit VGA palette files.
+/**
+ * The decoded palette is cached, and shared with any other Palette_VGA
+ * opened on the same stream.  getPalette() returns a copy of the shared
+ * table so callers may modify it.
+ */
 class Palette_VGA: virtual public Palette
 {
 	public:
@@ -87,6 +92,13 @@ class Palette_VGA: virtual public Palette
 	private:
 		stream::inout_sptr data;
 		unsigned int depth;
+		PaletteTablePtr pal;     ///< Shared palette, or null if not yet read
+
+		/// Decode the palette, or fetch it from the cache.
+		/**
+		 * @return The shared table, which must not be modified.
+		 */
+		PaletteTablePtr loadPalette();
 };
 
 } // namespace gamegraphics
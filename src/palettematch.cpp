@@ -0,0 +1,230 @@
+/**
+ * @file  palettematch.cpp
+ * @brief Mapping of truecolour pixels to the nearest palette entries.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <camoto/gamegraphics/image.hpp>
+#include <camoto/gamegraphics/palettematch.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Number of entries in the per-thread colour cache (one per RGB555 value).
+#define PM_CACHE_SIZE 32768
+
+/// Value marking an unused colour cache entry.
+/**
+ * This is white, which can only ever be stored in the last slot, so it can't
+ * produce a false hit anywhere else.  The last slot is emptied with black
+ * instead.
+ */
+#define PM_CACHE_EMPTY 0xFFFFFFFF
+
+/// Don't bother starting threads for images with fewer pixels than this.
+#define PM_MIN_THREAD_PIXELS (64 * 1024)
+
+/// Sort nodes on one colour component, then on index so ties are stable.
+struct NodeAxisLess
+{
+	unsigned int axis;
+
+	template <class T>
+	bool operator() (const T& a, const T& b) const
+	{
+		if (a.rgb[this->axis] != b.rgb[this->axis]) {
+			return a.rgb[this->axis] < b.rgb[this->axis];
+		}
+		return a.index < b.index;
+	}
+};
+
+PaletteMatcher::PaletteMatcher(const PaletteTable& pal)
+	:	transparentIndex(0)
+{
+	unsigned int palSize = std::min<unsigned int>(pal.size(), 256);
+
+	bool foundTransparent = false;
+	for (unsigned int i = 0; i < palSize; i++) {
+		if (pal[i].alpha == 0) {
+			if (!foundTransparent) {
+				this->transparentIndex = i;
+				foundTransparent = true;
+			}
+			continue;
+		}
+		Node n;
+		n.rgb[0] = pal[i].red;
+		n.rgb[1] = pal[i].green;
+		n.rgb[2] = pal[i].blue;
+		n.axis = 0;
+		n.index = i;
+		this->tree.push_back(n);
+	}
+	this->build(0, this->tree.size());
+}
+
+PaletteMatcher::~PaletteMatcher()
+{
+}
+
+unsigned int PaletteMatcher::nearest(uint8_t red, uint8_t green,
+	uint8_t blue) const
+{
+	if (this->tree.empty()) return this->transparentIndex;
+
+	int rgb[3];
+	rgb[0] = red;
+	rgb[1] = green;
+	rgb[2] = blue;
+	unsigned int bestDist = (unsigned int)-1;
+	unsigned int bestIndex = 0;
+	this->search(0, this->tree.size(), rgb, &bestDist, &bestIndex);
+	return bestIndex;
+}
+
+void PaletteMatcher::fromRGBA(const uint8_t *rgba, unsigned int width,
+	unsigned int height, unsigned long stride, uint8_t *data, uint8_t *mask,
+	unsigned int numThreads) const
+{
+	if (numThreads == 0) numThreads = boost::thread::hardware_concurrency();
+	if ((unsigned long)width * height < PM_MIN_THREAD_PIXELS) numThreads = 1;
+	if (numThreads > height) numThreads = height;
+
+	if (numThreads <= 1) {
+		this->fromRGBARows(rgba, width, stride, data, mask, 0, height);
+		return;
+	}
+
+	// Give each thread an equal block of rows, and do the last block here
+	boost::thread_group threads;
+	unsigned int rowsPerThread = height / numThreads;
+	unsigned int row = 0;
+	for (unsigned int t = 0; t < numThreads - 1; t++) {
+		threads.create_thread(boost::bind(&PaletteMatcher::fromRGBARows, this,
+			rgba, width, stride, data, mask, row, row + rowsPerThread));
+		row += rowsPerThread;
+	}
+	this->fromRGBARows(rgba, width, stride, data, mask, row, height);
+	threads.join_all();
+	return;
+}
+
+void PaletteMatcher::build(unsigned int begin, unsigned int end)
+{
+	if (end - begin < 2) return;
+
+	// Split on whichever component varies the most in this range
+	uint8_t low[3] = {255, 255, 255}, high[3] = {0, 0, 0};
+	for (unsigned int i = begin; i < end; i++) {
+		for (unsigned int c = 0; c < 3; c++) {
+			low[c] = std::min(low[c], this->tree[i].rgb[c]);
+			high[c] = std::max(high[c], this->tree[i].rgb[c]);
+		}
+	}
+	unsigned int axis = 0;
+	for (unsigned int c = 1; c < 3; c++) {
+		if (high[c] - low[c] > high[axis] - low[axis]) axis = c;
+	}
+
+	NodeAxisLess less;
+	less.axis = axis;
+	unsigned int mid = (begin + end) / 2;
+	std::nth_element(this->tree.begin() + begin, this->tree.begin() + mid,
+		this->tree.begin() + end, less);
+	this->tree[mid].axis = axis;
+
+	this->build(begin, mid);
+	this->build(mid + 1, end);
+	return;
+}
+
+void PaletteMatcher::search(unsigned int begin, unsigned int end,
+	const int *rgb, unsigned int *bestDist, unsigned int *bestIndex) const
+{
+	if (begin >= end) return;
+
+	unsigned int mid = (begin + end) / 2;
+	const Node& n = this->tree[mid];
+
+	int dr = rgb[0] - n.rgb[0];
+	int dg = rgb[1] - n.rgb[1];
+	int db = rgb[2] - n.rgb[2];
+	unsigned int dist = dr * dr + dg * dg + db * db;
+	if ((dist < *bestDist) || ((dist == *bestDist) && (n.index < *bestIndex))) {
+		*bestDist = dist;
+		*bestIndex = n.index;
+	}
+
+	int diff = rgb[n.axis] - n.rgb[n.axis];
+	unsigned int planeDist = diff * diff;
+	if (diff < 0) {
+		this->search(begin, mid, rgb, bestDist, bestIndex);
+		// Equal distance may still hold a lower index, so check those too
+		if (planeDist <= *bestDist) {
+			this->search(mid + 1, end, rgb, bestDist, bestIndex);
+		}
+	} else {
+		this->search(mid + 1, end, rgb, bestDist, bestIndex);
+		if (planeDist <= *bestDist) {
+			this->search(begin, mid, rgb, bestDist, bestIndex);
+		}
+	}
+	return;
+}
+
+void PaletteMatcher::fromRGBARows(const uint8_t *rgba, unsigned int width,
+	unsigned long stride, uint8_t *data, uint8_t *mask,
+	unsigned int rowBegin, unsigned int rowEnd) const
+{
+	// Artwork uses few distinct colours, so remember recent lookups.  The slot
+	// is picked from the RGB555 value but the full colour is stored with the
+	// result (colour << 8 | index) so a hit is always exact.  Each thread has
+	// its own cache, so no locking is needed.
+	std::vector<uint32_t> cache(PM_CACHE_SIZE, PM_CACHE_EMPTY);
+	cache[PM_CACHE_SIZE - 1] = 0;
+
+	for (unsigned int y = rowBegin; y < rowEnd; y++) {
+		const uint8_t *src = rgba + y * stride;
+		uint8_t *dst = data + y * width;
+		uint8_t *dstMask = mask ? mask + y * width : NULL;
+		for (unsigned int x = 0; x < width; x++, src += 4) {
+			if (src[3] < 128) {
+				dst[x] = this->transparentIndex;
+				if (dstMask) dstMask[x] = Image::Mask_Vis_Transparent;
+				continue;
+			}
+			uint32_t colour = (src[0] << 16) | (src[1] << 8) | src[2];
+			unsigned int slot = ((src[0] >> 3) << 10) | ((src[1] >> 3) << 5)
+				| (src[2] >> 3);
+			uint32_t entry = cache[slot];
+			if ((entry >> 8) != colour) {
+				entry = (colour << 8) | this->nearest(src[0], src[1], src[2]);
+				cache[slot] = entry;
+			}
+			dst[x] = entry & 0xFF;
+			if (dstMask) dstMask[x] = Image::Mask_Vis_Opaque;
+		}
+	}
+	return;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
@@ -0,0 +1,156 @@
+/**
+ * @file  rgba.cpp
+ * @brief Conversion of indexed images to 32-bit RGBA pixels.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <camoto/gamegraphics/rgba.hpp>
+
+// The AVX2 path is compiled in whenever the compiler can target it, and only
+// used if the CPU running the code supports it.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RGBA_AVX2
+#include <immintrin.h>
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+#ifdef RGBA_AVX2
+/// Does this CPU support AVX2?
+static bool haveAVX2()
+{
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+
+/// Convert the start of one row eight pixels at a time, using AVX2.
+/**
+ * @return Number of pixels converted, a multiple of eight.  The caller
+ *   converts the rest.
+ */
+__attribute__((target("avx2")))
+static unsigned int toRGBARowAVX2(const uint8_t *src, const uint8_t *srcMask,
+	unsigned int width, const uint32_t *lut, uint8_t *dst)
+{
+	// Gather eight palette entries at a time.  x86 is little endian, so
+	// alpha is the top byte of each 32-bit pixel.
+	const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+	const __m256i visBit = _mm256_set1_epi32(Image::Mask_Vis_Transparent);
+	unsigned int x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i idx = _mm256_cvtepu8_epi32(
+			_mm_loadl_epi64((const __m128i *)(src + x)));
+		__m256i px = _mm256_i32gather_epi32((const int *)lut, idx, 4);
+		if (srcMask) {
+			__m256i m = _mm256_cvtepu8_epi32(
+				_mm_loadl_epi64((const __m128i *)(srcMask + x)));
+			m = _mm256_cmpeq_epi32(_mm256_and_si256(m, visBit), visBit);
+			px = _mm256_andnot_si256(_mm256_and_si256(m, alpha), px);
+		}
+		_mm256_storeu_si256((__m256i *)(dst + x * 4), px);
+	}
+	return x;
+}
+#endif
+
+PaletteTablePtr getDisplayPalette(ImagePtr img)
+{
+	int caps = img->getCaps();
+	if (caps & Image::HasPalette) return img->getPalette();
+
+	// Need to use the default palette
+	switch (caps & Image::ColourDepthMask) {
+		case Image::ColourDepthEGA:
+			return createPalette_DefaultEGA();
+		case Image::ColourDepthCGA:
+			return createPalette_CGA(CGAPal_CyanMagenta);
+		case Image::ColourDepthMono:
+			return createPalette_DefaultMono();
+		case Image::ColourDepthVGA:
+		default:
+			return createPalette_DefaultVGA();
+	}
+}
+
+void toRGBA(const uint8_t *data, const uint8_t *mask,
+	unsigned int width, unsigned int height, const PaletteTable& pal,
+	MaskPolicy maskPolicy, uint8_t *out, unsigned long stride)
+{
+	// Precompute every possible pixel, already in output byte order, so each
+	// pixel is a single 32-bit copy.
+	uint32_t lut[256];
+	unsigned int palSize = pal.size();
+	if (palSize > 256) palSize = 256;
+	for (unsigned int i = 0; i < 256; i++) {
+		uint8_t rgba[4];
+		if (i < palSize) {
+			rgba[0] = pal[i].red;
+			rgba[1] = pal[i].green;
+			rgba[2] = pal[i].blue;
+			rgba[3] = pal[i].alpha;
+		} else {
+			rgba[0] = rgba[1] = rgba[2] = 0;
+			rgba[3] = 255;
+		}
+		memcpy(&lut[i], rgba, 4);
+	}
+
+	bool useMask = (maskPolicy == MaskTransparent) && mask;
+#ifdef RGBA_AVX2
+	bool useAVX2 = haveAVX2();
+#endif
+
+	for (unsigned int y = 0; y < height; y++) {
+		const uint8_t *src = data + y * width;
+		const uint8_t *srcMask = useMask ? mask + y * width : NULL;
+		uint8_t *dst = out + y * stride;
+		unsigned int x = 0;
+#ifdef RGBA_AVX2
+		if (useAVX2) x = toRGBARowAVX2(src, srcMask, width, lut, dst);
+#endif
+		for (; x < width; x++) {
+			memcpy(dst + x * 4, &lut[src[x]], 4);
+			if (useMask && (srcMask[x] & Image::Mask_Vis_Transparent)) {
+				dst[x * 4 + 3] = 0;
+			}
+		}
+	}
+	return;
+}
+
+void toRGBA(ImagePtr img, PaletteTablePtr pal, MaskPolicy maskPolicy,
+	uint8_t *out, unsigned long stride)
+{
+	unsigned int width, height;
+	img->getDimensions(&width, &height);
+	if ((width == 0) || (height == 0)) return;
+
+	if (!pal) pal = getDisplayPalette(img);
+
+	StdImageDataPtr data = img->toStandard();
+	StdImageDataPtr mask;
+	if (maskPolicy != MaskIgnore) mask = img->toStandardMask();
+
+	toRGBA(data.get(), mask.get(), width, height, *pal, maskPolicy, out,
+		stride);
+	return;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
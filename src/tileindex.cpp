@@ -0,0 +1,148 @@
+/**
+ * @file  tileindex.cpp
+ * @brief Find identical tiles within and across tilesets.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <string.h>
+#include <camoto/gamegraphics/tileindex.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+#include "hash.hpp"
+
+namespace camoto {
+namespace gamegraphics {
+
+uint64_t hashImage(unsigned int width, unsigned int height,
+	const uint8_t *pixels, const uint8_t *mask)
+{
+	unsigned long len = width * height;
+	uint64_t h = hashBlock(0, ((uint64_t)width << 32) | height);
+	h = hashBytes(h, pixels, len);
+	h = hashBytes(h, mask, len);
+
+	return hashFinish(h);
+}
+
+TileIndex::TileIndex(bool shareBuffers)
+	:	shareBuffers(shareBuffers),
+		numTilesets(0)
+{
+}
+
+unsigned int TileIndex::add(TilesetPtr tileset)
+{
+	TraceSpan span("TileIndex::add");
+	unsigned int n = this->numTilesets++;
+	this->addTiles(n, "0", tileset);
+	return n;
+}
+
+const TileIndexEntries& TileIndex::getTiles() const
+{
+	return this->tiles;
+}
+
+TileGroups TileIndex::getDuplicates() const
+{
+	// Group number for each original tile that has at least one duplicate
+	std::map<unsigned long, unsigned long> groupOf;
+	TileGroups groups;
+	for (unsigned long i = 0; i < this->tiles.size(); i++) {
+		unsigned long original = this->tiles[i].original;
+		if (original == i) continue;
+
+		std::map<unsigned long, unsigned long>::iterator g = groupOf.find(original);
+		if (g == groupOf.end()) {
+			g = groupOf.insert(std::make_pair(original, groups.size())).first;
+			groups.push_back(TileGroup(1, original));
+		}
+		groups[g->second].push_back(i);
+	}
+	return groups;
+}
+
+void TileIndex::addTiles(unsigned int tileset, const std::string& prefix,
+	TilesetPtr parent)
+{
+	const Tileset::VC_ENTRYPTR& items = parent->getItems();
+	unsigned int j = 0;
+	for (Tileset::VC_ENTRYPTR::const_iterator i = items.begin();
+		i != items.end();
+		i++, j++
+	) {
+		std::ostringstream ss;
+		ss << prefix << '.' << j;
+
+		int attr = (*i)->getAttr();
+		if (attr & Tileset::EmptySlot) continue;
+		if (attr & Tileset::SubTileset) {
+			this->addTiles(tileset, ss.str(), parent->openTileset(*i));
+			continue;
+		}
+
+		TileIndexEntry tile;
+		tile.tileset = tileset;
+		tile.id = ss.str();
+		tile.parent = parent;
+		tile.entry = *i;
+
+		ImagePtr img = parent->openImage(*i);
+		img->getDimensions(&tile.width, &tile.height);
+		StdImageDataPtr pixels = img->toStandard();
+		StdImageDataPtr mask = img->toStandardMask();
+		tile.hash = hashImage(tile.width, tile.height, pixels.get(), mask.get());
+
+		unsigned long index = this->tiles.size();
+		tile.original = this->findOriginal(tile, pixels, mask);
+		if (tile.original == index) {
+			this->byHash.insert(std::make_pair(tile.hash, index));
+			if (this->shareBuffers) {
+				tile.pixels = pixels;
+				tile.mask = mask;
+			}
+		} else if (this->shareBuffers) {
+			// Point at the first copy and let this one be freed
+			tile.pixels = this->tiles[tile.original].pixels;
+			tile.mask = this->tiles[tile.original].mask;
+		}
+		this->tiles.push_back(tile);
+	}
+	return;
+}
+
+unsigned long TileIndex::findOriginal(const TileIndexEntry& tile,
+	const StdImageDataPtr& pixels, const StdImageDataPtr& mask) const
+{
+	unsigned long len = tile.width * tile.height;
+	std::pair<HashIndex::const_iterator, HashIndex::const_iterator> range =
+		this->byHash.equal_range(tile.hash);
+	for (HashIndex::const_iterator i = range.first; i != range.second; i++) {
+		const TileIndexEntry& other = this->tiles[i->second];
+		if ((other.width != tile.width) || (other.height != tile.height)) continue;
+		if (this->shareBuffers) {
+			// We have the data, so rule out hash collisions
+			if (memcmp(other.pixels.get(), pixels.get(), len) != 0) continue;
+			if (memcmp(other.mask.get(), mask.get(), len) != 0) continue;
+		}
+		return i->second;
+	}
+	return this->tiles.size();
+}
+
+} // namespace gamegraphics
+} // namespace camoto
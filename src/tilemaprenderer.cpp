@@ -0,0 +1,336 @@
+/**
+ * @file  tilemaprenderer.cpp
+ * @brief Draw a grid of tiles from a tileset into a framebuffer.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <camoto/gamegraphics/tilemaprenderer.hpp>
+#include <camoto/gamegraphics/rgba.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Copy the bytes of src selected by mask over dst.
+/**
+ * @param dst
+ *   Destination, len bytes.  Bytes where mask is 0x00 are left alone.
+ *
+ * @param src
+ *   Source, len bytes.
+ *
+ * @param mask
+ *   0xFF for each byte to take from src, 0x00 for each byte to keep.
+ *
+ * @param len
+ *   Number of bytes in each buffer.
+ */
+static void blitMasked(uint8_t *dst, const uint8_t *src, const uint8_t *mask,
+	unsigned long len)
+{
+	unsigned long i = 0;
+#ifdef __SSE2__
+	for (; i + 16 <= len; i += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+		_mm_storeu_si128((__m128i *)(dst + i),
+			_mm_or_si128(_mm_and_si128(m, s), _mm_andnot_si128(m, d)));
+	}
+#endif
+	// Eight bytes at a time in ordinary registers
+	for (; i + 8 <= len; i += 8) {
+		uint64_t s, m, d;
+		memcpy(&s, src + i, 8);
+		memcpy(&m, mask + i, 8);
+		memcpy(&d, dst + i, 8);
+		d = (s & m) | (d & ~m);
+		memcpy(dst + i, &d, 8);
+	}
+	for (; i < len; i++) {
+		dst[i] = (src[i] & mask[i]) | (dst[i] & ~mask[i]);
+	}
+	return;
+}
+
+/// Divide, rounding towards negative infinity.
+static long floorDiv(long a, long b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
+
+TileMapRenderer::TileMapRenderer(TilesetPtr tileset,
+	const std::vector<unsigned int>& cells, unsigned int mapWidth,
+	unsigned int mapHeight, unsigned int cellWidth, unsigned int cellHeight,
+	RenderFormat format)
+	:	tileset(tileset),
+		cells(cells),
+		mapWidth(mapWidth),
+		mapHeight(mapHeight),
+		cellWidth(cellWidth),
+		cellHeight(cellHeight),
+		bpp((format == RenderRGBA) ? 4 : 1),
+		maxTileWidth(0),
+		maxTileHeight(0),
+		drawn(false),
+		lastViewX(0),
+		lastViewY(0),
+		lastWidth(0),
+		lastHeight(0)
+{
+	if ((cellWidth == 0) || (cellHeight == 0)) {
+		throw stream::error("tile map cells must be at least one pixel in size");
+	}
+	if (cells.size() != (unsigned long)mapWidth * mapHeight) {
+		throw stream::error("tile map is not mapWidth * mapHeight cells long");
+	}
+
+	TraceSpan span("TileMapRenderer::decode");
+	unsigned long numItems = tileset->getItems().size();
+	this->tiles.resize(numItems);
+	this->decoded.resize(numItems, false);
+
+	// Decode every tile in use now, so drawing never has to
+	for (std::vector<unsigned int>::const_iterator
+		i = cells.begin(); i != cells.end(); i++
+	) {
+		this->getTile(*i);
+	}
+}
+
+unsigned int TileMapRenderer::getCell(unsigned int x, unsigned int y) const
+{
+	if ((x >= this->mapWidth) || (y >= this->mapHeight)) return EmptyCell;
+	return this->cells[y * this->mapWidth + x];
+}
+
+void TileMapRenderer::setCell(unsigned int x, unsigned int y,
+	unsigned int index)
+{
+	if ((x >= this->mapWidth) || (y >= this->mapHeight)) {
+		throw stream::error("tile map cell is outside the map");
+	}
+	this->getTile(index);
+	unsigned long pos = y * this->mapWidth + x;
+	this->cells[pos] = index;
+	this->dirty.push_back(pos);
+	return;
+}
+
+void TileMapRenderer::render(const RenderTarget& target, int viewX, int viewY)
+{
+	TraceSpan span("TileMapRenderer::render");
+	this->drawRect(target, viewX, viewY, 0, 0, target.width, target.height);
+	this->dirty.clear();
+	this->drawn = true;
+	this->lastViewX = viewX;
+	this->lastViewY = viewY;
+	this->lastWidth = target.width;
+	this->lastHeight = target.height;
+	return;
+}
+
+void TileMapRenderer::update(const RenderTarget& target, int viewX, int viewY)
+{
+	long dx = (long)viewX - this->lastViewX;
+	long dy = (long)viewY - this->lastViewY;
+	unsigned long absX = (dx < 0) ? -dx : dx;
+	unsigned long absY = (dy < 0) ? -dy : dy;
+	if (
+		!this->drawn
+		|| (target.width != this->lastWidth)
+		|| (target.height != this->lastHeight)
+		|| (absX >= target.width)
+		|| (absY >= target.height)
+	) {
+		this->render(target, viewX, viewY);
+		return;
+	}
+
+	TraceSpan span("TileMapRenderer::update");
+	unsigned int w = target.width, h = target.height;
+
+	if (dx || dy) {
+		// Move what is still visible to where it belongs in the new frame.
+		// Rows are copied in the order that never overwrites one not yet moved.
+		unsigned long rowBytes = (w - absX) * this->bpp;
+		unsigned long srcX = (dx > 0) ? dx * this->bpp : 0;
+		unsigned long dstX = (dx < 0) ? -dx * this->bpp : 0;
+		unsigned int rows = h - absY;
+		for (unsigned int n = 0; n < rows; n++) {
+			unsigned int r = (dy < 0) ? rows - 1 - n : n;
+			unsigned int srcRow = (dy > 0) ? r + dy : r;
+			unsigned int dstRow = (dy < 0) ? r - dy : r;
+			memmove(target.pixels + dstRow * target.stride + dstX,
+				target.pixels + srcRow * target.stride + srcX, rowBytes);
+		}
+
+		// Draw the strips that have scrolled into view
+		if (dy > 0) this->drawRect(target, viewX, viewY, 0, h - absY, w, absY);
+		else if (dy < 0) this->drawRect(target, viewX, viewY, 0, 0, w, absY);
+		unsigned int rowStart = (dy < 0) ? absY : 0;
+		if (dx > 0) {
+			this->drawRect(target, viewX, viewY, w - absX, rowStart, absX, rows);
+		} else if (dx < 0) {
+			this->drawRect(target, viewX, viewY, 0, rowStart, absX, rows);
+		}
+	}
+
+	// Redraw cells changed by setCell(), including anything an oversized tile
+	// in the cell covers or used to cover.
+	unsigned long dirtyWidth = std::max(this->cellWidth, this->maxTileWidth);
+	unsigned long dirtyHeight = std::max(this->cellHeight, this->maxTileHeight);
+	for (std::vector<unsigned long>::const_iterator
+		i = this->dirty.begin(); i != this->dirty.end(); i++
+	) {
+		long mapX = (long)(*i % this->mapWidth) * this->cellWidth;
+		long mapY = (long)(*i / this->mapWidth) * this->cellHeight;
+		this->redrawMapRect(target, viewX, viewY, mapX, mapY,
+			dirtyWidth, dirtyHeight);
+	}
+	this->dirty.clear();
+
+	this->lastViewX = viewX;
+	this->lastViewY = viewY;
+	return;
+}
+
+const TileMapRenderer::Tile *TileMapRenderer::getTile(unsigned int index)
+{
+	if (index >= this->tiles.size()) return NULL;
+	if (this->decoded[index]) return this->tiles[index].get();
+
+	const Tileset::EntryPtr& ep = this->tileset->getItems()[index];
+	if (ep->getAttr() & (Tileset::EmptySlot | Tileset::SubTileset)) {
+		this->decoded[index] = true;
+		return NULL;
+	}
+
+	ImagePtr img = this->tileset->openImage(ep);
+	TilePtr tile(new Tile);
+	img->getDimensions(&tile->width, &tile->height);
+	unsigned long numPixels = tile->width * tile->height;
+	StdImageDataPtr data = img->toStandard();
+	StdImageDataPtr mask = img->toStandardMask();
+
+	tile->pixels.resize(numPixels * this->bpp);
+	tile->mask.resize(numPixels * this->bpp);
+	if (numPixels) {
+		if (this->bpp == 4) {
+			PaletteTablePtr pal = getDisplayPalette(img);
+			toRGBA(data.get(), NULL, tile->width, tile->height, *pal, MaskIgnore,
+				&tile->pixels[0], tile->width * 4);
+		} else {
+			memcpy(&tile->pixels[0], data.get(), numPixels);
+		}
+	}
+
+	// Turn the mask into whole bytes the blitter can select with
+	unsigned long numVisible = 0;
+	for (unsigned long i = 0; i < numPixels; i++) {
+		bool vis = (mask[i] & Image::Mask_Visibility) != Image::Mask_Vis_Transparent;
+		if (vis) numVisible++;
+		memset(&tile->mask[i * this->bpp], vis ? 0xFF : 0x00, this->bpp);
+	}
+	tile->visible = numVisible > 0;
+	tile->opaque = numVisible == numPixels;
+
+	if (tile->width > this->maxTileWidth) this->maxTileWidth = tile->width;
+	if (tile->height > this->maxTileHeight) this->maxTileHeight = tile->height;
+
+	this->tiles[index] = tile;
+	this->decoded[index] = true;
+	return tile.get();
+}
+
+void TileMapRenderer::drawRect(const RenderTarget& target, int viewX,
+	int viewY, unsigned int x, unsigned int y, unsigned int width,
+	unsigned int height)
+{
+	if ((width == 0) || (height == 0)) return;
+
+	for (unsigned int r = 0; r < height; r++) {
+		memset(target.pixels + (y + r) * target.stride + x * this->bpp, 0,
+			width * this->bpp);
+	}
+
+	// Area of the map being drawn, in map pixels
+	long mx0 = (long)viewX + x, mx1 = mx0 + width;
+	long my0 = (long)viewY + y, my1 = my0 + height;
+
+	// Cells whose tiles could reach into the area, allowing for tiles that
+	// are bigger than a cell
+	long overX = (this->maxTileWidth > this->cellWidth)
+		? this->maxTileWidth - this->cellWidth : 0;
+	long overY = (this->maxTileHeight > this->cellHeight)
+		? this->maxTileHeight - this->cellHeight : 0;
+	long cx0 = std::max(floorDiv(mx0 - overX, this->cellWidth), 0L);
+	long cy0 = std::max(floorDiv(my0 - overY, this->cellHeight), 0L);
+	long cx1 = std::min(floorDiv(mx1 - 1, this->cellWidth),
+		(long)this->mapWidth - 1);
+	long cy1 = std::min(floorDiv(my1 - 1, this->cellHeight),
+		(long)this->mapHeight - 1);
+
+	for (long cy = cy0; cy <= cy1; cy++) {
+		for (long cx = cx0; cx <= cx1; cx++) {
+			const Tile *tile = this->getTile(this->cells[cy * this->mapWidth + cx]);
+			if (!tile || !tile->visible) continue;
+
+			// Part of the tile inside the area
+			long tx = cx * this->cellWidth, ty = cy * this->cellHeight;
+			long ix0 = std::max(tx, mx0), ix1 = std::min(tx + (long)tile->width, mx1);
+			long iy0 = std::max(ty, my0), iy1 = std::min(ty + (long)tile->height, my1);
+			if ((ix0 >= ix1) || (iy0 >= iy1)) continue;
+
+			unsigned long len = (ix1 - ix0) * this->bpp;
+			unsigned long srcOff = ((iy0 - ty) * tile->width + (ix0 - tx)) * this->bpp;
+			unsigned long srcStride = tile->width * this->bpp;
+			uint8_t *dst = target.pixels + (iy0 - viewY) * target.stride
+				+ (ix0 - viewX) * this->bpp;
+			for (long ry = iy0; ry < iy1; ry++) {
+				if (tile->opaque) {
+					memcpy(dst, &tile->pixels[srcOff], len);
+				} else {
+					blitMasked(dst, &tile->pixels[srcOff], &tile->mask[srcOff], len);
+				}
+				srcOff += srcStride;
+				dst += target.stride;
+			}
+		}
+	}
+	return;
+}
+
+void TileMapRenderer::redrawMapRect(const RenderTarget& target, int viewX,
+	int viewY, long mapX, long mapY, unsigned long width, unsigned long height)
+{
+	long x0 = std::max(mapX - viewX, 0L);
+	long y0 = std::max(mapY - viewY, 0L);
+	long x1 = std::min(mapX - viewX + (long)width, (long)target.width);
+	long y1 = std::min(mapY - viewY + (long)height, (long)target.height);
+	if ((x0 >= x1) || (y0 >= y1)) return;
+	this->drawRect(target, viewX, viewY, x0, y0, x1 - x0, y1 - y0);
+	return;
+}
+
+} // namespace gamegraphics
+} // namespace camoto
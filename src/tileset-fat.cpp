@@ -18,12 +18,54 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics/trace.hpp>
 #include "tileset-fat.hpp"
+#include "hash.hpp"
+
+/// Don't bother starting threads in replaceAll() for fewer images than this.
+#define FAT_MIN_THREAD_TILES 16
 
 namespace camoto {
 namespace gamegraphics {
 
+/// One image being encoded by Tileset_FAT::replaceAll().
+struct FATReplaceJob {
+	ImagePtr img;               ///< Image writing into content
+	stream::string_sptr content; ///< Copy of the entry's content being replaced
+	StdImageDataPtr pixels;     ///< New image
+	StdImageDataPtr mask;       ///< New mask
+	bool failed;                ///< Did fromStandard() throw an exception?
+	std::string error;          ///< Exception message if failed
+};
+
+/// Encode a block of images, recording rather than throwing any errors.
+static void encodeJobs(FATReplaceJob *jobs, unsigned long count)
+{
+	for (unsigned long i = 0; i < count; i++) {
+		try {
+			TraceSpan span("Tileset_FAT::encode");
+			jobs[i].img->fromStandard(jobs[i].pixels, jobs[i].mask);
+			jobs[i].failed = false;
+		} catch (const std::exception& e) {
+			jobs[i].failed = true;
+			jobs[i].error = e.what();
+		}
+	}
+	return;
+}
+
+/// Sort FAT entries into the order they appear in the file.
+static bool beforeOnDisk(const Tileset_FAT::FATEntry *a,
+	const Tileset_FAT::FATEntry *b)
+{
+	if (a->offset != b->offset) return a->offset < b->offset;
+	return a->index < b->index;
+}
+
 Tileset_FAT::Tileset_FAT(stream::inout_sptr data,
 	stream::pos offFirstTile)
 	:	data(new stream::seg()),
@@ -181,6 +223,7 @@ void Tileset_FAT::resize(EntryPtr& id, stream::len newSize)
 {
 	FATEntry *pFAT = dynamic_cast<FATEntry *>(id.get());
 	assert(pFAT);
+	this->checkNewSize(pFAT, newSize);
 	stream::delta delta = newSize - pFAT->size;
 
 	// Add or remove the data in the underlying stream
@@ -235,6 +278,221 @@ void Tileset_FAT::flush()
 	return;
 }
 
+bool Tileset_FAT::getFingerprint(const EntryPtr& id, uint64_t *fingerprint)
+{
+	const FATEntry *pFAT = dynamic_cast<const FATEntry *>(id.get());
+	assert(pFAT);
+	*fingerprint = Tileset_FAT::hashEntry(this->data, pFAT);
+	return true;
+}
+
+void Tileset_FAT::replaceAll(const std::vector<StdImageDataPtr>& pixels,
+	const std::vector<StdImageDataPtr>& masks)
+{
+	if (!this->canEncodeSeparately()) {
+		this->Tileset_Base::replaceAll(pixels, masks);
+		return;
+	}
+	if ((pixels.size() != this->items.size()) || (masks.size() != this->items.size())) {
+		throw stream::error("replaceAll() needs one image for every entry in the"
+			" tileset");
+	}
+
+	// Give each image a copy of its old content to write into, as some formats
+	// read the existing data when the image is opened.
+	std::vector<FATReplaceJob> jobs;
+	std::vector<FATEntry *> replaced;
+	for (unsigned long i = 0; i < this->items.size(); i++) {
+		if (!pixels[i]) continue;
+		const EntryPtr& id = this->items[i];
+		if (id->getAttr() & (EmptySlot | SubTileset)) {
+			throw stream::error("replaceAll() was given an image for an entry that"
+				" is not an image");
+		}
+		FATEntry *pFAT = dynamic_cast<FATEntry *>(id.get());
+		assert(pFAT);
+
+		FATReplaceJob job;
+		job.content.reset(new stream::string());
+		if (pFAT->size) {
+			std::string old(pFAT->size, '\0');
+			this->data->seekg(pFAT->offset + pFAT->lenHeader, stream::start);
+			this->data->read((uint8_t *)&old[0], pFAT->size);
+			job.content->write((const uint8_t *)old.data(), old.length());
+			job.content->seekp(0, stream::start);
+		}
+		job.img = this->createImageInstance(id, job.content);
+		job.pixels = pixels[i];
+		job.mask = masks[i];
+		job.failed = false;
+		jobs.push_back(job);
+		replaced.push_back(pFAT);
+	}
+	if (jobs.empty()) return;
+
+	// Encode everything before touching the file, so a failure leaves it as it
+	// was.  Give each thread an equal block of images, and do the last one here.
+	{
+		TraceSpan span("Tileset_FAT::replaceAll::encode");
+		unsigned long numThreads = boost::thread::hardware_concurrency();
+		if (jobs.size() < FAT_MIN_THREAD_TILES) numThreads = 1;
+		if (numThreads < 1) numThreads = 1;
+		boost::thread_group threads;
+		unsigned long perThread = jobs.size() / numThreads;
+		unsigned long first = 0;
+		for (unsigned long t = 0; t < numThreads - 1; t++) {
+			threads.create_thread(boost::bind(encodeJobs, &jobs[first], perThread));
+			first += perThread;
+		}
+		encodeJobs(&jobs[first], jobs.size() - first);
+		threads.join_all();
+	}
+
+	std::map<const FATEntry *, std::string> newContent;
+	for (unsigned long j = 0; j < jobs.size(); j++) {
+		if (jobs[j].failed) throw stream::error(jobs[j].error);
+		jobs[j].img.reset(); // finish any writes
+		jobs[j].content->flush();
+		newContent[replaced[j]] = *jobs[j].content->str();
+	}
+	jobs.clear();
+
+	// The new sizes don't go through resize(), so check them the same way
+	// before anything is written.
+	for (std::map<const FATEntry *, std::string>::const_iterator
+		i = newContent.begin(); i != newContent.end(); i++
+	) {
+		if (i->second.length() != (stream::len)i->first->size) {
+			this->checkNewSize(i->first, i->second.length());
+		}
+	}
+
+	// Everything from the first replaced entry to the end of the last entry
+	// will be rewritten, in the order the entries appear in the file.
+	std::vector<FATEntry *> order;
+	for (VC_ENTRYPTR::iterator i = this->items.begin(); i != this->items.end(); i++) {
+		FATEntry *pFAT = dynamic_cast<FATEntry *>(i->get());
+		assert(pFAT);
+		order.push_back(pFAT);
+	}
+	std::sort(order.begin(), order.end(), beforeOnDisk);
+	unsigned long firstChanged = 0;
+	while (newContent.find(order[firstChanged]) == newContent.end()) firstChanged++;
+	stream::pos start = order[firstChanged]->offset;
+	stream::pos oldEnd = start;
+	for (unsigned long j = firstChanged; j < order.size(); j++) {
+		stream::pos end = order[j]->offset + order[j]->lenHeader + order[j]->size;
+		if (end > oldEnd) oldEnd = end;
+	}
+
+	std::string oldRegion(oldEnd - start, '\0');
+	if (!oldRegion.empty()) {
+		TraceSpan span("Tileset_FAT::replaceAll::read");
+		this->data->seekg(start, stream::start);
+		this->data->read((uint8_t *)&oldRegion[0], oldRegion.length());
+	}
+
+	// Lay out the new region, keeping each entry's embedded FAT and anything
+	// between the entries.
+	std::string newRegion;
+	newRegion.reserve(oldRegion.length());
+	std::vector<stream::pos> newOffset(order.size()), newSize(order.size());
+	stream::pos pos = start; // end of the last entry copied, in the old file
+	for (unsigned long j = firstChanged; j < order.size(); j++) {
+		FATEntry *pFAT = order[j];
+		if (pFAT->offset > pos) {
+			newRegion.append(oldRegion, pos - start, pFAT->offset - pos);
+			pos = pFAT->offset;
+		}
+		newOffset[j] = start + newRegion.length();
+		newRegion.append(oldRegion, pFAT->offset - start, pFAT->lenHeader);
+		std::map<const FATEntry *, std::string>::const_iterator
+			nc = newContent.find(pFAT);
+		if (nc != newContent.end()) {
+			newRegion.append(nc->second);
+			newSize[j] = nc->second.length();
+		} else {
+			newRegion.append(oldRegion, pFAT->offset + pFAT->lenHeader - start,
+				pFAT->size);
+			newSize[j] = pFAT->size;
+		}
+		stream::pos end = pFAT->offset + pFAT->lenHeader + pFAT->size;
+		if (end > pos) pos = end;
+	}
+
+	// Resize the region then write it out in one go
+	{
+		TraceSpan span("Tileset_FAT::replaceAll::write");
+		stream::delta delta = (stream::delta)newRegion.length()
+			- (stream::delta)oldRegion.length();
+		if (delta > 0) {
+			this->data->seekp(oldEnd, stream::start);
+			this->data->insert(delta);
+		} else if (delta < 0) {
+			this->data->seekp(oldEnd + delta, stream::start);
+			this->data->remove(-delta);
+		}
+		if (!newRegion.empty()) {
+			this->data->seekp(start, stream::start);
+			this->data->write((const uint8_t *)newRegion.data(), newRegion.length());
+		}
+	}
+
+	// Update the FAT, and move or resize any open stream::subs to match
+	for (unsigned long j = firstChanged; j < order.size(); j++) {
+		FATEntry *pFAT = order[j];
+		stream::delta offDelta = (stream::delta)newOffset[j]
+			- (stream::delta)pFAT->offset;
+		stream::delta sizeDelta = (stream::delta)newSize[j]
+			- (stream::delta)pFAT->size;
+		if (offDelta) {
+			pFAT->offset = newOffset[j];
+			this->updateFileOffset(pFAT, offDelta);
+		}
+		if (sizeDelta) {
+			pFAT->size = newSize[j];
+			this->updateFileSize(pFAT, sizeDelta);
+		}
+		if (!offDelta && !sizeDelta) continue;
+
+		for (OPEN_ITEMS::iterator i = this->openItems.begin();
+			i != this->openItems.end();
+			i++
+		) {
+			if (i->first.get() != pFAT) continue;
+			if (stream::sub_sptr sub = i->second.lock()) {
+				if (offDelta) sub->relocate(offDelta);
+				if (sizeDelta) sub->resize(pFAT->size);
+			}
+		}
+	}
+	this->cleanOpenSubstreams();
+
+	return;
+}
+
+uint64_t Tileset_FAT::hashEntry(stream::input_sptr content, const FATEntry *fat)
+{
+	TraceSpan span("Tileset_FAT::hashEntry");
+
+	// Mix in the lengths and attributes, as the data alone won't change if an
+	// entry shrinks and only zeros are cut off the end.
+	uint64_t h = hashBlock(0, fat->lenHeader);
+	h = hashBlock(h, fat->size);
+	h = hashBlock(h, fat->attr);
+
+	uint8_t buf[4096]; // must be a multiple of 8 for hashBytes()
+	stream::len remaining = fat->lenHeader + fat->size;
+	content->seekg(fat->offset, stream::start);
+	while (remaining) {
+		stream::len len = std::min<stream::len>(remaining, sizeof(buf));
+		content->read(buf, len);
+		h = hashBytes(h, buf, len);
+		remaining -= len;
+	}
+	return hashFinish(h);
+}
+
 void Tileset_FAT::shiftFiles(const FATEntry *fatSkip, stream::pos offStart,
 	stream::delta deltaOffset, int deltaIndex)
 {
@@ -339,8 +597,20 @@ Tileset_FAT::FATEntry *Tileset_FAT::createNewFATEntry()
 	return new FATEntry();
 }
 
+void Tileset_FAT::checkNewSize(const FATEntry *pid, stream::len newSize)
+{
+	// Default implementation allows any size
+	return;
+}
+
+bool Tileset_FAT::canEncodeSeparately() const
+{
+	return true;
+}
+
 stream::inout_sptr Tileset_FAT::openStream(const EntryPtr& id)
 {
+	TraceSpan span("Tileset_FAT::openStream");
 	assert(id->isValid());
 
 	// We are casting away const here, but that's because we need to maintain
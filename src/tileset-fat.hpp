@@ -110,6 +110,34 @@ class Tileset_FAT: virtual public Tileset_Base
 
 		virtual void flush();
 
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint);
+
+		/// Encode every image into memory, then write the new layout in one pass.
+		/**
+		 * Images are encoded into a copy of their old content, several at once if
+		 * canEncodeSeparately() allows it.  The part of the file from the first
+		 * replaced entry onwards is then written out in a single sequential pass,
+		 * and the FAT updated, instead of shifting the rest of the file each time
+		 * an image changes size.  Nothing is changed if any image fails to encode.
+		 */
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks);
+
+		/// Hash the raw bytes of an entry, including any embedded FAT.
+		/**
+		 * This is the implementation of getFingerprint(), shared with formats
+		 * that use FATEntry without deriving from this class.
+		 *
+		 * @param content
+		 *   Stream the entry's offset is relative to.
+		 *
+		 * @param fat
+		 *   Entry to hash.
+		 *
+		 * @return The fingerprint.
+		 */
+		static uint64_t hashEntry(stream::input_sptr content, const FATEntry *fat);
+
 		/// Shift any files *starting* at or after offStart by delta bytes.
 		/**
 		 * This updates the internal offsets and index numbers.  The FAT is updated
@@ -145,6 +173,22 @@ class Tileset_FAT: virtual public Tileset_Base
 		virtual ImagePtr createImageInstance(const EntryPtr& id,
 			stream::inout_sptr content);
 
+		/// Make sure an entry can be given a new size.
+		/**
+		 * This is called by resize() and replaceAll() before anything is changed.
+		 * The default allows any size.  Formats where every tile is the same size
+		 * override this to reject the rest.
+		 *
+		 * @param pid
+		 *   The entry to be resized.  pid->size is still the old size.
+		 *
+		 * @param newSize
+		 *   Proposed size of the entry's content, not including any embedded FAT.
+		 *
+		 * @throw stream::error if the entry can't be this size.
+		 */
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
+
 		/// Adjust the offset of the given entry in the on-disk FAT.
 		/**
 		 * @param pid
@@ -254,6 +298,18 @@ class Tileset_FAT: virtual public Tileset_Base
 		 */
 		virtual FATEntry *createNewFATEntry();
 
+		/// Can images be encoded away from the tileset, and at the same time?
+		/**
+		 * replaceAll() uses this to decide whether it can encode each image into
+		 * a memory buffer on its own thread.  Formats whose images read or write
+		 * anything other than the content stream passed to createImageInstance(),
+		 * such as state shared with the tileset, must return false, and will then
+		 * have their images replaced one at a time instead.
+		 *
+		 * @return true by default.
+		 */
+		virtual bool canEncodeSeparately() const;
+
 	private:
 
 		/// Create a stream::sub containing the item's data.
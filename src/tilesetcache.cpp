@@ -0,0 +1,708 @@
+/**
+ * @file  tilesetcache.cpp
+ * @brief Store decoded tilesets on disk so they can be reopened instantly.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string.h>
+#include <camoto/gamegraphics/tilesetcache.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+#include "basetileset.hpp"
+#include "baseimage.hpp"
+#include "hash.hpp"
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#define CACHE_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace camoto {
+namespace gamegraphics {
+
+/// First eight bytes of every cache file.
+#define CACHE_MAGIC "GGTCACHE"
+
+/// Cache format version, increased whenever the layout changes.
+#define CACHE_VERSION 1
+
+/// Written in native byte order, to spot caches from other machines.
+#define CACHE_BYTE_ORDER 0x01020304
+
+/// The pixel data starts on a boundary of this many bytes.
+#define CACHE_PAGE_SIZE 4096
+
+/// Each image's pixel data starts on a boundary of this many bytes.
+#define CACHE_PIXEL_ALIGN 16
+
+/// Start of a cache file.
+/**
+ * All fields are in native byte order, as a cache is only meant to be read
+ * back on the machine that wrote it.
+ */
+struct CacheHeader {
+	char magic[8];          ///< CACHE_MAGIC
+	uint32_t version;       ///< CACHE_VERSION
+	uint32_t byteOrder;     ///< CACHE_BYTE_ORDER
+	uint64_t fingerprint;   ///< Fingerprint of the source the cache came from
+	uint64_t fileSize;      ///< Size of the whole file, to spot truncation
+	uint64_t offNodes;      ///< Offset of the first CacheNode
+	uint32_t numNodes;      ///< Number of CacheNode structures
+	uint32_t reserved;      ///< Unused, always 0
+};
+
+/// One tileset or image in a cache file.
+/**
+ * Nodes are stored breadth first, starting with the root tileset, so the
+ * entries in each tileset are consecutive nodes.
+ */
+struct CacheNode {
+	uint32_t firstChild;    ///< Index of the node for this tileset's first entry
+	uint32_t numChildren;   ///< Number of entries in this tileset, 0 for images
+	int32_t attr;           ///< Tileset::Attributes (SubTileset for the root)
+	int32_t caps;           ///< Tileset::Caps or Image::Caps, minus changes
+	uint32_t width;         ///< Image or tileset dimensions
+	uint32_t height;        ///< Image or tileset dimensions
+	uint32_t layoutWidth;   ///< Tileset::getLayoutWidth()
+	int32_t hotspotX;       ///< Image::getHotspot(), if caps has HasHotspot
+	int32_t hotspotY;       ///< Image::getHotspot(), if caps has HasHotspot
+	int32_t hitX;           ///< Image::getHitRect(), if caps has HasHitRect
+	int32_t hitY;           ///< Image::getHitRect(), if caps has HasHitRect
+	uint32_t lenName;       ///< Length of the entry's name
+	uint64_t offName;       ///< Offset of the entry's name
+	uint64_t offPalette;    ///< Offset of a uint32_t count and RGBA values, or 0
+	uint64_t offPixels;     ///< Offset of width * height pixels then the mask
+};
+
+/// Is the node a tileset?
+static inline bool isTilesetNode(const CacheNode *node)
+{
+	return node->attr & Tileset::SubTileset;
+}
+
+// Exported in tilesetcache.hpp
+uint64_t fingerprintStream(stream::input_sptr source)
+{
+	TraceSpan span("fingerprintStream");
+
+	stream::len remaining = source->size();
+	uint64_t h = hashBlock(0, remaining);
+	uint8_t buf[4096]; // must be a multiple of 8 for hashBytes()
+	source->seekg(0, stream::start);
+	while (remaining) {
+		stream::len len = std::min<stream::len>(remaining, sizeof(buf));
+		source->read(buf, len);
+		h = hashBytes(h, buf, len);
+		remaining -= len;
+	}
+	return hashFinish(h);
+}
+
+//
+// Writer
+//
+
+/// A node waiting to be written out, along with what it came from.
+struct PendingNode {
+	CacheNode node;          ///< Fields to write out
+	std::string name;        ///< Entry name
+	PaletteTablePtr palette; ///< Palette, if the caps say there is one
+	TilesetPtr tileset;      ///< Valid for tilesets
+	ImagePtr image;          ///< Valid for images
+};
+
+/// Fill in the node fields from a tileset.
+static void describeTileset(PendingNode *pending)
+{
+	CacheNode& n = pending->node;
+	TilesetPtr tileset = pending->tileset;
+	n.caps = tileset->getCaps()
+		& (Tileset::HasPalette | Tileset::HasNames | Tileset::ColourDepthMask);
+	unsigned int width, height;
+	tileset->getTilesetDimensions(&width, &height);
+	n.width = width;
+	n.height = height;
+	n.layoutWidth = tileset->getLayoutWidth();
+	if (n.caps & Tileset::HasPalette) pending->palette = tileset->getPalette();
+	return;
+}
+
+/// Fill in the node fields from an image.
+static void describeImage(PendingNode *pending)
+{
+	CacheNode& n = pending->node;
+	ImagePtr image = pending->image;
+	n.caps = image->getCaps() & (Image::HasPalette | Image::HasHotspot
+		| Image::HasHitRect | Image::ColourDepthMask);
+	unsigned int width, height;
+	image->getDimensions(&width, &height);
+	n.width = width;
+	n.height = height;
+	if (n.caps & Image::HasHotspot) {
+		signed int x, y;
+		image->getHotspot(&x, &y);
+		n.hotspotX = x;
+		n.hotspotY = y;
+	}
+	if (n.caps & Image::HasHitRect) {
+		signed int x, y;
+		image->getHitRect(&x, &y);
+		n.hitX = x;
+		n.hitY = y;
+	}
+	if (n.caps & Image::HasPalette) pending->palette = image->getPalette();
+	return;
+}
+
+/// Write zeros until the file reaches the given offset.
+static void padTo(std::ofstream& out, uint64_t *pos, uint64_t target)
+{
+	static const char zeros[CACHE_PAGE_SIZE] = {0};
+	while (*pos < target) {
+		uint64_t len = std::min<uint64_t>(target - *pos, sizeof(zeros));
+		out.write(zeros, len);
+		*pos += len;
+	}
+	return;
+}
+
+/// Round an offset up to a multiple of align.
+static inline uint64_t alignUp(uint64_t off, uint64_t align)
+{
+	return (off + align - 1) / align * align;
+}
+
+/// Write the cache out to an open file.
+static void writeCacheFile(std::ofstream& out, TilesetPtr tileset,
+	uint64_t sourceFingerprint)
+{
+	// Lay the tree out breadth first, so each tileset's entries end up in
+	// consecutive nodes.  Images are opened but not decoded yet.
+	std::vector<PendingNode> nodes(1);
+	memset(&nodes[0].node, 0, sizeof(CacheNode));
+	nodes[0].node.attr = Tileset::SubTileset;
+	nodes[0].tileset = tileset;
+	describeTileset(&nodes[0]);
+	for (unsigned long n = 0; n < nodes.size(); n++) {
+		if (!nodes[n].tileset) continue;
+		TilesetPtr parent = nodes[n].tileset;
+		const Tileset::VC_ENTRYPTR& items = parent->getItems();
+		nodes[n].node.firstChild = nodes.size();
+		nodes[n].node.numChildren = items.size();
+		for (Tileset::VC_ENTRYPTR::const_iterator
+			i = items.begin(); i != items.end(); i++
+		) {
+			PendingNode child;
+			memset(&child.node, 0, sizeof(CacheNode));
+			child.node.attr = (*i)->getAttr();
+			child.name = (*i)->getName();
+			if (child.node.attr & Tileset::EmptySlot) {
+				// Nothing else to store
+			} else if (child.node.attr & Tileset::SubTileset) {
+				child.tileset = parent->openTileset(*i);
+				describeTileset(&child);
+			} else {
+				child.image = parent->openImage(*i);
+				describeImage(&child);
+			}
+			nodes.push_back(child);
+		}
+	}
+
+	// Work out where everything goes
+	uint64_t off = sizeof(CacheHeader);
+	uint64_t offNodes = off;
+	off += nodes.size() * sizeof(CacheNode);
+
+	for (std::vector<PendingNode>::iterator i = nodes.begin(); i != nodes.end(); i++) {
+		i->node.lenName = i->name.length();
+		i->node.offName = i->name.empty() ? 0 : off;
+		off += i->name.length();
+	}
+
+	// Identical palettes are only stored once
+	std::map<std::string, uint64_t> palettes;
+	std::vector<std::string> paletteData;
+	off = alignUp(off, 4);
+	for (std::vector<PendingNode>::iterator i = nodes.begin(); i != nodes.end(); i++) {
+		if (!i->palette) continue;
+		uint32_t count = i->palette->size();
+		std::string data((const char *)&count, sizeof(count));
+		for (PaletteTable::const_iterator
+			p = i->palette->begin(); p != i->palette->end(); p++
+		) {
+			data += (char)p->red;
+			data += (char)p->green;
+			data += (char)p->blue;
+			data += (char)p->alpha;
+		}
+		std::map<std::string, uint64_t>::iterator existing = palettes.find(data);
+		if (existing != palettes.end()) {
+			i->node.offPalette = existing->second;
+		} else {
+			i->node.offPalette = off;
+			palettes[data] = off;
+			paletteData.push_back(data);
+			off += data.length(); // always a multiple of 4
+		}
+	}
+
+	off = alignUp(off, CACHE_PAGE_SIZE);
+	for (std::vector<PendingNode>::iterator i = nodes.begin(); i != nodes.end(); i++) {
+		if (!i->image) continue;
+		i->node.offPixels = off;
+		off = alignUp(off + 2 * (uint64_t)i->node.width * i->node.height,
+			CACHE_PIXEL_ALIGN);
+	}
+
+	CacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_VERSION;
+	header.byteOrder = CACHE_BYTE_ORDER;
+	header.fingerprint = sourceFingerprint;
+	header.fileSize = off;
+	header.offNodes = offNodes;
+	header.numNodes = nodes.size();
+
+	// Write it all out
+	uint64_t pos = 0;
+	out.write((const char *)&header, sizeof(header));
+	pos += sizeof(header);
+	for (std::vector<PendingNode>::const_iterator i = nodes.begin(); i != nodes.end(); i++) {
+		out.write((const char *)&i->node, sizeof(CacheNode));
+		pos += sizeof(CacheNode);
+	}
+	for (std::vector<PendingNode>::const_iterator i = nodes.begin(); i != nodes.end(); i++) {
+		out.write(i->name.data(), i->name.length());
+		pos += i->name.length();
+	}
+	padTo(out, &pos, alignUp(pos, 4));
+	for (std::vector<std::string>::const_iterator
+		i = paletteData.begin(); i != paletteData.end(); i++
+	) {
+		out.write(i->data(), i->length());
+		pos += i->length();
+	}
+
+	// Decode each image in turn, dropping it as soon as it has been written
+	for (std::vector<PendingNode>::iterator i = nodes.begin(); i != nodes.end(); i++) {
+		if (!i->image) continue;
+		padTo(out, &pos, i->node.offPixels);
+		unsigned long len = i->node.width * i->node.height;
+		if (len) {
+			StdImageDataPtr pixels = i->image->toStandard();
+			StdImageDataPtr mask = i->image->toStandardMask();
+			out.write((const char *)pixels.get(), len);
+			out.write((const char *)mask.get(), len);
+			pos += 2 * len;
+		}
+		i->image.reset();
+	}
+	padTo(out, &pos, header.fileSize);
+	return;
+}
+
+// Exported in tilesetcache.hpp
+void writeTilesetCache(TilesetPtr tileset, uint64_t sourceFingerprint,
+	const std::string& filename)
+{
+	TraceSpan span("writeTilesetCache");
+
+	std::string tempFilename = filename + ".tmp";
+	std::ofstream out(tempFilename.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out) throw stream::error("unable to create " + tempFilename);
+	try {
+		writeCacheFile(out, tileset, sourceFingerprint);
+		out.close();
+		if (!out) throw stream::error("unable to write " + tempFilename);
+	} catch (...) {
+		out.close();
+		std::remove(tempFilename.c_str());
+		throw;
+	}
+
+	// Not atomic on Windows, where rename() won't replace an existing file
+	std::remove(filename.c_str());
+	if (std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
+		std::remove(tempFilename.c_str());
+		throw stream::error("unable to replace " + filename);
+	}
+	return;
+}
+
+//
+// Reader
+//
+
+/// A cache file mapped into memory.
+class CacheFile
+{
+	public:
+		/// Map a file into memory.
+		/**
+		 * @throw stream::error if the file could not be opened.
+		 */
+		CacheFile(const std::string& filename)
+			:	data(NULL),
+				len(0)
+		{
+#ifdef CACHE_USE_MMAP
+			int fd = open(filename.c_str(), O_RDONLY);
+			if (fd < 0) throw stream::error("unable to open " + filename);
+			struct stat st;
+			if (fstat(fd, &st) < 0) {
+				close(fd);
+				throw stream::error("unable to open " + filename);
+			}
+			this->len = st.st_size;
+			if (this->len) {
+				void *p = mmap(NULL, this->len, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p == MAP_FAILED) {
+					close(fd);
+					throw stream::error("unable to map " + filename);
+				}
+				this->data = (const uint8_t *)p;
+			}
+			close(fd); // the mapping stays valid
+#else
+			// No mmap() so read the whole thing in instead
+			std::ifstream in(filename.c_str(), std::ios::binary);
+			if (!in) throw stream::error("unable to open " + filename);
+			in.seekg(0, std::ios::end);
+			this->len = in.tellg();
+			in.seekg(0, std::ios::beg);
+			uint8_t *buf = new uint8_t[this->len];
+			if (!in.read((char *)buf, this->len)) {
+				delete[] buf;
+				throw stream::error("unable to read " + filename);
+			}
+			this->data = buf;
+#endif
+		}
+
+		~CacheFile()
+		{
+#ifdef CACHE_USE_MMAP
+			if (this->data) munmap((void *)this->data, this->len);
+#else
+			delete[] this->data;
+#endif
+		}
+
+		/// Get the header at the start of the file.
+		const CacheHeader *getHeader() const
+		{
+			return (const CacheHeader *)this->data;
+		}
+
+		/// Get a node by index.
+		const CacheNode *getNode(uint32_t index) const
+		{
+			return (const CacheNode *)(this->data + this->getHeader()->offNodes)
+				+ index;
+		}
+
+		/// Read a palette stored in the file.
+		PaletteTablePtr getPalette(uint64_t offPalette) const
+		{
+			PaletteTablePtr pal;
+			if (!offPalette) return pal;
+			uint32_t count;
+			memcpy(&count, this->data + offPalette, sizeof(count));
+			const uint8_t *rgba = this->data + offPalette + sizeof(count);
+			pal.reset(new PaletteTable(count));
+			for (PaletteTable::iterator i = pal->begin(); i != pal->end(); i++) {
+				i->red = *rgba++;
+				i->green = *rgba++;
+				i->blue = *rgba++;
+				i->alpha = *rgba++;
+			}
+			return pal;
+		}
+
+		/// Check that everything in the file is where it should be.
+		/**
+		 * @return true if the file is a valid cache of the given source.
+		 */
+		bool isValid(uint64_t sourceFingerprint) const
+		{
+			if (this->len < sizeof(CacheHeader)) return false;
+			const CacheHeader *header = this->getHeader();
+			if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0) {
+				return false;
+			}
+			if (header->version != CACHE_VERSION) return false;
+			if (header->byteOrder != CACHE_BYTE_ORDER) return false;
+			if (header->fingerprint != sourceFingerprint) return false;
+			if (header->fileSize != this->len) return false;
+			if (header->numNodes < 1) return false;
+			if (header->offNodes % sizeof(uint64_t)) return false;
+			if (header->offNodes > this->len) return false;
+			if ((this->len - header->offNodes) / sizeof(CacheNode) < header->numNodes) {
+				return false;
+			}
+			if (!isTilesetNode(this->getNode(0))) return false;
+
+			for (uint32_t i = 0; i < header->numNodes; i++) {
+				const CacheNode *node = this->getNode(i);
+				if (!this->fits(node->offName, node->lenName)) return false;
+				if (isTilesetNode(node)) {
+					// Entries always come after their tileset, so there can't be loops
+					if (node->numChildren && (
+						(node->firstChild <= i)
+						|| (node->firstChild > header->numNodes)
+						|| (node->numChildren > header->numNodes - node->firstChild)
+					)) return false;
+				} else {
+					if (node->numChildren) return false;
+					if (!(node->attr & Tileset::EmptySlot)
+						&& !this->fits(node->offPixels,
+							2 * (uint64_t)node->width * node->height)
+					) return false;
+				}
+				if (node->offPalette) {
+					if (!this->fits(node->offPalette, sizeof(uint32_t))) return false;
+					uint32_t count;
+					memcpy(&count, this->data + node->offPalette, sizeof(count));
+					if (!this->fits(node->offPalette + sizeof(uint32_t),
+						(uint64_t)count * 4)) return false;
+				}
+			}
+			return true;
+		}
+
+		const uint8_t *data;   ///< Start of the file in memory
+		uint64_t len;          ///< Size of the file in bytes
+
+	protected:
+		/// Does the given range lie within the file?
+		bool fits(uint64_t off, uint64_t size) const
+		{
+			return (off <= this->len) && (size <= this->len - off);
+		}
+};
+
+/// Shared pointer to a CacheFile.
+typedef boost::shared_ptr<CacheFile> CacheFilePtr;
+
+/// Image read straight out of a cache file.
+class Image_Cache: virtual public Image_Base
+{
+	public:
+		Image_Cache(CacheFilePtr file, const CacheNode *node)
+			:	file(file),
+				node(node)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->node->caps;
+		}
+
+		virtual void getDimensions(unsigned int *width, unsigned int *height)
+		{
+			*width = this->node->width;
+			*height = this->node->height;
+			return;
+		}
+
+		virtual void getHotspot(signed int *x, signed int *y)
+		{
+			*x = this->node->hotspotX;
+			*y = this->node->hotspotY;
+			return;
+		}
+
+		virtual void getHitRect(signed int *x, signed int *y)
+		{
+			*x = this->node->hitX;
+			*y = this->node->hitY;
+			return;
+		}
+
+		virtual StdImageDataPtr toStandard()
+		{
+			return this->copyOut(0);
+		}
+
+		virtual StdImageDataPtr toStandardMask()
+		{
+			return this->copyOut(this->node->width * this->node->height);
+		}
+
+		virtual void fromStandard(StdImageDataPtr newContent,
+			StdImageDataPtr newMask)
+		{
+			throw stream::error("cached images can't be modified");
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			return this->file->getPalette(this->node->offPalette);
+		}
+
+	protected:
+		CacheFilePtr file;       ///< Keeps the file mapped
+		const CacheNode *node;   ///< This image's node within file
+
+		/// Copy the pixels or mask out of the mapping.
+		/**
+		 * Callers are free to modify what toStandard() returns (Image_Sub writes
+		 * into it) and the mapping is read-only, so they always get a copy.
+		 *
+		 * @param offset
+		 *   Offset from the start of this image's pixel data.
+		 */
+		StdImageDataPtr copyOut(unsigned long offset)
+		{
+			unsigned long len = this->node->width * this->node->height;
+			uint8_t *copy = new uint8_t[len];
+			StdImageDataPtr ret(copy);
+			memcpy(copy, this->file->data + this->node->offPixels + offset, len);
+			return ret;
+		}
+};
+
+/// Tileset read straight out of a cache file.
+class Tileset_Cache: virtual public Tileset_Base
+{
+	public:
+		/// Entry pointing to a node in the cache.
+		struct CacheEntry: virtual public Tileset_Base::Tileset_BaseEntry {
+			const CacheNode *node;  ///< Entry's node within the file
+		};
+
+		Tileset_Cache(CacheFilePtr file, const CacheNode *node)
+			:	file(file),
+				node(node)
+		{
+			for (uint32_t i = 0; i < node->numChildren; i++) {
+				const CacheNode *child = file->getNode(node->firstChild + i);
+				CacheEntry *e = new CacheEntry();
+				EntryPtr ep(e);
+				e->valid = true;
+				e->attr = child->attr;
+				e->name.assign((const char *)file->data + child->offName,
+					child->lenName);
+				e->node = child;
+				this->items.push_back(ep);
+			}
+		}
+
+		virtual int getCaps()
+		{
+			return this->node->caps;
+		}
+
+		virtual const VC_ENTRYPTR& getItems() const
+		{
+			return this->items;
+		}
+
+		virtual TilesetPtr openTileset(const EntryPtr& id)
+		{
+			const CacheEntry *e = dynamic_cast<const CacheEntry *>(id.get());
+			assert(e);
+			assert(e->attr & Tileset::SubTileset);
+			return TilesetPtr(new Tileset_Cache(this->file, e->node));
+		}
+
+		virtual ImagePtr openImage(const EntryPtr& id)
+		{
+			const CacheEntry *e = dynamic_cast<const CacheEntry *>(id.get());
+			assert(e);
+			if (e->attr & (Tileset::SubTileset | Tileset::EmptySlot)) {
+				throw stream::error("this entry is not an image");
+			}
+			return ImagePtr(new Image_Cache(this->file, e->node));
+		}
+
+		virtual EntryPtr insert(const EntryPtr& idBeforeThis, int attr)
+		{
+			throw stream::error("cached tilesets can't be modified");
+		}
+
+		virtual void remove(EntryPtr& id)
+		{
+			throw stream::error("cached tilesets can't be modified");
+		}
+
+		virtual void resize(EntryPtr& id, stream::len newSize)
+		{
+			throw stream::error("cached tilesets can't be modified");
+		}
+
+		virtual void flush()
+		{
+			return;
+		}
+
+		virtual void getTilesetDimensions(unsigned int *width,
+			unsigned int *height)
+		{
+			*width = this->node->width;
+			*height = this->node->height;
+			return;
+		}
+
+		virtual unsigned int getLayoutWidth()
+		{
+			return this->node->layoutWidth;
+		}
+
+		virtual PaletteTablePtr getPalette()
+		{
+			return this->file->getPalette(this->node->offPalette);
+		}
+
+	protected:
+		CacheFilePtr file;       ///< Keeps the file mapped
+		const CacheNode *node;   ///< This tileset's node within file
+		VC_ENTRYPTR items;       ///< One entry per child node
+};
+
+// Exported in tilesetcache.hpp
+TilesetPtr openTilesetCache(const std::string& filename,
+	uint64_t sourceFingerprint)
+{
+	TraceSpan span("openTilesetCache");
+
+	CacheFilePtr file;
+	try {
+		file.reset(new CacheFile(filename));
+	} catch (const stream::error&) {
+		return TilesetPtr(); // no cache yet
+	}
+	if (!file->isValid(sourceFingerprint)) return TilesetPtr();
+	return TilesetPtr(new Tileset_Cache(file, file->getNode(0)));
+}
+
+} // namespace gamegraphics
+} // namespace camoto
@@ -21,10 +21,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <camoto/iostream_helpers.hpp>
 #include <camoto/gamegraphics/palettetable.hpp>
 #include "tileset-fat.hpp"
+#include "hash.hpp"
 #include "img-ega-byteplanar-tiled.hpp"
+#include "lru-cache.hpp"
 #include "tls-actrinfo.hpp"
 
 /// Number of planes in each image
@@ -43,6 +46,12 @@
 /// Size of each tile within a single actor frame, in bytes.
 #define ACTR_TILE_SIZE (ACTR_TILE_WIDTH / 8 * ACTR_TILE_HEIGHT * ACTR_NUMPLANES)
 
+/// Size of each frame table entry in the info file, in bytes.
+#define ACTR_FRAME_INFO_SIZE 8
+
+/// Maximum number of bytes of decoded frames to keep in memory.
+#define ACTR_CACHE_SIZE (4 * 1024 * 1024)
+
 #include <camoto/gamegraphics/tilesettype.hpp>
 #include <camoto/gamegraphics/palettetable.hpp>
 #include "tileset-fat.hpp"
@@ -50,6 +59,36 @@
 namespace camoto {
 namespace gamegraphics {
 
+/// Location and size of one actor frame within the tile data.
+struct ActorFrame {
+	stream::pos offset;  ///< Offset in the tile data, alignment already removed
+	stream::len size;    ///< Length of the frame data, in bytes
+	unsigned int width;  ///< Image width, in tiles
+	unsigned int height; ///< Image height, in tiles
+};
+
+/// Every frame of every actor, parsed once from the info file.
+struct ActorFrameIndex {
+	/// All frames in file order, one actor after the other.
+	std::vector<ActorFrame> frames;
+
+	/// Index into frames of each actor's first frame.
+	/**
+	 * There is one more element than there are actors, so the frames for
+	 * actor n are [firstFrame[n], firstFrame[n + 1]).
+	 */
+	std::vector<unsigned int> firstFrame;
+};
+
+/// Shared pointer to an immutable frame index.
+typedef boost::shared_ptr<const ActorFrameIndex> ActorFrameIndexPtr;
+
+/// Decoded frames, keyed on frame number * 2 + 1 for the mask.
+typedef LRUCache<unsigned long, StdImageDataPtr> ActorFrameCache;
+
+/// Shared pointer to a frame cache.
+typedef boost::shared_ptr<ActorFrameCache> ActorFrameCachePtr;
+
 /// Tileset for the full list of actors, one sub-tileset for each actor.
 class Tileset_Actrinfo: virtual public Tileset_FAT
 {
@@ -59,9 +98,10 @@ class Tileset_Actrinfo: virtual public Tileset_FAT
 		virtual ~Tileset_Actrinfo();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual unsigned int getLayoutWidth();
 		virtual PaletteTablePtr getPalette();
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint);
 
 		// Tileset_FAT
 		virtual TilesetPtr createTilesetInstance(const EntryPtr& id,
@@ -70,34 +110,59 @@ class Tileset_Actrinfo: virtual public Tileset_FAT
 	protected:
 		stream::inout_sptr dataTiles;  ///< ACTORS.MNI or equivalent
 		PaletteTablePtr pal;
+		ActorFrameIndexPtr frameIndex; ///< Every frame of every actor
+		ActorFrameCachePtr frameCache; ///< Recently decoded frames
 };
 
 /// Tileset containing each frame for a single actor.
 class Tileset_SingleActor: virtual public Tileset_FAT
 {
 	public:
-		Tileset_SingleActor(stream::inout_sptr fat, stream::inout_sptr data,
-			PaletteTablePtr pal);
+		Tileset_SingleActor(stream::inout_sptr data, PaletteTablePtr pal,
+			ActorFrameIndexPtr frameIndex, unsigned int actor,
+			ActorFrameCachePtr frameCache);
 		virtual ~Tileset_SingleActor();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual unsigned int getLayoutWidth();
 		virtual PaletteTablePtr getPalette();
 
 		// Tileset_FAT
 		virtual ImagePtr createImageInstance(const EntryPtr& id,
 			stream::inout_sptr content);
+		virtual bool canEncodeSeparately() const;
 
 		class ActorEntry: virtual public FATEntry {
 			public:
 				unsigned int width;  ///< Image width, in tiles
 				unsigned int height; ///< Image height, in tiles
+				unsigned int frame;  ///< Index into ActorFrameIndex::frames
 		};
 
 	protected:
-		stream::inout_sptr dataInfo;  ///< ACTRINFO.MNI or equivalent
 		PaletteTablePtr pal;
+		ActorFrameCachePtr frameCache; ///< Shared with the parent tileset
+};
+
+/// Actor frame that keeps recently decoded copies in the tileset's cache.
+class Image_ActorFrame: virtual public Image_EGABytePlanarTiled
+{
+	public:
+		Image_ActorFrame(ActorFrameCachePtr frameCache, unsigned int frame);
+		virtual ~Image_ActorFrame();
+
+		virtual StdImageDataPtr toStandard();
+		virtual StdImageDataPtr toStandardMask();
+		virtual void fromStandard(StdImageDataPtr newContent,
+			StdImageDataPtr newMask);
+
+	protected:
+		ActorFrameCachePtr frameCache;
+		unsigned int frame;
+
+		/// Return a copy of the cached pixels or mask, decoding on a miss.
+		StdImageDataPtr getCached(bool mask);
 };
 
 //
@@ -187,22 +252,35 @@ Tileset_Actrinfo::Tileset_Actrinfo(stream::inout_sptr dataInfo,
 	stream::inout_sptr dataTiles, PaletteTablePtr pal)
 	:	Tileset_FAT(dataInfo, ACTR_FIRST_TILE_OFFSET),
 		dataTiles(dataTiles),
-		pal(pal)
+		pal(pal),
+		frameCache(new ActorFrameCache(ACTR_CACHE_SIZE))
 {
+	// Read the whole info file in one go, since every byte of it is needed to
+	// build the frame index anyway.
+	stream::len lenInfo = dataInfo->size();
+	std::vector<uint8_t> info(lenInfo);
 	this->data->seekg(0, stream::start);
+	if (lenInfo) this->data->read(&info[0], lenInfo);
+
 	std::vector<unsigned int> offsets;
-	unsigned int nextOffset;
 	unsigned int numImages = 1;
 	for (unsigned int i = 0; i < numImages; i++) {
-		this->data >> u16le(nextOffset);
+		if (i * 2 + 2 > lenInfo) {
+			throw stream::error("actor info file is truncated");
+		}
+		unsigned int nextOffset = info[i * 2] | (info[i * 2 + 1] << 8);
 		nextOffset -= nextOffset / 65536;
 		if (i == 0) numImages = nextOffset;
 		nextOffset *= 2;
 		offsets.push_back(nextOffset);
 	}
-	stream::len lenInfo = dataInfo->size();
 	offsets.push_back(lenInfo);
 
+	ActorFrameIndex *index = new ActorFrameIndex();
+	this->frameIndex.reset(index);
+	index->firstFrame.reserve(numImages + 1);
+	stream::len lenTiles = dataTiles->size();
+
 	this->items.reserve(numImages);
 	std::vector<unsigned int>::const_iterator oi = offsets.begin();
 	for (unsigned int i = 0; i < numImages; i++) {
@@ -218,7 +296,29 @@ Tileset_Actrinfo::Tileset_Actrinfo(stream::inout_sptr dataInfo,
 			fat->attr = Tileset::EmptySlot;
 		}
 		this->items.push_back(ep);
+
+		// Add this actor's frames to the index
+		index->firstFrame.push_back(index->frames.size());
+		stream::pos end = std::min<stream::pos>(fat->offset + fat->size, lenInfo);
+		ActorFrame *last = NULL;
+		for (stream::pos off = fat->offset; off + ACTR_FRAME_INFO_SIZE <= end;
+			off += ACTR_FRAME_INFO_SIZE
+		) {
+			const uint8_t *e = &info[off];
+			ActorFrame frame;
+			frame.height = e[0] | (e[1] << 8);
+			frame.width = e[2] | (e[3] << 8);
+			frame.offset = e[4] | (e[5] << 8) | (e[6] << 16)
+				| ((stream::pos)e[7] << 24);
+			// Adjust for memory alignment
+			frame.offset -= frame.offset / 65536;
+			if (last) last->size = frame.offset - last->offset;
+			index->frames.push_back(frame);
+			last = &index->frames.back();
+		}
+		if (last) last->size = lenTiles - last->offset;
 	}
+	index->firstFrame.push_back(index->frames.size());
 }
 
 Tileset_Actrinfo::~Tileset_Actrinfo()
@@ -231,12 +331,9 @@ int Tileset_Actrinfo::getCaps()
 		| (this->pal ? Tileset::HasPalette : 0);
 }
 
-void Tileset_Actrinfo::resize(EntryPtr& id, stream::len newSize)
+void Tileset_Actrinfo::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
-	FATEntry *fat = dynamic_cast<FATEntry *>(id.get());
-	assert(fat);
-
-	if (newSize != fat->size) {
+	if (newSize != pid->size) {
 		throw stream::error("tiles in this tileset are a fixed size");
 	}
 	return;
@@ -252,6 +349,33 @@ PaletteTablePtr Tileset_Actrinfo::getPalette()
 	return this->pal;
 }
 
+bool Tileset_Actrinfo::getFingerprint(const EntryPtr& id,
+	uint64_t *fingerprint)
+{
+	FATEntry *fat = dynamic_cast<FATEntry *>(id.get());
+	assert(fat);
+
+	// The info file only says where each frame is, so the frame pixels in the
+	// tile data must be hashed as well or changed artwork would go unnoticed.
+	uint64_t h = Tileset_FAT::hashEntry(this->data, fat);
+	stream::len lenTiles = this->dataTiles->size();
+	unsigned int end = this->frameIndex->firstFrame[fat->index + 1];
+	for (unsigned int f = this->frameIndex->firstFrame[fat->index]; f < end; f++) {
+		const ActorFrame& frame = this->frameIndex->frames[f];
+		FATEntry pixels;
+		pixels.valid = true;
+		pixels.attr = Tileset::Default;
+		pixels.index = f;
+		pixels.lenHeader = 0;
+		pixels.offset = std::min<stream::pos>(frame.offset, lenTiles);
+		pixels.size = std::min<stream::len>(
+			frame.width * frame.height * ACTR_TILE_SIZE, lenTiles - pixels.offset);
+		h = hashBlock(h, Tileset_FAT::hashEntry(this->dataTiles, &pixels));
+	}
+	*fingerprint = h;
+	return true;
+}
+
 TilesetPtr Tileset_Actrinfo::createTilesetInstance(const EntryPtr& id,
 	stream::inout_sptr content)
 {
@@ -259,7 +383,8 @@ TilesetPtr Tileset_Actrinfo::createTilesetInstance(const EntryPtr& id,
 	assert(fat);
 
 	return TilesetPtr(
-		new Tileset_SingleActor(content, this->dataTiles, this->pal)
+		new Tileset_SingleActor(this->dataTiles, this->pal, this->frameIndex,
+			fat->index, this->frameCache)
 	);
 }
 
@@ -268,45 +393,33 @@ TilesetPtr Tileset_Actrinfo::createTilesetInstance(const EntryPtr& id,
 // Tileset_SingleActor
 //
 
-Tileset_SingleActor::Tileset_SingleActor(stream::inout_sptr dataInfo,
-	stream::inout_sptr data, PaletteTablePtr pal)
+Tileset_SingleActor::Tileset_SingleActor(stream::inout_sptr data,
+	PaletteTablePtr pal, ActorFrameIndexPtr frameIndex, unsigned int actor,
+	ActorFrameCachePtr frameCache)
 	:	Tileset_FAT(data, ACTR_SINGLE_FIRST_TILE_OFFSET),
-		pal(pal)
+		pal(pal),
+		frameCache(frameCache)
 {
-	stream::pos lenFAT = dataInfo->size();
-	this->data->seekg(0, stream::start);
-
-	stream::len lenRemaining = lenFAT;
-	ActorEntry *fatLast = NULL;
-	unsigned int i = 0;
-	while (lenRemaining) {
+	unsigned int first = frameIndex->firstFrame[actor];
+	unsigned int end = frameIndex->firstFrame[actor + 1];
+	this->items.reserve(end - first);
+	for (unsigned int f = first; f < end; f++) {
+		const ActorFrame& frame = frameIndex->frames[f];
 		ActorEntry *fat = new ActorEntry();
 		EntryPtr ep(fat);
 		fat->valid = true;
 		fat->attr = Tileset::Default;
-		fat->index = i++;
+		fat->index = f - first;
 		fat->lenHeader = 0;
-		dataInfo
-			>> u16le(fat->height)
-			>> u16le(fat->width)
-			>> u32le(fat->offset)
-		;
-		// Adjust for memory alignment
-		fat->offset -= fat->offset / 65536;
-		if (fatLast) {
-			fatLast->size = fat->offset - fatLast->offset;
-			if (fatLast->size == 0) {
-				fatLast->attr = Tileset::EmptySlot;
-			}
+		fat->offset = frame.offset;
+		fat->size = frame.size;
+		fat->width = frame.width;
+		fat->height = frame.height;
+		fat->frame = f;
+		if ((fat->size == 0) && (f + 1 < end)) {
+			fat->attr = Tileset::EmptySlot;
 		}
-
 		this->items.push_back(ep);
-		lenRemaining -= 8;
-		fatLast = fat;
-	}
-	if (fatLast) {
-		stream::pos lenData = this->data->size();
-		fatLast->size = lenData - fatLast->offset;
 	}
 }
 
@@ -320,12 +433,9 @@ int Tileset_SingleActor::getCaps()
 		| (this->pal ? Tileset::HasPalette : 0);
 }
 
-void Tileset_SingleActor::resize(EntryPtr& id, stream::len newSize)
+void Tileset_SingleActor::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
-	FATEntry *fat = dynamic_cast<FATEntry *>(id.get());
-	assert(fat);
-
-	if (newSize != fat->size) {
+	if (newSize != pid->size) {
 		throw stream::error("tiles in this tileset are a fixed size");
 	}
 	return;
@@ -355,7 +465,7 @@ ImagePtr Tileset_SingleActor::createImageInstance(const EntryPtr& id,
 	planes[PLANE_HITMAP] = 0;
 	planes[PLANE_OPACITY] = 1;
 
-	Image_EGABytePlanarTiled *ega = new Image_EGABytePlanarTiled();
+	Image_ActorFrame *ega = new Image_ActorFrame(this->frameCache, fat->frame);
 	ImagePtr conv(ega);
 	ega->setParams(
 		content, 0, fat->width * ACTR_TILE_WIDTH, fat->height * ACTR_TILE_HEIGHT,
@@ -365,5 +475,65 @@ ImagePtr Tileset_SingleActor::createImageInstance(const EntryPtr& id,
 	return conv;
 }
 
+bool Tileset_SingleActor::canEncodeSeparately() const
+{
+	// Frames share a decode cache with the other actors, which isn't locked
+	return false;
+}
+
+
+//
+// Image_ActorFrame
+//
+
+Image_ActorFrame::Image_ActorFrame(ActorFrameCachePtr frameCache,
+	unsigned int frame)
+	:	frameCache(frameCache),
+		frame(frame)
+{
+}
+
+Image_ActorFrame::~Image_ActorFrame()
+{
+}
+
+StdImageDataPtr Image_ActorFrame::toStandard()
+{
+	return this->getCached(false);
+}
+
+StdImageDataPtr Image_ActorFrame::toStandardMask()
+{
+	return this->getCached(true);
+}
+
+void Image_ActorFrame::fromStandard(StdImageDataPtr newContent,
+	StdImageDataPtr newMask)
+{
+	this->frameCache->erase(this->frame * 2UL);
+	this->frameCache->erase(this->frame * 2UL + 1);
+	this->Image_EGABytePlanarTiled::fromStandard(newContent, newMask);
+	return;
+}
+
+StdImageDataPtr Image_ActorFrame::getCached(bool mask)
+{
+	unsigned long key = this->frame * 2UL + (mask ? 1 : 0);
+	unsigned long len = this->width * this->height;
+
+	StdImageDataPtr decoded;
+	if (!this->frameCache->get(key, &decoded)) {
+		decoded = this->doConversion(mask);
+		this->frameCache->put(key, decoded, len);
+	}
+
+	// Callers are free to modify what they get back, so they can't have the
+	// cached copy.
+	uint8_t *copy = new uint8_t[len];
+	StdImageDataPtr ret(copy);
+	memcpy(copy, decoded.get(), len);
+	return ret;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
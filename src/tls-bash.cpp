@@ -236,7 +236,7 @@ int Tileset_MonsterBash::getCaps()
 	return Tileset::ColourDepthEGA;
 }
 
-void Tileset_MonsterBash::resize(EntryPtr& id, stream::len newSize)
+void Tileset_MonsterBash::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != this->lenTile) {
 		throw stream::error("tiles in this tileset are a fixed size");
@@ -72,7 +72,7 @@ class Tileset_MonsterBash: virtual public Tileset_FAT
 		virtual ~Tileset_MonsterBash();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual void getTilesetDimensions(unsigned int *width, unsigned int *height);
 		virtual unsigned int getLayoutWidth();
 
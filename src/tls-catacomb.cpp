@@ -225,7 +225,7 @@ int Tileset_Catacomb::getCaps()
 	return 0;
 }
 
-void Tileset_Catacomb::resize(EntryPtr& id, stream::len newSize)
+void Tileset_Catacomb::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	unsigned int tileSize;
 	switch (this->imageType) {
@@ -275,7 +275,7 @@ ImagePtr Tileset_Catacomb::createImageInstance(const EntryPtr& id,
 		}
 		case CAT_CGA: {
 			Image_CGA *cga = new Image_CGA(content, 0, CAT_TILE_WIDTH, CAT_TILE_HEIGHT,
-				CGAPal_CyanMagentaBright);
+				CGAPal_CyanMagentaBright, CGA_Linear);
 			conv.reset(cga);
 			break;
 		}
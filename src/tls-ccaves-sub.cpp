@@ -172,7 +172,7 @@ int Tileset_CCavesSub::getCaps()
 	return Tileset::ChangeDimensions | Tileset::ColourDepthEGA;
 }
 
-void Tileset_CCavesSub::resize(EntryPtr& id, stream::len newSize)
+void Tileset_CCavesSub::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != (unsigned)(this->width * this->height * this->numPlanes)) {
 		throw stream::error("tiles in this tileset are a fixed size");
@@ -178,7 +178,7 @@ int Tileset_CComic::getCaps()
 	return Tileset::ColourDepthEGA;
 }
 
-void Tileset_CComic::resize(EntryPtr& id, stream::len newSize)
+void Tileset_CComic::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != CCA_TILE_WIDTH / 8 * CCA_TILE_HEIGHT * this->numPlanes) {
 		throw stream::error("tiles in this tileset are a fixed size");
@@ -80,7 +80,7 @@ class Tileset_CComic: virtual public Tileset_FAT {
 
 		virtual int getCaps();
 
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 
 		virtual void getTilesetDimensions(unsigned int *width, unsigned int *height);
 
@@ -26,6 +26,7 @@
 #include "img-ega-planar.hpp"
 #include "filter-ccomic2.hpp"
 #include "tls-ccomic2.hpp"
+#include "instrument.hpp"
 
 namespace camoto {
 namespace gamegraphics {
@@ -109,6 +110,7 @@ TilesetPtr TilesetType_CComic2::open(stream::inout_sptr psGraphics,
 	filter_sptr filtWrite(new filter_ccomic2_rle(CC2_FIRST_TILE_OFFSET));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psGraphics, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_CComic2(decoded, NUMPLANES_TILES));
 }
@@ -160,7 +162,7 @@ int Tileset_CComic2::getCaps()
 	return Tileset::ColourDepthEGA;
 }
 
-void Tileset_CComic2::resize(EntryPtr& id, stream::len newSize)
+void Tileset_CComic2::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != CC2_TILE_WIDTH / 8 * CC2_TILE_HEIGHT * this->numPlanes) {
 		throw stream::error("tiles in this tileset are a fixed size");
@@ -64,7 +64,7 @@ class Tileset_CComic2: virtual public Tileset_FAT
 		virtual ~Tileset_CComic2();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual void getTilesetDimensions(unsigned int *width, unsigned int *height);
 		virtual unsigned int getLayoutWidth();
 
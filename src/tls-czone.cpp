@@ -24,6 +24,7 @@
 #include <boost/bind.hpp>
 #include <camoto/iostream_helpers.hpp>
 #include "tls-czone.hpp"
+#include "basetileset.hpp"
 #include "tls-ega-apogee.hpp"
 #include "tileset-fat.hpp" // for FATEntry
 #include "pal-vga-raw.hpp"
@@ -59,6 +60,9 @@ class Tileset_CZone: virtual public Tileset
 		virtual unsigned int getLayoutWidth();
 		virtual PaletteTablePtr getPalette();
 		virtual void setPalette(PaletteTablePtr newPalette);
+		virtual bool getFingerprint(const EntryPtr& id, uint64_t *fingerprint);
+		virtual void replaceAll(const std::vector<StdImageDataPtr>& pixels,
+			const std::vector<StdImageDataPtr>& masks);
 
 	protected:
 		stream::inout_sptr data;
@@ -269,5 +273,22 @@ void Tileset_CZone::setPalette(PaletteTablePtr newPalette)
 	return;
 }
 
+bool Tileset_CZone::getFingerprint(const EntryPtr& id, uint64_t *fingerprint)
+{
+	Tileset_FAT::FATEntryPtr pFAT = boost::dynamic_pointer_cast<Tileset_FAT::FATEntry>(id);
+	assert(pFAT);
+	*fingerprint = Tileset_FAT::hashEntry(this->data, pFAT.get());
+	return true;
+}
+
+void Tileset_CZone::replaceAll(const std::vector<StdImageDataPtr>& pixels,
+	const std::vector<StdImageDataPtr>& masks)
+{
+	// Every tile is the same size, so there is nothing to gain from doing
+	// anything other than replacing them one by one.
+	replaceEachImage(this, pixels, masks);
+	return;
+}
+
 } // namespace gamegraphics
 } // namespace camoto
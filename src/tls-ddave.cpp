@@ -26,6 +26,7 @@
 #include "filter-pad.hpp"
 #include "img-ega-rowplanar.hpp"
 #include "tls-ddave.hpp"
+#include "instrument.hpp"
 #include "img-ddave.hpp"
 #include "pal-vga-raw.hpp"
 
@@ -150,6 +151,7 @@ TilesetPtr TilesetType_DDaveCGA::create(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::CGA, pal));
 }
@@ -163,6 +165,7 @@ TilesetPtr TilesetType_DDaveCGA::open(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::CGA, pal));
 }
@@ -194,6 +197,7 @@ TilesetPtr TilesetType_DDaveEGA::create(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::EGA, PaletteTablePtr()));
 }
@@ -205,6 +209,7 @@ TilesetPtr TilesetType_DDaveEGA::open(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::EGA, PaletteTablePtr()));
 }
@@ -243,6 +248,7 @@ TilesetPtr TilesetType_DDaveVGA::create(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::VGA, pal));
 }
@@ -261,6 +267,7 @@ TilesetPtr TilesetType_DDaveVGA::open(stream::inout_sptr psTileset,
 	filter_sptr filtWrite(new filter_pad(std::string("\x00", 1), DD_PAD_BLOCK));
 	stream::filtered_sptr decoded(new stream::filtered());
 	decoded->open(psTileset, filtRead, filtWrite, NULL);
+	countFilterPass();
 
 	return TilesetPtr(new Tileset_DDave(decoded, Tileset_DDave::VGA, pal));
 }
@@ -74,7 +74,7 @@ int Tileset_EGAApogee::getCaps()
 		| (this->pal ? Tileset::HasPalette : 0);
 }
 
-void Tileset_EGAApogee::resize(EntryPtr& id, stream::len newSize)
+void Tileset_EGAApogee::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != this->tileWidth / 8 * this->tileHeight * this->numPlanes) {
 		throw stream::error("tiles in this tileset are a fixed size");
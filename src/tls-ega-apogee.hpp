@@ -43,7 +43,7 @@ class Tileset_EGAApogee: virtual public Tileset_FAT
 		virtual ~Tileset_EGAApogee();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual void getTilesetDimensions(unsigned int *width, unsigned int *height);
 		virtual unsigned int getLayoutWidth();
 		virtual PaletteTablePtr getPalette();
@@ -22,6 +22,7 @@
  */
 
 #include <camoto/iostream_helpers.hpp>
+#include <camoto/gamegraphics/palettematch.hpp>
 #include "img-ega-byteplanar.hpp"
 #include "pal-vga-raw.hpp"
 #include "tls-jill.hpp"
@@ -44,6 +45,26 @@ namespace gamegraphics {
 
 #define BYTE_OFFSET 16  ///< 16 == VGA, 8 == EGA, 0 == CGA
 
+/// Replace every byte in a buffer with its entry in a 256-byte lookup table.
+static void applyColourMap(uint8_t *data, unsigned long len,
+	const uint8_t *map)
+{
+	unsigned long i = 0;
+	// Unrolled so the independent lookups can be overlapped
+	for (; i + 4 <= len; i += 4) {
+		uint8_t a = map[data[i]];
+		uint8_t b = map[data[i + 1]];
+		uint8_t c = map[data[i + 2]];
+		uint8_t d = map[data[i + 3]];
+		data[i] = a;
+		data[i + 1] = b;
+		data[i + 2] = c;
+		data[i + 3] = d;
+	}
+	for (; i < len; i++) data[i] = map[data[i]];
+	return;
+}
+
 //
 // TilesetType_Jill
 //
@@ -187,7 +208,7 @@ TilesetPtr Tileset_Jill::createTilesetInstance(const EntryPtr& id,
 	assert((id->getAttr() & Tileset::EmptySlot) == 0);
 
 	//stream::sub_sptr sub = boost::dynamic_pointer_cast<stream::sub>(content);
-	return TilesetPtr(new Tileset_JillSub(content));
+	return TilesetPtr(new Tileset_JillSub(content, this->pal));
 }
 
 void Tileset_Jill::updateFileOffset(const FATEntry *pid, stream::len offDelta)
@@ -209,7 +230,8 @@ void Tileset_Jill::updateFileSize(const FATEntry *pid, stream::len sizeDelta)
 // Tileset_JillSub
 //
 
-Tileset_JillSub::Tileset_JillSub(stream::inout_sptr data)
+Tileset_JillSub::Tileset_JillSub(stream::inout_sptr data,
+	PaletteTablePtr pal)
 	:	Tileset_FAT(data, JILL_FIRST_TILE_OFFSET)
 {
 	uint8_t numImages;
@@ -228,22 +250,20 @@ Tileset_JillSub::Tileset_JillSub(stream::inout_sptr data)
 		>> u16le(flags)
 	;
 
+	// Both maps always have 256 entries, so any pixel value can be looked up
+	// without a range check.  Values past the end of the file's colour map are
+	// left unchanged.
+	this->colourMap.reset(new uint8_t[256]);
+	for (int i = 0; i < 256; i++) this->colourMap[i] = i;
+
 	unsigned int offset = 12;
+	int lenColourMap = (bppColourMap >= 8) ? 256 : (1 << bppColourMap);
 	if (flags & JILL_F_FONT) {
-		// Predefined colour map
-		int lenColourMap = 1 << bppColourMap;
-		this->colourMap.reset(new uint8_t[lenColourMap]);
-		for (int i = 0; i < lenColourMap; i++) this->colourMap[i] = i;
-
+		// Predefined colour map, identity
 	} else if (bppColourMap == 8) {
-		// Predefined colour map
-		this->colourMap.reset(new uint8_t[256]);
-		for (int i = 0; i < 256; i++) this->colourMap[i] = i;
-
+		// Predefined colour map, identity
 	} else {
 		// Read the colour map
-		int lenColourMap = 1 << bppColourMap;
-		this->colourMap.reset(new uint8_t[lenColourMap]);
 		for (int i = 0; i < lenColourMap; i++) {
 			uint32_t value;
 			this->data >> u32le(value);
@@ -252,6 +272,37 @@ Tileset_JillSub::Tileset_JillSub(stream::inout_sptr data)
 		offset += lenColourMap * 4;
 	}
 
+	// Build the inverse map.  Colours in the map go back to the lowest pixel
+	// value that produces them, and any other colour goes to the pixel value
+	// whose colour is closest.
+	this->colourMapInv.reset(new uint8_t[256]);
+	if (!pal) pal = createPalette_DefaultVGA();
+	PaletteTable mapPal(lenColourMap);
+	for (int i = 0; i < lenColourMap; i++) {
+		unsigned int c = this->colourMap[i];
+		if (c < pal->size()) mapPal[i] = (*pal)[c];
+		else mapPal[i].red = mapPal[i].green = mapPal[i].blue = 0;
+		mapPal[i].alpha = 255;
+	}
+	PaletteMatcher matcher(mapPal);
+	for (int v = 0; v < 256; v++) {
+		int f;
+		for (f = 0; f < lenColourMap; f++) {
+			if (this->colourMap[f] == v) break;
+		}
+		if (f == lenColourMap) {
+			if ((unsigned int)v < pal->size()) {
+				const PaletteEntry& p = (*pal)[v];
+				f = matcher.nearest(p.red, p.green, p.blue);
+			} else if (lenColourMap == 256) {
+				f = v;
+			} else {
+				f = 0;
+			}
+		}
+		this->colourMapInv[v] = f;
+	}
+
 	this->items.reserve(numImages);
 	for (int i = 0; i < numImages; i++) {
 		uint8_t width, height;
@@ -302,7 +353,8 @@ ImagePtr Tileset_JillSub::createImageInstance(const EntryPtr& id,
 			return ImagePtr(new Palette_VGA(sub, 6));
 		}
 	}
-	return ImagePtr(new Image_Jill(content, this->colourMap));
+	return ImagePtr(new Image_Jill(content, this->colourMap,
+		this->colourMapInv));
 }
 
 Tileset_JillSub::FATEntry *Tileset_JillSub::preInsertFile(
@@ -332,9 +384,11 @@ void Tileset_JillSub::postRemoveFile(const FATEntry *pid)
 // Image_Jill
 //
 
-Image_Jill::Image_Jill(stream::inout_sptr data, const StdImageDataPtr colourMap)
+Image_Jill::Image_Jill(stream::inout_sptr data,
+	const StdImageDataPtr colourMap, const StdImageDataPtr colourMapInv)
 	:	Image_VGA(data, 3), // 3 == skip width/height/flag fields
-		colourMap(colourMap)
+		colourMap(colourMap),
+		colourMapInv(colourMapInv)
 {
 	this->data->seekg(0, stream::start);
 	data >> u8(this->width) >> u8(this->height);
@@ -377,13 +431,8 @@ StdImageDataPtr Image_Jill::toStandard()
 {
 	StdImageDataPtr img = this->Image_VGA::toStandard();
 
-	uint8_t *p = img.get();
-
 	// Apply the colour map
-	for (int i = 0; i < this->width * this->height; i++) {
-		*p = this->colourMap[*p];
-		p++;
-	}
+	applyColourMap(img.get(), this->width * this->height, this->colourMap.get());
 
 	return img;
 }
@@ -392,29 +441,19 @@ void Image_Jill::fromStandard(StdImageDataPtr newContent,
 	StdImageDataPtr newMask
 )
 {
-	std::cerr << "ERROR: Cannot overwrite Jill images yet (no colourmap handling)" << std::endl;
+	// Map the colours back to what the file stores, in a copy so the caller's
+	// data isn't changed
+	unsigned long dataSize = this->width * this->height;
+	StdImageDataPtr mapped(new uint8_t[dataSize]);
+	memcpy(mapped.get(), newContent.get(), dataSize);
+	applyColourMap(mapped.get(), dataSize, this->colourMapInv.get());
 
-	this->Image_VGA::fromStandard(newContent, newMask);
+	this->Image_VGA::fromStandard(mapped, newMask);
 
 	// Update dimensions
 	this->data->seekp(0, stream::start);
 	this->data << u8(this->width) << u8(this->height);
 
-	uint8_t *img = new uint8_t[this->width * this->height];
-	boost::shared_array<uint8_t> pimg(img);
-	this->data->seekg(3, stream::start);
-	this->data->read(img, this->width * this->height);
-
-	// Apply the colour map
-	uint8_t *p = img;
-	for (int i = 0; i < this->width * this->height; i++) {
-		*p = this->colourMap[*p];
-		p++;
-	}
-
-	this->data->seekp(3, stream::start);
-	this->data->write(img, this->width * this->height);
-
 	return;
 }
 
@@ -68,7 +68,17 @@ class Tileset_Jill: virtual public Tileset_FAT
 class Tileset_JillSub: virtual public Tileset_FAT
 {
 	public:
-		Tileset_JillSub(stream::inout_sptr data);
+		/// Constructor
+		/**
+		 * @param data
+		 *   Sub-tileset content.
+		 *
+		 * @param pal
+		 *   Palette from the parent tileset, used to pick the closest colour
+		 *   when writing pixels that aren't in the colour map.  If this is a
+		 *   null pointer the default VGA palette is used.
+		 */
+		Tileset_JillSub(stream::inout_sptr data, PaletteTablePtr pal);
 		virtual ~Tileset_JillSub();
 
 		virtual int getCaps();
@@ -81,7 +91,8 @@ class Tileset_JillSub: virtual public Tileset_FAT
 		virtual void postRemoveFile(const FATEntry *pid);
 
 	protected:
-		StdImageDataPtr colourMap;
+		StdImageDataPtr colourMap;    ///< 256 entries, file pixel to VGA index
+		StdImageDataPtr colourMapInv; ///< 256 entries, VGA index to file pixel
 };
 
 /// Image implementation for a Jill of the Jungle tile.
@@ -96,9 +107,15 @@ class Image_Jill: virtual public Image_VGA
 		 *   Image data, including width/height header.
 		 *
 		 * @param colourMap
-		 *   Colour mapping table (not a palette) from the parent tileset.
+		 *   Colour mapping table (not a palette) from the parent tileset.  256
+		 *   entries, mapping pixel values in the file to VGA palette indices.
+		 *
+		 * @param colourMapInv
+		 *   Inverse of colourMap, 256 entries mapping VGA palette indices to the
+		 *   closest pixel value the file can store.
 		 */
-		Image_Jill(stream::inout_sptr data, const StdImageDataPtr colourMap);
+		Image_Jill(stream::inout_sptr data, const StdImageDataPtr colourMap,
+			const StdImageDataPtr colourMapInv);
 		virtual ~Image_Jill();
 
 		virtual int getCaps();
@@ -112,6 +129,7 @@ class Image_Jill: virtual public Image_VGA
 		uint8_t width;
 		uint8_t height;
 		const StdImageDataPtr colourMap;
+		const StdImageDataPtr colourMapInv;
 };
 
 
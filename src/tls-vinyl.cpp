@@ -52,6 +52,21 @@
 namespace camoto {
 namespace gamegraphics {
 
+/// Get the length of a tile's codes, not including the embedded FAT.
+/**
+ * Tiles with any visible pixel need a mask byte for every four pixels.
+ *
+ * @param newMask
+ *   Mask for the tile, in the standard format.
+ */
+static unsigned int encodedTileLength(StdImageDataPtr newMask)
+{
+	for (unsigned int i = 0; i < VGFM_TILE_WIDTH * VGFM_TILE_HEIGHT; i++) {
+		if (newMask[i] != 0x01) return 0xC0;
+	}
+	return 0x80;
+}
+
 /// Image implementation for tiles within a VGFM tileset.
 class Image_VGFMTile: virtual public Image_Base
 {
@@ -66,6 +81,8 @@ class Image_VGFMTile: virtual public Image_Base
 		virtual StdImageDataPtr toStandardMask();
 		virtual void fromStandard(StdImageDataPtr newContent,
 			StdImageDataPtr newMask);
+		virtual bool getEncodedSize(StdImageDataPtr newContent,
+			StdImageDataPtr newMask, stream::len *size);
 		virtual PaletteTablePtr getPalette();
 
 	protected:
@@ -117,6 +134,13 @@ void Image_VGFMTile::fromStandard(StdImageDataPtr newContent,
 	return;
 }
 
+bool Image_VGFMTile::getEncodedSize(StdImageDataPtr newContent,
+	StdImageDataPtr newMask, stream::len *size)
+{
+	*size = encodedTileLength(newMask);
+	return true;
+}
+
 PaletteTablePtr Image_VGFMTile::getPalette()
 {
 	return this->pal;
@@ -457,6 +481,12 @@ void Tileset_Vinyl::postRemoveFile(const FATEntry *pid)
 	return;
 }
 
+bool Tileset_Vinyl::canEncodeSeparately() const
+{
+	// Tiles are encoded into the pixel array shared by the whole tileset
+	return false;
+}
+
 StdImageDataPtr Tileset_Vinyl::toStandard(unsigned int index)
 {
 	FATEntry *fatEntry = dynamic_cast<FATEntry *>(this->items[index].get());
@@ -529,14 +559,8 @@ void Tileset_Vinyl::fromStandard(unsigned int index, StdImageDataPtr newContent,
 	FATEntry *fatEntry = dynamic_cast<FATEntry *>(this->items[index].get());
 	assert(fatEntry);
 
-	bool hasMask = false;
-	for (unsigned int i = 0; i < VGFM_TILE_WIDTH * VGFM_TILE_HEIGHT; i++) {
-		if (newMask[i] != 0x01) {
-			hasMask = true;
-			break;
-		}
-	}
-	unsigned int len = hasMask ? 0xC0 : 0x80;
+	unsigned int len = encodedTileLength(newMask);
+	bool hasMask = len == 0xC0;
 	// Don't include the embedded FAT here as that is added to the requested
 	// length internally.
 	this->resize(this->items[index], len);
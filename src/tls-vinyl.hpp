@@ -61,6 +61,7 @@ class Tileset_Vinyl: virtual public Tileset_FAT
 			FATEntry *pNewEntry);
 		virtual void postInsertFile(FATEntry *pNewEntry);
 		virtual void postRemoveFile(const FATEntry *pid);
+		virtual bool canEncodeSeparately() const;
 
 		// Called by Image_VGFMTile
 		virtual StdImageDataPtr toStandard(unsigned int index);
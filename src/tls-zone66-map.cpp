@@ -164,7 +164,7 @@ int Tileset_Zone66Map::getCaps()
 		| (this->pal ? Tileset::HasPalette : 0);
 }
 
-void Tileset_Zone66Map::resize(EntryPtr& id, stream::len newSize)
+void Tileset_Zone66Map::checkNewSize(const FATEntry *pid, stream::len newSize)
 {
 	if (newSize != Z66_TILE_SIZE) {
 		throw stream::error("Zone 66 map tiles are a fixed size");
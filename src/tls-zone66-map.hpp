@@ -55,7 +55,7 @@ class Tileset_Zone66Map: virtual public Tileset_FAT
 		virtual ~Tileset_Zone66Map();
 
 		virtual int getCaps();
-		void resize(EntryPtr& id, stream::len newSize);
+		virtual void checkNewSize(const FATEntry *pid, stream::len newSize);
 		virtual void getTilesetDimensions(unsigned int *width, unsigned int *height);
 		virtual unsigned int getLayoutWidth();
 		virtual PaletteTablePtr getPalette();
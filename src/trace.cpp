@@ -0,0 +1,169 @@
+/**
+ * @file  trace.cpp
+ * @brief Timeline output in Chrome trace-event format.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <camoto/stream_file.hpp>
+#include <camoto/gamegraphics/trace.hpp>
+
+namespace camoto {
+namespace gamegraphics {
+
+/// Is a trace being written?  Checked without the lock by every span.
+static boost::atomic<bool> tracing(false);
+
+/// Protects everything below.
+static boost::mutex traceMutex;
+
+/// File the events are being written to.
+static std::ofstream *traceFile = NULL;
+
+/// Time the trace was started, all timestamps are relative to this.
+static boost::posix_time::ptime traceStart;
+
+/// Has at least one event been written?  Controls the comma separator.
+static bool traceHasEvents = false;
+
+/// Small sequential numbers for each thread, which read better in viewers.
+typedef std::map<boost::thread::id, unsigned int> ThreadIDMap;
+static ThreadIDMap threadIDs;
+
+/// Microseconds since the trace started.
+static double traceNow()
+{
+	return (boost::posix_time::microsec_clock::universal_time() - traceStart)
+		.total_microseconds();
+}
+
+/// Write a string as a quoted JSON value.
+static void writeJSONString(std::ostream& out, const char *s)
+{
+	out << '"';
+	for (; *s; s++) {
+		switch (*s) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			default:
+				if ((unsigned char)*s >= 0x20) out << *s;
+				break;
+		}
+	}
+	out << '"';
+	return;
+}
+
+/// Close the trace on exit so the file is always complete.
+static void stopTraceAtExit()
+{
+	stopTrace();
+	return;
+}
+
+void startTrace(const std::string& filename)
+{
+	stopTrace();
+
+	boost::mutex::scoped_lock lock(traceMutex);
+	std::ofstream *f = new std::ofstream(filename.c_str(),
+		std::ios::out | std::ios::trunc);
+	if (!f->is_open()) {
+		delete f;
+		throw stream::open_error("unable to create trace file " + filename);
+	}
+	static bool registered = false;
+	if (!registered) {
+		std::atexit(stopTraceAtExit);
+		registered = true;
+	}
+
+	traceFile = f;
+	traceStart = boost::posix_time::microsec_clock::universal_time();
+	traceHasEvents = false;
+	threadIDs.clear();
+	*traceFile << "{\"traceEvents\": [\n";
+	tracing = true;
+	return;
+}
+
+void stopTrace()
+{
+	boost::mutex::scoped_lock lock(traceMutex);
+	if (!traceFile) return;
+	tracing = false;
+	*traceFile << "\n], \"displayTimeUnit\": \"ms\"}\n";
+	delete traceFile;
+	traceFile = NULL;
+	return;
+}
+
+bool isTracing()
+{
+	return tracing;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *detail)
+	:	name(NULL),
+		detail(detail),
+		start(0)
+{
+	if (!tracing) return;
+	this->name = name;
+	this->start = traceNow();
+}
+
+TraceSpan::~TraceSpan()
+{
+	if (!this->name) return;
+	double end = traceNow();
+
+	boost::mutex::scoped_lock lock(traceMutex);
+	// Tracing may have been stopped while this span was open
+	if (!traceFile) return;
+
+	boost::thread::id self = boost::this_thread::get_id();
+	ThreadIDMap::iterator t = threadIDs.find(self);
+	if (t == threadIDs.end()) {
+		t = threadIDs.insert(std::make_pair(self, threadIDs.size() + 1)).first;
+	}
+
+	std::ostream& out = *traceFile;
+	if (traceHasEvents) out << ",\n";
+	traceHasEvents = true;
+	out << "{\"name\": ";
+	writeJSONString(out, this->name);
+	out << ", \"cat\": \"gamegraphics\", \"ph\": \"X\", \"pid\": 1"
+		<< ", \"tid\": " << t->second
+		<< ", \"ts\": " << (unsigned long long)this->start
+		<< ", \"dur\": " << (unsigned long long)(end - this->start);
+	if (this->detail) {
+		out << ", \"args\": {\"detail\": ";
+		writeJSONString(out, this->detail);
+		out << "}";
+	}
+	out << "}";
+}
+
+} // namespace gamegraphics
+} // namespace camoto
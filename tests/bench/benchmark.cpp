@@ -0,0 +1,575 @@
+/**
+ * @file  benchmark.cpp
+ * @brief Throughput benchmark for every image and tileset format.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/program_options.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/bind.hpp>
+#include <camoto/gamegraphics.hpp>
+#include <camoto/stream_string.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+namespace po = boost::program_options;
+namespace pt = boost::posix_time;
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+#define PROGNAME "benchmark"
+
+/*** Return values ***/
+// All is good
+#define RET_OK                 0
+// Bad arguments (missing/invalid parameters)
+#define RET_BADARGS            1
+// Couldn't write the results
+#define RET_SHOWSTOPPER        2
+// At least one format could not be benchmarked and --strict was given
+#define RET_FORMATERROR        3
+
+/// Settings shared by every measurement.
+struct BenchSettings {
+	unsigned int width;      ///< Size of standalone images, if they can be resized
+	unsigned int height;
+	unsigned int tileWidth;  ///< Size of tiles, if the tileset can be resized
+	unsigned int tileHeight;
+	unsigned int numTiles;   ///< Number of tiles to insert into each tileset
+	double minTime;          ///< Seconds to repeat each operation for
+};
+
+/// Result of timing one operation.
+struct BenchResult {
+	unsigned long iterations; ///< Number of times the operation was run
+	double seconds;           ///< Total time taken by all iterations
+	unsigned long bytes;      ///< Bytes of standard image data per iteration
+	unsigned long tiles;      ///< Number of tiles per iteration, or 0
+};
+
+/// Everything measured for one format.
+struct FormatResult {
+	/// Details about the synthetic input, such as its dimensions.
+	std::vector< std::pair<std::string, unsigned long> > info;
+
+	/// Timings for each operation that completed, in the order they ran.
+	std::vector< std::pair<std::string, BenchResult> > results;
+
+	/// Add a timing result.
+	void add(const std::string& name, const BenchResult& r)
+	{
+		this->results.push_back(std::make_pair(name, r));
+		return;
+	}
+};
+
+/// Quote a string for inclusion in the JSON output.
+std::string jsonString(const std::string& s)
+{
+	std::ostringstream out;
+	out << '"';
+	for (std::string::const_iterator i = s.begin(); i != s.end(); i++) {
+		switch (*i) {
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if ((unsigned char)*i < 0x20) {
+					out << "\\u00" << std::hex << ((*i >> 4) & 0xF) << (*i & 0xF)
+						<< std::dec;
+				} else {
+					out << *i;
+				}
+				break;
+		}
+	}
+	out << '"';
+	return out.str();
+}
+
+/// Run an operation repeatedly until the minimum time has elapsed.
+/**
+ * @param op
+ *   Operation to time.
+ *
+ * @param bytes
+ *   Amount of standard image data handled by each call to op, used to
+ *   calculate MB/s.
+ *
+ * @param tiles
+ *   Number of tiles handled by each call to op, or 0 if tiles/s is not
+ *   meaningful.
+ *
+ * @param minTime
+ *   Keep repeating op until at least this many seconds have passed.
+ */
+BenchResult measure(boost::function<void()> op, unsigned long bytes,
+	unsigned long tiles, double minTime)
+{
+	BenchResult r;
+	r.iterations = 0;
+	r.bytes = bytes;
+	r.tiles = tiles;
+	pt::ptime start = pt::microsec_clock::universal_time();
+	do {
+		op();
+		r.iterations++;
+		r.seconds = (pt::microsec_clock::universal_time() - start)
+			.total_microseconds() / 1000000.0;
+	} while (r.seconds < minTime);
+	return r;
+}
+
+/// Write a timing result as a JSON object.
+void writeResult(std::ostream& out, const std::string& name,
+	const BenchResult& r)
+{
+	double seconds = r.seconds > 0 ? r.seconds : 1e-9;
+	double perSec = r.iterations / seconds;
+	out << "\t\t\t\t" << jsonString(name) << ": {"
+		<< "\"iterations\": " << r.iterations
+		<< ", \"seconds\": " << r.seconds
+		<< ", \"ops_per_sec\": " << perSec
+		<< ", \"mb_per_sec\": " << perSec * r.bytes / (1024.0 * 1024.0);
+	if (r.tiles) {
+		out << ", \"tiles_per_sec\": " << perSec * r.tiles;
+	}
+	out << "}";
+	return;
+}
+
+/// Create a PCX image holding the default VGA palette.
+stream::string_sptr createPalettePCX()
+{
+	stream::string_sptr pcx(new stream::string());
+	ImageTypePtr type = getManager()->getImageTypeByCode("img-pcx-8b1p");
+	if (!type) throw stream::error("PCX support is missing");
+	SuppData none;
+	ImagePtr img = type->create(pcx, none);
+	img->setDimensions(1, 1);
+	img->setPalette(createPalette_DefaultVGA());
+	StdImageDataPtr pixel(new uint8_t[1]), mask(new uint8_t[1]);
+	pixel[0] = 0;
+	mask[0] = 0;
+	img->fromStandard(pixel, mask);
+	return pcx;
+}
+
+/// Create a valid, empty supplementary file for each one the format needs.
+/**
+ * Palettes are filled with a greyscale ramp in whichever container the
+ * filename suggests (a raw 6-bit VGA palette unless it is a .pcx or Halloween
+ * Harry .gmf file), and FAT files hold an empty list, so that formats which
+ * can't be created without them are still benchmarked.
+ */
+SuppData createSupps(const SuppFilenames& names)
+{
+	// 6-bit values, so the same data is valid at 6 and 8 bits per channel
+	std::string vgaPal(768, '\0');
+	for (unsigned int i = 0; i < 768; i++) vgaPal[i] = (char)((i / 3) >> 2);
+
+	SuppData supps;
+	for (SuppFilenames::const_iterator i = names.begin(); i != names.end(); i++) {
+		std::string ext;
+		std::string::size_type dot = i->second.find_last_of('.');
+		if (dot != std::string::npos) ext = i->second.substr(dot + 1);
+
+		stream::string_sptr supp;
+		switch (i->first) {
+			case SuppItem::Palette:
+				if (ext.compare("pcx") == 0) {
+					supp = createPalettePCX();
+				} else if (ext.compare("gmf") == 0) {
+					supp.reset(new stream::string());
+					supp->write(std::string("\x11SubZero Game File", 0x12));
+					supp->write(std::string(0x1D - 0x12, '\0'));
+					supp->write(vgaPal);
+				} else {
+					supp.reset(new stream::string());
+					supp->write(vgaPal);
+				}
+				break;
+			case SuppItem::FAT:
+				// A count of zero entries
+				supp.reset(new stream::string());
+				supp->write(std::string(2, '\0'));
+				break;
+			default:
+				supp.reset(new stream::string());
+				break;
+		}
+		supp->seekp(0, stream::start);
+		supps[i->first] = supp;
+	}
+	return supps;
+}
+
+/// Generate repeatable pseudorandom pixels valid for the given colour depth.
+void fillSynthetic(int caps, unsigned long len, StdImageDataPtr *pixels,
+	StdImageDataPtr *mask)
+{
+	uint8_t colourMask;
+	switch (caps & Image::ColourDepthMask) {
+		case Image::ColourDepthEGA: colourMask = 0x0F; break;
+		case Image::ColourDepthCGA: colourMask = 0x03; break;
+		case Image::ColourDepthMono: colourMask = 0x01; break;
+		default: colourMask = 0xFF; break;
+	}
+	uint8_t *p = new uint8_t[len];
+	uint8_t *m = new uint8_t[len];
+	pixels->reset(p);
+	mask->reset(m);
+	uint32_t seed = 0x12345678;
+	for (unsigned long i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		p[i] = (seed >> 16) & colourMask;
+		m[i] = (seed >> 28) & (Image::Mask_Visibility | Image::Mask_Hitmap);
+	}
+	return;
+}
+
+/// Time every image operation for one format.
+void benchImage(FormatResult *fr, ImageTypePtr type,
+	const BenchSettings& settings)
+{
+	stream::string_sptr base(new stream::string());
+	SuppData supps = createSupps(type->getRequiredSupps("bench.dat"));
+
+	// Create a synthetic image in this format
+	ImagePtr img = type->create(base, supps);
+	if (img->getCaps() & Image::CanSetDimensions) {
+		img->setDimensions(settings.width, settings.height);
+	}
+	unsigned int width, height;
+	img->getDimensions(&width, &height);
+	unsigned long len = width * height;
+	if (len == 0) throw stream::error("image has no size");
+
+	StdImageDataPtr pixels, mask;
+	fillSynthetic(img->getCaps(), len, &pixels, &mask);
+
+	fr->info.push_back(std::make_pair("width", width));
+	fr->info.push_back(std::make_pair("height", height));
+
+	fr->add("fromStandard", measure(
+		boost::bind(&Image::fromStandard, img, pixels, mask),
+		len, 0, settings.minTime));
+
+	fr->add("open", measure(
+		boost::bind(&ImageType::open, type, base, boost::ref(supps)),
+		len, 0, settings.minTime));
+
+	ImagePtr opened = type->open(base, supps);
+	fr->add("toStandard", measure(
+		boost::bind(&Image::toStandard, opened),
+		len, 0, settings.minTime));
+
+	fr->add("toStandardMask", measure(
+		boost::bind(&Image::toStandardMask, opened),
+		len, 0, settings.minTime));
+
+	fr->add("isInstance", measure(
+		boost::bind(&ImageType::isInstance, type, base),
+		len, 0, settings.minTime));
+	return;
+}
+
+/// Write the same content to every image in a list.
+void writeAll(const std::vector<ImagePtr>& images, StdImageDataPtr pixels,
+	StdImageDataPtr mask)
+{
+	for (std::vector<ImagePtr>::const_iterator
+		i = images.begin(); i != images.end(); i++
+	) {
+		(*i)->fromStandard(pixels, mask);
+	}
+	return;
+}
+
+/// Convert every image in a list to standard format.
+void readAll(const std::vector<ImagePtr>& images, bool mask)
+{
+	for (std::vector<ImagePtr>::const_iterator
+		i = images.begin(); i != images.end(); i++
+	) {
+		if (mask) (*i)->toStandardMask();
+		else (*i)->toStandard();
+	}
+	return;
+}
+
+/// Open every top-level image in a tileset.
+/**
+ * @return Number of pixels in each tile, which are all assumed to be the same
+ *   size as the first.
+ */
+unsigned long openAll(TilesetPtr tileset, std::vector<ImagePtr> *images,
+	const BenchSettings& settings)
+{
+	unsigned long len = 0;
+	const Tileset::VC_ENTRYPTR& items = tileset->getItems();
+	for (Tileset::VC_ENTRYPTR::const_iterator
+		i = items.begin(); i != items.end(); i++
+	) {
+		if ((*i)->getAttr() & (Tileset::EmptySlot | Tileset::SubTileset)) continue;
+		ImagePtr img = tileset->openImage(*i);
+		unsigned int width, height;
+		img->getDimensions(&width, &height);
+		if (((width == 0) || (height == 0))
+			&& (img->getCaps() & Image::CanSetDimensions)
+		) {
+			img->setDimensions(settings.tileWidth, settings.tileHeight);
+			img->getDimensions(&width, &height);
+		}
+		if (len == 0) len = width * height;
+		images->push_back(img);
+	}
+	return len;
+}
+
+/// Time every tileset operation for one format.
+void benchTileset(FormatResult *fr, TilesetTypePtr type,
+	const BenchSettings& settings)
+{
+	stream::string_sptr base(new stream::string());
+	SuppData supps = createSupps(type->getRequiredSupps("bench.dat"));
+
+	// Create a synthetic tileset in this format
+	TilesetPtr tileset = type->create(base, supps);
+	if (tileset->getCaps() & Tileset::ChangeDimensions) {
+		tileset->setTilesetDimensions(settings.tileWidth, settings.tileHeight);
+	}
+	for (unsigned int t = 0; t < settings.numTiles; t++) {
+		tileset->insert(Tileset::EntryPtr(), Tileset::Default);
+	}
+
+	std::vector<ImagePtr> images;
+	unsigned long len = openAll(tileset, &images, settings);
+	unsigned long numTiles = images.size();
+	if ((numTiles == 0) || (len == 0)) throw stream::error("tileset has no tiles");
+
+	StdImageDataPtr pixels, mask;
+	fillSynthetic(images[0]->getCaps(), len, &pixels, &mask);
+
+	fr->info.push_back(std::make_pair("tiles", numTiles));
+	fr->info.push_back(std::make_pair("tile_bytes", len));
+
+	fr->add("fromStandard", measure(
+		boost::bind(writeAll, boost::cref(images), pixels, mask),
+		len * numTiles, numTiles, settings.minTime));
+
+	fr->add("flush", measure(
+		boost::bind(&Tileset::flush, tileset),
+		len * numTiles, numTiles, settings.minTime));
+
+	// Make sure everything has been written before reopening
+	images.clear();
+	tileset->flush();
+
+	fr->add("open", measure(
+		boost::bind(&TilesetType::open, type, base, boost::ref(supps)),
+		len * numTiles, numTiles, settings.minTime));
+
+	TilesetPtr opened = type->open(base, supps);
+	openAll(opened, &images, settings);
+
+	fr->add("toStandard", measure(
+		boost::bind(readAll, boost::cref(images), false),
+		len * numTiles, numTiles, settings.minTime));
+
+	fr->add("toStandardMask", measure(
+		boost::bind(readAll, boost::cref(images), true),
+		len * numTiles, numTiles, settings.minTime));
+
+	fr->add("isInstance", measure(
+		boost::bind(&TilesetType::isInstance, type, base),
+		len * numTiles, numTiles, settings.minTime));
+	return;
+}
+
+/// Should this format be benchmarked?
+bool wanted(const std::string& code, const std::vector<std::string>& only)
+{
+	if (only.empty()) return true;
+	for (std::vector<std::string>::const_iterator
+		i = only.begin(); i != only.end(); i++
+	) {
+		if (code.compare(*i) == 0) return true;
+	}
+	return false;
+}
+
+/// Write everything measured for one format as a JSON object.
+/**
+ * @param error
+ *   Message from the exception that stopped the benchmark early, or an empty
+ *   string if every operation completed.
+ */
+void writeFormat(std::ostream& out, const std::string& code,
+	const FormatResult& fr, const std::string& error)
+{
+	out << "\t\t{\n\t\t\t\"code\": " << jsonString(code);
+	for (std::vector< std::pair<std::string, unsigned long> >::const_iterator
+		i = fr.info.begin(); i != fr.info.end(); i++
+	) {
+		out << ",\n\t\t\t" << jsonString(i->first) << ": " << i->second;
+	}
+	out << ",\n\t\t\t\"results\": {";
+	for (std::vector< std::pair<std::string, BenchResult> >::const_iterator
+		i = fr.results.begin(); i != fr.results.end(); i++
+	) {
+		if (i != fr.results.begin()) out << ",";
+		out << "\n";
+		writeResult(out, i->first, i->second);
+	}
+	out << "\n\t\t\t}";
+	if (!error.empty()) {
+		out << ",\n\t\t\t\"error\": " << jsonString(error);
+	}
+	out << "\n\t\t}";
+	return;
+}
+
+int main(int iArgC, char *cArgV[])
+{
+	BenchSettings settings;
+	std::string outFile;
+	std::vector<std::string> only;
+	bool strict = false;
+
+	po::options_description poOptions("Options");
+	poOptions.add_options()
+		("width", po::value<unsigned int>(&settings.width)->default_value(320),
+			"width of standalone images that can be resized")
+		("height", po::value<unsigned int>(&settings.height)->default_value(200),
+			"height of standalone images that can be resized")
+		("tile-width", po::value<unsigned int>(&settings.tileWidth)->default_value(16),
+			"width of tiles in tilesets that can be resized")
+		("tile-height", po::value<unsigned int>(&settings.tileHeight)->default_value(16),
+			"height of tiles in tilesets that can be resized")
+		("tiles,n", po::value<unsigned int>(&settings.numTiles)->default_value(64),
+			"number of tiles to add to each tileset")
+		("time,s", po::value<double>(&settings.minTime)->default_value(0.2),
+			"minimum number of seconds to repeat each operation for")
+		("type,t", po::value< std::vector<std::string> >(&only),
+			"only benchmark this format code (may be given more than once)")
+		("output,o", po::value<std::string>(&outFile),
+			"write the JSON results to this file instead of stdout")
+		("strict", po::bool_switch(&strict),
+			"fail if any format could not be benchmarked")
+		("help", "show this help")
+	;
+
+	po::variables_map mpArgs;
+	try {
+		po::store(po::parse_command_line(iArgC, cArgV, poOptions), mpArgs);
+		po::notify(mpArgs);
+	} catch (const po::error& e) {
+		std::cerr << PROGNAME ": " << e.what() << "\n";
+		return RET_BADARGS;
+	}
+	if (mpArgs.count("help")) {
+		std::cout << "Usage: " PROGNAME " [options]\n" << poOptions << std::endl;
+		return RET_OK;
+	}
+
+	std::ofstream outStream;
+	if (!outFile.empty()) {
+		outStream.open(outFile.c_str());
+		if (!outStream) {
+			std::cerr << PROGNAME ": unable to open " << outFile << "\n";
+			return RET_SHOWSTOPPER;
+		}
+	}
+	std::ostream& out = outFile.empty() ? std::cout : outStream;
+
+	ManagerPtr manager = getManager();
+
+	out << "{\n\t\"settings\": {"
+		<< "\"width\": " << settings.width
+		<< ", \"height\": " << settings.height
+		<< ", \"tile_width\": " << settings.tileWidth
+		<< ", \"tile_height\": " << settings.tileHeight
+		<< ", \"tiles\": " << settings.numTiles
+		<< ", \"min_time\": " << settings.minTime
+		<< "},\n\t\"images\": [\n";
+
+	// Formats that could not be measured
+	std::vector<std::string> failed;
+
+	bool first = true;
+	ImageTypePtr imageType;
+	for (unsigned int i = 0; (imageType = manager->getImageType(i)); i++) {
+		std::string code = imageType->getCode();
+		if (!wanted(code, only)) continue;
+		std::cerr << "Benchmarking " << code << std::endl;
+		FormatResult fr;
+		std::string error;
+		try {
+			benchImage(&fr, imageType, settings);
+		} catch (const std::exception& e) {
+			error = e.what();
+			std::cerr << "WARNING: " << code << " was not benchmarked: " << error
+				<< std::endl;
+			failed.push_back(code);
+		}
+		if (!first) out << ",\n";
+		first = false;
+		writeFormat(out, code, fr, error);
+	}
+
+	out << "\n\t],\n\t\"tilesets\": [\n";
+
+	first = true;
+	TilesetTypePtr tilesetType;
+	for (unsigned int i = 0; (tilesetType = manager->getTilesetType(i)); i++) {
+		std::string code = tilesetType->getCode();
+		if (!wanted(code, only)) continue;
+		std::cerr << "Benchmarking " << code << std::endl;
+		FormatResult fr;
+		std::string error;
+		try {
+			benchTileset(&fr, tilesetType, settings);
+		} catch (const std::exception& e) {
+			error = e.what();
+			std::cerr << "WARNING: " << code << " was not benchmarked: " << error
+				<< std::endl;
+			failed.push_back(code);
+		}
+		if (!first) out << ",\n";
+		first = false;
+		writeFormat(out, code, fr, error);
+	}
+
+	out << "\n\t]\n}\n";
+
+	if (!failed.empty()) {
+		std::cerr << "WARNING: " << failed.size() << " format(s) could not be"
+			" benchmarked:";
+		for (std::vector<std::string>::const_iterator
+			i = failed.begin(); i != failed.end(); i++
+		) {
+			std::cerr << " " << *i;
+		}
+		std::cerr << std::endl;
+		if (strict) return RET_FORMATERROR;
+	}
+	return RET_OK;
+}
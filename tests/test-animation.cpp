@@ -0,0 +1,199 @@
+/**
+ * @file  test-animation.cpp
+ * @brief Test code for playing back tilesets of animation frames.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "../src/img-vga-raw.hpp"
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Raw VGA image with a hotspot, which can be made to fail decoding.
+class SpriteImage: public Image_VGARaw
+{
+	public:
+		SpriteImage(stream::inout_sptr data, unsigned int width,
+			unsigned int height, signed int hotspot, bool broken)
+			:	Image_VGA(data, 0),
+				Image_VGARaw(data, width, height, createPalette_DefaultVGA()),
+				hotspot(hotspot),
+				broken(broken)
+		{
+		}
+
+		virtual int getCaps()
+		{
+			return this->Image_VGARaw::getCaps() | Image::HasHotspot;
+		}
+
+		virtual void getHotspot(signed int *x, signed int *y)
+		{
+			*x = this->hotspot;
+			*y = -this->hotspot;
+			return;
+		}
+
+		virtual StdImageDataPtr toStandard()
+		{
+			if (this->broken) throw stream::error("broken frame");
+			return this->Image_VGARaw::toStandard();
+		}
+
+	protected:
+		signed int hotspot;
+		bool broken;
+};
+
+/// Create a SpriteImage for addTile().
+static ImagePtr createSprite(stream::inout_sptr data, unsigned int width,
+	unsigned int height, signed int hotspot, bool broken)
+{
+	return ImagePtr(new SpriteImage(data, width, height, hotspot, broken));
+}
+
+/// Add a frame filled with one colour, which is also its hotspot.
+static void addFrame(TilesetFromImages_List *content, unsigned int width,
+	unsigned int height, uint8_t colour, bool broken)
+{
+	addTile(content, width, height, std::string(width * height, (char)colour),
+		boost::bind(createSprite, _1, _2, _3, colour, broken));
+	return;
+}
+
+struct animation_sample {
+	TilesetPtr frames;
+
+	animation_sample()
+	{
+		TilesetFromImages_List content;
+		addFrame(&content, 2, 2, 0x10, false);
+		addFrame(&content, 3, 1, 0x11, false);
+		TilesetFromImages_Item sub;
+		sub.isImage = false;
+		sub.tileset = createTilesetFromImages(content, 0);
+		content.push_back(sub);
+		addFrame(&content, 4, 4, 0x12, false);
+		this->frames = createTilesetFromImages(content, 0);
+	}
+
+	/// Check the frame at the playhead.
+	void checkFrame(AnimationPlayer& anim, unsigned int index,
+		unsigned int width, unsigned int height)
+	{
+		BOOST_REQUIRE_EQUAL(anim.getFrameIndex(), index);
+		const AnimationFrame& f = anim.getFrame();
+		BOOST_REQUIRE_EQUAL(f.index, index);
+		BOOST_REQUIRE_EQUAL(f.width, width);
+		BOOST_REQUIRE_EQUAL(f.height, height);
+		BOOST_REQUIRE(f.pixels);
+		BOOST_REQUIRE(f.mask);
+		for (unsigned int i = 0; i < width * height; i++) {
+			BOOST_REQUIRE_EQUAL((int)f.pixels[i], 0x10 + index);
+		}
+		BOOST_CHECK(f.hasHotspot);
+		BOOST_CHECK_EQUAL(f.hotspotX, (int)(0x10 + index));
+		BOOST_CHECK_EQUAL(f.hotspotY, -(int)(0x10 + index));
+		BOOST_CHECK(!f.hasHitRect);
+		return;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(animation, animation_sample)
+
+BOOST_AUTO_TEST_CASE(info)
+{
+	BOOST_TEST_MESSAGE("Read frame information without decoding");
+
+	AnimationPlayer anim(this->frames, 100, 2);
+	BOOST_REQUIRE_EQUAL(anim.getFrameCount(), 3);
+	BOOST_CHECK_EQUAL(anim.getDuration(), 300);
+	BOOST_CHECK(anim.getPalette());
+
+	const AnimationFrame& f = anim.getFrameInfo(2);
+	BOOST_CHECK_EQUAL(f.index, 2);
+	BOOST_CHECK_EQUAL(f.start, 200);
+	BOOST_CHECK_EQUAL(f.duration, 100);
+	BOOST_CHECK_EQUAL(f.width, 4);
+	BOOST_CHECK_EQUAL(f.hotspotX, 0x12);
+	BOOST_CHECK(!f.pixels);
+}
+
+BOOST_AUTO_TEST_CASE(play)
+{
+	BOOST_TEST_MESSAGE("Play every frame in order, looping at the end");
+
+	AnimationPlayer anim(this->frames, 100, 2);
+	for (int loop = 0; loop < 3; loop++) {
+		this->checkFrame(anim, 0, 2, 2);
+		anim.nextFrame();
+		this->checkFrame(anim, 1, 3, 1);
+		anim.nextFrame();
+		this->checkFrame(anim, 2, 4, 4);
+		anim.nextFrame();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(seek)
+{
+	BOOST_TEST_MESSAGE("Jump to a frame by number or time");
+
+	AnimationPlayer anim(this->frames, 100, 4);
+	anim.seekFrame(2);
+	this->checkFrame(anim, 2, 4, 4);
+	anim.seekFrame(1);
+	this->checkFrame(anim, 1, 3, 1);
+	anim.seekTime(50);
+	this->checkFrame(anim, 0, 2, 2);
+	anim.seekTime(250);
+	this->checkFrame(anim, 2, 4, 4);
+	anim.seekTime(3 * 300 + 150);
+	this->checkFrame(anim, 1, 3, 1);
+}
+
+BOOST_AUTO_TEST_CASE(decode_error)
+{
+	BOOST_TEST_MESSAGE("Report a frame that can't be decoded");
+
+	TilesetFromImages_List content;
+	addFrame(&content, 2, 2, 0x10, false);
+	addFrame(&content, 2, 2, 0x11, true);
+	AnimationPlayer anim(createTilesetFromImages(content, 0), 50, 2);
+	this->checkFrame(anim, 0, 2, 2);
+	anim.nextFrame();
+	BOOST_CHECK_THROW(anim.getFrame(), stream::error);
+	anim.nextFrame();
+	this->checkFrame(anim, 0, 2, 2);
+}
+
+BOOST_AUTO_TEST_CASE(no_frames)
+{
+	BOOST_TEST_MESSAGE("Handle an animation with no frames");
+
+	TilesetFromImages_List content;
+	AnimationPlayer anim(createTilesetFromImages(content, 0), 50, 2);
+	BOOST_CHECK_EQUAL(anim.getFrameCount(), 0);
+	BOOST_CHECK_EQUAL(anim.getDuration(), 0);
+	BOOST_CHECK_THROW(anim.getFrame(), stream::error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+/**
+ * @file  test-atlas.cpp
+ * @brief Test code for drawing a whole tileset into one image.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Add a slot that is not an image to a tileset list.
+static void addGap(TilesetFromImages_List *content)
+{
+	TilesetFromImages_Item item;
+	item.isImage = false;
+	content->push_back(item);
+	return;
+}
+
+/// Check that a tile was drawn where the atlas says it was.
+static void checkTile(const AtlasPtr& atlas, unsigned int index, uint8_t colour)
+{
+	const AtlasTile& t = atlas->tiles[index];
+	BOOST_REQUIRE(t.isImage);
+	BOOST_REQUIRE_LE(t.x + t.width, atlas->width);
+	BOOST_REQUIRE_LE(t.y + t.height, atlas->height);
+	for (unsigned int y = 0; y < t.height; y++) {
+		for (unsigned int x = 0; x < t.width; x++) {
+			unsigned long off = (t.y + y) * atlas->width + t.x + x;
+			BOOST_REQUIRE_EQUAL((int)atlas->pixels[off], (int)colour);
+			BOOST_REQUIRE_EQUAL((int)atlas->mask[off], 0);
+		}
+	}
+	return;
+}
+
+BOOST_AUTO_TEST_SUITE(atlas)
+
+BOOST_AUTO_TEST_CASE(grid)
+{
+	BOOST_TEST_MESSAGE("Lay out same-sized tiles as a grid");
+
+	TilesetFromImages_List content;
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+	addTile(&content, 2, 2, std::string(4, '\x02'));
+	addTile(&content, 2, 2, std::string(4, '\x03'));
+	TilesetPtr tileset(createTilesetFromImages(content, 2));
+
+	AtlasPtr atlas(createAtlas(tileset, 0));
+	BOOST_REQUIRE_EQUAL(atlas->width, 4);
+	BOOST_REQUIRE_EQUAL(atlas->height, 4);
+	BOOST_REQUIRE_EQUAL(atlas->tiles.size(), 3);
+
+	checkTile(atlas, 0, 1);
+	checkTile(atlas, 1, 2);
+	checkTile(atlas, 2, 3);
+	BOOST_CHECK_EQUAL(atlas->tiles[1].x, 2);
+	BOOST_CHECK_EQUAL(atlas->tiles[2].y, 2);
+
+	// Unused cell at the bottom right is transparent
+	BOOST_CHECK_EQUAL((int)atlas->mask[3 * 4 + 3], Image::Mask_Vis_Transparent);
+	BOOST_CHECK(atlas->palette);
+}
+
+BOOST_AUTO_TEST_CASE(grid_width_override)
+{
+	BOOST_TEST_MESSAGE("Lay out same-sized tiles with a given grid width");
+
+	TilesetFromImages_List content;
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+	addTile(&content, 2, 2, std::string(4, '\x02'));
+	addTile(&content, 2, 2, std::string(4, '\x03'));
+	TilesetPtr tileset(createTilesetFromImages(content, 2));
+
+	AtlasPtr atlas(createAtlas(tileset, 3));
+	BOOST_REQUIRE_EQUAL(atlas->width, 6);
+	BOOST_REQUIRE_EQUAL(atlas->height, 2);
+	checkTile(atlas, 2, 3);
+}
+
+BOOST_AUTO_TEST_CASE(gaps)
+{
+	BOOST_TEST_MESSAGE("Leave a gap for entries that aren't images");
+
+	TilesetFromImages_List content;
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+	addGap(&content);
+	addTile(&content, 2, 2, std::string(4, '\x03'));
+	TilesetPtr tileset(createTilesetFromImages(content, 3));
+
+	AtlasPtr atlas(createAtlas(tileset, 0));
+	BOOST_REQUIRE_EQUAL(atlas->width, 6);
+	BOOST_REQUIRE_EQUAL(atlas->height, 2);
+	BOOST_CHECK(!atlas->tiles[1].isImage);
+	checkTile(atlas, 0, 1);
+	checkTile(atlas, 2, 3);
+	BOOST_CHECK_EQUAL(atlas->tiles[2].x, 4);
+	BOOST_CHECK_EQUAL((int)atlas->mask[2], Image::Mask_Vis_Transparent);
+}
+
+BOOST_AUTO_TEST_CASE(packed)
+{
+	BOOST_TEST_MESSAGE("Pack tiles of different sizes without overlapping");
+
+	TilesetFromImages_List content;
+	addTile(&content, 4, 2, std::string(8, '\x01'));
+	addTile(&content, 2, 4, std::string(8, '\x02'));
+	addTile(&content, 3, 3, std::string(9, '\x03'));
+	addTile(&content, 1, 1, std::string(1, '\x04'));
+	TilesetPtr tileset(createTilesetFromImages(content, 0));
+
+	AtlasPtr atlas(createAtlas(tileset, 0));
+	BOOST_REQUIRE_EQUAL(atlas->tiles.size(), 4);
+
+	// Tiles were all different colours, so if any overlapped one would have
+	// been drawn over the other.
+	checkTile(atlas, 0, 1);
+	checkTile(atlas, 1, 2);
+	checkTile(atlas, 2, 3);
+	checkTile(atlas, 3, 4);
+
+	// Shouldn't waste more than half the area
+	BOOST_CHECK_LE(atlas->width * atlas->height, 2 * (8 + 8 + 9 + 1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,191 @@
+/**
+ * @file  test-imagecache.cpp
+ * @brief Test code for the process-wide cache of decoded images.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "../src/img-vga-raw.hpp"
+#include "../src/imagecache.hpp"
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+#define INST_CODE "img-cga-raw-linear-fullscreen"
+#define INST_SIZE 16000
+
+/// Raw VGA image counting how many times it has been decoded.
+class CountingImage: public Image_VGARaw
+{
+	public:
+		CountingImage(stream::inout_sptr data, unsigned int width,
+			unsigned int height, unsigned int *decodes)
+			:	Image_VGA(data, 0),
+				Image_VGARaw(data, width, height, createPalette_DefaultVGA()),
+				decodes(decodes)
+		{
+		}
+
+		virtual StdImageDataPtr toStandard()
+		{
+			(*this->decodes)++;
+			return this->Image_VGARaw::toStandard();
+		}
+
+	protected:
+		unsigned int *decodes;
+};
+
+struct imagecache_sample {
+	TilesetPtr tileset;
+	unsigned int decodes;
+
+	imagecache_sample()
+		:	decodes(0)
+	{
+		setImageCacheSize(1024);
+
+		TilesetFromImages_List content;
+		for (int i = 0; i < 3; i++) {
+			stream::string_sptr data(new stream::string());
+			data->write(std::string(64, (char)(0x10 + i)));
+			TilesetFromImages_Item item;
+			item.isImage = true;
+			item.image.reset(new CountingImage(data, 8, 8, &this->decodes));
+			content.push_back(item);
+		}
+		this->tileset = cacheTileset(createTilesetFromImages(content, 0));
+	}
+
+	~imagecache_sample()
+	{
+		setImageCacheSize(0);
+	}
+
+	/// Decode one tile through a newly opened Image instance.
+	StdImageDataPtr decode(unsigned int index)
+	{
+		return this->tileset->openImage(this->tileset->getItems()[index])
+			->toStandard();
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(imagecache, imagecache_sample)
+
+BOOST_AUTO_TEST_CASE(hit)
+{
+	BOOST_TEST_MESSAGE("Decode each image only once");
+
+	BOOST_CHECK_EQUAL((int)this->decode(1)[0], 0x11);
+	BOOST_CHECK_EQUAL((int)this->decode(1)[63], 0x11);
+	BOOST_CHECK_EQUAL(this->decodes, 1);
+	BOOST_CHECK_EQUAL(getImageCacheUsage(), 64);
+
+	this->decode(2);
+	BOOST_CHECK_EQUAL(this->decodes, 2);
+}
+
+BOOST_AUTO_TEST_CASE(copy)
+{
+	BOOST_TEST_MESSAGE("Changing a returned buffer doesn't change the cache");
+
+	StdImageDataPtr pixels = this->decode(0);
+	pixels[0] = 0x99;
+	BOOST_CHECK_EQUAL((int)this->decode(0)[0], 0x10);
+}
+
+BOOST_AUTO_TEST_CASE(invalidate)
+{
+	BOOST_TEST_MESSAGE("Decode again after the image has been changed");
+
+	this->decode(0);
+	this->decode(1);
+
+	ImagePtr img = this->tileset->openImage(this->tileset->getItems()[0]);
+	StdImageDataPtr pixels(new uint8_t[64]), mask(new uint8_t[64]);
+	memset(pixels.get(), 0x42, 64);
+	memset(mask.get(), 0, 64);
+	img->fromStandard(pixels, mask);
+
+	BOOST_CHECK_EQUAL((int)this->decode(0)[5], 0x42);
+	BOOST_CHECK_EQUAL(this->decodes, 3);
+
+	// Other entries are unaffected
+	this->decode(1);
+	BOOST_CHECK_EQUAL(this->decodes, 3);
+}
+
+BOOST_AUTO_TEST_CASE(evict)
+{
+	BOOST_TEST_MESSAGE("Drop the least recently used image once over budget");
+
+	setImageCacheSize(128);
+	this->decode(0);
+	this->decode(1);
+	this->decode(0);
+	this->decode(2); // evicts 1
+	BOOST_CHECK_EQUAL(this->decodes, 3);
+	BOOST_CHECK_EQUAL(getImageCacheUsage(), 128);
+
+	this->decode(0);
+	BOOST_CHECK_EQUAL(this->decodes, 3);
+	this->decode(1);
+	BOOST_CHECK_EQUAL(this->decodes, 4);
+
+	setImageCacheSize(64);
+	BOOST_CHECK_EQUAL(getImageCacheUsage(), 64);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_CASE(imagecache_manager)
+{
+	BOOST_TEST_MESSAGE("Cache images opened through the Manager");
+
+	ManagerPtr manager(getManager());
+	manager->resetStats();
+	manager->setInstrumentation(true);
+	manager->setImageCacheSize(1024 * 1024);
+
+	ImageTypePtr type(manager->getImageTypeByCode(INST_CODE));
+	BOOST_REQUIRE_MESSAGE(type, "Invalid image code " INST_CODE);
+
+	stream::string_sptr base(new stream::string());
+	base->write(std::string(INST_SIZE, '\x55'));
+	SuppData suppData;
+	ImagePtr img(type->open(base, suppData));
+
+	StdImageDataPtr pixels = img->toStandard();
+	img->toStandard();
+	img->toStandard();
+	BOOST_REQUIRE_EQUAL(manager->getStats().size(), 1);
+	BOOST_CHECK_EQUAL(manager->getStats()[0].toStandardCalls, 1);
+
+	img->fromStandard(pixels, img->toStandardMask());
+	img->toStandard();
+
+	manager->setImageCacheSize(0);
+	manager->setInstrumentation(false);
+
+	// One each for the first toStandard(), the mask, and after fromStandard()
+	BOOST_CHECK_EQUAL(manager->getStats()[0].toStandardCalls, 3);
+	manager->resetStats();
+}
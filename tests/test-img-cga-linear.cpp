@@ -0,0 +1,112 @@
+/**
+ * @file  test-img-cga-linear.cpp
+ * @brief Test code for linear (non-interlaced) CGA images.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <camoto/gamegraphics/image.hpp>
+#include "../src/img-cga.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+#define IMG_TYPE "img-cga-raw-linear-fullscreen"
+#define IMG_CLASS img_cga_linear
+#include "test-img-defines.hpp"
+
+// Fullscreen image
+ISINSTANCE_TEST(c00,
+	ZERO_8192 ZERO_4096 ZERO_2048 ZERO_1024 ZERO_512 ZERO_128
+	,
+	PossiblyYes
+);
+
+// Trailing data
+ISINSTANCE_TEST(c01,
+	ZERO_8192 ZERO_4096 ZERO_2048 ZERO_1024 ZERO_512 ZERO_128 ZERO_1
+	,
+	DefinitelyNo
+);
+
+#define TESTDATA_INITIAL_8x8 \
+	"\xFF\xFF\x00\x02\x00\x02\x00\x02" \
+	"\x00\x02\x00\x02\x00\x02\x15\x56"
+
+#define TESTDATA_INITIAL_16x16 \
+	"\xFF\xFF\xFF\xFF\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x00\x00\x00\x02" \
+	"\x00\x00\x00\x02\x15\x55\x55\x56"
+
+#define TESTDATA_INITIAL_9x9 \
+	"\xFF\xFF\xC0\x00\x20\x00\x08\x00" \
+	"\x02\x00\x00\x80\x00\x20\x00\x08" \
+	"\x00\x02\x15\x55\x80"
+
+#define TESTDATA_INITIAL_8x4 \
+	"\xFF\xFF\x00\x02\x00\x02\x15\x56"
+
+// Image_CGA is only exposed as a fullscreen type, so create it directly at the
+// size being tested.
+#define IMG_OPEN_CODE \
+	this->img = ImagePtr(new Image_CGA(this->base, 0, width, height, \
+		CGAPal_CyanMagentaBright, CGA_Linear));
+
+// Same code for creating empty images
+#define IMG_CREATE_CODE IMG_OPEN_CODE
+
+// Only the lower two bits of each pixel can be stored
+#define IMG_PIXEL_MASK 0x03
+
+#include "test-img.hpp"
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(fullscreen))
+{
+	BOOST_TEST_MESSAGE("Converting a fullscreen " TOSTRING(IMG_CLASS) " image");
+
+	ManagerPtr pManager(getManager());
+	ImageTypePtr pTestType(pManager->getImageTypeByCode(IMG_TYPE));
+	BOOST_REQUIRE_MESSAGE(pTestType, "Could not find image type " IMG_TYPE);
+
+	stream::string_sptr base(new stream::string());
+	SuppData suppData;
+	ImagePtr img = pTestType->create(base, suppData);
+
+	unsigned int width, height;
+	img->getDimensions(&width, &height);
+	BOOST_REQUIRE_EQUAL(width, 320);
+	BOOST_REQUIRE_EQUAL(height, 200);
+
+	// Runs of three pixels, so they do not line up with the packed bytes
+	StdImageDataPtr pixels(new uint8_t[320 * 200]);
+	for (unsigned int i = 0; i < 320 * 200; i++) pixels[i] = (i / 3) & 3;
+	StdImageDataPtr mask(new uint8_t[320 * 200]);
+	memset(mask.get(), 0, 320 * 200);
+	img->fromStandard(pixels, mask);
+
+	BOOST_REQUIRE_EQUAL(base->size(), 16000);
+
+	// The second row follows straight on from the first
+	BOOST_CHECK_EQUAL((int)(uint8_t)base->str()->at(80), 0xBF);
+
+	StdImageDataPtr output = pTestType->open(base, suppData)->toStandard();
+	BOOST_CHECK_EQUAL(memcmp(output.get(), pixels.get(), 320 * 200), 0);
+}
@@ -41,6 +41,22 @@
 #define EMPTY_SUITE_NAME   TEST_VAR(suite_empty)
 #define INITIALSTATE_NAME  TEST_RESULT(initialstate)
 
+// Runs of zero bytes, for test data too large to write out by hand.
+#define ZERO_1 "\x00"
+#define ZERO_2 ZERO_1 ZERO_1
+#define ZERO_4 ZERO_2 ZERO_2
+#define ZERO_8 ZERO_4 ZERO_4
+#define ZERO_16 ZERO_8 ZERO_8
+#define ZERO_32 ZERO_16 ZERO_16
+#define ZERO_64 ZERO_32 ZERO_32
+#define ZERO_128 ZERO_64 ZERO_64
+#define ZERO_256 ZERO_128 ZERO_128
+#define ZERO_512 ZERO_256 ZERO_256
+#define ZERO_1024 ZERO_512 ZERO_512
+#define ZERO_2048 ZERO_1024 ZERO_1024
+#define ZERO_4096 ZERO_2048 ZERO_2048
+#define ZERO_8192 ZERO_4096 ZERO_4096
+
 // Define an ISINSTANCE_TEST macro which we use to confirm the initial state
 // is a valid instance of this format.  This is defined as a macro so the
 // format-specific code can reuse it later to test various invalid formats.
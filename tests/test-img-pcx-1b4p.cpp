@@ -138,6 +138,7 @@ using namespace camoto;
 	"\x00\x00\x01\x01\x80\x80\x81\x81" \
 	"\x7E\x7E\x01\x01\x80\x80\xC2\xFF"
 
+#define IMG_KNOWS_SIZE
 #define IMG_TYPE "img-pcx-1b4p"
 #define IMG_CLASS img_pcx_1b4p
 #include "test-img.hpp"
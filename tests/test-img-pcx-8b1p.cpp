@@ -138,6 +138,7 @@ using namespace camoto;
 	"\x0C\xC6\x00\x0A" \
 	"\x0C\xC6\x09\x0A" \
 
+#define IMG_KNOWS_SIZE
 #define IMG_TYPE "img-pcx-8b1p"
 #define IMG_CLASS img_pcx_8b1p
 #include "test-img.hpp"
@@ -76,6 +76,7 @@ using namespace camoto;
 	"\x0C\x00\x00\x00\x00\x00\x00\x0A" \
 	"\x0C\x09\x09\x09\x09\x09\x09\x0A"
 
+#define IMG_KNOWS_SIZE
 #define IMG_TYPE "img-pic-raptor"
 #define IMG_CLASS img_pic_raptor
 #include "test-img.hpp"
@@ -0,0 +1,115 @@
+/**
+ * @file  test-img-vga-planar.cpp
+ * @brief Test code for converting between planar and linear VGA data.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "../src/img-vga-raw-planar.hpp"
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+struct img_vga_planar_sample: public default_sample {
+	stream::string_sptr base;
+
+	img_vga_planar_sample()
+		:	base(new stream::string())
+	{
+	}
+
+	/// Write a test pattern through the planar image and read it back.
+	/**
+	 * The plane conversion works 16 bytes per plane at a time, with any
+	 * leftover bytes handled one at a time, so the dimensions decide which of
+	 * those paths get exercised.
+	 */
+	void roundTrip(unsigned int width, unsigned int height)
+	{
+		unsigned int dataSize = width * height;
+		unsigned int planeSize = width / 4 * height;
+
+		std::string pattern(dataSize, '\0');
+		for (unsigned int i = 0; i < dataSize; i++) {
+			pattern[i] = (char)((i * 7 + i / 256) & 0xFF);
+		}
+
+		ImagePtr img(new Image_VGARawPlanar(this->base, width, height,
+			createPalette_DefaultVGA()));
+
+		uint8_t *imgData = new uint8_t[dataSize];
+		StdImageDataPtr content(imgData);
+		memcpy(imgData, pattern.data(), dataSize);
+		uint8_t *maskData = new uint8_t[dataSize];
+		StdImageDataPtr mask(maskData);
+		memset(maskData, 0, dataSize);
+		img->fromStandard(content, mask);
+
+		// Plane p holds every fourth pixel, starting at pixel p
+		std::string planar(dataSize, '\0');
+		for (unsigned int p = 0; p < 4; p++) {
+			for (unsigned int j = 0; j < planeSize; j++) {
+				planar[p * planeSize + j] = pattern[j * 4 + p];
+			}
+		}
+		BOOST_CHECK_MESSAGE(
+			this->is_equal(planar, *this->base->str(), 16),
+			"Error converting " << width << "x" << height
+				<< " linear data to planar"
+		);
+
+		StdImageDataPtr output = img->toStandard();
+		std::string linear((char *)output.get(), dataSize);
+		BOOST_CHECK_MESSAGE(
+			this->is_equal(pattern, linear, width),
+			"Error converting " << width << "x" << height
+				<< " planar data back to linear"
+		);
+		return;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(img_vga_planar, img_vga_planar_sample)
+
+BOOST_AUTO_TEST_CASE(round_trip_exact)
+{
+	BOOST_TEST_MESSAGE("Round trip with planes a multiple of 16 bytes");
+
+	// 64x4 gives 64-byte planes, so only the 16-byte blocks are used
+	this->roundTrip(64, 4);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_tail)
+{
+	BOOST_TEST_MESSAGE("Round trip with leftover bytes in each plane");
+
+	// 72x3 gives 54-byte planes: three 16-byte blocks then six single bytes
+	this->roundTrip(72, 3);
+}
+
+BOOST_AUTO_TEST_CASE(round_trip_small)
+{
+	BOOST_TEST_MESSAGE("Round trip with planes smaller than 16 bytes");
+
+	// 8x2 gives 4-byte planes, so only the single byte loop is used
+	this->roundTrip(8, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -76,6 +76,7 @@
 // This format doesn't support masks
 #undef IMG_HAS_MASK
 
+#define IMG_KNOWS_SIZE
 #define IMG_TYPE "img-zone66_tile"
 #define IMG_CLASS img_zone66_tile
 #include "test-img.hpp"
@@ -193,3 +194,46 @@ BOOST_FIXTURE_TEST_SUITE(SUITE_NAME, FIXTURE_NAME)
 TO_STANDARD_TEST(4, 7);
 FROM_STANDARD_TEST(4, 7)
 BOOST_AUTO_TEST_SUITE_END()
+
+ISINSTANCE_TEST(c00, TESTDATA_INITIAL_8x8, DefinitelyYes);
+
+// Blank image as written by create()
+ISINSTANCE_TEST(c01,
+	"\x04\x00\x07\x00"
+	"\xFF"
+	, DefinitelyYes);
+
+// Trailing data after end-of-image code
+ISINSTANCE_TEST(c02,
+	"\x04\x00\x03\x00"
+	"\x04\x00\x01\x00\x01"
+	"\xFF"
+	"\x00"
+	, DefinitelyNo);
+
+// Invalid 0x00 code
+ISINSTANCE_TEST(c03,
+	"\x04\x00\x03\x00"
+	"\x04\x00\x01\x00\x01" "\x00"
+	"\xFF"
+	, DefinitelyNo);
+
+// Pixel run goes past the end of the image
+ISINSTANCE_TEST(c04,
+	"\x04\x00\x01\x00"
+	"\x05\x00\x01\x00\x01\x01"
+	"\xFF"
+	, DefinitelyNo);
+
+// Data cut off in the middle of a pixel run
+ISINSTANCE_TEST(c05,
+	"\x04\x00\x03\x00"
+	"\x04\x00\x01"
+	, DefinitelyNo);
+
+// Longer than any tile of this size could be
+ISINSTANCE_TEST(c06,
+	"\x01\x00\x01\x00"
+	"\xFD\x00\xFD\x00\x01\x05"
+	"\xFF"
+	, DefinitelyNo);
@@ -37,6 +37,43 @@
 // make error diagnosis easier.  Defaults to 8.
 //#define IMG_DATA_WIDTH 8
 
+// Define if getEncodedSize() must be able to predict the size of the encoded
+// image, for formats that implement it.
+//#define IMG_KNOWS_SIZE
+
+// Bits of each standard pixel the format can store, for formats with fewer
+// than 16 colours.  The expected toStandard() output is masked with this, so
+// the EGA test images can be reused.  Defaults to 0xFF.
+//#define IMG_PIXEL_MASK 0x03
+
+// Heap allocation budget for a single toStandard(), toStandardMask() or
+// fromStandard() call on a 16x16 image.  The defaults allow for a few
+// buffers, filters and stream resizes, and will fail if a conversion
+// allocates per pixel.  Allocating per row is caught by converting the 8x8
+// image as well: the 16x16 one has eight more rows, but may only make
+// IMG_ALLOC_MAX_GROWTH more allocations.  Override these for formats that
+// legitimately need more.
+//#define IMG_ALLOC_MAX_COUNT 24
+//#define IMG_ALLOC_MAX_GROWTH 4
+//#define IMG_ALLOC_MAX_BYTES_PER_PIXEL 16
+//#define IMG_ALLOC_MAX_BYTES_FIXED 16384
+
+#ifndef IMG_PIXEL_MASK
+#define IMG_PIXEL_MASK 0xFF
+#endif
+#ifndef IMG_ALLOC_MAX_COUNT
+#define IMG_ALLOC_MAX_COUNT 24
+#endif
+#ifndef IMG_ALLOC_MAX_GROWTH
+#define IMG_ALLOC_MAX_GROWTH 4
+#endif
+#ifndef IMG_ALLOC_MAX_BYTES_PER_PIXEL
+#define IMG_ALLOC_MAX_BYTES_PER_PIXEL 16
+#endif
+#ifndef IMG_ALLOC_MAX_BYTES_FIXED
+#define IMG_ALLOC_MAX_BYTES_FIXED 16384
+#endif
+
 using namespace camoto;
 using namespace camoto::gamegraphics;
 
@@ -191,6 +228,59 @@ struct FIXTURE_NAME: public default_sample {
 		BOOST_REQUIRE_MESSAGE(this->img, "Could not create image instance");
 	}
 
+	/// Count the allocations made decoding one of the test images.
+	/**
+	 * @param data
+	 *   Encoded image, one of the TESTDATA_INITIAL_* values.
+	 *
+	 * @param mask
+	 *   True to call toStandardMask() instead of toStandard().
+	 *
+	 * @return Number of heap allocations made by the conversion alone.
+	 */
+	unsigned long countToStandard(const std::string& data, int width,
+		int height, bool mask)
+	{
+		boost::shared_ptr<std::string> d(new std::string(data));
+		this->base->open(d);
+		this->openImage(width, height);
+
+		StdImageDataPtr output;
+		AllocCounter counter;
+		output = mask ? this->img->toStandardMask() : this->img->toStandard();
+		return counter.count();
+	}
+
+	/// Count the allocations made encoding one of the test images.
+	/**
+	 * @param image
+	 *   One of the stdformat_test_image_* values.
+	 *
+	 * @param mask
+	 *   The matching stdformat_test_mask_* value.
+	 *
+	 * @return Number of heap allocations made by the conversion alone.
+	 */
+	unsigned long countFromStandard(const uint8_t *image, const uint8_t *mask,
+		int width, int height)
+	{
+		StdImageDataPtr stddata(new uint8_t[width * height]);
+		memcpy(stddata.get(), image, width * height);
+
+		StdImageDataPtr stdmask(new uint8_t[width * height]);
+		memcpy(stdmask.get(), mask, width * height);
+
+		this->base.reset(new stream::string());
+		this->createImage(width, height);
+		if (this->img->getCaps() & Image::CanSetDimensions) {
+			this->img->setDimensions(width, height);
+		}
+
+		AllocCounter counter;
+		this->img->fromStandard(stddata, stdmask);
+		return counter.count();
+	}
+
 };
 
 BOOST_FIXTURE_TEST_SUITE(SUITE_NAME, FIXTURE_NAME)
@@ -231,9 +321,13 @@ BOOST_AUTO_TEST_CASE(TEST_NAME(to_standard_ ## w ## x ## h)) \
 	GET_HOTSPOT \
 	GET_HITRECT \
 \
+	std::string expected = makeString(stdformat_test_image_ ## w ## x ## h); \
+	for (std::string::iterator i = expected.begin(); i != expected.end(); i++) { \
+		*i &= IMG_PIXEL_MASK; \
+	} \
 	BOOST_CHECK_MESSAGE( \
 		default_sample::is_equal( \
-			makeString(stdformat_test_image_ ## w ## x ## h), \
+			expected, \
 			std::string((const char *)output.get(), w * h), \
 			w \
 		), \
@@ -295,6 +389,14 @@ TO_MASK_TEST(8, 4);
 #define SET_HITRECT
 #endif
 
+#ifdef IMG_KNOWS_SIZE
+#define CHECK_KNOWS_SIZE \
+	BOOST_REQUIRE_MESSAGE(knowsSize, \
+		"getEncodedSize() couldn't predict the size of the encoded image");
+#else
+#define CHECK_KNOWS_SIZE
+#endif
+
 #define FROM_STANDARD_TEST(w, h) \
 BOOST_AUTO_TEST_CASE(TEST_NAME(from_standard_ ## w ## x ## h)) \
 { \
@@ -311,12 +413,20 @@ BOOST_AUTO_TEST_CASE(TEST_NAME(from_standard_ ## w ## x ## h)) \
 	if (this->img->getCaps() & Image::CanSetDimensions) { \
 		this->img->setDimensions(w, h); \
 	} \
+	/* Predict the size before anything is written */ \
+	stream::len encodedSize = 0; \
+	bool knowsSize = this->img->getEncodedSize(stddata, stdmask, &encodedSize); \
+	CHECK_KNOWS_SIZE \
+\
 	this->img->fromStandard(stddata, stdmask); \
 \
 	SET_HOTSPOT \
 	SET_HITRECT \
 \
 	int targetSize = sizeof(TESTDATA_INITIAL_ ## w ## x ## h) - 1; \
+	if (knowsSize) { \
+		BOOST_CHECK_EQUAL(encodedSize, targetSize); \
+	} \
 	BOOST_CHECK_MESSAGE( \
 		default_sample::is_equal( \
 			makeString(TESTDATA_INITIAL_ ## w ## x ## h), \
@@ -335,4 +445,104 @@ FROM_STANDARD_TEST(16, 16)
 FROM_STANDARD_TEST(9, 9)
 FROM_STANDARD_TEST(8, 4)
 
+// Check the allocations made by one conversion against the budget.  The
+// counter is read before any assertions, as Boost.Test allocates as well.
+#define CHECK_ALLOC_BUDGET(counter, w, h, op) \
+{ \
+	unsigned long allocCount = counter.count(); \
+	unsigned long allocBytes = counter.bytes(); \
+	BOOST_TEST_MESSAGE(op ": " << allocCount << " allocations, " \
+		<< allocBytes << " bytes"); \
+	BOOST_CHECK_MESSAGE(allocCount <= IMG_ALLOC_MAX_COUNT, \
+		op " made " << allocCount << " heap allocations, budget is " \
+		<< IMG_ALLOC_MAX_COUNT); \
+	BOOST_CHECK_MESSAGE(allocBytes <= \
+		(w) * (h) * IMG_ALLOC_MAX_BYTES_PER_PIXEL + IMG_ALLOC_MAX_BYTES_FIXED, \
+		op " allocated " << allocBytes << " bytes, budget is " \
+		<< (w) * (h) * IMG_ALLOC_MAX_BYTES_PER_PIXEL + IMG_ALLOC_MAX_BYTES_FIXED); \
+}
+
+// Check the number of allocations doesn't grow with the number of rows, by
+// comparing the counts for the 8x8 and 16x16 images.  Run this after the
+// budget check, so any one-off setup has already been done.
+#define CHECK_ALLOC_GROWTH(small, large, op) \
+{ \
+	unsigned long smallCount = small; \
+	unsigned long largeCount = large; \
+	BOOST_CHECK_MESSAGE(largeCount <= smallCount + IMG_ALLOC_MAX_GROWTH, \
+		op " made " << smallCount << " heap allocations for 8x8 but " \
+		<< largeCount << " for 16x16, budget is " << IMG_ALLOC_MAX_GROWTH \
+		<< " more"); \
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_to_standard))
+{
+	BOOST_TEST_MESSAGE("Checking allocations converting " TOSTRING(IMG_CLASS) " to stdformat");
+
+	boost::shared_ptr<std::string> d(new std::string(makeString(TESTDATA_INITIAL_16x16)));
+	this->base->open(d);
+	this->openImage(16, 16);
+
+	StdImageDataPtr output;
+	{
+		AllocCounter counter;
+		output = this->img->toStandard();
+		CHECK_ALLOC_BUDGET(counter, 16, 16, "toStandard()");
+	}
+	CHECK_ALLOC_GROWTH(
+		this->countToStandard(makeString(TESTDATA_INITIAL_8x8), 8, 8, false),
+		this->countToStandard(makeString(TESTDATA_INITIAL_16x16), 16, 16, false),
+		"toStandard()");
+}
+
+#ifdef IMG_HAS_MASK
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_to_mask))
+{
+	BOOST_TEST_MESSAGE("Checking allocations converting " TOSTRING(IMG_CLASS) " to stdmask");
+
+	boost::shared_ptr<std::string> d(new std::string(makeString(TESTDATA_INITIAL_16x16)));
+	this->base->open(d);
+	this->openImage(16, 16);
+
+	StdImageDataPtr output;
+	{
+		AllocCounter counter;
+		output = this->img->toStandardMask();
+		CHECK_ALLOC_BUDGET(counter, 16, 16, "toStandardMask()");
+	}
+	CHECK_ALLOC_GROWTH(
+		this->countToStandard(makeString(TESTDATA_INITIAL_8x8), 8, 8, true),
+		this->countToStandard(makeString(TESTDATA_INITIAL_16x16), 16, 16, true),
+		"toStandardMask()");
+}
+#endif // IMG_HAS_MASK
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_from_standard))
+{
+	BOOST_TEST_MESSAGE("Checking allocations converting stdformat to " TOSTRING(IMG_CLASS));
+
+	StdImageDataPtr stddata(new uint8_t[16*16]);
+	memcpy(stddata.get(), stdformat_test_image_16x16, 16*16);
+
+	StdImageDataPtr stdmask(new uint8_t[16*16]);
+	memcpy(stdmask.get(), stdformat_test_mask_16x16, 16*16);
+
+	this->createImage(16, 16);
+
+	if (this->img->getCaps() & Image::CanSetDimensions) {
+		this->img->setDimensions(16, 16);
+	}
+	{
+		AllocCounter counter;
+		this->img->fromStandard(stddata, stdmask);
+		CHECK_ALLOC_BUDGET(counter, 16, 16, "fromStandard()");
+	}
+	CHECK_ALLOC_GROWTH(
+		this->countFromStandard(stdformat_test_image_8x8,
+			stdformat_test_mask_8x8, 8, 8),
+		this->countFromStandard(stdformat_test_image_16x16,
+			stdformat_test_mask_16x16, 16, 16),
+		"fromStandard()");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
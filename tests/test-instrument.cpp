@@ -0,0 +1,88 @@
+/**
+ * @file  test-instrument.cpp
+ * @brief Test code for the per-format instrumentation counters.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+#define INST_CODE "img-cga-raw-linear-fullscreen"
+#define INST_SIZE 16000
+
+BOOST_AUTO_TEST_CASE(instrument_counters)
+{
+	BOOST_TEST_MESSAGE("Collect per-format counters through the Manager");
+
+	ManagerPtr manager(getManager());
+	manager->resetStats();
+	manager->setInstrumentation(true);
+
+	ImageTypePtr type(manager->getImageTypeByCode(INST_CODE));
+	BOOST_REQUIRE_MESSAGE(type, "Invalid image code " INST_CODE);
+
+	stream::string_sptr base(new stream::string());
+	base->write(std::string(INST_SIZE, '\x55'));
+	SuppData suppData;
+	ImagePtr img(type->open(base, suppData));
+
+	StdImageDataPtr pixels = img->toStandard();
+	img->fromStandard(pixels, img->toStandardMask());
+
+	manager->setInstrumentation(false);
+
+	FormatStatsVector stats = manager->getStats();
+	BOOST_REQUIRE_EQUAL(stats.size(), 1);
+	BOOST_REQUIRE_EQUAL(stats[0].code, INST_CODE);
+	BOOST_CHECK_GE(stats[0].bytesRead, INST_SIZE);
+	BOOST_CHECK_GE(stats[0].bytesWritten, INST_SIZE);
+	BOOST_CHECK_GT(stats[0].readCalls, 0);
+	BOOST_CHECK_GT(stats[0].writeCalls, 0);
+	BOOST_CHECK_EQUAL(stats[0].toStandardCalls, 2);
+	BOOST_CHECK_EQUAL(stats[0].fromStandardCalls, 1);
+	BOOST_CHECK_EQUAL(stats[0].imageBuffers, 2);
+	BOOST_CHECK_EQUAL(stats[0].imageBufferBytes, 320 * 200 * 2);
+
+	manager->resetStats();
+	BOOST_CHECK_EQUAL(manager->getStats().size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(instrument_disabled)
+{
+	BOOST_TEST_MESSAGE("Nothing is counted while instrumentation is off");
+
+	ManagerPtr manager(getManager());
+	manager->resetStats();
+
+	ImageTypePtr type(manager->getImageTypeByCode(INST_CODE));
+	BOOST_REQUIRE_MESSAGE(type, "Invalid image code " INST_CODE);
+
+	stream::string_sptr base(new stream::string());
+	base->write(std::string(INST_SIZE, '\x55'));
+	SuppData suppData;
+	ImagePtr img(type->open(base, suppData));
+	img->toStandard();
+
+	BOOST_CHECK_EQUAL(manager->getStats().size(), 0);
+}
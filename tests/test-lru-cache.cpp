@@ -0,0 +1,111 @@
+/**
+ * @file  test-lru-cache.cpp
+ * @brief Test code for the least-recently-used cache.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "../src/lru-cache.hpp"
+
+using namespace camoto::gamegraphics;
+
+BOOST_AUTO_TEST_CASE(lru_cache_evict)
+{
+	BOOST_TEST_MESSAGE("Evict the least recently used items from the cache");
+
+	LRUCache<int, int> cache(3);
+	cache.put(1, 10, 1);
+	cache.put(2, 20, 1);
+	cache.put(3, 30, 1);
+
+	// Touch the first item so the second becomes the oldest
+	int value = 0;
+	BOOST_REQUIRE(cache.get(1, &value));
+	BOOST_REQUIRE_EQUAL(value, 10);
+
+	cache.put(4, 40, 1);
+	BOOST_REQUIRE_EQUAL(cache.count(), 3);
+	BOOST_REQUIRE(!cache.get(2, &value));
+	BOOST_REQUIRE(cache.get(1, &value));
+	BOOST_REQUIRE(cache.get(3, &value));
+	BOOST_REQUIRE(cache.get(4, &value));
+	BOOST_REQUIRE_EQUAL(value, 40);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_cost)
+{
+	BOOST_TEST_MESSAGE("Limit the cache by the cost of each item");
+
+	LRUCache<int, int> cache(10);
+	cache.put(1, 10, 4);
+	cache.put(2, 20, 4);
+	BOOST_REQUIRE_EQUAL(cache.size(), 8);
+
+	// Needs both older items gone to fit
+	cache.put(3, 30, 9);
+	BOOST_REQUIRE_EQUAL(cache.count(), 1);
+	BOOST_REQUIRE_EQUAL(cache.size(), 9);
+
+	// Too big to ever fit, so not stored and nothing else is dropped
+	cache.put(4, 40, 11);
+	int value = 0;
+	BOOST_REQUIRE(!cache.get(4, &value));
+	BOOST_REQUIRE(cache.get(3, &value));
+	BOOST_REQUIRE_EQUAL(value, 30);
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_replace)
+{
+	BOOST_TEST_MESSAGE("Replace and erase items in the cache");
+
+	LRUCache<int, int> cache(10);
+	cache.put(1, 10, 4);
+	cache.put(1, 11, 2);
+	BOOST_REQUIRE_EQUAL(cache.count(), 1);
+	BOOST_REQUIRE_EQUAL(cache.size(), 2);
+
+	int value = 0;
+	BOOST_REQUIRE(cache.get(1, &value));
+	BOOST_REQUIRE_EQUAL(value, 11);
+
+	cache.erase(1);
+	BOOST_REQUIRE_EQUAL(cache.count(), 0);
+	BOOST_REQUIRE_EQUAL(cache.size(), 0);
+	BOOST_REQUIRE(!cache.get(1, &value));
+}
+
+BOOST_AUTO_TEST_CASE(lru_cache_capacity)
+{
+	BOOST_TEST_MESSAGE("Shrink the cache by lowering its capacity");
+
+	LRUCache<int, int> cache(10);
+	cache.put(1, 10, 4);
+	cache.put(2, 20, 4);
+	cache.setCapacity(5);
+	BOOST_REQUIRE_EQUAL(cache.count(), 1);
+	BOOST_REQUIRE_EQUAL(cache.size(), 4);
+
+	int value = 0;
+	BOOST_REQUIRE(!cache.get(1, &value));
+	BOOST_REQUIRE(cache.get(2, &value));
+
+	cache.setCapacity(0);
+	BOOST_REQUIRE_EQUAL(cache.count(), 0);
+	cache.put(3, 30, 1);
+	BOOST_REQUIRE(!cache.get(3, &value));
+}
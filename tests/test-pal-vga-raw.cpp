@@ -22,6 +22,7 @@
 #include <boost/bind.hpp>
 #include <camoto/stream_string.hpp>
 
+#include "../src/pal-cache.hpp"
 #include "../src/pal-vga-raw.hpp"
 
 #include "tests.hpp"
@@ -144,3 +145,64 @@ BOOST_AUTO_TEST_CASE(pal_vga8_raw_write)
 	BOOST_REQUIRE_EQUAL(buf[4], 255);
 	BOOST_REQUIRE_EQUAL(buf[5], 255);
 }
+
+BOOST_AUTO_TEST_CASE(pal_vga_raw_cache)
+{
+	BOOST_TEST_MESSAGE("Share cached VGA palettes");
+
+	uint8_t data[768];
+	memset(data, 0, 768);
+	data[3] = data[4] = data[5] = 0x3F;
+
+	stream::string_sptr ss(new stream::string());
+	ss->write(data, 768);
+
+	PaletteTablePtr shared;
+	{
+		Palette_VGA img(ss, 6);
+		PaletteTablePtr pal = img.getPalette();
+		BOOST_REQUIRE_EQUAL((*pal)[1].red, 255);
+		shared = findCachedPalette(ss, 6);
+		BOOST_REQUIRE(shared);
+		BOOST_REQUIRE(shared != pal);
+
+		// Changing the returned copy must not change the shared table
+		(*pal)[1].alpha = 0;
+		BOOST_REQUIRE_EQUAL((*shared)[1].alpha, 255);
+	}
+
+	// A second palette object on the same stream must use the same table
+	Palette_VGA img(ss, 6);
+	BOOST_REQUIRE_EQUAL((*img.getPalette())[1].alpha, 255);
+	BOOST_REQUIRE_EQUAL(findCachedPalette(ss, 6), shared);
+
+	// An identical palette in a different stream is shared too
+	stream::string_sptr ss2(new stream::string());
+	ss2->write(data, 768);
+	Palette_VGA img2(ss2, 6);
+	img2.getPalette();
+	BOOST_REQUIRE_EQUAL(findCachedPalette(ss2, 6), shared);
+
+	// But the same data at a different depth is not
+	Palette_VGA img8(ss, 8);
+	img8.getPalette();
+	BOOST_REQUIRE(findCachedPalette(ss, 8) != shared);
+
+	// Writing a palette invalidates the cache for that stream
+	PaletteTablePtr newPal(new PaletteTable(*shared));
+	(*newPal)[1].red = 0;
+	img.setPalette(newPal);
+
+	Palette_VGA img3(ss, 6);
+	PaletteTablePtr pal3 = img3.getPalette();
+	BOOST_REQUIRE_EQUAL((*pal3)[1].red,   0);
+	BOOST_REQUIRE_EQUAL((*pal3)[1].green, 255);
+	BOOST_REQUIRE(findCachedPalette(ss, 6) != shared);
+
+	// The original object must reread its changed data too
+	BOOST_REQUIRE_EQUAL((*img.getPalette())[1].red, 0);
+
+	// The untouched stream keeps its palette
+	BOOST_REQUIRE_EQUAL(findCachedPalette(ss2, 6), shared);
+	BOOST_REQUIRE_EQUAL((*shared)[1].red, 255);
+}
@@ -0,0 +1,95 @@
+/**
+ * @file  test-palettematch.cpp
+ * @brief Test code for matching truecolour pixels to a palette.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <camoto/gamegraphics/image.hpp>
+#include <camoto/gamegraphics/palettematch.hpp>
+
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+BOOST_AUTO_TEST_CASE(palettematch_nearest)
+{
+	BOOST_TEST_MESSAGE("Match colours to the EGA palette");
+
+	PaletteTablePtr pal = createPalette_DefaultEGA();
+	PaletteMatcher matcher(*pal);
+
+	// Exact matches
+	for (unsigned int i = 0; i < pal->size(); i++) {
+		BOOST_REQUIRE_EQUAL(
+			matcher.nearest((*pal)[i].red, (*pal)[i].green, (*pal)[i].blue), i);
+	}
+
+	// Close matches
+	BOOST_REQUIRE_EQUAL(matcher.nearest(0x10, 0x08, 0x00), 0);
+	BOOST_REQUIRE_EQUAL(matcher.nearest(0xF0, 0xF8, 0xFF), 15);
+	BOOST_REQUIRE_EQUAL(matcher.nearest(0x00, 0x00, 0xB0), 1);
+	BOOST_REQUIRE_EQUAL(matcher.nearest(0xA0, 0x60, 0x08), 6);
+}
+
+BOOST_AUTO_TEST_CASE(palettematch_duplicates)
+{
+	BOOST_TEST_MESSAGE("Match colours to a palette with duplicate entries");
+
+	PaletteTablePtr pal(new PaletteTable(4));
+	for (unsigned int i = 0; i < 4; i++) {
+		(*pal)[i].red = (*pal)[i].green = (*pal)[i].blue = (i < 2) ? 0 : 255;
+		(*pal)[i].alpha = 255;
+	}
+	// First black entry marks transparency so must not be picked
+	(*pal)[0].alpha = 0;
+	PaletteMatcher matcher(*pal);
+
+	// Lowest index wins a tie
+	BOOST_REQUIRE_EQUAL(matcher.nearest(0, 0, 0), 1);
+	BOOST_REQUIRE_EQUAL(matcher.nearest(255, 255, 255), 2);
+	BOOST_REQUIRE_EQUAL(matcher.nearest(200, 200, 200), 2);
+}
+
+BOOST_AUTO_TEST_CASE(palettematch_rgba)
+{
+	BOOST_TEST_MESSAGE("Convert an RGBA image to indexed pixels");
+
+	PaletteTablePtr pal = createPalette_DefaultEGA();
+	PaletteMatcher matcher(*pal);
+
+	// Two rows of three pixels, with padding at the end of each row
+	const uint8_t rgba[] = {
+		0x00, 0x00, 0xAA, 0xFF,  0xFF, 0xFF, 0x50, 0xFF,  0x00, 0x00, 0x00, 0x00,
+		0xDE, 0xAD, 0xBE, 0xEF,
+		0xFE, 0x56, 0x56, 0x80,  0xFF, 0xFF, 0xFF, 0x7F,  0xAA, 0xAA, 0xAA, 0xFF,
+		0xDE, 0xAD, 0xBE, 0xEF,
+	};
+	uint8_t data[6], mask[6];
+	matcher.fromRGBA(rgba, 3, 2, 16, data, mask, 1);
+
+	BOOST_REQUIRE_EQUAL((int)data[0], 1);
+	BOOST_REQUIRE_EQUAL((int)mask[0], (int)Image::Mask_Vis_Opaque);
+	BOOST_REQUIRE_EQUAL((int)data[1], 14);
+	BOOST_REQUIRE_EQUAL((int)mask[2], (int)Image::Mask_Vis_Transparent);
+	BOOST_REQUIRE_EQUAL((int)data[3], 12);
+	BOOST_REQUIRE_EQUAL((int)mask[3], (int)Image::Mask_Vis_Opaque);
+	BOOST_REQUIRE_EQUAL((int)mask[4], (int)Image::Mask_Vis_Transparent);
+	BOOST_REQUIRE_EQUAL((int)data[5], 7);
+}
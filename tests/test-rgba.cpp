@@ -0,0 +1,79 @@
+/**
+ * @file  test-rgba.cpp
+ * @brief Test code for conversion of indexed images to RGBA.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <camoto/gamegraphics/rgba.hpp>
+
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Require an output pixel to contain the given RGBA values
+#define REQUIRE_RGBA(p, r, g, b, a) \
+	BOOST_REQUIRE_EQUAL((int)(p)[0], r); \
+	BOOST_REQUIRE_EQUAL((int)(p)[1], g); \
+	BOOST_REQUIRE_EQUAL((int)(p)[2], b); \
+	BOOST_REQUIRE_EQUAL((int)(p)[3], a);
+
+BOOST_AUTO_TEST_CASE(rgba_convert)
+{
+	BOOST_TEST_MESSAGE("Convert indexed pixels to RGBA");
+
+	PaletteTablePtr pal = createPalette_FullCGA();
+	(*pal)[9].alpha = 0;
+
+	// 9 pixels wide so any vectorised path also runs the leftover pixel
+	const uint8_t data[] = {
+		0x00, 0x01, 0x0F, 0x09, 0x0C, 0x00, 0x01, 0x0F, 0x20,
+		0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F, 0x0F,
+	};
+	const uint8_t mask[] = {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0x01, 0x02, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x01,
+	};
+
+	// Extra four bytes at the end of each row must be left alone
+	const unsigned long stride = 9 * 4 + 4;
+	uint8_t out[stride * 2];
+	memset(out, 0xEE, sizeof(out));
+
+	toRGBA(data, mask, 9, 2, *pal, MaskTransparent, out, stride);
+
+	REQUIRE_RGBA(out + 0 * 4, 0x00, 0x00, 0x00, 0xFF);
+	REQUIRE_RGBA(out + 1 * 4, 0x00, 0x00, 0xAA, 0xFF);
+	REQUIRE_RGBA(out + 2 * 4, 0xFF, 0xFF, 0xFF, 0xFF);
+	// Palette alpha is kept
+	REQUIRE_RGBA(out + 3 * 4, 0x55, 0x55, 0xFF, 0x00);
+	// Index past the end of the palette
+	REQUIRE_RGBA(out + 8 * 4, 0x00, 0x00, 0x00, 0xFF);
+	BOOST_REQUIRE_EQUAL((int)out[9 * 4], 0xEE);
+
+	// Transparent mask bit clears alpha, hitmap bit doesn't
+	REQUIRE_RGBA(out + stride + 0 * 4, 0xFF, 0xFF, 0xFF, 0x00);
+	REQUIRE_RGBA(out + stride + 1 * 4, 0xFF, 0xFF, 0xFF, 0xFF);
+	REQUIRE_RGBA(out + stride + 3 * 4, 0xFF, 0xFF, 0xFF, 0x00);
+	REQUIRE_RGBA(out + stride + 8 * 4, 0xFF, 0xFF, 0xFF, 0x00);
+
+	// Mask can be ignored
+	toRGBA(data, NULL, 9, 2, *pal, MaskIgnore, out, stride);
+	REQUIRE_RGBA(out + stride + 0 * 4, 0xFF, 0xFF, 0xFF, 0xFF);
+}
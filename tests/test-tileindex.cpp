@@ -0,0 +1,114 @@
+/**
+ * @file  test-tileindex.cpp
+ * @brief Test code for finding identical tiles.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+BOOST_AUTO_TEST_SUITE(tileindex)
+
+BOOST_AUTO_TEST_CASE(hash)
+{
+	BOOST_TEST_MESSAGE("Hash image content");
+
+	uint8_t pixels[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+	uint8_t mask[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+	uint8_t mask2[9] = {0, 0, 0, 0, 1, 0, 0, 0, 0};
+
+	uint64_t h = hashImage(3, 3, pixels, mask);
+	BOOST_CHECK_EQUAL(h, hashImage(3, 3, pixels, mask));
+	BOOST_CHECK(h != hashImage(3, 3, pixels, mask2));
+	BOOST_CHECK(h != hashImage(9, 1, pixels, mask));
+}
+
+BOOST_AUTO_TEST_CASE(within_tileset)
+{
+	BOOST_TEST_MESSAGE("Find duplicates within one tileset");
+
+	TilesetFromImages_List content;
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+	addTile(&content, 2, 2, std::string(4, '\x02'));
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+	addTile(&content, 4, 1, std::string(4, '\x01')); // same bytes, different shape
+	addTile(&content, 2, 2, std::string(4, '\x01'));
+
+	TileIndex index(false);
+	BOOST_CHECK_EQUAL(index.add(createTilesetFromImages(content, 0)), 0);
+
+	const TileIndexEntries& tiles = index.getTiles();
+	BOOST_REQUIRE_EQUAL(tiles.size(), 5);
+	BOOST_CHECK_EQUAL(tiles[2].id, "0.2");
+	BOOST_CHECK_EQUAL(tiles[2].original, 0);
+	BOOST_CHECK_EQUAL(tiles[3].original, 3);
+	BOOST_CHECK(!tiles[0].pixels);
+
+	TileGroups dups = index.getDuplicates();
+	BOOST_REQUIRE_EQUAL(dups.size(), 1);
+	BOOST_REQUIRE_EQUAL(dups[0].size(), 3);
+	BOOST_CHECK_EQUAL(dups[0][0], 0);
+	BOOST_CHECK_EQUAL(dups[0][1], 2);
+	BOOST_CHECK_EQUAL(dups[0][2], 4);
+}
+
+BOOST_AUTO_TEST_CASE(across_tilesets)
+{
+	BOOST_TEST_MESSAGE("Find duplicates across tilesets and sub-tilesets");
+
+	TilesetFromImages_List first;
+	addTile(&first, 2, 2, std::string(4, '\x01'));
+	addTile(&first, 2, 2, std::string(4, '\x02'));
+
+	TilesetFromImages_List inner;
+	addTile(&inner, 2, 2, std::string(4, '\x02'));
+	TilesetFromImages_List second;
+	addTile(&second, 2, 2, std::string(4, '\x03'));
+	TilesetFromImages_Item sub;
+	sub.isImage = false;
+	sub.tileset = createTilesetFromImages(inner, 0);
+	second.push_back(sub);
+
+	TileIndex index(true);
+	index.add(createTilesetFromImages(first, 0));
+	BOOST_CHECK_EQUAL(index.add(createTilesetFromImages(second, 0)), 1);
+
+	const TileIndexEntries& tiles = index.getTiles();
+	BOOST_REQUIRE_EQUAL(tiles.size(), 4);
+	BOOST_CHECK_EQUAL(tiles[3].tileset, 1);
+	BOOST_CHECK_EQUAL(tiles[3].id, "0.1.0");
+	BOOST_CHECK_EQUAL(tiles[3].original, 1);
+
+	// Duplicates share the first copy's buffers
+	BOOST_REQUIRE(tiles[1].pixels);
+	BOOST_CHECK_EQUAL(tiles[3].pixels.get(), tiles[1].pixels.get());
+	BOOST_CHECK_EQUAL(tiles[3].mask.get(), tiles[1].mask.get());
+	BOOST_CHECK(tiles[2].pixels.get() != tiles[1].pixels.get());
+
+	TileGroups dups = index.getDuplicates();
+	BOOST_REQUIRE_EQUAL(dups.size(), 1);
+	BOOST_REQUIRE_EQUAL(dups[0].size(), 2);
+	BOOST_CHECK_EQUAL(dups[0][0], 1);
+	BOOST_CHECK_EQUAL(dups[0][1], 3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
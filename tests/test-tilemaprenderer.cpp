@@ -0,0 +1,222 @@
+/**
+ * @file  test-tilemaprenderer.cpp
+ * @brief Test code for drawing tile maps into a framebuffer.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "../src/img-vga-raw.hpp"
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Raw VGA image where pixels of colour 0 are transparent.
+class KeyedImage: public Image_VGARaw
+{
+	public:
+		KeyedImage(stream::inout_sptr data, unsigned int width,
+			unsigned int height)
+			:	Image_VGA(data, 0),
+				Image_VGARaw(data, width, height, createPalette_DefaultVGA())
+		{
+		}
+
+		virtual StdImageDataPtr toStandardMask()
+		{
+			unsigned int width, height;
+			this->getDimensions(&width, &height);
+			StdImageDataPtr pixels = this->toStandard();
+			StdImageDataPtr mask(new uint8_t[width * height]);
+			for (unsigned int i = 0; i < width * height; i++) {
+				mask[i] = pixels[i] ? Image::Mask_Vis_Opaque
+					: Image::Mask_Vis_Transparent;
+			}
+			return mask;
+		}
+};
+
+/// Create a KeyedImage for addTile().
+static ImagePtr createKeyedImage(stream::inout_sptr data, unsigned int width,
+	unsigned int height)
+{
+	return ImagePtr(new KeyedImage(data, width, height));
+}
+
+#define E TileMapRenderer::EmptyCell
+
+struct tilemaprenderer_sample {
+	TilesetPtr tileset;
+
+	tilemaprenderer_sample()
+	{
+		TilesetFromImages_List content;
+		// 0: solid
+		addTile(&content, 2, 2, std::string(4, '\x11'),
+			createKeyedImage);
+		// 1: transparent on the diagonal
+		addTile(&content, 2, 2, std::string("\x00\x22\x22\x00", 4),
+			createKeyedImage);
+		// 2: bigger than a cell, overlapping its neighbours
+		addTile(&content, 3, 3, std::string("\x33\x33\x33\x33\x00\x33\x33\x33\x33", 9),
+			createKeyedImage);
+		// 3: not an image
+		TilesetFromImages_Item empty;
+		empty.isImage = false;
+		empty.tileset = createTilesetFromImages(content, 0);
+		content.push_back(empty);
+		this->tileset = createTilesetFromImages(content, 0);
+	}
+
+	/// Get the cells for a map, in rows.
+	std::vector<unsigned int> cells(const unsigned int *c, unsigned int len)
+	{
+		return std::vector<unsigned int>(c, c + len);
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(tilemaprenderer, tilemaprenderer_sample)
+
+BOOST_AUTO_TEST_CASE(render_indexed)
+{
+	BOOST_TEST_MESSAGE("Draw a map into an 8bpp framebuffer");
+
+	const unsigned int map[] = {
+		0, 1,
+		E, 3,
+	};
+	TileMapRenderer r(this->tileset, this->cells(map, 4), 2, 2, 2, 2,
+		RenderIndexed8);
+
+	// Offset so the map's top-left is at (1, 1), with a wider stride
+	uint8_t fb[6 * 5];
+	memset(fb, 0xEE, sizeof(fb));
+	RenderTarget target;
+	target.pixels = fb;
+	target.width = 5;
+	target.height = 5;
+	target.stride = 6;
+	r.render(target, -1, -1);
+
+	const uint8_t expected[] = {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0xEE,
+		0x00, 0x11, 0x11, 0x00, 0x22, 0xEE,
+		0x00, 0x11, 0x11, 0x22, 0x00, 0xEE,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0xEE,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0xEE,
+	};
+	for (unsigned int i = 0; i < sizeof(fb); i++) {
+		BOOST_REQUIRE_EQUAL((int)fb[i], (int)expected[i]);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(render_rgba)
+{
+	BOOST_TEST_MESSAGE("Draw a map into an RGBA framebuffer");
+
+	const unsigned int map[] = {1};
+	TileMapRenderer r(this->tileset, this->cells(map, 1), 1, 1, 2, 2,
+		RenderRGBA);
+
+	uint8_t fb[2 * 2 * 4];
+	RenderTarget target;
+	target.pixels = fb;
+	target.width = 2;
+	target.height = 2;
+	target.stride = 2 * 4;
+	r.render(target, 0, 0);
+
+	PaletteTablePtr pal = createPalette_DefaultVGA();
+	// Transparent pixel left as the background
+	BOOST_CHECK_EQUAL((int)fb[0], 0);
+	BOOST_CHECK_EQUAL((int)fb[3], 0);
+	// Visible pixel converted through the palette
+	BOOST_CHECK_EQUAL((int)fb[4], (int)(*pal)[0x22].red);
+	BOOST_CHECK_EQUAL((int)fb[5], (int)(*pal)[0x22].green);
+	BOOST_CHECK_EQUAL((int)fb[6], (int)(*pal)[0x22].blue);
+	BOOST_CHECK_EQUAL((int)fb[7], (int)(*pal)[0x22].alpha);
+}
+
+BOOST_AUTO_TEST_CASE(update_matches_render)
+{
+	BOOST_TEST_MESSAGE("Scrolling and changing cells gives the same frame as a"
+		" full redraw");
+
+	const unsigned int map[] = {
+		0, 1, 2, 0, 1,
+		1, E, 0, 2, 0,
+		2, 0, 1, 3, 2,
+		0, 2, 0, 1, 0,
+	};
+	TileMapRenderer r(this->tileset, this->cells(map, 20), 5, 4, 2, 2,
+		RenderRGBA);
+	TileMapRenderer check(this->tileset, this->cells(map, 20), 5, 4, 2, 2,
+		RenderRGBA);
+
+	const unsigned int w = 5, h = 4, stride = w * 4;
+	uint8_t fb[stride * h], expected[stride * h];
+	RenderTarget target, checkTarget;
+	target.pixels = fb;
+	checkTarget.pixels = expected;
+	target.width = checkTarget.width = w;
+	target.height = checkTarget.height = h;
+	target.stride = checkTarget.stride = stride;
+
+	// Viewport moves, with a cell change before some of them
+	const int moves[][5] = {
+		// viewX, viewY, cellX, cellY, new tile (-1 for no change, -2 for empty)
+		{ 0,  0, 0, 0, -1},
+		{ 1,  0, 0, 0, -1},
+		{ 3,  2, 0, 0, -1},
+		{ 2,  3, 2, 1,  2},
+		{-1, -2, 0, 0,  1},
+		{-1, -2, 4, 3, -2},
+		{ 4,  1, 0, 0, -1},
+		{ 0,  5, 1, 2,  0},
+		{20, 20, 0, 0, -1},
+		{ 6,  4, 3, 2,  1},
+	};
+	r.render(target, moves[0][0], moves[0][1]);
+	for (unsigned int m = 0; m < sizeof(moves) / sizeof(moves[0]); m++) {
+		if (moves[m][4] != -1) {
+			unsigned int tile = (moves[m][4] == -2) ? E : moves[m][4];
+			r.setCell(moves[m][2], moves[m][3], tile);
+			check.setCell(moves[m][2], moves[m][3], tile);
+		}
+		r.update(target, moves[m][0], moves[m][1]);
+		check.render(checkTarget, moves[m][0], moves[m][1]);
+		for (unsigned int i = 0; i < sizeof(fb); i++) {
+			BOOST_REQUIRE_MESSAGE(fb[i] == expected[i], "Frame " << m
+				<< " differs at byte " << i);
+		}
+	}
+	BOOST_CHECK_EQUAL(r.getCell(4, 3), E);
+}
+
+BOOST_AUTO_TEST_CASE(bad_map)
+{
+	BOOST_TEST_MESSAGE("Reject a map of the wrong size");
+
+	const unsigned int map[] = {0, 1, 2};
+	BOOST_CHECK_THROW(TileMapRenderer(this->tileset, this->cells(map, 3), 2, 2,
+		2, 2, RenderIndexed8), stream::error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -30,6 +30,31 @@
 // to DefinitelyYes.
 //#define TILESET_DETECTION_UNCERTAIN
 
+// Heap allocation budget for a single toStandard(), fromStandard(), insert()
+// or flush() call on one tile.  The byte budget is per pixel of
+// DATA_TILE_WIDTH x DATA_TILE_HEIGHT, plus a fixed amount for buffers and
+// stream resizes.  For formats whose tiles can be resized, allocating per row
+// is caught by converting a tile four times the size in each direction as
+// well, which may only make TILESET_ALLOC_MAX_GROWTH more allocations.
+// Override these for formats that legitimately need more.
+//#define TILESET_ALLOC_MAX_COUNT 64
+//#define TILESET_ALLOC_MAX_GROWTH 4
+//#define TILESET_ALLOC_MAX_BYTES_PER_PIXEL 16
+//#define TILESET_ALLOC_MAX_BYTES_FIXED 65536
+
+#ifndef TILESET_ALLOC_MAX_COUNT
+#define TILESET_ALLOC_MAX_COUNT 64
+#endif
+#ifndef TILESET_ALLOC_MAX_GROWTH
+#define TILESET_ALLOC_MAX_GROWTH 4
+#endif
+#ifndef TILESET_ALLOC_MAX_BYTES_PER_PIXEL
+#define TILESET_ALLOC_MAX_BYTES_PER_PIXEL 16
+#endif
+#ifndef TILESET_ALLOC_MAX_BYTES_FIXED
+#define TILESET_ALLOC_MAX_BYTES_FIXED 65536
+#endif
+
 using namespace camoto;
 using namespace camoto::gamegraphics;
 
@@ -156,6 +181,89 @@ struct FIXTURE_NAME: public default_sample {
 		return;
 	}
 
+	/// Check the allocations made since counter was created against the budget.
+	/**
+	 * The counter is read before any assertions, as Boost.Test allocates too.
+	 */
+	void checkAllocBudget(const AllocCounter& counter, const char *op)
+	{
+		unsigned long allocCount = counter.count();
+		unsigned long allocBytes = counter.bytes();
+		unsigned long maxBytes = DATA_TILE_WIDTH * DATA_TILE_HEIGHT
+			* TILESET_ALLOC_MAX_BYTES_PER_PIXEL + TILESET_ALLOC_MAX_BYTES_FIXED;
+
+		BOOST_TEST_MESSAGE(op << ": " << allocCount << " allocations, "
+			<< allocBytes << " bytes");
+		BOOST_CHECK_MESSAGE(allocCount <= TILESET_ALLOC_MAX_COUNT,
+			op << " made " << allocCount << " heap allocations, budget is "
+			<< TILESET_ALLOC_MAX_COUNT);
+		BOOST_CHECK_MESSAGE(allocBytes <= maxBytes,
+			op << " allocated " << allocBytes << " bytes, budget is " << maxBytes);
+		return;
+	}
+
+	/// Count the allocations made decoding the first tile at a given size.
+	/**
+	 * The tile is resized and refilled first, so this can only be used with
+	 * formats whose tiles can be resized.
+	 *
+	 * @return Number of heap allocations made by the conversion alone.
+	 */
+	unsigned long countToStandard(int width, int height)
+	{
+		const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+		setTileData(tiles[0], 3, 0, width, height);
+		pTileset->flush();
+		ImagePtr img(pTileset->openImage(tiles[0]));
+
+		StdImageDataPtr output;
+		AllocCounter counter;
+		output = img->toStandard();
+		return counter.count();
+	}
+
+	/// Count the allocations made encoding the first tile at a given size.
+	/**
+	 * As with countToStandard(), the format's tiles must be resizable.
+	 *
+	 * @return Number of heap allocations made by the conversion alone.
+	 */
+	unsigned long countFromStandard(int width, int height)
+	{
+		const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+		ImagePtr img(pTileset->openImage(tiles[0]));
+		img->setDimensions(width, height);
+		MAKE_IMAGE(newImg, 3, width, height);
+		MAKE_MASK(newMask, 0, width, height);
+
+		// Convert it once first, so the tile has already grown to the new size
+		img->fromStandard(newImg, newMask);
+
+		AllocCounter counter;
+		img->fromStandard(newImg, newMask);
+		return counter.count();
+	}
+
+	/// Check the allocation count doesn't grow with the size of the tile.
+	/**
+	 * @param small
+	 *   Allocations made converting a DATA_TILE_WIDTH x DATA_TILE_HEIGHT tile.
+	 *
+	 * @param large
+	 *   Allocations made converting a tile four times the size in each
+	 *   direction.
+	 */
+	void checkAllocGrowth(unsigned long small, unsigned long large,
+		const char *op)
+	{
+		BOOST_CHECK_MESSAGE(large <= small + TILESET_ALLOC_MAX_GROWTH,
+			op << " made " << small << " heap allocations for a "
+			<< DATA_TILE_WIDTH << "x" << DATA_TILE_HEIGHT << " tile but " << large
+			<< " for one four times the size, budget is "
+			<< TILESET_ALLOC_MAX_GROWTH << " more");
+		return;
+	}
+
 };
 
 BOOST_FIXTURE_TEST_SUITE(SUITE_NAME, FIXTURE_NAME)
@@ -663,6 +771,215 @@ BOOST_AUTO_TEST_CASE(TEST_NAME(resize_first))
 
 }
 
+BOOST_AUTO_TEST_CASE(TEST_NAME(fingerprint))
+{
+	BOOST_TEST_MESSAGE("Fingerprint tiles without decoding them");
+
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	BOOST_REQUIRE_EQUAL(tiles.size(), 2);
+
+	uint64_t first, second;
+	if (!pTileset->getFingerprint(tiles[0], &first)) {
+		BOOST_TEST_MESSAGE("Format can't fingerprint tiles, skipping");
+		return;
+	}
+	BOOST_REQUIRE(pTileset->getFingerprint(tiles[1], &second));
+
+	// Unchanged data gives the same fingerprint
+	uint64_t again;
+	BOOST_REQUIRE(pTileset->getFingerprint(tiles[0], &again));
+	BOOST_CHECK_EQUAL(again, first);
+
+	// Changing one tile only changes its own fingerprint
+	setTileData(tiles[0], 4, 0);
+	BOOST_REQUIRE(pTileset->getFingerprint(tiles[0], &again));
+	BOOST_CHECK(again != first);
+	BOOST_REQUIRE(pTileset->getFingerprint(tiles[1], &again));
+	BOOST_CHECK_EQUAL(again, second);
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(replace_all))
+{
+	BOOST_TEST_MESSAGE("Replace every tile in one go");
+
+	// Replace the tiles one at a time in a second copy to compare against
+	FIXTURE_NAME other;
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	const Tileset::VC_ENTRYPTR& otherTiles = other.pTileset->getItems();
+	BOOST_REQUIRE_EQUAL(tiles.size(), otherTiles.size());
+
+	std::vector<StdImageDataPtr> pixels(tiles.size()), masks(tiles.size());
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		if (tiles[i]->getAttr() & (Tileset::EmptySlot | Tileset::SubTileset)) {
+			continue;
+		}
+		unsigned int width, height;
+		ImagePtr img = other.pTileset->openImage(otherTiles[i]);
+		img->getDimensions(&width, &height);
+		MAKE_IMAGE(newImg, 4 + i, width, height);
+		MAKE_MASK(newMask, 0, width, height);
+		img->fromStandard(newImg, newMask);
+		pixels[i] = newImg;
+		masks[i] = newMask;
+	}
+	other.pTileset->flush();
+
+	// Nothing to replace leaves the file alone
+	std::vector<StdImageDataPtr> none(tiles.size());
+	pTileset->replaceAll(none, none);
+	BOOST_CHECK_MESSAGE(
+		is_equal(makeString(TEST_RESULT(initialstate))),
+		"Error replacing no tiles"
+	);
+
+	pTileset->replaceAll(pixels, masks);
+	BOOST_CHECK_MESSAGE(
+		is_equal(*other.base->str()),
+		"Replacing every tile gave a different file to replacing them one by one"
+	);
+
+#ifdef HAS_FAT
+	stream::string_sptr otherFAT =
+		boost::dynamic_pointer_cast<stream::string>(other.suppData[EST_FAT]);
+	BOOST_CHECK_MESSAGE(
+		is_supp_equal(EST_FAT, *otherFAT->str()),
+		"Replacing every tile gave a different FAT to replacing them one by one"
+	);
+#endif
+
+	// One image is needed for every entry
+	pixels.pop_back();
+	BOOST_CHECK_THROW(pTileset->replaceAll(pixels, masks), stream::error);
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(replace_all_many))
+{
+	BOOST_TEST_MESSAGE("Replace enough tiles in one go to encode them in parallel");
+
+	// Grow both copies to more tiles than Tileset_FAT encodes on one thread
+	FIXTURE_NAME other;
+	while (pTileset->getItems().size() < 20) {
+		Tileset::EntryPtr ep = pTileset->insert(Tileset::EntryPtr(),
+			Tileset::Default);
+		setTileData(ep, 1, 0);
+		Tileset::EntryPtr otherEp = other.pTileset->insert(Tileset::EntryPtr(),
+			Tileset::Default);
+		other.setTileData(otherEp, 1, 0);
+	}
+	pTileset->flush();
+	other.pTileset->flush();
+
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	const Tileset::VC_ENTRYPTR& otherTiles = other.pTileset->getItems();
+	BOOST_REQUIRE_EQUAL(tiles.size(), otherTiles.size());
+
+	std::vector<StdImageDataPtr> pixels(tiles.size()), masks(tiles.size());
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		if (tiles[i]->getAttr() & (Tileset::EmptySlot | Tileset::SubTileset)) {
+			continue;
+		}
+		unsigned int width, height;
+		ImagePtr img = other.pTileset->openImage(otherTiles[i]);
+		img->getDimensions(&width, &height);
+		MAKE_IMAGE(newImg, 2 + (i % 12), width, height);
+		MAKE_MASK(newMask, 0, width, height);
+		img->fromStandard(newImg, newMask);
+		pixels[i] = newImg;
+		masks[i] = newMask;
+	}
+	other.pTileset->flush();
+
+	pTileset->replaceAll(pixels, masks);
+	BOOST_CHECK_MESSAGE(
+		is_equal(*other.base->str()),
+		"Replacing many tiles gave a different file to replacing them one by one"
+	);
+
+#ifdef HAS_FAT
+	stream::string_sptr otherFAT =
+		boost::dynamic_pointer_cast<stream::string>(other.suppData[EST_FAT]);
+	BOOST_CHECK_MESSAGE(
+		is_supp_equal(EST_FAT, *otherFAT->str()),
+		"Replacing many tiles gave a different FAT to replacing them one by one"
+	);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_to_standard))
+{
+	BOOST_TEST_MESSAGE("Checking allocations converting tile to stdformat");
+
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	ImagePtr img(pTileset->openImage(tiles[0]));
+
+	StdImageDataPtr output;
+	{
+		AllocCounter counter;
+		output = img->toStandard();
+		checkAllocBudget(counter, "toStandard()");
+	}
+
+#ifdef test_tileset_resize_first
+	// Run after the budget check, so any one-off setup has already been done
+	checkAllocGrowth(
+		countToStandard(DATA_TILE_WIDTH, DATA_TILE_HEIGHT),
+		countToStandard(DATA_TILE_WIDTH * 4, DATA_TILE_HEIGHT * 4),
+		"toStandard()");
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_from_standard))
+{
+	BOOST_TEST_MESSAGE("Checking allocations converting stdformat to tile");
+
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	ImagePtr img(pTileset->openImage(tiles[0]));
+
+	if (img->getCaps() & Image::CanSetDimensions) {
+		img->setDimensions(DATA_TILE_WIDTH, DATA_TILE_HEIGHT);
+	}
+	MAKE_IMAGE(newImg, 3, DATA_TILE_WIDTH, DATA_TILE_HEIGHT);
+	MAKE_MASK(newMask, 0, DATA_TILE_WIDTH, DATA_TILE_HEIGHT);
+	{
+		AllocCounter counter;
+		img->fromStandard(newImg, newMask);
+		checkAllocBudget(counter, "fromStandard()");
+	}
+
+#ifdef test_tileset_resize_first
+	checkAllocGrowth(
+		countFromStandard(DATA_TILE_WIDTH, DATA_TILE_HEIGHT),
+		countFromStandard(DATA_TILE_WIDTH * 4, DATA_TILE_HEIGHT * 4),
+		"fromStandard()");
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_insert))
+{
+	BOOST_TEST_MESSAGE("Checking allocations inserting a tile");
+
+	Tileset::EntryPtr epNew;
+	{
+		AllocCounter counter;
+		epNew = pTileset->insert(Tileset::EntryPtr(), Tileset::Default);
+		checkAllocBudget(counter, "insert()");
+	}
+	BOOST_REQUIRE_MESSAGE(epNew->isValid(), "Couldn't insert new tile");
+}
+
+BOOST_AUTO_TEST_CASE(TEST_NAME(alloc_flush))
+{
+	BOOST_TEST_MESSAGE("Checking allocations flushing a changed tile");
+
+	const Tileset::VC_ENTRYPTR& tiles = pTileset->getItems();
+	setTileData(tiles[0], 3, 0);
+	{
+		AllocCounter counter;
+		pTileset->flush();
+		checkAllocBudget(counter, "flush()");
+	}
+}
+
 //
 // Metadata tests
 //
@@ -0,0 +1,222 @@
+/**
+ * @file  test-tilesetcache.cpp
+ * @brief Test code for saving decoded tilesets to a cache file.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "../src/img-vga-raw.hpp"
+#include "../src/tls-img.hpp"
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Cache file created in the current directory by these tests.
+#define CACHE_FILENAME "test-tilesetcache.tmp"
+
+/// Pixels with increasing values, starting from first.
+static std::string ramp(unsigned int len, uint8_t first)
+{
+	std::string pixels;
+	for (unsigned int i = 0; i < len; i++) pixels += (char)(first + i);
+	return pixels;
+}
+
+struct tilesetcache_sample {
+	TilesetPtr tileset;
+
+	tilesetcache_sample()
+	{
+		TilesetFromImages_List inner;
+		addTile(&inner, 3, 2, ramp(6, 0x40));
+		inner.back().name = "inner";
+
+		TilesetFromImages_List content;
+		addTile(&content, 2, 2, ramp(4, 0x10));
+		content.back().name = "first";
+		TilesetFromImages_Item sub;
+		sub.isImage = false;
+		sub.tileset = createTilesetFromImages(inner, 0);
+		content.push_back(sub);
+		addTile(&content, 4, 1, ramp(4, 0x20));
+		content.back().name = "last";
+		this->tileset = createTilesetFromImages(content, 5);
+	}
+
+	~tilesetcache_sample()
+	{
+		std::remove(CACHE_FILENAME);
+	}
+
+	/// Check an image from the cache matches the one in the original.
+	void checkImage(TilesetPtr cached, TilesetPtr original, unsigned int index)
+	{
+		ImagePtr a = cached->openImage(cached->getItems()[index]);
+		ImagePtr b = original->openImage(original->getItems()[index]);
+		unsigned int aw, ah, bw, bh;
+		a->getDimensions(&aw, &ah);
+		b->getDimensions(&bw, &bh);
+		BOOST_REQUIRE_EQUAL(aw, bw);
+		BOOST_REQUIRE_EQUAL(ah, bh);
+		BOOST_CHECK_EQUAL(a->getCaps(), b->getCaps());
+
+		StdImageDataPtr ap = a->toStandard(), bp = b->toStandard();
+		StdImageDataPtr am = a->toStandardMask(), bm = b->toStandardMask();
+		for (unsigned int i = 0; i < aw * ah; i++) {
+			BOOST_REQUIRE_EQUAL((int)ap[i], (int)bp[i]);
+			BOOST_REQUIRE_EQUAL((int)am[i], (int)bm[i]);
+		}
+
+		PaletteTablePtr pal = a->getPalette();
+		BOOST_REQUIRE(pal);
+		BOOST_REQUIRE_EQUAL(pal->size(), 256);
+		BOOST_CHECK_EQUAL((int)(*pal)[1].blue, (int)(*b->getPalette())[1].blue);
+		return;
+	}
+};
+
+BOOST_FIXTURE_TEST_SUITE(tilesetcache, tilesetcache_sample)
+
+BOOST_AUTO_TEST_CASE(round_trip)
+{
+	BOOST_TEST_MESSAGE("Write a tileset to a cache and read it back");
+
+	writeTilesetCache(this->tileset, 1234, CACHE_FILENAME);
+	TilesetPtr cached = openTilesetCache(CACHE_FILENAME, 1234);
+	BOOST_REQUIRE(cached);
+
+	BOOST_CHECK_EQUAL(cached->getLayoutWidth(), 5);
+	const Tileset::VC_ENTRYPTR& items = cached->getItems();
+	BOOST_REQUIRE_EQUAL(items.size(), 3);
+	BOOST_CHECK_EQUAL(items[0]->getName(), "first");
+	BOOST_CHECK_EQUAL(items[1]->getAttr(), Tileset::SubTileset);
+	BOOST_CHECK_EQUAL(items[2]->getName(), "last");
+	checkImage(cached, this->tileset, 0);
+	checkImage(cached, this->tileset, 2);
+
+	TilesetPtr sub = cached->openTileset(items[1]);
+	TilesetPtr origSub = this->tileset->openTileset(this->tileset->getItems()[1]);
+	BOOST_REQUIRE_EQUAL(sub->getItems().size(), 1);
+	BOOST_CHECK_EQUAL(sub->getItems()[0]->getName(), "inner");
+	checkImage(sub, origSub, 0);
+}
+
+BOOST_AUTO_TEST_CASE(outlives_tileset)
+{
+	BOOST_TEST_MESSAGE("Image data stays valid after the cache is closed");
+
+	writeTilesetCache(this->tileset, 1, CACHE_FILENAME);
+	StdImageDataPtr pixels;
+	{
+		TilesetPtr cached = openTilesetCache(CACHE_FILENAME, 1);
+		BOOST_REQUIRE(cached);
+		pixels = cached->openImage(cached->getItems()[2])->toStandard();
+	}
+	BOOST_CHECK_EQUAL((int)pixels[3], 0x23);
+}
+
+BOOST_AUTO_TEST_CASE(stale)
+{
+	BOOST_TEST_MESSAGE("Ignore a cache of a different source");
+
+	writeTilesetCache(this->tileset, 1, CACHE_FILENAME);
+	BOOST_CHECK(!openTilesetCache(CACHE_FILENAME, 2));
+}
+
+BOOST_AUTO_TEST_CASE(missing)
+{
+	BOOST_TEST_MESSAGE("Ignore a cache that doesn't exist");
+
+	BOOST_CHECK(!openTilesetCache(CACHE_FILENAME, 1));
+}
+
+BOOST_AUTO_TEST_CASE(truncated)
+{
+	BOOST_TEST_MESSAGE("Ignore a cache that has been cut short");
+
+	writeTilesetCache(this->tileset, 1, CACHE_FILENAME);
+	std::string data;
+	{
+		std::ifstream in(CACHE_FILENAME, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(in),
+			std::istreambuf_iterator<char>());
+	}
+	{
+		std::ofstream out(CACHE_FILENAME, std::ios::binary | std::ios::trunc);
+		out.write(data.data(), data.length() - 1);
+	}
+	BOOST_CHECK(!openTilesetCache(CACHE_FILENAME, 1));
+}
+
+BOOST_AUTO_TEST_CASE(read_only)
+{
+	BOOST_TEST_MESSAGE("Refuse to modify a cached tileset");
+
+	writeTilesetCache(this->tileset, 1, CACHE_FILENAME);
+	TilesetPtr cached = openTilesetCache(CACHE_FILENAME, 1);
+	BOOST_REQUIRE(cached);
+
+	Tileset::EntryPtr ep = cached->getItems()[0];
+	BOOST_CHECK_THROW(cached->insert(ep, Tileset::Default), stream::error);
+	BOOST_CHECK_THROW(cached->remove(ep), stream::error);
+
+	ImagePtr img = cached->openImage(ep);
+	StdImageDataPtr pixels(new uint8_t[4]), mask(new uint8_t[4]);
+	BOOST_CHECK_THROW(img->fromStandard(pixels, mask), stream::error);
+}
+
+BOOST_AUTO_TEST_CASE(modify_copy)
+{
+	BOOST_TEST_MESSAGE("Edit a tile of a cached image through a wrapper");
+
+	writeTilesetCache(this->tileset, 1, CACHE_FILENAME);
+	TilesetPtr cached = openTilesetCache(CACHE_FILENAME, 1);
+	BOOST_REQUIRE(cached);
+	ImagePtr img = cached->openImage(cached->getItems()[0]);
+
+	// Image_Sub writes straight into the buffer toStandard() returned, so
+	// this must not touch the read-only mapping.
+	Image_TilesetFrom tiles(img, 1, 1, 2, 2);
+	ImagePtr tile = tiles.openImage(tiles.getItems()[1]);
+	StdImageDataPtr pixels(new uint8_t[1]), mask(new uint8_t[1]);
+	pixels[0] = 0x99;
+	mask[0] = 0;
+	tile->fromStandard(pixels, mask);
+	BOOST_CHECK_EQUAL((int)tile->toStandard()[0], 0x99);
+
+	// The cache itself is unchanged, and writing back is refused
+	BOOST_CHECK_EQUAL((int)img->toStandard()[1], 0x11);
+	BOOST_CHECK_THROW(tiles.flush(), stream::error);
+}
+
+BOOST_AUTO_TEST_CASE(fingerprint)
+{
+	BOOST_TEST_MESSAGE("Fingerprint a whole stream");
+
+	stream::string_sptr a(new stream::string()), b(new stream::string());
+	a->write(std::string("hello, world"));
+	b->write(std::string("hello, world!"));
+	BOOST_CHECK_EQUAL(fingerprintStream(a), fingerprintStream(a));
+	BOOST_CHECK(fingerprintStream(a) != fingerprintStream(b));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,191 @@
+/**
+ * @file  test-tls-actrinfo.cpp
+ * @brief Test code for Cosmo/Duke II actor tilesets.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <boost/test/unit_test.hpp>
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Two actors with one 1x1 tile frame each.
+#define ACTR_INFO \
+	"\x02\x00" "\x06\x00" \
+	"\x01\x00" "\x01\x00" "\x00\x00\x00\x00" \
+	"\x01\x00" "\x01\x00" "\x28\x00\x00\x00"
+
+/// First actor with a 1x1 and a 2x1 tile frame, second with one 1x1 frame.
+#define ACTR_INFO_FRAMES \
+	"\x02\x00" "\x0A\x00" \
+	"\x01\x00" "\x01\x00" "\x00\x00\x00\x00" \
+	"\x01\x00" "\x02\x00" "\x28\x00\x00\x00" \
+	"\x01\x00" "\x01\x00" "\x78\x00\x00\x00"
+
+/// Size of one 8x8 five-plane tile in the tile data.
+#define ACTR_TILE_LEN 40
+
+/// Overwrite one byte of a stream.
+static void poke(stream::string_sptr data, stream::pos offset, char value)
+{
+	data->seekp(offset, stream::start);
+	data->write(std::string(1, value));
+	return;
+}
+
+/// Open an actor tileset from an info file and tile data.
+static TilesetPtr openActors(const std::string& info, stream::string_sptr tiles)
+{
+	ManagerPtr manager(getManager());
+	TilesetTypePtr type(manager->getTilesetTypeByCode("tls-actrinfo"));
+	BOOST_REQUIRE_MESSAGE(type, "Invalid tileset code tls-actrinfo");
+
+	stream::string_sptr dataInfo(new stream::string());
+	dataInfo->write(info);
+
+	SuppData suppData;
+	suppData[SuppItem::FAT] = dataInfo;
+	return type->open(tiles, suppData);
+}
+
+BOOST_AUTO_TEST_SUITE(tls_actrinfo)
+
+BOOST_AUTO_TEST_CASE(fingerprint_frames)
+{
+	BOOST_TEST_MESSAGE("Actor fingerprints change with the frame data");
+
+	stream::string_sptr tiles(new stream::string());
+	tiles->write(std::string(ACTR_TILE_LEN * 2, '\0'));
+	TilesetPtr tileset(openActors(makeString(ACTR_INFO), tiles));
+
+	const Tileset::VC_ENTRYPTR& actors = tileset->getItems();
+	BOOST_REQUIRE_EQUAL(actors.size(), 2);
+
+	uint64_t first, second, again;
+	BOOST_REQUIRE(tileset->getFingerprint(actors[0], &first));
+	BOOST_REQUIRE(tileset->getFingerprint(actors[1], &second));
+	BOOST_CHECK(first != second);
+
+	TilesetPtr sub(tileset->openTileset(actors[1]));
+	const Tileset::VC_ENTRYPTR& frames = sub->getItems();
+	BOOST_REQUIRE_EQUAL(frames.size(), 1);
+	uint64_t frame;
+	BOOST_REQUIRE(sub->getFingerprint(frames[0], &frame));
+
+	// Changing the second actor's artwork, which is only in the tile data and
+	// not the info file, must change its fingerprint but not the first's.
+	poke(tiles, ACTR_TILE_LEN + 5, '\xFF');
+
+	BOOST_REQUIRE(tileset->getFingerprint(actors[1], &again));
+	BOOST_CHECK(again != second);
+	BOOST_REQUIRE(tileset->getFingerprint(actors[0], &again));
+	BOOST_CHECK_EQUAL(again, first);
+	BOOST_REQUIRE(sub->getFingerprint(frames[0], &again));
+	BOOST_CHECK(again != frame);
+
+	// And the same the other way around
+	poke(tiles, 5, '\xFF');
+	BOOST_REQUIRE(tileset->getFingerprint(actors[0], &again));
+	BOOST_CHECK(again != first);
+}
+
+BOOST_AUTO_TEST_CASE(frame_lookup)
+{
+	BOOST_TEST_MESSAGE("Each actor gets its own frames from the frame index");
+
+	stream::string_sptr tiles(new stream::string());
+	tiles->write(std::string(ACTR_TILE_LEN * 4, '\0'));
+	TilesetPtr tileset(openActors(makeString(ACTR_INFO_FRAMES), tiles));
+
+	const Tileset::VC_ENTRYPTR& actors = tileset->getItems();
+	BOOST_REQUIRE_EQUAL(actors.size(), 2);
+
+	unsigned int width, height;
+	TilesetPtr first(tileset->openTileset(actors[0]));
+	const Tileset::VC_ENTRYPTR& firstFrames = first->getItems();
+	BOOST_REQUIRE_EQUAL(firstFrames.size(), 2);
+	first->openImage(firstFrames[0])->getDimensions(&width, &height);
+	BOOST_CHECK_EQUAL(width, 8);
+	BOOST_CHECK_EQUAL(height, 8);
+	first->openImage(firstFrames[1])->getDimensions(&width, &height);
+	BOOST_CHECK_EQUAL(width, 16);
+	BOOST_CHECK_EQUAL(height, 8);
+
+	TilesetPtr second(tileset->openTileset(actors[1]));
+	const Tileset::VC_ENTRYPTR& secondFrames = second->getItems();
+	BOOST_REQUIRE_EQUAL(secondFrames.size(), 1);
+	second->openImage(secondFrames[0])->getDimensions(&width, &height);
+	BOOST_CHECK_EQUAL(width, 8);
+	BOOST_CHECK_EQUAL(height, 8);
+
+	// Opening an actor again gives the same frames
+	TilesetPtr again(tileset->openTileset(actors[0]));
+	BOOST_CHECK_EQUAL(again->getItems().size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(frame_cache)
+{
+	BOOST_TEST_MESSAGE("Decoded frames are reused until they are replaced");
+
+	stream::string_sptr tiles(new stream::string());
+	tiles->write(std::string(ACTR_TILE_LEN * 4, '\0'));
+	TilesetPtr tileset(openActors(makeString(ACTR_INFO_FRAMES), tiles));
+	const Tileset::VC_ENTRYPTR& actors = tileset->getItems();
+
+	TilesetPtr sub(tileset->openTileset(actors[1]));
+	StdImageDataPtr before = sub->openImage(sub->getItems()[0])->toStandard();
+
+	// Callers get their own copy, so changing it leaves the cache alone
+	uint8_t original = before[0];
+	before[0] = original ^ 0x0F;
+
+	// Set every plane of the first row, behind the tileset's back
+	for (unsigned int i = 0; i < 5; i++) {
+		poke(tiles, ACTR_TILE_LEN * 3 + i, '\xFF');
+	}
+
+	// A new tileset has nothing cached, so it sees the change...
+	TilesetPtr fresh(openActors(makeString(ACTR_INFO_FRAMES), tiles));
+	TilesetPtr freshSub(fresh->openTileset(fresh->getItems()[1]));
+	StdImageDataPtr changed = freshSub->openImage(freshSub->getItems()[0])
+		->toStandard();
+	BOOST_REQUIRE_NE((int)changed[0], (int)original);
+
+	// ...but the original one still has the frame cached, even when the
+	// actor is opened again.
+	TilesetPtr reopened(tileset->openTileset(actors[1]));
+	ImagePtr img(reopened->openImage(reopened->getItems()[0]));
+	StdImageDataPtr cached = img->toStandard();
+	BOOST_CHECK_EQUAL((int)cached[0], (int)original);
+
+	// Replacing the frame drops it from the cache
+	StdImageDataPtr newImg(new uint8_t[8 * 8]);
+	memset(newImg.get(), 0x0F, 8 * 8);
+	StdImageDataPtr newMask(new uint8_t[8 * 8]);
+	memset(newMask.get(), Image::Mask_Vis_Opaque, 8 * 8);
+	img->fromStandard(newImg, newMask);
+
+	StdImageDataPtr after = img->toStandard();
+	BOOST_CHECK_EQUAL((int)after[0], 0x0F);
+	BOOST_CHECK_EQUAL((int)after[8 * 8 - 1], 0x0F);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
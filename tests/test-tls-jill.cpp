@@ -0,0 +1,258 @@
+/**
+ * @file  test-tls-jill.cpp
+ * @brief Test code for Jill of the Jungle tilesets.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <sstream>
+#include <camoto/gamegraphics/image.hpp>
+#include "../src/tls-jill.hpp"
+#include "../examples/manifest.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Colour map used by the test data.
+/**
+ * The first 16 colours are reversed, so the map is its own inverse.
+ */
+static StdImageDataPtr jillColourMap()
+{
+	StdImageDataPtr map(new uint8_t[256]);
+	for (int i = 0; i < 256; i++) map[i] = (i < 16) ? 15 - i : i;
+	return map;
+}
+
+#define TESTDATA_INITIAL_8x8 \
+	"\x08\x08\x00" \
+	"\x00\x00\x00\x00\x00\x00\x00\x00" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x06\x06\x06\x06\x06\x06\x05"
+
+#define TESTDATA_INITIAL_16x16 \
+	"\x10\x10\x00" \
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x06\x05"
+
+#define TESTDATA_INITIAL_9x9 \
+	"\x09\x09\x00" \
+	"\x00\x00\x00\x00\x00\x00\x00\x00\x00" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x06\x06\x06\x06\x06\x06\x06\x05"
+
+#define TESTDATA_INITIAL_8x4 \
+	"\x08\x04\x00" \
+	"\x00\x00\x00\x00\x00\x00\x00\x00" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x0F\x0F\x0F\x0F\x0F\x0F\x05" \
+	"\x03\x06\x06\x06\x06\x06\x06\x05"
+
+// Image_Jill is only reachable through a tileset, so create it directly with
+// the reversed colour map.
+#define IMG_OPEN_CODE \
+	this->img = ImagePtr(new Image_Jill(this->base, jillColourMap(), \
+		jillColourMap()));
+
+// New images start with a blank width, height and flags header
+#define IMG_CREATE_CODE \
+	this->base->write(std::string(3, '\0')); \
+	IMG_OPEN_CODE
+
+#define IMG_KNOWS_SIZE
+#define IMG_CLASS img_jill
+#include "test-img.hpp"
+
+/// Sub-tileset with a reversed 4bpp colour map and two 4x2 tiles.
+#define JILL_SUB \
+	"\x02" "\x00\x00" "\x00\x00" "\x00\x00" "\x00\x00" "\x04" "\x00\x00" \
+	"\x00\x00\x0F\x00" \
+	"\x00\x00\x0E\x00" \
+	"\x00\x00\x0D\x00" \
+	"\x00\x00\x0C\x00" \
+	"\x00\x00\x0B\x00" \
+	"\x00\x00\x0A\x00" \
+	"\x00\x00\x09\x00" \
+	"\x00\x00\x08\x00" \
+	"\x00\x00\x07\x00" \
+	"\x00\x00\x06\x00" \
+	"\x00\x00\x05\x00" \
+	"\x00\x00\x04\x00" \
+	"\x00\x00\x03\x00" \
+	"\x00\x00\x02\x00" \
+	"\x00\x00\x01\x00" \
+	"\x00\x00\x00\x00" \
+	"\x04\x02\x00" "\x0F\x0E\x0D\x0C" "\x00\x01\x02\x03" \
+	"\x04\x02\x00" "\x05\x05\x05\x05" "\x0A\x0A\x0A\x0A"
+
+/// Tileset file with JILL_SUB in the first slot and the rest empty.
+#define JILL_FILE \
+	"\x00\x03\x00\x00" ZERO_256 ZERO_128 ZERO_64 ZERO_32 ZERO_16 ZERO_8 ZERO_4 \
+	"\x62\x00" ZERO_128 ZERO_64 ZERO_32 ZERO_16 ZERO_8 ZERO_4 ZERO_2 \
+	JILL_SUB
+
+BOOST_AUTO_TEST_CASE(tls_jill_round_trip)
+{
+	BOOST_TEST_MESSAGE("Decoding and encoding every Jill tile leaves the file "
+		"unchanged");
+
+	ManagerPtr manager(getManager());
+	TilesetTypePtr type(manager->getTilesetTypeByCode("tls-jill"));
+	BOOST_REQUIRE_MESSAGE(type, "Could not find tileset code tls-jill");
+
+	stream::string_sptr base(new stream::string());
+	base << makeString(JILL_FILE);
+	SuppData suppData;
+	TilesetPtr tileset(type->open(base, suppData));
+	TilesetPtr sub(tileset->openTileset(tileset->getItems()[0]));
+	const Tileset::VC_ENTRYPTR& tiles = sub->getItems();
+	BOOST_REQUIRE_EQUAL(tiles.size(), 2);
+
+	// The colour map is applied, so the first tile comes out as 0..3, 15..12
+	StdImageDataPtr pixels = sub->openImage(tiles[0])->toStandard();
+	BOOST_CHECK_EQUAL((int)pixels[0], 0x00);
+	BOOST_CHECK_EQUAL((int)pixels[3], 0x03);
+	BOOST_CHECK_EQUAL((int)pixels[4], 0x0F);
+	BOOST_CHECK_EQUAL((int)pixels[7], 0x0C);
+
+	for (Tileset::VC_ENTRYPTR::const_iterator
+		i = tiles.begin(); i != tiles.end(); i++
+	) {
+		ImagePtr img(sub->openImage(*i));
+		img->fromStandard(img->toStandard(), img->toStandardMask());
+	}
+	sub->flush();
+	tileset->flush();
+
+	default_sample sample;
+	BOOST_CHECK_MESSAGE(
+		sample.is_equal(makeString(JILL_FILE), *(base->str()), 16),
+		"Converting Jill tiles to and from standard format changed the file"
+	);
+}
+
+#define JILL_MANIFEST "test-tls-jill.manifest"
+
+/// Offset of the first colour map entry's value in JILL_FILE.
+#define JILL_COLOURMAP_OFFSET (768 + 12 + 2)
+
+/// Fingerprints gametls would record for JILL_SUB and its images, by ID.
+typedef std::map<std::string, uint64_t> JillFingerprints;
+
+/// Fingerprint JILL_SUB and its images the way gametls --manifest does.
+/**
+ * @param base
+ *   Tileset file to open.
+ *
+ * @param mixed
+ *   On return, the fingerprints recorded in the manifest.
+ *
+ * @param own
+ *   On return, the fingerprints of the images' own data.
+ */
+static void jillFingerprints(stream::string_sptr base, JillFingerprints *mixed,
+	JillFingerprints *own)
+{
+	ManagerPtr manager(getManager());
+	TilesetTypePtr type(manager->getTilesetTypeByCode("tls-jill"));
+	BOOST_REQUIRE_MESSAGE(type, "Could not find tileset code tls-jill");
+
+	SuppData suppData;
+	TilesetPtr tileset(type->open(base, suppData));
+	uint64_t subFingerprint;
+	BOOST_REQUIRE(getManifestFingerprint(tileset, tileset->getItems()[0],
+		hashPalette(tileset), 0, &subFingerprint));
+	(*mixed)["0.0"] = subFingerprint;
+
+	TilesetPtr sub(tileset->openTileset(tileset->getItems()[0]));
+	const Tileset::VC_ENTRYPTR& tiles = sub->getItems();
+	uint64_t palHash = hashPalette(sub);
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		std::ostringstream ss;
+		ss << "0.0." << i;
+		std::string id = ss.str();
+		BOOST_REQUIRE(getManifestFingerprint(sub, tiles[i], palHash,
+			subFingerprint, &(*mixed)[id]));
+		BOOST_REQUIRE(sub->getFingerprint(tiles[i], &(*own)[id]));
+	}
+	return;
+}
+
+BOOST_AUTO_TEST_CASE(tls_jill_manifest_colour_map)
+{
+	BOOST_TEST_MESSAGE("Changing a Jill colour map writes the images out again");
+
+	stream::string_sptr base(new stream::string());
+	base << makeString(JILL_FILE);
+
+	JillFingerprints before, beforeOwn;
+	jillFingerprints(base, &before, &beforeOwn);
+	BOOST_REQUIRE_EQUAL(before.size(), 3);
+
+	std::remove(JILL_MANIFEST);
+	{
+		Manifest manifest(JILL_MANIFEST);
+		for (JillFingerprints::const_iterator
+			i = before.begin(); i != before.end(); i++
+		) {
+			manifest.record(i->first, i->second, i->first.compare("0.0") == 0);
+		}
+		manifest.save();
+	}
+
+	base->seekp(JILL_COLOURMAP_OFFSET, stream::start);
+	base->write("\x0E", 1);
+
+	JillFingerprints after, afterOwn;
+	jillFingerprints(base, &after, &afterOwn);
+
+	Manifest manifest(JILL_MANIFEST);
+	std::remove(JILL_MANIFEST);
+
+	BOOST_CHECK(!manifest.matches("0.0", after["0.0"], true));
+
+	// The image data itself is untouched, only the sub-tileset header
+	BOOST_CHECK_EQUAL(afterOwn["0.0.0"], beforeOwn["0.0.0"]);
+	BOOST_CHECK_EQUAL(afterOwn["0.0.1"], beforeOwn["0.0.1"]);
+	BOOST_CHECK(!manifest.matches("0.0.0", after["0.0.0"], false));
+	BOOST_CHECK(!manifest.matches("0.0.1", after["0.0.1"], false));
+}
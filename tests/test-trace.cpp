@@ -0,0 +1,100 @@
+/**
+ * @file  test-trace.cpp
+ * @brief Test code for the trace-event output.
+ *
+ * Copyright (C) 2010-2015 Adam Nielsen <malvineous@shikadi.net>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <set>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <camoto/stream_string.hpp>
+#include <camoto/gamegraphics.hpp>
+
+#include "tests.hpp"
+
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+#define TRACE_CODE "img-cga-raw-linear-fullscreen"
+#define TRACE_SIZE 16000
+#define TRACE_FILE "test-trace.json"
+
+/// Open and decode one image, producing a few spans.
+static void traceDecode(ImageTypePtr type)
+{
+	stream::string_sptr base(new stream::string());
+	base->write(std::string(TRACE_SIZE, '\x55'));
+	SuppData suppData;
+	ImagePtr img(type->open(base, suppData));
+	img->toStandard();
+	return;
+}
+
+BOOST_AUTO_TEST_CASE(trace_decode)
+{
+	BOOST_TEST_MESSAGE("Write a trace of decodes in two threads");
+
+	startTrace(TRACE_FILE);
+	BOOST_REQUIRE(isTracing());
+
+	// Types are only wrapped with spans if tracing was on when they were fetched
+	ManagerPtr manager(getManager());
+	ImageTypePtr type(manager->getImageTypeByCode(TRACE_CODE));
+	BOOST_REQUIRE_MESSAGE(type, "Invalid image code " TRACE_CODE);
+
+	traceDecode(type);
+	boost::thread worker(traceDecode, type);
+	worker.join();
+
+	stopTrace();
+	BOOST_REQUIRE(!isTracing());
+
+	boost::property_tree::ptree trace;
+	BOOST_REQUIRE_NO_THROW(boost::property_tree::read_json(TRACE_FILE, trace));
+	std::remove(TRACE_FILE);
+
+	std::set<std::string> names;
+	std::set<int> threads;
+	const boost::property_tree::ptree& events = trace.get_child("traceEvents");
+	for (boost::property_tree::ptree::const_iterator
+		i = events.begin(); i != events.end(); i++
+	) {
+		BOOST_CHECK_EQUAL(i->second.get<std::string>("ph"), "X");
+		names.insert(i->second.get<std::string>("name"));
+		threads.insert(i->second.get<int>("tid"));
+	}
+	BOOST_CHECK(names.count("ImageType::open"));
+	BOOST_CHECK(names.count("Image::toStandard"));
+
+	// Each thread gets its own small ID, starting from 1
+	BOOST_CHECK_EQUAL(threads.size(), 2);
+	BOOST_CHECK(threads.count(1));
+	BOOST_CHECK(threads.count(2));
+}
+
+BOOST_AUTO_TEST_CASE(trace_unwritable)
+{
+	BOOST_TEST_MESSAGE("Tracing stays off if the file can't be created");
+
+	BOOST_CHECK_THROW(startTrace("nonexistent-dir/" TRACE_FILE),
+		stream::open_error);
+	BOOST_CHECK(!isTracing());
+}
@@ -22,12 +22,100 @@
 #define BOOST_TEST_DYN_LINK
 #include <boost/test/unit_test.hpp>
 
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <new>
 
 #include <camoto/debug.hpp>
+#include <camoto/stream_string.hpp>
+#include "../src/img-vga-raw.hpp"
 #include "tests.hpp"
 
+using namespace camoto;
+using namespace camoto::gamegraphics;
+
+/// Total number of allocations made by the test program.
+static unsigned long allocTotalCount = 0;
+
+/// Total number of bytes allocated by the test program.
+static unsigned long allocTotalBytes = 0;
+
+// Exception specifications were removed from operator new in C++11
+#if __cplusplus >= 201103L
+#define ALLOC_THROW
+#define ALLOC_NOTHROW noexcept
+#else
+#define ALLOC_THROW throw(std::bad_alloc)
+#define ALLOC_NOTHROW throw()
+#endif
+
+/// Allocate memory for operator new, counting the request.
+static void *countedAlloc(std::size_t size)
+{
+	// Some tests run multiple threads
+	__sync_fetch_and_add(&allocTotalCount, 1);
+	__sync_fetch_and_add(&allocTotalBytes, size);
+	void *p = std::malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void *operator new(std::size_t size) ALLOC_THROW
+{
+	return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size) ALLOC_THROW
+{
+	return countedAlloc(size);
+}
+
+void operator delete(void *p) ALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) ALLOC_NOTHROW
+{
+	std::free(p);
+}
+
+AllocCounter::AllocCounter()
+	:	startCount(allocTotalCount),
+		startBytes(allocTotalBytes)
+{
+}
+
+unsigned long AllocCounter::count() const
+{
+	return allocTotalCount - this->startCount;
+}
+
+unsigned long AllocCounter::bytes() const
+{
+	return allocTotalBytes - this->startBytes;
+}
+
+ImagePtr createTestImage(stream::inout_sptr data, unsigned int width,
+	unsigned int height)
+{
+	return ImagePtr(new Image_VGARaw(data, width, height,
+		createPalette_DefaultVGA()));
+}
+
+void addTile(TilesetFromImages_List *content, unsigned int width,
+	unsigned int height, const std::string& pixels, TestImageFactory factory)
+{
+	stream::string_sptr data(new stream::string());
+	data->write(pixels);
+	TilesetFromImages_Item item;
+	item.isImage = true;
+	item.image = factory(data, width, height);
+	content->push_back(item);
+	return;
+}
+
 void default_sample::printNice(boost::test_tools::predicate_result& res,
 	const std::string& s, const std::string& diff, unsigned int width)
 {
@@ -21,13 +21,69 @@
 #ifndef _CAMOTO_GAMEGRAPHICS_TESTS_HPP_
 #define _CAMOTO_GAMEGRAPHICS_TESTS_HPP_
 
+#include <boost/function.hpp>
 #include <boost/test/unit_test.hpp>
 #include <camoto/stream.hpp>
+#include <camoto/gamegraphics/tileset.hpp>
 #include <stdint.h>
 
 // Allow a string constant to be passed around with embedded nulls
 #define makeString(x)  std::string((const char *)(x), sizeof((x)) - 1)
 
+/// Count the heap allocations made while an instance is in scope.
+/**
+ * The test program replaces the global operator new, so this sees every
+ * allocation made by the library and libgamecommon as well as the tests.
+ * Keep assertions outside the measured code, as Boost.Test allocates too.
+ */
+class AllocCounter
+{
+	public:
+		/// Start counting from now.
+		AllocCounter();
+
+		/// Number of allocations since construction.
+		unsigned long count() const;
+
+		/// Total bytes requested by those allocations.
+		unsigned long bytes() const;
+
+	protected:
+		unsigned long startCount;
+		unsigned long startBytes;
+};
+
+/// Create an image of the given size, reading its pixels from data.
+typedef boost::function<camoto::gamegraphics::ImagePtr(
+	camoto::stream::inout_sptr data, unsigned int width, unsigned int height)>
+	TestImageFactory;
+
+/// Create a raw VGA image using the default VGA palette.
+camoto::gamegraphics::ImagePtr createTestImage(camoto::stream::inout_sptr data,
+	unsigned int width, unsigned int height);
+
+/// Add an image to a list for createTilesetFromImages().
+/**
+ * @param content
+ *   List to append the image to.
+ *
+ * @param width
+ *   Image width in pixels.
+ *
+ * @param height
+ *   Image height in pixels.
+ *
+ * @param pixels
+ *   8bpp image data, width * height bytes.
+ *
+ * @param factory
+ *   Function creating the image around the pixel data.  Defaults to a raw
+ *   VGA image.
+ */
+void addTile(camoto::gamegraphics::TilesetFromImages_List *content,
+	unsigned int width, unsigned int height, const std::string& pixels,
+	TestImageFactory factory = createTestImage);
+
 struct default_sample {
 
 	void printNice(boost::test_tools::predicate_result& res, const std::string& s,